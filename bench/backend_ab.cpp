@@ -0,0 +1,372 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+//backend_ab: replays a recorded command trace into the backend it was built with
+//backend_ab_stl --generate=1000000 --trace=trace.resp
+//backend_ab_stl --trace=trace.resp --output=stl.json
+//backend_ab_eastl --trace=trace.resp --output=eastl.json
+//A trace is a file of RESP commands, an appendonly.aof works as is. Peak RSS only grows during a
+//run, use --family to get it per data type.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "argparse/argparse.hpp"
+#include "backend.hpp"
+#include "execute_command.hpp"
+#include "resp_command.hpp"
+#include "resp_command_parser.hpp"
+
+#include "../src/eastl_stub_allocator.inl"
+
+using steady_clock = std::chrono::steady_clock;
+
+//counting replacements of the scalar operator new/delete, the array forms are counted by the
+//EASTL arena when it is compiled in
+namespace allocation_counter
+{
+    constexpr std::size_t HEADER_SIZE = 16;
+    static std::atomic<std::uint64_t> g_allocations{0};
+    static std::atomic<std::uint64_t> g_deallocations{0};
+    static std::atomic<std::int64_t> g_bytes_in_use{0};
+
+    static void* allocate(std::size_t size) noexcept
+    {
+        auto base = static_cast<char*>(std::malloc(HEADER_SIZE + size));
+        if (!base)
+            return nullptr;
+        *reinterpret_cast<std::size_t*>(base) = size;
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        g_bytes_in_use.fetch_add(static_cast<std::int64_t>(size), std::memory_order_relaxed);
+        return base + HEADER_SIZE;
+    }
+
+    static void deallocate(void* p) noexcept
+    {
+        if (!p)
+            return;
+        auto base = static_cast<char*>(p) - HEADER_SIZE;
+        g_deallocations.fetch_add(1, std::memory_order_relaxed);
+        g_bytes_in_use.fetch_sub(static_cast<std::int64_t>(*reinterpret_cast<std::size_t*>(base)), std::memory_order_relaxed);
+        std::free(base);
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* p = allocation_counter::allocate(size))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocation_counter::allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    allocation_counter::deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    allocation_counter::deallocate(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    allocation_counter::deallocate(p);
+}
+
+struct memory_counters final
+{
+    std::uint64_t allocations;
+    std::int64_t bytes_in_use;
+
+    static memory_counters now()
+    {
+        memory_counters counters{ allocation_counter::g_allocations.load(), allocation_counter::g_bytes_in_use.load() };
+#ifdef EASTL_BACKEND_HPP
+        auto arena = eastl_arena::stats();
+        counters.allocations += arena.allocations;
+        counters.bytes_in_use += static_cast<std::int64_t>(arena.bytes_in_use);
+#endif
+        return counters;
+    }
+};
+
+static std::size_t peak_rss_bytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+enum class family
+{
+    ALL, STRING, SET, ZSET, OTHER
+};
+
+static const char* to_string(family f)
+{
+    switch (f)
+    {
+        case family::ALL: return "all";
+        case family::STRING: return "string";
+        case family::SET: return "set";
+        case family::ZSET: return "zset";
+        default: return "other";
+    }
+}
+
+//command family by (uppercase) name, keyspace commands belong to every family
+static family family_of(const std::string& name)
+{
+    if (name == "SET" || name == "GET")
+        return family::STRING;
+    if (name.size() > 1 && name[0] == 'S' && name != "SELECT" && name != "SAVE")
+        return family::SET;
+    if (name.size() > 1 && name[0] == 'Z')
+        return family::ZSET;
+    return family::OTHER;
+}
+
+static DbValueTypeEnum value_type_of(family f)
+{
+    switch (f)
+    {
+        case family::STRING: return DbValueTypeEnum::STRING;
+        case family::SET: return DbValueTypeEnum::SET;
+        case family::ZSET: return DbValueTypeEnum::SORTEDSET;
+        default: return DbValueTypeEnum::NONE;
+    }
+}
+
+static std::string encode(const std::vector<std::string>& args)
+{
+    std::string out = "*" + std::to_string(args.size()) + "\r\n";
+    for (const auto& arg : args)
+        out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    return out;
+}
+
+//synthetic trace: SELECT 0 then a mix of writes and reads over every data type
+static void generate_trace(const std::string& path, std::size_t count, std::size_t keyspace, std::uint64_t seed)
+{
+    std::mt19937_64 rng{seed};
+    std::ofstream ofs{path, std::ios::binary};
+    auto pick = [&](std::size_t n) { return std::to_string(std::uniform_int_distribution<std::size_t>(0, n - 1)(rng)); };
+    const std::size_t collections = std::max<std::size_t>(keyspace / 100, 1);
+    ofs << encode({ "SELECT", "0" });
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto r = std::uniform_int_distribution<int>(0, 99)(rng);
+        if (r < 30) ofs << encode({ "SET", "key:" + pick(keyspace), std::string(16 + rng() % 112, 'v') });
+        else if (r < 45) ofs << encode({ "GET", "key:" + pick(keyspace) });
+        else if (r < 48) ofs << encode({ "DEL", "key:" + pick(keyspace) });
+        else if (r < 63) ofs << encode({ "SADD", "set:" + pick(collections), "member:" + pick(keyspace) });
+        else if (r < 68) ofs << encode({ "SISMEMBER", "set:" + pick(collections), "member:" + pick(keyspace) });
+        else if (r < 70) ofs << encode({ "SREM", "set:" + pick(collections), "member:" + pick(keyspace) });
+        else if (r < 72) ofs << encode({ "SINTER", "set:" + pick(collections), "set:" + pick(collections) });
+        else if (r < 87) ofs << encode({ "ZADD", "zset:" + pick(collections), pick(1000000), "member:" + pick(keyspace) });
+        else if (r < 92) ofs << encode({ "ZSCORE", "zset:" + pick(collections), "member:" + pick(keyspace) });
+        else if (r < 94) ofs << encode({ "ZREM", "zset:" + pick(collections), "member:" + pick(keyspace) });
+        else ofs << encode({ "ZRANGE", "zset:" + pick(collections), "0", "9" });
+    }
+    if (!ofs)
+        throw std::runtime_error("cannot write " + path);
+}
+
+struct phase_result final
+{
+    family f;
+    std::size_t commands;
+    std::size_t errors;
+    double seconds;
+    std::uint64_t allocations;
+    std::int64_t bytes;
+    std::size_t keys;
+};
+
+static const std::string CLIENT_ID = "BACKEND-AB";
+
+//replays the commands of a family into empty databases
+static phase_result replay(const std::vector<std::vector<std::string_view>>& trace, family f)
+{
+    clear_all_databases();
+    std::deque<resp::command> commands;
+    for (const auto& args : trace)
+    {
+        auto cmd_family = family_of(to_upper(args[0]));
+        if (f == family::ALL || cmd_family == f || cmd_family == family::OTHER)
+            commands.emplace_back(std::vector<std::string_view>{args});
+    }
+
+    phase_result result{ f, commands.size() };
+    const auto before = memory_counters::now();
+    const auto start = steady_clock::now();
+    for (const auto& cmd : commands)
+    {
+        bool unk_cmd{};
+        Context_t ctx{CLIENT_ID};
+        auto reply = execute_command<Context_t, Strategy_t>(ctx, cmd, unk_cmd);
+        if (!reply.empty() && reply[0] == '-')
+            ++result.errors;
+    }
+    result.seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+    const auto after = memory_counters::now();
+    result.allocations = after.allocations - before.allocations;
+    result.bytes = after.bytes_in_use - before.bytes_in_use;
+
+    const auto type = value_type_of(f);
+    for (const auto& db : g_databases)
+    {
+        auto gen = db.keys();
+        while (auto key_opt = gen.next())
+            if (type == DbValueTypeEnum::NONE || db.lookup_type_of(*key_opt) == type)
+                ++result.keys;
+    }
+    return result;
+}
+
+static void write_json(std::ostream& os, const std::vector<phase_result>& results, const std::string& trace)
+{
+    os << "{\n  \"backend\": \"" << g_backend << "\",\n  \"trace\": \"" << trace
+       << "\",\n  \"peak_rss_bytes\": " << peak_rss_bytes() << ",\n  \"phases\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& r = results[i];
+        os << (i ? ",\n" : "\n")
+           << "    { \"family\": \"" << to_string(r.f) << "\", \"commands\": " << r.commands
+           << ", \"errors\": " << r.errors
+           << ", \"ops_per_sec\": " << (r.seconds > 0 ? r.commands / r.seconds : 0.0)
+           << ", \"allocations\": " << r.allocations
+           << ", \"bytes_in_use\": " << r.bytes
+           << ", \"keys\": " << r.keys
+           << ", \"bytes_per_key\": " << (r.keys ? static_cast<double>(r.bytes) / r.keys : 0.0) << " }";
+    }
+    os << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    argparse::ArgumentParser arg_parser("backend_ab");
+    arg_parser.add_argument("--trace").help("RESP command file to replay (or to write with --generate)").required().nargs(1);
+    arg_parser.add_argument("--generate").help("write a synthetic trace with this many commands and exit").default_value(0).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--keyspace").help("distinct keys of a generated trace").default_value(100000).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--seed").help("random seed of a generated trace").default_value(1).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--family").help("all, string, set, zset or every (default)").default_value(std::string{"every"}).nargs(1);
+    arg_parser.add_argument("--output").help("JSON file, default is stdout").default_value(std::string{}).nargs(1);
+    try
+    {
+        arg_parser.parse_args(argc, argv);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        std::cerr << arg_parser;
+        return 1;
+    }
+
+    const auto trace_path = arg_parser.get<std::string>("--trace");
+    try
+    {
+        if (auto count = arg_parser.get<int>("--generate"); count > 0)
+        {
+            generate_trace(trace_path, static_cast<std::size_t>(count),
+                           static_cast<std::size_t>(std::max(arg_parser.get<int>("--keyspace"), 1)),
+                           static_cast<std::uint64_t>(arg_parser.get<int>("--seed")));
+            return 0;
+        }
+
+        std::ifstream ifs{trace_path, std::ios::binary};
+        if (!ifs)
+            throw std::runtime_error("cannot read " + trace_path);
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        const std::string content = ss.str();
+        std::vector<std::vector<std::string_view>> trace;
+        resp::command_parser parser { content.data(), content.data() + content.size() };
+        while (auto args_opt = parser.parse_next())
+            if (!args_opt->empty())
+                trace.push_back(std::move(*args_opt));
+        if (parser.position != content.data() + content.size())
+            std::cerr << "ignoring " << (content.data() + content.size() - parser.position) << " trailing bytes\n";
+
+        std::vector<family> phases;
+        const auto selected = arg_parser.get<std::string>("--family");
+        if (selected == "every") phases = { family::ALL, family::STRING, family::SET, family::ZSET };
+        else if (selected == "all") phases = { family::ALL };
+        else if (selected == "string") phases = { family::STRING };
+        else if (selected == "set") phases = { family::SET };
+        else if (selected == "zset") phases = { family::ZSET };
+        else throw std::invalid_argument("unknown family: " + selected);
+
+        Context_t::create_or_remove_client(CLIENT_ID);
+        std::vector<phase_result> results;
+        for (auto f : phases)
+        {
+            results.push_back(replay(trace, f));
+            const auto& r = results.back();
+            std::cerr << g_backend << ' ' << to_string(f) << ": " << static_cast<std::uint64_t>(r.commands / r.seconds) << " ops/s, "
+                      << r.allocations << " allocations, " << r.keys << " keys, "
+                      << (r.keys ? r.bytes / static_cast<std::int64_t>(r.keys) : 0) << " bytes/key\n";
+        }
+        clear_all_databases();
+        Context_t::create_or_remove_client(CLIENT_ID);
+
+        auto output = arg_parser.get<std::string>("--output");
+        if (output.empty())
+        {
+            write_json(std::cout, results, trace_path);
+        }
+        else
+        {
+            std::ofstream ofs{output};
+            write_json(ofs, results, trace_path);
+            if (!ofs)
+                throw std::runtime_error("cannot write " + output);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "backend_ab: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
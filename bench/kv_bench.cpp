@@ -0,0 +1,584 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+//kv_bench: load generator for a running kv_store
+//kv_bench --port=1234 --connections=50 --pipeline=16 --requests=1000000 --keyspace=100000
+//         --value-size=uniform:16:512 --mix=GET=60,SET=30,SADD=4,ZADD=4,ZRANGE=1,SINTER=1
+//kv_bench --unixsocket=/tmp/kv_store.sock ... connects to a server started with the same --unixsocket
+
+#include <zmq.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "hdr_histogram.hpp"
+
+using steady_clock = std::chrono::steady_clock;
+
+enum class op_type : std::size_t
+{
+    GET, SET, SADD, ZADD, ZRANGE, SINTER, COUNT
+};
+
+constexpr std::array<std::string_view, static_cast<std::size_t>(op_type::COUNT)> OP_NAMES{
+    "GET", "SET", "SADD", "ZADD", "ZRANGE", "SINTER"
+};
+
+struct options final
+{
+    std::string host;
+    int port;
+    std::string unixsocket;     //overrides host and port when set
+    int db;
+    int connections;
+    int pipeline;
+    std::uint64_t requests;
+    double duration;            //seconds, overrides requests when set
+    std::uint64_t keyspace;
+    std::uint64_t collections;  //sets and sorted sets shared by SADD/ZADD/ZRANGE/SINTER
+    std::string value_size;
+    std::string mix;
+    bool populate;
+    std::uint64_t seed;
+};
+
+//fixed:N, uniform:MIN:MAX or normal:MEAN:STDDEV
+class value_size_distribution final
+{
+    enum class kind { FIXED, UNIFORM, NORMAL } k = kind::FIXED;
+    double a = 64, b = 0;
+public:
+    explicit value_size_distribution(std::string_view spec)
+    {
+        auto next = [&spec]() {
+            auto pos = spec.find(':');
+            auto field = spec.substr(0, pos);
+            spec.remove_prefix(pos == std::string_view::npos ? spec.size() : pos + 1);
+            return field;
+        };
+        auto number = [](std::string_view sv) {
+            double value{};
+            auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+            if (ec != std::errc{} || ptr != sv.data() + sv.size() || value < 0)
+                throw std::invalid_argument("invalid value size: " + std::string(sv));
+            return value;
+        };
+        auto name = next();
+        if (name == "fixed") { k = kind::FIXED; a = number(next()); }
+        else if (name == "uniform") { k = kind::UNIFORM; a = number(next()); b = number(next()); }
+        else if (name == "normal") { k = kind::NORMAL; a = number(next()); b = number(next()); }
+        else throw std::invalid_argument("value size must be fixed:N, uniform:MIN:MAX or normal:MEAN:STDDEV");
+        if (k == kind::UNIFORM && b < a)
+            throw std::invalid_argument("uniform value size needs MIN <= MAX");
+    }
+
+    std::size_t max() const noexcept
+    {
+        switch (k)
+        {
+            case kind::FIXED: return static_cast<std::size_t>(a);
+            case kind::UNIFORM: return static_cast<std::size_t>(b);
+            default: return static_cast<std::size_t>(a + 6 * b);
+        }
+    }
+
+    template<typename Rng>
+    std::size_t operator()(Rng& rng) const
+    {
+        switch (k)
+        {
+            case kind::FIXED: return static_cast<std::size_t>(a);
+            case kind::UNIFORM: return std::uniform_int_distribution<std::size_t>(static_cast<std::size_t>(a), static_cast<std::size_t>(b))(rng);
+            default: return static_cast<std::size_t>(std::clamp(std::normal_distribution<double>(a, b)(rng), 1.0, a + 6 * b));
+        }
+    }
+};
+
+//GET=60,SET=30,... weights of each command family
+class command_mix final
+{
+    std::array<double, static_cast<std::size_t>(op_type::COUNT)> cumulative{};
+public:
+    explicit command_mix(std::string_view spec)
+    {
+        std::array<double, static_cast<std::size_t>(op_type::COUNT)> weights{};
+        while (!spec.empty())
+        {
+            auto pos = spec.find(',');
+            auto item = spec.substr(0, pos);
+            spec.remove_prefix(pos == std::string_view::npos ? spec.size() : pos + 1);
+            auto eq = item.find('=');
+            if (eq == std::string_view::npos)
+                throw std::invalid_argument("mix items must be COMMAND=WEIGHT");
+            auto name = item.substr(0, eq);
+            auto weight_sv = item.substr(eq + 1);
+            double weight{};
+            auto [ptr, ec] = std::from_chars(weight_sv.data(), weight_sv.data() + weight_sv.size(), weight);
+            if (ec != std::errc{} || weight < 0)
+                throw std::invalid_argument("invalid mix weight: " + std::string(item));
+            std::size_t i = 0;
+            while (i < OP_NAMES.size() && OP_NAMES[i] != name) ++i;
+            if (i == OP_NAMES.size())
+                throw std::invalid_argument("unknown mix command: " + std::string(name));
+            weights[i] = weight;
+        }
+        double total = 0;
+        for (std::size_t i = 0; i < weights.size(); ++i)
+            cumulative[i] = total += weights[i];
+        if (total <= 0)
+            throw std::invalid_argument("mix needs at least one positive weight");
+        for (auto& c : cumulative)
+            c /= total;
+    }
+
+    template<typename Rng>
+    op_type operator()(Rng& rng) const
+    {
+        double r = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        std::size_t i = 0;
+        while (i + 1 < cumulative.size() && r >= cumulative[i]) ++i; //zero weights are never selected
+        return static_cast<op_type>(i);
+    }
+};
+
+static void append_array_size(std::string& out, std::size_t size)
+{
+    out.push_back('*');
+    out.append(std::to_string(size));
+    out.append("\r\n");
+}
+
+static void append_bulk(std::string& out, std::string_view sv)
+{
+    out.push_back('$');
+    out.append(std::to_string(sv.size()));
+    out.append("\r\n");
+    out.append(sv);
+    out.append("\r\n");
+}
+
+static void append_command(std::string& out, std::initializer_list<std::string_view> args)
+{
+    append_array_size(out, args.size());
+    for (auto arg : args)
+        append_bulk(out, arg);
+}
+
+//bytes of the first complete reply in buf, 0 when it is still incomplete
+static std::size_t reply_length(std::string_view buf, std::size_t pos = 0)
+{
+    if (pos >= buf.size())
+        return 0;
+    auto crlf = buf.find("\r\n", pos);
+    if (crlf == std::string_view::npos)
+        return 0;
+    const std::size_t header = crlf + 2 - pos;
+    switch (buf[pos])
+    {
+        case '+': case '-': case ':':
+            return header;
+        case '$':
+        {
+            long long size = std::strtoll(buf.data() + pos + 1, nullptr, 10);
+            if (size < 0)
+                return header;
+            std::size_t total = header + static_cast<std::size_t>(size) + 2;
+            return pos + total <= buf.size() ? total : 0;
+        }
+        case '*':
+        {
+            long long count = std::strtoll(buf.data() + pos + 1, nullptr, 10);
+            std::size_t total = header;
+            for (long long i = 0; i < count; ++i)
+            {
+                std::size_t n = reply_length(buf, pos + total);
+                if (!n)
+                    return 0;
+                total += n;
+            }
+            return total;
+        }
+        default:
+            throw std::runtime_error("unexpected reply from server");
+    }
+}
+
+struct connection final
+{
+    std::string id;
+    std::string received;
+    struct pending final
+    {
+        op_type op;
+        steady_clock::time_point sent;
+    };
+    std::deque<pending> in_flight;
+};
+
+class bench final
+{
+    const options& opts;
+    value_size_distribution value_size;
+    command_mix mix;
+    std::mt19937_64 rng;
+    std::string value_source;
+    void* socket = nullptr;
+    std::vector<connection> conns;
+
+    std::array<hdr_histogram, static_cast<std::size_t>(op_type::COUNT)> latencies{};
+    std::uint64_t issued = 0, completed = 0, errors = 0;
+
+    void send(connection& c, const std::string& data)
+    {
+        zmq_send(socket, c.id.data(), c.id.size(), ZMQ_SNDMORE);
+        zmq_send(socket, data.data(), data.size(), 0);
+    }
+
+    std::string key(const char* prefix, std::uint64_t n) const
+    {
+        return prefix + std::to_string(n);
+    }
+
+    //one random command of the mix
+    op_type next_command(std::string& out)
+    {
+        auto op = mix(rng);
+        auto k = std::uniform_int_distribution<std::uint64_t>(0, opts.keyspace - 1)(rng);
+        auto c = std::uniform_int_distribution<std::uint64_t>(0, opts.collections - 1)(rng);
+        switch (op)
+        {
+            case op_type::GET:
+                append_command(out, { "GET", key("key:", k) });
+                break;
+            case op_type::SET:
+            {
+                auto size = value_size(rng);
+                auto offset = std::uniform_int_distribution<std::size_t>(0, value_source.size() - size)(rng);
+                append_command(out, { "SET", key("key:", k), std::string_view(value_source).substr(offset, size) });
+                break;
+            }
+            case op_type::SADD:
+                append_command(out, { "SADD", key("set:", c), key("member:", k) });
+                break;
+            case op_type::ZADD:
+                append_command(out, { "ZADD", key("zset:", c), std::to_string(k), key("member:", k) });
+                break;
+            case op_type::ZRANGE:
+                append_command(out, { "ZRANGE", key("zset:", c), "0", "9" });
+                break;
+            default:
+            {
+                auto other = std::uniform_int_distribution<std::uint64_t>(0, opts.collections - 1)(rng);
+                append_command(out, { "SINTER", key("set:", c), key("set:", other) });
+                break;
+            }
+        }
+        return op;
+    }
+
+    //keeps `depth` commands in flight per connection until next returns false; measured phases
+    //record per command latencies
+    template<typename Next>
+    void run(int depth, bool measured, Next next)
+    {
+        bool more = true;
+        std::string batch;
+        auto refill = [&](connection& c) {
+            batch.clear();
+            auto now = steady_clock::now();
+            while (more && c.in_flight.size() < static_cast<std::size_t>(depth))
+            {
+                std::optional<op_type> op = next(batch);
+                if (!op)
+                {
+                    more = false;
+                    break;
+                }
+                c.in_flight.push_back({ *op, now });
+            }
+            if (!batch.empty())
+                send(c, batch);
+        };
+        for (auto& c : conns)
+            refill(c);
+
+        std::size_t outstanding = 0;
+        for (auto& c : conns)
+            outstanding += c.in_flight.size();
+        zmq_msg_t id_msg, data_msg;
+        while (outstanding)
+        {
+            zmq_pollitem_t items[]{ { socket, 0, ZMQ_POLLIN, 0 } };
+            if (zmq_poll(items, 1, 5000) <= 0)
+                throw std::runtime_error("timed out waiting for replies");
+            while (true)
+            {
+                zmq_msg_init(&id_msg);
+                if (zmq_msg_recv(&id_msg, socket, ZMQ_DONTWAIT) == -1)
+                {
+                    zmq_msg_close(&id_msg);
+                    break;
+                }
+                zmq_msg_init(&data_msg);
+                zmq_msg_recv(&data_msg, socket, 0);
+                const auto now = steady_clock::now();
+                std::string_view id{ static_cast<const char*>(zmq_msg_data(&id_msg)), zmq_msg_size(&id_msg) };
+                std::string_view data{ static_cast<const char*>(zmq_msg_data(&data_msg)), zmq_msg_size(&data_msg) };
+                if (data.empty())
+                    throw std::runtime_error("connection closed by server");
+                auto& c = conns[std::stoul(std::string(id.substr(1)))];
+                c.received.append(data);
+                zmq_msg_close(&id_msg);
+                zmq_msg_close(&data_msg);
+
+                std::size_t pos = 0;
+                while (std::size_t n = reply_length(c.received, pos))
+                {
+                    if (c.in_flight.empty())
+                        throw std::runtime_error("reply without request");
+                    auto pending = c.in_flight.front();
+                    c.in_flight.pop_front();
+                    --outstanding;
+                    if (c.received[pos] == '-')
+                        ++errors;
+                    if (measured)
+                    {
+                        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - pending.sent).count();
+                        latencies[static_cast<std::size_t>(pending.op)].record(static_cast<std::uint64_t>(ns));
+                        ++completed;
+                    }
+                    pos += n;
+                }
+                c.received.erase(0, pos);
+                std::size_t before = c.in_flight.size();
+                refill(c);
+                outstanding += c.in_flight.size() - before;
+            }
+        }
+    }
+
+public:
+    explicit bench(const options& opts)
+        : opts{opts}, value_size{opts.value_size}, mix{opts.mix}, rng{opts.seed}
+    {
+        value_source.resize(std::max<std::size_t>(value_size.max(), 1));
+        for (auto& ch : value_source)
+            ch = static_cast<char>('a' + rng() % 26);
+    }
+
+    ~bench()
+    {
+        if (socket)
+            zmq_close(socket);
+    }
+
+    void connect(void* ctx)
+    {
+        socket = zmq_socket(ctx, ZMQ_STREAM);
+        if (!socket)
+            throw std::runtime_error("cannot create socket");
+        int no_linger = 0;
+        zmq_setsockopt(socket, ZMQ_LINGER, &no_linger, sizeof(no_linger));
+        std::string address = opts.unixsocket.empty() ? "tcp://" + opts.host + ":" + std::to_string(opts.port) : "ipc://" + opts.unixsocket;
+        for (int i = 0; i < opts.connections; ++i)
+        {
+            connection c;
+            c.id = "c" + std::to_string(i);
+            zmq_setsockopt(socket, ZMQ_CONNECT_ROUTING_ID, c.id.data(), c.id.size());
+            if (zmq_connect(socket, address.c_str()) != 0)
+                throw std::runtime_error("cannot connect to " + address);
+            conns.push_back(std::move(c));
+        }
+        //ZMQ_STREAM notifies every established connection with an empty message
+        for (int connected = 0; connected < opts.connections; )
+        {
+            zmq_pollitem_t items[]{ { socket, 0, ZMQ_POLLIN, 0 } };
+            if (zmq_poll(items, 1, 5000) <= 0)
+                throw std::runtime_error("cannot connect to " + address);
+            char buffer[64];
+            zmq_recv(socket, buffer, sizeof(buffer), 0);
+            if (zmq_recv(socket, buffer, sizeof(buffer), 0) == 0)
+                ++connected;
+        }
+        if (opts.db != 0)
+        {
+            //depth 1: the first refill of every connection sends its SELECT
+            auto db = std::to_string(opts.db);
+            std::size_t remaining = conns.size();
+            run(1, false, [&](std::string& out) -> std::optional<op_type> {
+                if (!remaining)
+                    return std::nullopt;
+                --remaining;
+                append_command(out, { "SELECT", db });
+                return op_type::GET;
+            });
+        }
+    }
+
+    void populate()
+    {
+        std::uint64_t i = 0;
+        const std::uint64_t total = 3 * opts.keyspace;
+        run(opts.pipeline, false, [&](std::string& out) -> std::optional<op_type> {
+            if (i == total)
+                return std::nullopt;
+            std::uint64_t k = i / 3;
+            switch (i++ % 3)
+            {
+                case 0:
+                {
+                    auto size = value_size(rng);
+                    append_command(out, { "SET", key("key:", k), std::string_view(value_source).substr(0, size) });
+                    return op_type::SET;
+                }
+                case 1:
+                    append_command(out, { "SADD", key("set:", k % opts.collections), key("member:", k) });
+                    return op_type::SADD;
+                default:
+                    append_command(out, { "ZADD", key("zset:", k % opts.collections), std::to_string(k), key("member:", k) });
+                    return op_type::ZADD;
+            }
+        });
+    }
+
+    double measure()
+    {
+        const auto start = steady_clock::now();
+        const auto deadline = start + std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(opts.duration));
+        std::uint64_t checks = 0;
+        bool timed_out = false;
+        run(opts.pipeline, true, [&](std::string& out) -> std::optional<op_type> {
+            if (opts.duration > 0)
+            {
+                if (timed_out || ((++checks & 255) == 0 && (timed_out = steady_clock::now() >= deadline)))
+                    return std::nullopt;
+            }
+            else if (issued == opts.requests)
+            {
+                return std::nullopt;
+            }
+            ++issued;
+            return next_command(out);
+        });
+        return std::chrono::duration<double>(steady_clock::now() - start).count();
+    }
+
+    void report(double elapsed) const
+    {
+        std::printf("kv_bench: %d connections, pipeline %d, keyspace %llu, value size %s\n",
+                    opts.connections, opts.pipeline, static_cast<unsigned long long>(opts.keyspace), opts.value_size.c_str());
+        std::printf("requests: %llu  errors: %llu  elapsed: %.3f s  throughput: %.0f ops/s\n\n",
+                    static_cast<unsigned long long>(completed), static_cast<unsigned long long>(errors),
+                    elapsed, elapsed > 0 ? completed / elapsed : 0.0);
+        std::printf("%-8s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+                    "latency", "count", "mean(us)", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+        auto row = [](std::string_view name, const hdr_histogram& h) {
+            auto us = [](double ns) { return ns / 1000.0; };
+            std::printf("%-8.*s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                        static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(h.count()), us(h.mean()),
+                        us(h.percentile(50)), us(h.percentile(90)), us(h.percentile(99)),
+                        us(h.percentile(99.9)), us(h.percentile(99.99)), us(h.max()));
+        };
+        hdr_histogram all;
+        for (std::size_t i = 0; i < latencies.size(); ++i)
+        {
+            if (latencies[i].count())
+            {
+                row(OP_NAMES[i], latencies[i]);
+                all.merge(latencies[i]);
+            }
+        }
+        row("ALL", all);
+    }
+};
+
+options parse_args(int argc, char* argv[])
+{
+    argparse::ArgumentParser arg_parser("kv_bench");
+    arg_parser.add_argument("--host").help("server host").default_value(std::string{"127.0.0.1"}).nargs(1);
+    arg_parser.add_argument("--port").help("server tcp port").default_value(1234).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--unixsocket").help("server unix domain socket path, overrides host and port").default_value(std::string{}).nargs(1);
+    arg_parser.add_argument("--db").help("database index (0-7)").default_value(0).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--connections").help("parallel connections").default_value(50).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--pipeline").help("requests in flight per connection").default_value(1).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--requests").help("total requests").default_value(100000).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--duration").help("seconds to run, overrides --requests").default_value(0.0).scan<'g', double>().nargs(1);
+    arg_parser.add_argument("--keyspace").help("distinct keys").default_value(10000).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--collections").help("distinct sets and sorted sets").default_value(100).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--value-size").help("fixed:N, uniform:MIN:MAX or normal:MEAN:STDDEV").default_value(std::string{"fixed:64"}).nargs(1);
+    arg_parser.add_argument("--mix").help("command weights").default_value(std::string{"GET=50,SET=30,SADD=5,ZADD=5,ZRANGE=5,SINTER=5"}).nargs(1);
+    arg_parser.add_argument("--no-populate").help("don't load the keyspace before measuring").flag();
+    arg_parser.add_argument("--seed").help("random seed").default_value(1).scan<'i', int>().nargs(1);
+    options opts;
+    try
+    {
+        arg_parser.parse_args(argc, argv);
+        opts.host = arg_parser.get<std::string>("--host");
+        opts.port = arg_parser.get<int>("--port");
+        opts.unixsocket = arg_parser.get<std::string>("--unixsocket");
+        opts.db = arg_parser.get<int>("--db");
+        opts.connections = arg_parser.get<int>("--connections");
+        opts.pipeline = arg_parser.get<int>("--pipeline");
+        opts.requests = static_cast<std::uint64_t>(arg_parser.get<int>("--requests"));
+        opts.duration = arg_parser.get<double>("--duration");
+        opts.keyspace = static_cast<std::uint64_t>(arg_parser.get<int>("--keyspace"));
+        opts.collections = static_cast<std::uint64_t>(arg_parser.get<int>("--collections"));
+        opts.value_size = arg_parser.get<std::string>("--value-size");
+        opts.mix = arg_parser.get<std::string>("--mix");
+        opts.populate = !arg_parser.get<bool>("--no-populate");
+        opts.seed = static_cast<std::uint64_t>(arg_parser.get<int>("--seed"));
+        if (opts.connections < 1 || opts.pipeline < 1 || opts.keyspace < 1 || opts.collections < 1)
+            throw std::out_of_range("connections, pipeline, keyspace and collections must be positive.");
+        if (opts.db < 0 || opts.db > 7)
+            throw std::out_of_range("db must be between 0 and 7.");
+        value_size_distribution{opts.value_size};
+        command_mix{opts.mix};
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        std::cerr << arg_parser;
+        std::exit(1);
+    }
+    return opts;
+}
+
+int main(int argc, char* argv[])
+{
+    auto opts = parse_args(argc, argv);
+    void* ctx = zmq_ctx_new();
+    int rc = 0;
+    try
+    {
+        bench b{opts};
+        b.connect(ctx);
+        if (opts.populate)
+            b.populate();
+        auto elapsed = b.measure();
+        b.report(elapsed);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "kv_bench: " << e.what() << '\n';
+        rc = 1;
+    }
+    zmq_ctx_term(ctx);
+    return rc;
+}
\ No newline at end of file
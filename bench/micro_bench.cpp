@@ -0,0 +1,231 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+//micro_bench: in-process benchmarks of the RESP layer and Strategy_t, no network involved
+//micro_bench --filter=zsets --min-time=0.5 --output=stl.json
+//Build with -DEASTL_BACKEND=ON for the EASTL numbers, "backend" tells the JSON files apart.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "backend.hpp"
+#include "execute_command.hpp"
+#include "format.hpp"
+#include "resp.hpp"
+#include "resp_command_parser.hpp"
+
+#include "../src/eastl_stub_allocator.inl"
+
+using namespace std::literals;
+using steady_clock = std::chrono::steady_clock;
+
+//results feed this so the optimizer can't drop the measured work
+static volatile std::size_t g_sink = 0;
+
+struct bench_result final
+{
+    std::string name;
+    std::uint64_t iterations;
+    double ns_per_op;
+};
+
+class micro_bench final
+{
+    std::string filter;
+    double min_time;
+    std::vector<bench_result> results;
+
+public:
+    micro_bench(std::string filter, double min_time) : filter{std::move(filter)}, min_time{min_time} {}
+
+    //runs op in growing batches until a batch takes min_time seconds
+    void run(const std::string& name, const std::function<std::size_t(std::uint64_t)>& op)
+    {
+        if (!filter.empty() && name.find(filter) == std::string::npos)
+            return;
+        std::uint64_t counter = 0;
+        for (std::uint64_t batch = 1; ; batch *= 2)
+        {
+            auto start = steady_clock::now();
+            std::size_t sink = 0;
+            for (std::uint64_t i = 0; i < batch; ++i)
+                sink += op(counter++);
+            std::chrono::duration<double> elapsed = steady_clock::now() - start;
+            g_sink = g_sink + sink;
+            if (elapsed.count() >= min_time || batch >= (1ull << 40))
+            {
+                results.push_back({ name, batch, elapsed.count() * 1e9 / static_cast<double>(batch) });
+                std::cerr << name << ": " << results.back().ns_per_op << " ns/op\n";
+                return;
+            }
+        }
+    }
+
+    void write_json(std::ostream& os) const
+    {
+        os << "{\n  \"backend\": \"" << g_backend << "\",\n  \"benchmarks\": [";
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            os << (i ? ",\n" : "\n")
+               << "    { \"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+               << ", \"ns_per_op\": " << r.ns_per_op
+               << ", \"ops_per_sec\": " << (r.ns_per_op > 0 ? 1e9 / r.ns_per_op : 0.0) << " }";
+        }
+        os << "\n  ]\n}\n";
+    }
+};
+
+static std::string encode(std::initializer_list<std::string_view> args)
+{
+    std::string out = "*" + std::to_string(args.size()) + "\r\n";
+    for (auto arg : args)
+        out += "$" + std::to_string(arg.size()) + "\r\n" + std::string(arg) + "\r\n";
+    return out;
+}
+
+static const std::string CLIENT_ID = "MICRO-BENCH";
+
+static std::size_t execute(resp::command&& cmd)
+{
+    bool unk_cmd{};
+    Context_t ctx{CLIENT_ID};
+    return execute_command<Context_t, Strategy_t>(ctx, cmd, unk_cmd).size();
+}
+
+int main(int argc, char* argv[])
+{
+    argparse::ArgumentParser arg_parser("micro_bench");
+    arg_parser.add_argument("--filter").help("run benchmarks whose name contains this text").default_value(std::string{}).nargs(1);
+    arg_parser.add_argument("--min-time").help("minimum seconds per benchmark").default_value(0.2).scan<'g', double>().nargs(1);
+    arg_parser.add_argument("--keyspace").help("distinct keys").default_value(10000).scan<'i', int>().nargs(1);
+    arg_parser.add_argument("--output").help("JSON file, default is stdout").default_value(std::string{}).nargs(1);
+    std::size_t keyspace;
+    try
+    {
+        arg_parser.parse_args(argc, argv);
+        keyspace = static_cast<std::size_t>(arg_parser.get<int>("--keyspace"));
+        if (keyspace < 100)
+            throw std::out_of_range("keyspace must be at least 100.");
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        std::cerr << arg_parser;
+        return 1;
+    }
+
+    micro_bench bench{arg_parser.get<std::string>("--filter"), arg_parser.get<double>("--min-time")};
+    Context_t::create_or_remove_client(CLIENT_ID);
+
+    std::vector<std::string> keys, members, scores;
+    for (std::size_t i = 0; i < keyspace; ++i)
+    {
+        keys.push_back("key:" + std::to_string(i));
+        members.push_back("member:" + std::to_string(i));
+        scores.push_back(std::to_string(i));
+    }
+    const std::string value(64, 'v');
+    auto key = [&](std::uint64_t i) -> std::string_view { return keys[i % keyspace]; };
+    auto member = [&](std::uint64_t i) -> std::string_view { return members[i % keyspace]; };
+    auto score = [&](std::uint64_t i) -> std::string_view { return scores[i % keyspace]; };
+
+    //RESP parsing
+    const std::string set_request = encode({ "SET", "key:42", value });
+    bench.run("parse/SET", [&](std::uint64_t) {
+        resp::command_parser parser { set_request.data(), set_request.data() + set_request.size() };
+        return parser.parse_next()->size();
+    });
+    std::string pipeline;
+    for (int i = 0; i < 16; ++i)
+        pipeline += encode({ "GET", keys[i] });
+    bench.run("parse/pipeline16", [&](std::uint64_t) {
+        resp::command_parser parser { pipeline.data(), pipeline.data() + pipeline.size() };
+        std::size_t n = 0;
+        while (auto args = parser.parse_next())
+            n += args->size();
+        return n;
+    });
+    bench.run("parse/command_name", [&](std::uint64_t) {
+        return resp::command{ "zrangebyscore"sv, "key"sv }.name().size();
+    });
+
+    //dispatch through execute_command
+    bench.run("dispatch/PING", [&](std::uint64_t) { return execute(resp::command{ "PING"sv }); });
+    bench.run("dispatch/unknown", [&](std::uint64_t) { return execute(resp::command{ "NOSUCHCOMMAND"sv }); });
+    const std::string get_request = encode({ "GET", "key:42" });
+    bench.run("dispatch/parse+GET", [&](std::uint64_t) {
+        resp::command_parser parser { get_request.data(), get_request.data() + get_request.size() };
+        return execute(resp::command{ std::move(*parser.parse_next()) });
+    });
+
+    //strings
+    bench.run("strings/SET", [&](std::uint64_t i) { return execute(resp::command{ "SET"sv, key(i), std::string_view(value) }); });
+    bench.run("strings/GET", [&](std::uint64_t i) { return execute(resp::command{ "GET"sv, key(i) }); });
+    bench.run("strings/GET_miss", [&](std::uint64_t i) { return execute(resp::command{ "GET"sv, member(i) }); });
+    bench.run("strings/EXISTS", [&](std::uint64_t i) { return execute(resp::command{ "EXISTS"sv, key(i) }); });
+    bench.run("strings/DEL+SET", [&](std::uint64_t i) {
+        return execute(resp::command{ "DEL"sv, key(i) }) + execute(resp::command{ "SET"sv, key(i), std::string_view(value) });
+    });
+
+    //sets, 100 sets sharing the members
+    auto set_key = [&](std::uint64_t i) -> std::string_view { return keys[i % 100]; };
+    clear_all_databases();
+    bench.run("sets/SADD", [&](std::uint64_t i) { return execute(resp::command{ "SADD"sv, set_key(i), member(i) }); });
+    bench.run("sets/SISMEMBER", [&](std::uint64_t i) { return execute(resp::command{ "SISMEMBER"sv, set_key(i), member(i) }); });
+    bench.run("sets/SCARD", [&](std::uint64_t i) { return execute(resp::command{ "SCARD"sv, set_key(i) }); });
+    bench.run("sets/SINTER", [&](std::uint64_t i) { return execute(resp::command{ "SINTER"sv, set_key(i), set_key(i + 1) }); });
+    bench.run("sets/SMEMBERS", [&](std::uint64_t i) { return execute(resp::command{ "SMEMBERS"sv, set_key(i) }); });
+
+    //sorted sets
+    clear_all_databases();
+    bench.run("zsets/ZADD", [&](std::uint64_t i) { return execute(resp::command{ "ZADD"sv, set_key(i), score(i), member(i) }); });
+    bench.run("zsets/ZSCORE", [&](std::uint64_t i) { return execute(resp::command{ "ZSCORE"sv, set_key(i), member(i) }); });
+    bench.run("zsets/ZRANGE", [&](std::uint64_t i) { return execute(resp::command{ "ZRANGE"sv, set_key(i), "0"sv, "9"sv }); });
+    bench.run("zsets/ZRANGE_BYSCORE", [&](std::uint64_t i) {
+        return execute(resp::command{ "ZRANGE"sv, set_key(i), score(i), score(i + 100), "BYSCORE"sv });
+    });
+
+    //keyspace
+    bench.run("keys/TYPE", [&](std::uint64_t i) { return execute(resp::command{ "TYPE"sv, set_key(i) }); });
+    bench.run("keys/DBSIZE", [&](std::uint64_t) { return execute(resp::command{ "DBSIZE"sv }); });
+
+    //reply formatting
+    bench.run("reply/simple_string", [&](std::uint64_t i) { return format::resp_simple_string(key(i)).size(); });
+    bench.run("reply/integer", [&](std::uint64_t i) { return resp::integer(static_cast<int>(i)).size(); });
+    bench.run("reply/array10", [&](std::uint64_t i) {
+        auto first = members.begin() + (i % (keyspace - 10));
+        return resp::array(first, first + 10).size();
+    });
+
+    clear_all_databases();
+    Context_t::create_or_remove_client(CLIENT_ID);
+
+    auto output = arg_parser.get<std::string>("--output");
+    if (output.empty())
+    {
+        bench.write_json(std::cout);
+    }
+    else
+    {
+        std::ofstream ofs{output};
+        bench.write_json(ofs);
+        if (!ofs)
+        {
+            std::cerr << "cannot write " << output << '\n';
+            return 1;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
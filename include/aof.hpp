@@ -0,0 +1,575 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef AOF_HPP
+#define AOF_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "coarse_clock.hpp"
+#include "execute_command.hpp"
+#include "resp_command.hpp"
+#include "resp_command_parser.hpp"
+
+//Append only file: every successful write command is logged in RESP and replayed at startup.
+//BGREWRITEAOF forks a child that writes the minimal command log for the current dataset,
+//while the parent buffers writes arriving meanwhile and appends them before the swap.
+
+namespace aof
+{
+    enum class fsync_policy
+    {
+        ALWAYS, EVERYSEC, NO
+    };
+
+    static inline std::optional<fsync_policy> to_fsync_policy(std::string_view sv)
+    {
+        using enum fsync_policy;
+        if (sv == "always") return ALWAYS;
+        if (sv == "everysec") return EVERYSEC;
+        if (sv == "no") return NO;
+        return std::nullopt;
+    }
+
+    //items per SADD/ZADD in a rewritten log, bounds the size of each replayed command
+    constexpr std::size_t REWRITE_ITEMS_PER_CMD = 64;
+
+    static inline void append_bulk(std::string& out, std::string_view sv)
+    {
+        char digits[24];
+        auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), sv.size());
+        out.push_back('$');
+        out.append(digits, ptr);
+        out.append("\r\n");
+        out.append(sv);
+        out.append("\r\n");
+    }
+
+    static inline void append_array_size(std::string& out, std::size_t size)
+    {
+        char digits[24];
+        auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), size);
+        out.push_back('*');
+        out.append(digits, ptr);
+        out.append("\r\n");
+    }
+
+    //shortest representation that parses back to the same double
+    static inline std::string score_to_string(double score)
+    {
+        char digits[32];
+        auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), score);
+        return std::string(digits, ptr);
+    }
+
+    static inline void append_select(std::string& out, int db_num)
+    {
+        append_array_size(out, 2);
+        append_bulk(out, "SELECT");
+        append_bulk(out, std::to_string(db_num));
+    }
+
+    static inline void append_command(std::string& out, const resp::command& cmd)
+    {
+        const auto& args = cmd.arguments();
+        append_array_size(out, args.size());
+        append_bulk(out, cmd.name());
+        for (std::size_t i = 1; i < args.size(); ++i)
+            append_bulk(out, args[i]);
+    }
+
+    //minimal command log reproducing the databases, written through any sink with append(const char*, size)
+    template<typename Sink, typename Databases>
+    static void rewrite(Sink& sink, const Databases& databases)
+    {
+        std::string out;
+        auto drain = [&]() {
+            if (out.size() >= (1 << 16))
+            {
+                sink.append(out.data(), out.size());
+                out.clear();
+            }
+        };
+        for (std::size_t db_num = 0; db_num < databases.size(); ++db_num)
+        {
+            const auto& db = databases[db_num];
+            using db_type = std::decay_t<decltype(db)>;
+            if (db.size() == 0)
+                continue;
+            append_select(out, static_cast<int>(db_num));
+            db.for_each([&](std::string_view key, const auto& value) {
+                using value_type = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<value_type, typename db_type::string_type>)
+                {
+                    append_array_size(out, 3);
+                    append_bulk(out, "SET");
+                    append_bulk(out, key);
+                    append_bulk(out, std::string_view{value.data(), value.size()});
+                }
+                else if constexpr (std::is_same_v<value_type, typename db_type::set_type>)
+                {
+                    auto it = value.begin();
+                    for (std::size_t remaining = value.size(); remaining; )
+                    {
+                        std::size_t n = std::min(remaining, REWRITE_ITEMS_PER_CMD);
+                        append_array_size(out, 2 + n);
+                        append_bulk(out, "SADD");
+                        append_bulk(out, key);
+                        for (std::size_t i = 0; i < n; ++i, ++it)
+                            append_bulk(out, std::string_view{it->data(), it->size()});
+                        remaining -= n;
+                        drain();
+                    }
+                }
+                else
+                {
+                    auto it = value.Members.begin();
+                    for (std::size_t remaining = value.Members.size(); remaining; )
+                    {
+                        std::size_t n = std::min(remaining, REWRITE_ITEMS_PER_CMD);
+                        append_array_size(out, 2 + 2 * n);
+                        append_bulk(out, "ZADD");
+                        append_bulk(out, key);
+                        for (std::size_t i = 0; i < n; ++i, ++it)
+                        {
+                            append_bulk(out, score_to_string(it->second));
+                            append_bulk(out, std::string_view{it->first.data(), it->first.size()});
+                        }
+                        remaining -= n;
+                        drain();
+                    }
+                }
+                drain();
+            });
+        }
+        if (!out.empty())
+            sink.append(out.data(), out.size());
+    }
+
+    struct file_sink final
+    {
+        std::FILE* file;
+        void append(const char* data, std::size_t size)
+        {
+            if (std::fwrite(data, 1, size, file) != size)
+                throw std::runtime_error("append only file write failed");
+        }
+    };
+
+    static inline bool sync_file(std::FILE* file)
+    {
+        if (std::fflush(file) != 0)
+            return false;
+#ifndef _WIN32
+        return ::fsync(::fileno(file)) == 0;
+#else
+        return true;
+#endif
+    }
+
+    template<typename Databases>
+    static void rewrite_to_file(const std::string& filename, const Databases& databases)
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file)
+            throw std::runtime_error("cannot open " + filename);
+        try
+        {
+            file_sink sink{file};
+            rewrite(sink, databases);
+            if (!sync_file(file))
+                throw std::runtime_error("append only file sync failed");
+        }
+        catch (...)
+        {
+            std::fclose(file);
+            std::remove(filename.c_str());
+            throw;
+        }
+        std::fclose(file);
+    }
+
+    //kept next to the log so the final rename never crosses file systems
+    static inline std::string temp_rewrite_filename(const std::string& filename, long pid)
+    {
+        auto path = std::filesystem::path(filename).parent_path() / ("temp-rewriteaof-" + std::to_string(pid) + ".aof");
+        return path.string();
+    }
+
+    class append_only_file final
+    {
+        std::FILE* file = nullptr;
+        std::string buffer;             //commands not yet written, flushed once per event loop iteration
+        int selected_db = -1;           //last SELECT present in the file
+        std::chrono::steady_clock::time_point last_fsync{};
+
+        std::string rewrite_buffer;     //commands arriving while a rewrite child is running
+        int rewrite_selected_db = -1;
+        std::string rewrite_filename;
+        long child_pid = -1;
+
+    public:
+        bool enabled = false;
+        std::string filename = "appendonly.aof";
+        fsync_policy fsync = fsync_policy::EVERYSEC;
+        std::int64_t last_rewrite_time = 0; //unix time in seconds
+        bool last_rewrite_ok = true;
+        bool last_write_ok = true;      //the server rejects write commands while false
+
+        append_only_file() = default;
+        ~append_only_file() { close(); }
+        append_only_file(const append_only_file&) = delete;
+        append_only_file& operator=(const append_only_file&) = delete;
+
+        void open()
+        {
+            file = std::fopen(filename.c_str(), "ab");
+            if (!file)
+                throw std::runtime_error("cannot open " + filename);
+            selected_db = -1;
+        }
+
+        void close()
+        {
+            if (file)
+            {
+                flush();
+                sync_file(file);
+                std::fclose(file);
+                file = nullptr;
+            }
+        }
+
+        //a missing or empty log is first written from the dataset, which holds the keys loaded
+        //from the snapshot, otherwise the next start would replay a log without them; returns
+        //true when the log was written
+        template<typename Databases>
+        bool open_or_create(const Databases& databases)
+        {
+            std::error_code ec;
+            if (std::filesystem::file_size(filename, ec) > 0 && !ec)
+            {
+                open();
+                return false;
+            }
+            const auto temp_filename = temp_rewrite_filename(filename, 0);
+            rewrite_to_file(temp_filename, databases);
+            std::filesystem::rename(temp_filename, filename);
+            open();
+            return true;
+        }
+
+        bool is_open() const noexcept { return file != nullptr; }
+
+        bool rewrite_in_progress() const noexcept { return child_pid != -1; }
+
+        bool rejects_writes() const noexcept { return file && !last_write_ok; }
+
+        void feed(int db_num, const resp::command& cmd)
+        {
+            if (!file && !rewrite_in_progress())
+                return;
+            if (file)
+            {
+                if (db_num != selected_db)
+                {
+                    append_select(buffer, db_num);
+                    selected_db = db_num;
+                }
+                append_command(buffer, cmd);
+            }
+            if (rewrite_in_progress())
+            {
+                if (db_num != rewrite_selected_db)
+                {
+                    append_select(rewrite_buffer, db_num);
+                    rewrite_selected_db = db_num;
+                }
+                append_command(rewrite_buffer, cmd);
+            }
+        }
+
+        //write buffered commands before replies leave the server, then fsync per policy; what a
+        //failing write left in the buffer is retried on the next flush
+        void flush()
+        {
+            if (!file)
+                return;
+            if (!buffer.empty() || !last_write_ok)
+            {
+                buffer.erase(0, std::fwrite(buffer.data(), 1, buffer.size(), file));
+                const bool always = fsync == fsync_policy::ALWAYS;
+                if (!buffer.empty() || !(always ? sync_file(file) : std::fflush(file) == 0))
+                {
+                    std::clearerr(file);
+                    last_write_ok = false;
+                    return;
+                }
+                last_write_ok = true;
+                if (always)
+                    return;
+            }
+            if (fsync == fsync_policy::EVERYSEC)
+            {
+                auto now = coarse_clock::g_clock.now();
+                if (now - last_fsync >= std::chrono::seconds(1))
+                {
+                    sync_file(file);
+                    last_fsync = now;
+                }
+            }
+        }
+
+        template<typename Databases>
+        bool background_rewrite(const Databases& databases)
+        {
+            if (rewrite_in_progress())
+                return false;
+            rewrite_buffer.clear();
+            rewrite_selected_db = -1;
+#ifdef _WIN32
+            rewrite_filename = temp_rewrite_filename(filename, 0);
+            try { rewrite_to_file(rewrite_filename, databases); finish_rewrite(true); }
+            catch (...) { finish_rewrite(false); }
+            return true;
+#else
+            flush();
+            pid_t pid = ::fork();
+            if (pid == -1)
+                return false;
+            if (pid == 0)
+            {
+                int status = 0;
+                try { rewrite_to_file(temp_rewrite_filename(filename, ::getpid()), databases); }
+                catch (...) { status = 1; }
+                std::_Exit(status);
+            }
+            rewrite_filename = temp_rewrite_filename(filename, pid);
+            child_pid = pid;
+            return true;
+#endif
+        }
+
+        //call periodically from the event loop, returns true when a background rewrite just finished
+        bool poll_background_rewrite(bool wait = false)
+        {
+#ifndef _WIN32
+            if (!rewrite_in_progress())
+                return false;
+            int status = 0;
+            pid_t pid = ::waitpid(static_cast<pid_t>(child_pid), &status, wait ? 0 : WNOHANG);
+            if (pid == 0)
+                return false;
+            child_pid = -1;
+            finish_rewrite(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+            return true;
+#else
+            (void)wait;
+            return false;
+#endif
+        }
+
+    private:
+        //append what arrived during the rewrite, then atomically replace the old log
+        void finish_rewrite(bool ok)
+        {
+            using namespace std::chrono;
+            if (ok)
+            {
+                std::FILE* rewritten = std::fopen(rewrite_filename.c_str(), "ab");
+                ok = rewritten != nullptr;
+                if (ok)
+                {
+                    ok = std::fwrite(rewrite_buffer.data(), 1, rewrite_buffer.size(), rewritten) == rewrite_buffer.size();
+                    ok = sync_file(rewritten) && ok;
+                    std::fclose(rewritten);
+                }
+                if (ok)
+                {
+                    bool reopen = file != nullptr;
+                    if (reopen)
+                    {
+                        flush();
+                        std::fclose(file);
+                        file = nullptr;
+                    }
+                    std::error_code ec;
+                    std::filesystem::rename(rewrite_filename, filename, ec);
+                    ok = !ec;
+                    if (ok)
+                    {
+                        //what a failed flush kept for the old log is in the rewritten one already,
+                        //in the dataset of the child or in rewrite_buffer, and it was encoded
+                        //after the old log's last SELECT: written again it could land in another db
+                        buffer.clear();
+                        last_write_ok = true;
+                    }
+                    if (reopen)
+                        open();
+                }
+            }
+            if (!ok)
+            {
+                std::error_code ec;
+                std::filesystem::remove(rewrite_filename, ec);
+            }
+            rewrite_buffer.clear();
+            rewrite_buffer.shrink_to_fit();
+            rewrite_selected_db = -1;
+            last_rewrite_ok = ok;
+            if (ok)
+                last_rewrite_time = duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+        }
+    };
+
+    static append_only_file g_aof;
+
+    //the log holds something other than commands from offset on
+    struct corrupt_log_error final : std::runtime_error
+    {
+        std::size_t offset;
+
+        corrupt_log_error(const std::string& filename, std::size_t offset)
+            : std::runtime_error("bad format in append only file " + filename + " at offset " + std::to_string(offset)),
+              offset{offset}
+        {
+        }
+    };
+
+    //largest bulk string a logged command can hold, like proto-max-bulk-len
+    constexpr std::size_t MAX_BULK_SIZE = 512 * 1024 * 1024;
+
+    //size of the command at the start of [first, last): 0 when it runs past last (incomplete),
+    //nullopt when it isn't a well formed *count CRLF ($size CRLF data CRLF)+
+    static inline std::optional<std::size_t> command_size(const char* first, const char* last)
+    {
+        enum class header { OK, INCOMPLETE, CORRUPT };
+        const char* p = first;
+        auto read_header = [&](char type, std::size_t& number) {
+            if (p == last)
+                return header::INCOMPLETE;
+            if (*p != type)
+                return header::CORRUPT;
+            const char* digits = p + 1;
+            const char* q = digits;
+            while (q != last && q - digits <= 20 && *q >= '0' && *q <= '9')
+                ++q;
+            if (q == digits || q - digits > 20)
+                return q == last ? header::INCOMPLETE : header::CORRUPT;
+            if (q == last || (*q == '\r' && q + 1 == last))
+                return header::INCOMPLETE;
+            if (std::from_chars(digits, q, number).ec != std::errc{} || q[0] != '\r' || q[1] != '\n')
+                return header::CORRUPT;
+            p = q + 2;
+            return header::OK;
+        };
+        std::size_t count{};
+        if (auto h = read_header('*', count); h != header::OK)
+            return h == header::INCOMPLETE ? std::optional<std::size_t>{0} : std::nullopt;
+        if (count == 0)
+            return std::nullopt;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::size_t size{};
+            if (auto h = read_header('$', size); h != header::OK)
+                return h == header::INCOMPLETE ? std::optional<std::size_t>{0} : std::nullopt;
+            if (size > MAX_BULK_SIZE)
+                return std::nullopt;
+            const auto available = static_cast<std::size_t>(last - p);
+            if (available < size + 2)
+                return available <= size || p[size] == '\r' ? std::optional<std::size_t>{0} : std::nullopt;
+            if (p[size] != '\r' || p[size + 1] != '\n')
+                return std::nullopt;
+            p += size + 2;
+        }
+        return static_cast<std::size_t>(p - first);
+    }
+
+    //replays the log through the command strategy, reading it in chunks; returns the number of
+    //commands applied. Only an incomplete last command, the torn tail left by a crash, is
+    //truncated; anything else that isn't a command throws corrupt_log_error and the file is kept
+    //as is, like redis-check-aof the offset tells where to look
+    template<typename Context, typename CommandStrategy>
+    static std::size_t replay(const std::string& filename)
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file)
+            throw std::runtime_error("cannot open " + filename);
+
+        const std::string client_id = "AOF-LOADER";
+        Context::create_or_remove_client(client_id);
+        std::size_t applied{};
+        std::size_t offset{};   //of pending in the file
+        std::string pending;
+        char chunk[1 << 16];
+        try
+        {
+            for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), file)) > 0; )
+            {
+                pending.append(chunk, n);
+                std::size_t consumed{};
+                while (consumed < pending.size())
+                {
+                    const char* first = pending.data() + consumed;
+                    const char* last = pending.data() + pending.size();
+                    auto size = command_size(first, last);
+                    if (!size)
+                        throw corrupt_log_error(filename, offset + consumed);
+                    if (*size == 0)
+                        break;
+                    resp::command_parser parser { first, first + *size };
+                    auto args_opt = parser.parse_next();
+                    if (!args_opt)
+                        throw corrupt_log_error(filename, offset + consumed);
+                    bool unk_cmd{};
+                    Context ctx{client_id};
+                    resp::command cmd(std::move(*args_opt));
+                    execute_command<Context, CommandStrategy>(ctx, cmd, unk_cmd);
+                    ++applied;
+                    consumed += *size;
+                }
+                pending.erase(0, consumed);
+                offset += consumed;
+            }
+            if (std::ferror(file))
+                throw std::runtime_error("cannot read " + filename);
+        }
+        catch (...)
+        {
+            std::fclose(file);
+            Context::create_or_remove_client(client_id);
+            throw;
+        }
+        std::fclose(file);
+        Context::create_or_remove_client(client_id);
+
+        if (!pending.empty())
+            std::filesystem::resize_file(filename, offset);
+        return applied;
+    }
+}
+
+#endif /* AOF_HPP */
\ No newline at end of file
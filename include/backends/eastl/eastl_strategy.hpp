@@ -7,6 +7,7 @@
 #define EASTL_STRATEGY_HPP
 
 #include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -16,9 +17,20 @@
 #include <EASTL/optional.h>
 #include <EASTL/set.h>
 
+#include "aof.hpp"
+#include "command_stats.hpp"
 #include "database_defs.hpp"
+#include "execute_command.hpp"
+#include "hotkeys.hpp"
+#include "replication.hpp"
 #include "resp.hpp"
 #include "resp_command.hpp"
+#include "scripting.hpp"
+#include "server_stats.hpp"
+#include "slowlog.hpp"
+#include "snapshot.hpp"
+#include "tracing.hpp"
+#include "transaction.hpp"
 #include "eastl_context.hpp"
 
 struct Strategy_t final
@@ -54,10 +66,10 @@ struct Strategy_t final
         using enum DbValueTypeEnum;
         auto& CurrentDb = ctx.Client().CurrentDb();
         const auto& key = cmd[1];
-        switch (CurrentDb.lookup_type_of(key))
+        switch (server_stats::lookup_type_for_read(CurrentDb, key))
         {
             case STRING:            
-                return resp::simple_string(CurrentDb.Strings(key));
+                return resp::simple_string(CurrentDb.StringView(key));
             case NONE:
                 return resp::nil();
             default:
@@ -202,7 +214,7 @@ struct Strategy_t final
         using enum DbValueTypeEnum;
         auto& CurrentDb = ctx.Client().CurrentDb();
         const auto& key = cmd[1];
-        switch (CurrentDb.lookup_type_of(key))
+        switch (server_stats::lookup_type_for_read(CurrentDb, key))
         {
             case SET:
             {
@@ -224,7 +236,7 @@ struct Strategy_t final
         using enum DbValueTypeEnum;
         auto& CurrentDb = ctx.Client().CurrentDb();
         const auto& key = cmd[1];
-        switch (CurrentDb.lookup_type_of(key))
+        switch (server_stats::lookup_type_for_read(CurrentDb, key))
         {
             case SET:
             {
@@ -246,7 +258,7 @@ struct Strategy_t final
         using enum DbValueTypeEnum;
         auto& CurrentDb = ctx.Client().CurrentDb();
         const auto& key = cmd[1];
-        switch (CurrentDb.lookup_type_of(key))
+        switch (server_stats::lookup_type_for_read(CurrentDb, key))
         {
             case SET:
             {
@@ -272,7 +284,7 @@ struct Strategy_t final
         for (std::size_t i = 1; i < cmd.size(); ++i)
         {
             const auto& key = cmd[i];
-            switch (CurrentDb.lookup_type_of(key))
+            switch (server_stats::lookup_type_for_read(CurrentDb, key))
             {
             case NONE:
                 return resp::empty_array();
@@ -315,7 +327,7 @@ struct Strategy_t final
         for (std::size_t i = 1; i < cmd.size(); ++i)
         {
             const auto& key = cmd[i];
-            switch (CurrentDb.lookup_type_of(key))
+            switch (server_stats::lookup_type_for_read(CurrentDb, key))
             {
             case NONE:
                 break;
@@ -402,7 +414,7 @@ struct Strategy_t final
         using enum DbValueTypeEnum;
         auto& CurrentDb = ctx.Client().CurrentDb();
         const auto& key = cmd[1];
-        switch (CurrentDb.lookup_type_of(key))
+        switch (server_stats::lookup_type_for_read(CurrentDb, key))
         {
             case SORTEDSET:
             {
@@ -428,7 +440,7 @@ struct Strategy_t final
         using enum DbValueTypeEnum;
         auto& CurrentDb = ctx.Client().CurrentDb();
         const auto& key = cmd[1];
-        switch (CurrentDb.lookup_type_of(key))
+        switch (server_stats::lookup_type_for_read(CurrentDb, key))
         {
             case SORTEDSET:
                 return resp::integer(CurrentDb.SortedSets(key).Members.size());
@@ -447,7 +459,7 @@ struct Strategy_t final
         using enum DbValueTypeEnum;
         auto& CurrentDb = ctx.Client().CurrentDb();
         const auto& key = cmd[1];
-        switch (CurrentDb.lookup_type_of(key))
+        switch (server_stats::lookup_type_for_read(CurrentDb, key))
         {
             case SORTEDSET:
             {
@@ -675,7 +687,40 @@ struct Strategy_t final
                 return resp::error_wrong_number_of_arguments_for_command();
             
             return resp::simple_string(ctx.Client().to_string());
-        }        
+        }
+        if (subcmd == "LIST") //CLIENT LIST
+        {
+            if (cmd.size() != 2)
+                return resp::error_wrong_number_of_arguments_for_command();
+
+            std::vector<const Client_t*> clients;
+            clients.reserve(g_clients.size());
+            for (const auto& kv : g_clients)
+                clients.push_back(&kv.second);
+            eastl::sort(clients.begin(), clients.end(), [](const Client_t* lhs, const Client_t* rhs) { return lhs->ClientNumber < rhs->ClientNumber; });
+            std::string list;
+            for (const auto* client : clients)
+                list.append(client->to_string()).push_back('\n');
+            return resp::simple_string(list);
+        }
+        if (subcmd == "KILL") //CLIENT KILL ID client-id, never the link to the primary
+        {
+            if (cmd.size() != 4)
+                return resp::error_wrong_number_of_arguments_for_command();
+            if (to_upper(cmd[2]) != "ID")
+                return resp::error_syntax_error();
+
+            std::optional<int> id_opt = string_to_int(cmd[3]);
+            if (!id_opt)
+                return resp::error_value_is_not_an_integer_or_out_of_range();
+            for (auto& kv : g_clients)
+                if (kv.second.ClientNumber == *id_opt && !kv.second.CloseAsap && kv.first != replication::MASTER_CLIENT_ID)
+                {
+                    Context_t::close_client(kv.second);
+                    return resp::integer(1);
+                }
+            return resp::integer(0);
+        }
         return resp::error_unknown_subcommand(subcmd);
     }
 
@@ -716,6 +761,337 @@ struct Strategy_t final
 
         return resp::pong();
     }
+
+    static inline std::string save(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        auto& state = snapshot::g_snapshot;
+        if (state.in_progress())
+            return resp::error_background_save_in_progress();
+        try
+        {
+            snapshot::save(state.filename, g_databases, state.mappable);
+            state.saved(true);
+            return resp::ok();
+        }
+        catch (const std::exception& e)
+        {
+            state.saved(false);
+            return resp::error(e.what());
+        }
+    }
+
+    static inline std::string bgsave(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        if (snapshot::g_snapshot.in_progress())
+            return resp::error_background_save_in_progress();
+        if (aof::g_aof.rewrite_in_progress())
+            return resp::error_background_rewrite_in_progress();
+        if (!snapshot::background_save(g_databases))
+            return resp::error("Background save failed to start");
+        return resp::background_saving_started();
+    }
+
+    static inline std::string lastsave(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        return resp::integer(static_cast<int>(snapshot::g_snapshot.last_save_time));
+    }
+
+    static inline std::string bgrewriteaof(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        if (aof::g_aof.rewrite_in_progress())
+            return resp::error_background_rewrite_in_progress();
+        if (snapshot::g_snapshot.in_progress())
+            return resp::error_background_save_in_progress();
+        if (!aof::g_aof.background_rewrite(g_databases))
+            return resp::error("Background append only file rewriting failed to start");
+        return resp::background_rewrite_started();
+    }
+
+    static inline std::string replicaof(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 3)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        auto& state = replication::g_replication;
+        if (to_upper(cmd[1]) == "NO" && to_upper(cmd[2]) == "ONE")
+        {
+            state.replicaof_no_one();
+            return resp::ok();
+        }
+        std::optional<int> port_opt = string_to_int(cmd[2]);
+        if (!port_opt || *port_opt <= 0 || *port_opt + replication::PORT_OFFSET > 65535)
+            return resp::error_value_is_not_an_integer_or_out_of_range();
+        state.replicaof(cmd[1], *port_opt);
+        return resp::ok();
+    }
+
+    static inline std::string role(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        const auto& state = replication::g_replication;
+        const auto offset = std::to_string(state.master_repl_offset());
+        if (!state.is_replica())
+        {
+            std::vector<std::string> reply{ "master", offset, std::to_string(state.connected_replicas) };
+            return resp::array(reply.begin(), reply.end());
+        }
+        const char* link = state.state == replication::link_state::CONNECTED ? "connected" :
+                           state.state == replication::link_state::SYNC ? "sync" : "connect";
+        std::vector<std::string> reply{ "slave", state.master_host, std::to_string(state.master_port), link, offset };
+        return resp::array(reply.begin(), reply.end());
+    }
+
+    static inline std::string info(Context_t& ctx, const resp::command& cmd)
+    {
+        return resp::simple_string(server_stats::info(cmd, g_databases, g_clients, g_backend));
+    }
+
+    static inline std::string latency(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() < 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        const auto subcmd = to_upper(cmd[1]);
+        std::vector<std::string> cmd_names;
+        for (std::size_t i = 2; i < cmd.size(); ++i)
+            cmd_names.push_back(to_upper(cmd[i]));
+        if (subcmd == "HISTOGRAM") //LATENCY HISTOGRAM [command ...]
+            return command_stats::latency_histogram_reply(std::move(cmd_names));
+        if (subcmd == "LATEST") //LATENCY LATEST
+        {
+            if (cmd.size() != 2)
+                return resp::error_wrong_number_of_arguments_for_command();
+            return command_stats::latency_latest_reply();
+        }
+        if (subcmd == "RESET") //LATENCY RESET [command ...]
+            return resp::integer(static_cast<int>(command_stats::g_command_stats.reset(cmd_names)));
+        return resp::error_unknown_subcommand(cmd[1]);
+    }
+
+    static inline std::string slowlog(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() < 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        auto& log = ::slowlog::g_slowlog;
+        const auto subcmd = to_upper(cmd[1]);
+        if (subcmd == "GET") //SLOWLOG GET [count]
+        {
+            if (cmd.size() > 3)
+                return resp::error_wrong_number_of_arguments_for_command();
+            std::size_t count = 10;
+            if (cmd.size() == 3)
+            {
+                std::optional<int> count_opt = string_to_int(cmd[2]);
+                if (!count_opt || *count_opt < -1)
+                    return resp::error_value_is_not_an_integer_or_out_of_range();
+                count = *count_opt == -1 ? log.size() : static_cast<std::size_t>(*count_opt);
+            }
+            return log.get(count);
+        }
+        if (subcmd == "LEN") //SLOWLOG LEN
+        {
+            if (cmd.size() != 2)
+                return resp::error_wrong_number_of_arguments_for_command();
+            return resp::integer(static_cast<int>(log.size()));
+        }
+        if (subcmd == "RESET") //SLOWLOG RESET
+        {
+            if (cmd.size() != 2)
+                return resp::error_wrong_number_of_arguments_for_command();
+            log.reset();
+            return resp::ok();
+        }
+        return resp::error_unknown_subcommand(cmd[1]);
+    }
+
+    static inline std::string memory(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() < 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        const auto subcmd = to_upper(cmd[1]);
+        if (subcmd == "USAGE") //MEMORY USAGE key [SAMPLES count]
+        {
+            if (cmd.size() != 3 && cmd.size() != 5)
+                return resp::error_wrong_number_of_arguments_for_command();
+            std::size_t samples = DEFAULT_USAGE_SAMPLES;
+            if (cmd.size() == 5)
+            {
+                if (to_upper(cmd[3]) != "SAMPLES")
+                    return resp::error_syntax_error();
+                std::optional<int> samples_opt = string_to_int(cmd[4]);
+                if (!samples_opt || *samples_opt < 0)
+                    return resp::error_value_is_not_an_integer_or_out_of_range();
+                samples = static_cast<std::size_t>(*samples_opt);
+            }
+            auto usage = ctx.Client().CurrentDb().usage(cmd[2], samples);
+            if (!usage)
+                return resp::nil();
+            return resp::integer(usage->Bytes);
+        }
+        return resp::error_unknown_subcommand(cmd[1]);
+    }
+
+    static inline std::string object(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() < 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        const auto subcmd = to_upper(cmd[1]);
+        if (subcmd == "FREQ") //OBJECT FREQ key
+        {
+            if (cmd.size() != 3)
+                return resp::error_wrong_number_of_arguments_for_command();
+            const auto& key = cmd[2];
+            if (!ctx.Client().CurrentDb().exists(key))
+                return resp::nil();
+            return resp::integer(::hotkeys::g_sampler.frequency(ctx.Client().CurrentDbNumber, key));
+        }
+        return resp::error_unknown_subcommand(cmd[1]);
+    }
+
+    static inline std::string hotkeys(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() > 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        std::optional<int> count_opt = cmd.size() == 2 ? string_to_int(cmd[1]) : 10;
+        if (!count_opt || *count_opt < 0)
+            return resp::error_value_is_not_an_integer_or_out_of_range();
+        return ::hotkeys::g_sampler.hot_keys_reply(static_cast<std::size_t>(*count_opt));
+    }
+
+    static inline std::string bigkeys(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() > 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        std::optional<int> count_opt = cmd.size() == 2 ? string_to_int(cmd[1]) : 10;
+        if (!count_opt || *count_opt < 0)
+            return resp::error_value_is_not_an_integer_or_out_of_range();
+        return ::hotkeys::g_sampler.big_keys_reply(g_databases, static_cast<std::size_t>(*count_opt));
+    }
+
+    static inline std::string trace(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() < 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+        if (!tracing::ENABLED)
+            return resp::error("tracing is not compiled in, build with -DKV_TRACE=ON");
+
+        const auto subcmd = to_upper(cmd[1]);
+        if (subcmd == "DUMP") //TRACE DUMP [filename]
+        {
+            if (cmd.size() > 3)
+                return resp::error_wrong_number_of_arguments_for_command();
+            const auto filename = cmd.size() == 3 ? cmd[2] : std::string{tracing::DEFAULT_DUMP_FILENAME};
+            const auto events = tracing::dump(filename);
+            if (!events)
+                return resp::error("no trace events or the file can't be written");
+            return resp::integer(events);
+        }
+        if (subcmd == "RESET") //TRACE RESET
+        {
+            if (cmd.size() != 2)
+                return resp::error_wrong_number_of_arguments_for_command();
+            tracing::reset();
+            return resp::ok();
+        }
+        return resp::error_unknown_subcommand(cmd[1]);
+    }
+
+    static inline std::string multi(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        auto& client = ctx.Client();
+        if (client.InMulti)
+            return resp::error_multi_calls_can_not_be_nested();
+        client.InMulti = true;
+        return resp::ok();
+    }
+
+    //the server executes EXEC itself, through its pipeline of statistics, append only file and
+    //replication (server_main.cpp); this one serves the other callers of execute_command
+    static inline std::string exec(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        return transaction::exec(ctx.Client(), [&](const resp::command& queued) {
+            bool unk_cmd{};
+            return execute_command<Context_t, Strategy_t>(ctx, queued, unk_cmd);
+        });
+    }
+
+    static inline std::string discard(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        auto& client = ctx.Client();
+        if (!client.InMulti)
+            return resp::error_discard_without_multi();
+        transaction::discard(client);
+        return resp::ok();
+    }
+
+    static inline std::string watch(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() < 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        auto& client = ctx.Client();
+        if (client.InMulti)
+            return resp::error_watch_inside_multi();
+        for (std::size_t i = 1; i < cmd.size(); ++i)
+            client.Watch(cmd[i]);
+        return resp::ok();
+    }
+
+    static inline std::string unwatch(Context_t& ctx, const resp::command& cmd)
+    {
+        if (cmd.size() != 1)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        ctx.Client().Unwatch();
+        return resp::ok();
+    }
+
+    //like exec, the server executes EVAL and EVALSHA itself
+    static inline std::string eval(Context_t& ctx, const resp::command& cmd)
+    {
+        return scripting::eval(cmd, [&](const resp::command& called) {
+            bool unk_cmd{};
+            return execute_command<Context_t, Strategy_t>(ctx, called, unk_cmd);
+        });
+    }
+
+    static inline std::string evalsha(Context_t& ctx, const resp::command& cmd)
+    {
+        return eval(ctx, cmd);
+    }
+
+    static inline std::string script(Context_t& ctx, const resp::command& cmd)
+    {
+        return scripting::script_command(cmd);
+    }
 };
 
 #endif /* EASTL_STRATEGY_HPP */
\ No newline at end of file
@@ -1,10 +1,10 @@
 #ifndef EASTL_BACKEND_HPP
 #define EASTL_BACKEND_HPP
 
+const char* g_backend = "EASTL"; //reported by INFO server
+
 #include "eastl/eastl_context.hpp"
 #include "eastl/eastl_databases.hpp"
 #include "eastl/eastl_strategy.hpp"
 
-const char* g_backend = "EASTL";
-
 #endif /* EASTL_BACKEND_HPP */
\ No newline at end of file
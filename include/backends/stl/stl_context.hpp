@@ -6,12 +6,15 @@
 #ifndef STL_CONTEXT_HPP
 #define STL_CONTEXT_HPP
 
+#include <chrono>
 #include <sstream>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "stl_databases.hpp"
+#include "coarse_clock.hpp"
 
 struct Client_t final
 {
@@ -19,6 +22,17 @@ struct Client_t final
     int ClientNumber;
     int CurrentDbNumber = 0;
     std::string LibName, LibVersion, ConnectionName;
+    std::string QueryBuffer; //received bytes not yet forming a complete command
+    std::string ReplyBuffer; //replies of the commands executed from QueryBuffer, not sent yet
+    std::size_t OutputBytes = 0; //replies handed to the front end, not yet written to the connection
+    std::chrono::steady_clock::time_point OverSoftLimitSince{};
+    bool CloseAsap = false; //input is ignored until the front end closes it (output limit, CLIENT KILL, --timeout)
+    std::chrono::steady_clock::time_point CreatedAt = coarse_clock::g_clock.now();
+    std::chrono::steady_clock::time_point LastInteraction = CreatedAt;
+    bool InMulti = false;
+    bool MultiFailed = false; //a command was refused while queuing, EXEC discards the transaction
+    std::vector<std::vector<std::string>> Queued; //MULTI, copied out of QueryBuffer until EXEC
+    std::vector<WatchedKey_t> WatchedKeys;
     
     static inline int ClientCounter = 0;
     static Client_t create(const std::string& id) 
@@ -41,31 +55,61 @@ struct Client_t final
         return false;
     }
 
+    //WATCH key in the current database
+    void Watch(const std::string& key)
+    {
+        WatchedKeys.push_back(WatchedKey_t{CurrentDbNumber, key, CurrentDb().watch(key)});
+    }
+
+    //true when a watched key was modified after WATCH
+    bool WatchedKeysTouched() const
+    {
+        for (const auto& watched : WatchedKeys)
+            if (g_databases[watched.DbNumber].version(watched.Key) != watched.Version)
+                return true;
+        return false;
+    }
+
+    void Unwatch()
+    {
+        for (const auto& watched : WatchedKeys)
+            g_databases[watched.DbNumber].unwatch(watched.Key);
+        WatchedKeys.clear();
+    }
+
     std::string to_string() const
     {
+        using std::chrono::duration_cast;
+        using std::chrono::seconds;
+        const auto now = coarse_clock::g_clock.now();
+        const auto tot_mem = sizeof(Client_t) + Id.capacity() + LibName.capacity() + LibVersion.capacity() + 
+            ConnectionName.capacity() + QueryBuffer.capacity() + ReplyBuffer.capacity() + OutputBytes;
         std::stringstream ss;
         ss << "db=" << CurrentDbNumber 
-           << " id=" << ClientNumber           
+           << " id=" << ClientNumber
+           << " name=" << ConnectionName           
            << " lib-name=" << LibName
-           << " lib-ver=" << LibVersion;
+           << " lib-ver=" << LibVersion
+           << " age=" << duration_cast<seconds>(now - CreatedAt).count()
+           << " idle=" << duration_cast<seconds>(now - LastInteraction).count()
+           << " obl=" << OutputBytes
+           << " omem=" << OutputBytes + ReplyBuffer.capacity()
+           << " multi=" << (InMulti ? static_cast<long long>(Queued.size()) : -1)
+           << " watch=" << WatchedKeys.size()
+           << " qbuf=" << QueryBuffer.size()
+           << " qbuf-free=" << QueryBuffer.capacity() - QueryBuffer.size()
+           << " tot-mem=" << tot_mem;
         //unhandled/not supported
-        ss << " age=0"
-           << " argv-mem=0"
-           << " idle=0"
-           << " multi=0"
-           << " obl=0"
+        ss << " argv-mem=0"
            << " oll=0"
-           << " omem=0"
            << " sub=0"
-           << " psub=0"
-           << " qbuf=0"
-           << " qbuf-free=0"
-           << " tot-mem=0";
+           << " psub=0";
         return std::move(ss.str());
     }
 };
 
 std::unordered_map<std::string, Client_t> g_clients;
+std::vector<std::string> g_clients_to_close;
 
 //don't reuse context
 class Context_t final
@@ -83,6 +127,22 @@ public:
 
     Client_t& Client() const { return client; }
 
+    //the event loop closes the connection and removes the client (g_clients_to_close)
+    static void close_client(Client_t& client)
+    {
+        if (client.CloseAsap)
+            return;
+        client.CloseAsap = true;
+        g_clients_to_close.push_back(client.Id);
+    }
+
+    //nullptr for an unknown client, unlike the constructor it never creates one
+    static Client_t* find_client(const std::string& client_id)
+    {
+        auto it = g_clients.find(client_id);
+        return it != g_clients.end() ? &it->second : nullptr;
+    }
+
     static std::pair<int, bool> create_or_remove_client(const std::string& client_id)
     {
         int client_number;
@@ -91,6 +151,7 @@ public:
         if (it != g_clients.end())
         {
             client_number = it->second.ClientNumber;
+            it->second.Unwatch();
             g_clients.erase(it);
             created = false;
         }
@@ -7,15 +7,22 @@
 #define STL_DATABASES_HPP
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
 #include "database_defs.hpp"
 #include "Generator.hpp"
+#include "mapped_value.hpp"
 
 struct SortedSet_t final
 {
@@ -29,15 +36,46 @@ struct STL_Database_t final
     using set_type = std::set<std::string>;
     using sortedset_type = SortedSet_t;
 
-    using mapped_type = std::variant<string_type, set_type, sortedset_type>;
+    using mapped_type = std::variant<string_type, set_type, sortedset_type, MappedValue_t>;
     std::unordered_map<std::string, mapped_type> Dict;
+    std::unordered_map<std::string, KeyVersion_t> Watched;   //only the keys under WATCH
+
+    template<typename T>
+    static constexpr DbValueTypeEnum type_of()
+    {
+        using enum DbValueTypeEnum;
+        if constexpr (std::is_same_v<T, string_type>) return STRING;
+        else if constexpr (std::is_same_v<T, set_type>) return SET;
+        else if constexpr (std::is_same_v<T, sortedset_type>) return SORTEDSET;
+        else return NONE;
+    }
+
+    //decodes a value still living in a mapped snapshot
+    template<typename T>
+    static T Materialize(const MappedValue_t& mapped)
+    {
+        T value{};
+        if (mapped.Type != type_of<T>())
+            throw std::invalid_argument("mapped value holds another type");
+        if constexpr (std::is_same_v<T, string_type>)
+            value.assign(mapped.Data, mapped.Size);
+        else if constexpr (std::is_same_v<T, set_type>)
+            mapped_layout::decode_set(mapped, value);
+        else
+            mapped_layout::decode_sortedset(mapped, value);
+        return value;
+    }
 
     template<typename T>
     T& Get(const std::string& key)
     {
         auto it = Dict.find(key);
         if (it != Dict.end())
+        {
+            if (auto mapped = std::get_if<MappedValue_t>(&it->second))
+                it->second = Materialize<T>(*mapped);
             return std::get<T>(it->second);
+        }
         return std::get<T>(Dict.emplace(key, T{}).first->second);
     }
 
@@ -56,6 +94,29 @@ struct STL_Database_t final
         return Get<sortedset_type>(key);
     }
 
+    //read-only access to an existing string, never copies a mapped value
+    std::string_view StringView(const std::string& key) const
+    {
+        const auto& value = Dict.find(key)->second;
+        if (auto mapped = std::get_if<MappedValue_t>(&value))
+            return mapped->view();
+        const auto& s = std::get<string_type>(value);
+        return { s.data(), s.size() };
+    }
+
+    bool is_mapped(const std::string& key) const
+    {
+        auto it = Dict.find(key);
+        return it != Dict.end() && std::holds_alternative<MappedValue_t>(it->second);
+    }
+
+    //insert without lookup, for bulk loading keys known to be absent
+    template<typename T>
+    T& Emplace(std::string&& key)
+    {
+        return std::get<T>(Dict.emplace(std::move(key), T{}).first->second);
+    }
+
     DbValueTypeEnum lookup_type_of(const std::string& key) const
     { 
         using enum DbValueTypeEnum;
@@ -69,6 +130,8 @@ struct STL_Database_t final
                 return SET;
             if (std::holds_alternative<sortedset_type>(value))
                 return SORTEDSET;
+            if (auto mapped = std::get_if<MappedValue_t>(&value))
+                return mapped->Type;
         }
         return NONE;
     }
@@ -78,6 +141,43 @@ struct STL_Database_t final
         return lookup_type_of(key) != DbValueTypeEnum::NONE;
     }
 
+    //exact for strings, containers are extrapolated from up to samples elements (0 walks all)
+    std::optional<KeyUsage_t> usage(const std::string& key, std::size_t samples = DEFAULT_USAGE_SAMPLES) const
+    {
+        auto it = Dict.find(key);
+        if (it == Dict.end())
+            return std::nullopt;
+        KeyUsage_t usage{ HASH_NODE_OVERHEAD + sizeof(*it) + heap_bytes(it->first), 1 };
+        const auto& value = it->second;
+        if (auto s = std::get_if<string_type>(&value))
+        {
+            usage.Bytes += heap_bytes(*s);
+        }
+        else if (auto set = std::get_if<set_type>(&value))
+        {
+            usage.Elements = set->size();
+            usage.Bytes += sampled_bytes(*set, samples, [](const std::string& member) {
+                return TREE_NODE_OVERHEAD + sizeof(member) + heap_bytes(member);
+            });
+        }
+        else if (auto sorted_set = std::get_if<sortedset_type>(&value))
+        {
+            usage.Elements = sorted_set->Members.size();
+            usage.Bytes += sampled_bytes(sorted_set->Members, samples, [](const auto& member) {
+                //the member node plus its node in Scores
+                return 2 * TREE_NODE_OVERHEAD + sizeof(member) + sizeof(decltype(sortedset_type::Scores)::value_type) + heap_bytes(member.first);
+            });
+        }
+        else if (auto mapped = std::get_if<MappedValue_t>(&value))
+        {
+            //lives in the mapping, containers start with their element count (a shorter value is corrupt)
+            usage.Bytes += mapped->Size;
+            if (mapped->Type != DbValueTypeEnum::STRING)
+                usage.Elements = static_cast<std::size_t>(mapped_layout::read_u64(mapped_layout::value_reader{*mapped}.take(8)));
+        }
+        return usage;
+    }
+
     bool del(const std::string& key)
     {
         if (auto it = Dict.find(key); it != Dict.cend())
@@ -99,9 +199,70 @@ struct STL_Database_t final
             co_yield kv.first;
     }
 
+    void reserve(std::size_t count)
+    {
+        Dict.reserve(count);
+    }
+
+    template<typename Visitor>
+    void for_each(Visitor visitor) const
+    {
+        using enum DbValueTypeEnum;
+        for (const auto& kv : Dict)
+        {
+            std::string_view key{kv.first.data(), kv.first.size()};
+            if (auto mapped = std::get_if<MappedValue_t>(&kv.second))
+            {
+                switch (mapped->Type)
+                {
+                    case STRING: visitor(key, Materialize<string_type>(*mapped)); break;
+                    case SET: visitor(key, Materialize<set_type>(*mapped)); break;
+                    default: visitor(key, Materialize<sortedset_type>(*mapped)); break;
+                }
+                continue;
+            }
+            std::visit([&](const auto& value) {
+                if constexpr (!std::is_same_v<std::decay_t<decltype(value)>, MappedValue_t>)
+                    visitor(key, value);
+            }, kv.second);
+        }
+    }
+
+    //WATCH key, returns its current version
+    std::uint64_t watch(const std::string& key)
+    {
+        auto& watched = Watched[key];
+        ++watched.Watchers;
+        return watched.Version;
+    }
+
+    void unwatch(const std::string& key)
+    {
+        auto it = Watched.find(key);
+        if (it != Watched.end() && --it->second.Watchers == 0)
+            Watched.erase(it);
+    }
+
+    std::uint64_t version(const std::string& key) const
+    {
+        auto it = Watched.find(key);
+        return it != Watched.end() ? it->second.Version : 0;
+    }
+
+    //a write to key, a single emptiness test while nobody watches
+    void touch(const std::string& key)
+    {
+        if (Watched.empty())
+            return;
+        if (auto it = Watched.find(key); it != Watched.end())
+            ++it->second.Version;
+    }
+
     void clear()
     {
         Dict.clear();
+        for (auto& kv : Watched)
+            ++kv.second.Version;
     }
 };
 
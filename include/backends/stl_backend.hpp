@@ -1,10 +1,10 @@
 #ifndef STL_BACKEND_HPP
 #define STL_BACKEND_HPP
 
+const char* g_backend = "STL"; //reported by INFO server
+
 #include "stl/stl_context.hpp"
 #include "stl/stl_databases.hpp"
 #include "stl/stl_strategy.hpp"
 
-const char* g_backend = "STL";
-
 #endif /* STL_BACKEND_HPP */
\ No newline at end of file
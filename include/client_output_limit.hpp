@@ -0,0 +1,109 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef CLIENT_OUTPUT_LIMIT_HPP
+#define CLIENT_OUTPUT_LIMIT_HPP
+
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+//Output buffer limits of the clients, like Redis client-output-buffer-limit for normal clients
+//(--client-output-buffer-limit "<hard> <soft> <soft seconds>"). The front ends report the bytes of
+//replies not yet written to each connection; a client is disconnected once it reaches the hard
+//limit, or stays at or above the soft limit for soft seconds in a row. The native front ends also
+//stop reading from a connection above pause_above() and resume when it is back below, so a client
+//that doesn't read its replies can't make the server produce more of them. 0 disables a limit.
+
+namespace client_output
+{
+    struct limits final
+    {
+        std::size_t hard = 256ull * 1024 * 1024;
+        std::size_t soft = 64ull * 1024 * 1024;
+        std::chrono::seconds soft_seconds{60};
+
+        std::size_t pause_above() const noexcept { return soft ? soft : hard; }
+    };
+
+    static limits g_limits;
+
+    //bytes, or kb, mb and gb multiples of 1024
+    static inline std::optional<std::size_t> parse_size(std::string_view sv)
+    {
+        std::size_t value = 0;
+        auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+        if (ec != std::errc{} || ptr == sv.data())
+            return std::nullopt;
+        const std::string_view unit{ptr, static_cast<std::size_t>(sv.data() + sv.size() - ptr)};
+        auto equals = [&](std::string_view suffix) {
+            if (unit.size() != suffix.size())
+                return false;
+            for (std::size_t i = 0; i < unit.size(); ++i)
+                if ((unit[i] | 0x20) != suffix[i])
+                    return false;
+            return true;
+        };
+        if (unit.empty() || equals("b"))
+            return value;
+        if (equals("kb"))
+            return value * 1024;
+        if (equals("mb"))
+            return value * 1024 * 1024;
+        if (equals("gb"))
+            return value * 1024 * 1024 * 1024;
+        return std::nullopt;
+    }
+
+    //"<hard> <soft> <soft seconds>"
+    static inline std::optional<limits> parse(std::string_view sv)
+    {
+        std::string_view fields[3];
+        std::size_t count = 0;
+        while (!sv.empty())
+        {
+            const auto start = sv.find_first_not_of(' ');
+            if (start == std::string_view::npos)
+                break;
+            sv.remove_prefix(start);
+            const auto end = std::min(sv.find(' '), sv.size());
+            if (count == 3)
+                return std::nullopt;
+            fields[count++] = sv.substr(0, end);
+            sv.remove_prefix(end);
+        }
+        if (count != 3)
+            return std::nullopt;
+        auto hard = parse_size(fields[0]);
+        auto soft = parse_size(fields[1]);
+        std::int64_t seconds = -1;
+        auto [ptr, ec] = std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), seconds);
+        if (!hard || !soft || ec != std::errc{} || ptr != fields[2].data() + fields[2].size() || seconds < 0)
+            return std::nullopt;
+        return limits{*hard, *soft, std::chrono::seconds{seconds}};
+    }
+
+    //true when the client has to be disconnected; over_soft_since is when the client reached the
+    //soft limit, reset when it goes back below
+    static inline bool exceeded(const limits& l, std::size_t unsent,
+                                std::chrono::steady_clock::time_point& over_soft_since, std::chrono::steady_clock::time_point now)
+    {
+        if (l.hard && unsent >= l.hard)
+            return true;
+        if (!l.soft || unsent < l.soft)
+        {
+            over_soft_since = {};
+            return false;
+        }
+        if (over_soft_since == std::chrono::steady_clock::time_point{})
+            over_soft_since = now;
+        return now - over_soft_since >= l.soft_seconds;
+    }
+}
+
+#endif /* CLIENT_OUTPUT_LIMIT_HPP */
\ No newline at end of file
@@ -0,0 +1,63 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef COARSE_CLOCK_HPP
+#define COARSE_CLOCK_HPP
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+#include <chrono>
+
+//Time read once per event loop iteration (update) and shared by the code that only needs to know
+//roughly when something happened: client creation and last activity, idle timeouts, output buffer
+//limits, replication liveness, append only file fsync, INFO instantaneous metrics. Reading it is a
+//load, so it can be taken for every command. On Linux the time comes from CLOCK_MONOTONIC_COARSE,
+//the tick the kernel last stored (resolution() apart, 1 to 4 ms), which costs no hardware counter
+//read; it has the epoch of CLOCK_MONOTONIC, so it compares with steady_clock. Precise durations
+//are only measured for the sampled commands (command_stats::g_timing).
+
+namespace coarse_clock
+{
+    using clock_type = std::chrono::steady_clock;
+
+#if defined(__linux__)
+    static_assert(std::chrono::steady_clock::is_steady, "steady_clock is CLOCK_MONOTONIC on Linux");
+
+    static inline clock_type::time_point read() noexcept
+    {
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return clock_type::time_point{std::chrono::duration_cast<clock_type::duration>(std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec))};
+    }
+
+    static inline clock_type::duration resolution() noexcept
+    {
+        timespec ts;
+        if (::clock_getres(CLOCK_MONOTONIC_COARSE, &ts) != 0)
+            return std::chrono::milliseconds(4);
+        return std::chrono::duration_cast<clock_type::duration>(std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec));
+    }
+#else
+    static inline clock_type::time_point read() noexcept { return clock_type::now(); }
+
+    static inline clock_type::duration resolution() noexcept { return clock_type::duration{1}; }
+#endif
+
+    class cached_clock final
+    {
+        clock_type::time_point current = read();
+
+    public:
+        clock_type::time_point update() noexcept { return current = read(); }
+
+        clock_type::time_point now() const noexcept { return current; }
+    };
+
+    static cached_clock g_clock;
+}
+
+#endif /* COARSE_CLOCK_HPP */
\ No newline at end of file
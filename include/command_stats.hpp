@@ -0,0 +1,343 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef COMMAND_STATS_HPP
+#define COMMAND_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "resp.hpp"
+#include "utils.hpp"
+
+//Per command counters and latency histograms, fed by the server for every executed command and
+//read by INFO commandstats/latencystats and LATENCY HISTOGRAM/LATEST. Recording a call is a
+//lookup plus a few relaxed atomic increments, no locks and no allocation after the first call.
+//Only one in g_timing.sample_rate calls is timed (--latency-sample-rate): histograms and latest
+//latencies come from the timed calls, usec scales their average to every call.
+
+namespace command_stats
+{
+    //log-linear histogram of nanoseconds: values below SUB_BUCKET_COUNT are exact, every power of
+    //two above is split in SUB_BUCKET_COUNT linear steps (values reported within 6.25%)
+    class latency_histogram final
+    {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 4;
+        static constexpr std::uint64_t SUB_BUCKET_COUNT = 1ull << SUB_BUCKET_BITS;
+        static constexpr int MAX_MAGNITUDE = 36;    //values are clamped to 2^36 - 1 ns (68 seconds)
+        static constexpr std::uint64_t HIGHEST_TRACKABLE_VALUE = (1ull << MAX_MAGNITUDE) - 1;
+        static constexpr std::size_t COUNTS_LENGTH = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    private:
+        std::array<std::atomic<std::uint64_t>, COUNTS_LENGTH> counts{};
+
+    public:
+        static constexpr std::size_t index_of(std::uint64_t value) noexcept
+        {
+            value = std::min(value, HIGHEST_TRACKABLE_VALUE);
+            if (value < SUB_BUCKET_COUNT)
+                return static_cast<std::size_t>(value);
+            const int magnitude = 63 - std::countl_zero(value);
+            const int shift = magnitude - SUB_BUCKET_BITS;
+            const std::uint64_t sub_bucket = (value >> shift) - SUB_BUCKET_COUNT;
+            return static_cast<std::size_t>((shift + 1) * SUB_BUCKET_COUNT + sub_bucket);
+        }
+
+        //largest value that falls in the same slot
+        static constexpr std::uint64_t highest_equivalent_value(std::size_t index) noexcept
+        {
+            if (index < SUB_BUCKET_COUNT)
+                return index;
+            const int shift = static_cast<int>(index / SUB_BUCKET_COUNT) - 1;
+            const std::uint64_t sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+            return ((sub_bucket + 1) << shift) - 1;
+        }
+
+        void record(std::uint64_t value) noexcept
+        {
+            counts[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void reset() noexcept
+        {
+            for (auto& count : counts)
+                count.store(0, std::memory_order_relaxed);
+        }
+
+        std::uint64_t count() const noexcept
+        {
+            std::uint64_t total = 0;
+            for (const auto& count : counts)
+                total += count.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        //value at or below which percentile% of the recorded values fall
+        std::uint64_t percentile(double percentile) const noexcept
+        {
+            std::array<std::uint64_t, COUNTS_LENGTH> snapshot;
+            std::uint64_t total = 0;
+            for (std::size_t i = 0; i < COUNTS_LENGTH; ++i)
+                total += snapshot[i] = counts[i].load(std::memory_order_relaxed);
+            if (!total)
+                return 0;
+            auto wanted = static_cast<std::uint64_t>(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(total) + 0.5);
+            wanted = std::clamp<std::uint64_t>(wanted, 1, total);
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < COUNTS_LENGTH; ++i)
+                if ((seen += snapshot[i]) >= wanted)
+                    return highest_equivalent_value(i);
+            return HIGHEST_TRACKABLE_VALUE;
+        }
+
+        //calls visitor(upper bound, count) for every non empty slot, in increasing order
+        template<typename Visitor>
+        void for_each_bucket(Visitor visitor) const
+        {
+            for (std::size_t i = 0; i < COUNTS_LENGTH; ++i)
+                if (auto count = counts[i].load(std::memory_order_relaxed))
+                    visitor(highest_equivalent_value(i), count);
+        }
+    };
+
+    struct command_stat final
+    {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::uint64_t> timed_calls{0};
+        std::atomic<std::uint64_t> nanoseconds{0};      //of the timed calls
+        std::atomic<std::uint64_t> rejected_calls{0};   //refused before running, e.g. writes on a replica
+        std::atomic<std::uint64_t> failed_calls{0};     //ran and replied with an error
+        std::atomic<std::int64_t> latest_time{0};       //clock ticks when the latest timed call ended
+        std::atomic<std::uint64_t> latest_nanoseconds{0};
+        std::atomic<std::uint64_t> max_nanoseconds{0};
+        latency_histogram histogram;
+
+        void reset() noexcept
+        {
+            calls = timed_calls = nanoseconds = rejected_calls = failed_calls = 0;
+            latest_time = 0;
+            latest_nanoseconds = max_nanoseconds = 0;
+            histogram.reset();
+        }
+    };
+
+    using clock_type = std::chrono::high_resolution_clock;
+
+    constexpr std::uint64_t DEFAULT_TIMING_SAMPLE_RATE = 8;
+
+    //which calls read the precise clock; a countdown, no division per call
+    struct timing_policy final
+    {
+        std::uint64_t sample_rate = DEFAULT_TIMING_SAMPLE_RATE;    //0 disables, 1 times every call
+        std::uint64_t countdown = 1;
+
+        bool should_time() noexcept
+        {
+            if (!sample_rate || --countdown)
+                return false;
+            countdown = sample_rate;
+            return true;
+        }
+    };
+
+    static timing_policy g_timing;
+
+    //entries are created by the event loop thread only, never erased
+    class stats_table final
+    {
+        std::unordered_map<std::string, command_stat> stats;
+
+    public:
+        //a call that wasn't timed
+        command_stat* record(const std::string& cmd_name, bool failed, bool rejected)
+        {
+            auto& stat = stats[cmd_name];
+            if (rejected)
+            {
+                stat.rejected_calls.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            stat.calls.fetch_add(1, std::memory_order_relaxed);
+            if (failed)
+                stat.failed_calls.fetch_add(1, std::memory_order_relaxed);
+            return &stat;
+        }
+
+        void record(const std::string& cmd_name, std::uint64_t nanoseconds, bool failed, bool rejected, clock_type::time_point end)
+        {
+            auto* counted = record(cmd_name, failed, rejected);
+            if (!counted)
+                return;
+            auto& stat = *counted;
+            stat.timed_calls.fetch_add(1, std::memory_order_relaxed);
+            stat.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+            stat.latest_time.store(end.time_since_epoch().count(), std::memory_order_relaxed);
+            stat.latest_nanoseconds.store(nanoseconds, std::memory_order_relaxed);
+            if (nanoseconds > stat.max_nanoseconds.load(std::memory_order_relaxed))
+                stat.max_nanoseconds.store(nanoseconds, std::memory_order_relaxed);
+            stat.histogram.record(nanoseconds);
+        }
+
+        const command_stat* find(const std::string& cmd_name) const
+        {
+            auto it = stats.find(cmd_name);
+            return it != stats.end() ? &it->second : nullptr;
+        }
+
+        //names in alphabetical order, only commands seen at least once
+        std::vector<std::string> names() const
+        {
+            std::vector<std::string> result;
+            for (const auto& [name, stat] : stats)
+                if (stat.calls.load(std::memory_order_relaxed) || stat.rejected_calls.load(std::memory_order_relaxed))
+                    result.push_back(name);
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+
+        //resets the given commands, every command when empty; returns how many had samples
+        std::size_t reset(const std::vector<std::string>& cmd_names = {})
+        {
+            std::size_t count = 0;
+            for (auto& [name, stat] : stats)
+            {
+                if (!cmd_names.empty() && std::find(cmd_names.begin(), cmd_names.end(), name) == cmd_names.end())
+                    continue;
+                if (stat.calls.load(std::memory_order_relaxed) || stat.rejected_calls.load(std::memory_order_relaxed))
+                    ++count;
+                stat.reset();
+            }
+            return count;
+        }
+    };
+
+    static stats_table g_command_stats;
+
+    static inline std::string to_lower(std::string_view sv)
+    {
+        std::string temp(sv);
+        std::transform(temp.begin(), temp.end(), temp.begin(),
+            [](std::string::value_type c) -> std::string::value_type { return std::tolower(c); });
+        return temp;
+    }
+
+    static inline std::string integer(std::uint64_t num)
+    {
+        return ":" + std::to_string(num) + "\r\n";
+    }
+
+    //cmdstat_get:calls=2,usec=15,usec_per_call=7.50,rejected_calls=0,failed_calls=0
+    static inline std::string info_commandstats()
+    {
+        std::ostringstream oss;
+        oss << "# Commandstats\r\n" << std::fixed << std::setprecision(2);
+        for (const auto& name : g_command_stats.names())
+        {
+            const auto& stat = *g_command_stats.find(name);
+            const auto calls = stat.calls.load(std::memory_order_relaxed);
+            const auto timed_calls = stat.timed_calls.load(std::memory_order_relaxed);
+            const double usec_per_call = timed_calls ? static_cast<double>(stat.nanoseconds.load(std::memory_order_relaxed)) / 1000.0 / static_cast<double>(timed_calls) : 0.0;
+            oss << "cmdstat_" << to_lower(name) << ":calls=" << calls
+                << ",usec=" << static_cast<std::uint64_t>(usec_per_call * static_cast<double>(calls))
+                << ",usec_per_call=" << usec_per_call
+                << ",rejected_calls=" << stat.rejected_calls.load(std::memory_order_relaxed)
+                << ",failed_calls=" << stat.failed_calls.load(std::memory_order_relaxed) << "\r\n";
+        }
+        return oss.str();
+    }
+
+    //latency_percentiles_usec_get:p50=1.003,p99=3.007,p99.9=4.015
+    static inline std::string info_latencystats()
+    {
+        std::ostringstream oss;
+        oss << "# Latencystats\r\n" << std::fixed << std::setprecision(3);
+        for (const auto& name : g_command_stats.names())
+        {
+            const auto& histogram = g_command_stats.find(name)->histogram;
+            if (!histogram.count())
+                continue;
+            oss << "latency_percentiles_usec_" << to_lower(name)
+                << ":p50=" << histogram.percentile(50) / 1000.0
+                << ",p99=" << histogram.percentile(99) / 1000.0
+                << ",p99.9=" << histogram.percentile(99.9) / 1000.0 << "\r\n";
+        }
+        return oss.str();
+    }
+
+    //name -> ["calls", n, "histogram_usec", [bucket, cumulative count, ...]] with power of two
+    //microsecond buckets, for the given commands or every command seen
+    static inline std::string latency_histogram_reply(std::vector<std::string> cmd_names)
+    {
+        if (cmd_names.empty())
+            cmd_names = g_command_stats.names();
+        std::string reply;
+        std::size_t entries = 0;
+        for (const auto& name : cmd_names)
+        {
+            const auto* stat = g_command_stats.find(name);
+            if (!stat || !stat->calls.load(std::memory_order_relaxed))
+                continue;
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets;
+            std::uint64_t cumulative = 0;
+            stat->histogram.for_each_bucket([&](std::uint64_t upper_ns, std::uint64_t count) {
+                const std::uint64_t usec = std::bit_ceil(std::max<std::uint64_t>((upper_ns + 999) / 1000, 1));
+                cumulative += count;
+                if (!buckets.empty() && buckets.back().first == usec)
+                    buckets.back().second = cumulative;
+                else
+                    buckets.emplace_back(usec, cumulative);
+            });
+            reply += resp::simple_string(to_lower(name));
+            reply += format::resp_array_size(4);
+            reply += resp::simple_string("calls");
+            reply += integer(stat->calls.load(std::memory_order_relaxed));
+            reply += resp::simple_string("histogram_usec");
+            reply += format::resp_array_size(2 * buckets.size());
+            for (const auto& [usec, count] : buckets)
+                reply += integer(usec) + integer(count);
+            ++entries;
+        }
+        return format::resp_array_size(2 * entries) + reply;
+    }
+
+    //[name, unix time of the latest call, latest ms, max ms] per command seen
+    static inline std::string latency_latest_reply()
+    {
+        using namespace std::chrono;
+        const auto now = clock_type::now();
+        const auto unix_now = duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+        std::string reply;
+        std::size_t entries = 0;
+        for (const auto& name : g_command_stats.names())
+        {
+            const auto& stat = *g_command_stats.find(name);
+            if (!stat.timed_calls.load(std::memory_order_relaxed))
+                continue;
+            const clock_type::time_point latest{clock_type::duration{stat.latest_time.load(std::memory_order_relaxed)}};
+            const auto age = duration_cast<seconds>(now - latest).count();
+            reply += format::resp_array_size(4);
+            reply += resp::simple_string(to_lower(name));
+            reply += integer(static_cast<std::uint64_t>(unix_now - age));
+            reply += integer(stat.latest_nanoseconds.load(std::memory_order_relaxed) / 1000000);
+            reply += integer(stat.max_nanoseconds.load(std::memory_order_relaxed) / 1000000);
+            ++entries;
+        }
+        return format::resp_array_size(entries) + reply;
+    }
+}
+
+#endif /* COMMAND_STATS_HPP */
\ No newline at end of file
@@ -0,0 +1,40 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef CRC64_HPP
+#define CRC64_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//CRC-64/Jones (reflected), the same polynomial used by Redis RDB files
+constexpr std::array<std::uint64_t, 256> make_crc64_table(std::uint64_t poly)
+{
+    std::array<std::uint64_t, 256> table{};
+    for (std::uint64_t i = 0; i < 256; ++i)
+    {
+        std::uint64_t crc = i;
+        for (int j = 0; j < 8; ++j)
+            crc = (crc & 1) ? (crc >> 1) ^ poly : (crc >> 1);
+        table[i] = crc;
+    }
+    return table;
+}
+
+struct crc64 final
+{
+    static constexpr std::array<std::uint64_t, 256> table = make_crc64_table(0x95AC9329AC4BC9B5ULL);
+
+    static std::uint64_t update(std::uint64_t crc, const void* data, std::size_t size) noexcept
+    {
+        const auto* p = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+};
+
+#endif /* CRC64_HPP */
\ No newline at end of file
@@ -6,6 +6,8 @@
 #ifndef DATABASE_DEFS_HPP
 #define DATABASE_DEFS_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 enum class DbValueTypeEnum
@@ -25,4 +27,49 @@ static inline std::string to_string(DbValueTypeEnum value)
     }
 }
 
+//MEMORY USAGE estimate of one key: the dictionary entry, the value and its elements
+struct KeyUsage_t final
+{
+    std::size_t Bytes;
+    std::size_t Elements;
+};
+
+//WATCH: modification counter of a key some client watches, dropped with its last watcher
+struct KeyVersion_t final
+{
+    std::uint64_t Version = 0;
+    std::size_t Watchers = 0;
+};
+
+//a key watched by a client and its version when WATCH was executed
+struct WatchedKey_t final
+{
+    int DbNumber;
+    std::string Key;
+    std::uint64_t Version;
+};
+
+constexpr std::size_t HASH_NODE_OVERHEAD = 3 * sizeof(void*);   //next, cached hash, bucket slot
+constexpr std::size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);   //parent, left, right, color
+constexpr std::size_t DEFAULT_USAGE_SAMPLES = 5;
+
+//heap block owned by a string, nothing while it fits in the small buffer
+template<typename String>
+static inline std::size_t heap_bytes(const String& s)
+{
+    const auto* self = reinterpret_cast<const char*>(&s);
+    const auto* data = reinterpret_cast<const char*>(s.data());
+    return data >= self && data < self + sizeof(s) ? 0 : s.capacity() + 1;
+}
+
+//bytes of a container extrapolated from its first samples elements (0 walks all of them)
+template<typename Container, typename ElementBytes>
+static std::size_t sampled_bytes(const Container& container, std::size_t samples, ElementBytes element_bytes)
+{
+    std::size_t n = 0, bytes = 0;
+    for (auto it = container.begin(); it != container.end() && (!samples || n < samples); ++it, ++n)
+        bytes += element_bytes(*it);
+    return n ? bytes * container.size() / n : 0;
+}
+
 #endif /* DATABASE_DEFS_HPP */
\ No newline at end of file
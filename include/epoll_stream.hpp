@@ -0,0 +1,320 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef EPOLL_STREAM_HPP
+#define EPOLL_STREAM_HPP
+
+//RESP front end over native TCP sockets and edge-triggered epoll (--transport epoll, Linux only).
+//Bytes go straight from the kernel into a reused buffer handed to the handler, without routing id
+//frames, base64 ids or the ZeroMQ I/O thread. Every connection keeps its own output buffer: the
+//replies of all commands read in one wake up are written with one send, and what the socket
+//doesn't take is written when epoll reports it writable again. The epoll descriptor itself is
+//polled by the zmq_poll loop next to the other sockets. Same Handler as zmq_stream.hpp.
+//bind_unix listens on an AF_UNIX path instead (--unixsocket), for clients on the same host that
+//can skip the TCP/IP stack; its connection ids are prefixed with "unix:" so they never collide
+//with the ids of the TCP front end served by the same loop.
+//On shutdown stop_accepting closes the listening socket while the connections keep being served,
+//drained tells when every reply has been written (lifecycle.hpp).
+//The handler learns how many reply bytes each connection still has to write (unsent), and a
+//connection with more than pause_reading_above bytes unsent isn't read until it catches up
+//(client_output_limit.hpp); kill closes a connection for the event loop.
+
+#if defined(__linux__)
+
+#include <zmq.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "native_socket.hpp"
+#include "server_stats.hpp"
+#include "tracing.hpp"
+
+namespace transport
+{
+    constexpr std::size_t READ_BUFFER_SIZE = 64 * 1024;
+    constexpr int MAX_EVENTS = 256;
+
+    class epoll_stream final
+    {
+        struct connection final
+        {
+            std::string id;
+            std::string output;
+            std::size_t sent = 0;
+            std::size_t reported = 0;   //unsent bytes the handler knows of
+            bool unread = false;        //input left in the socket while reading was paused
+        };
+
+        int listen_fd = -1, epoll_fd = -1;
+        std::string unix_path;
+        std::size_t pause_above = 0;
+        std::unordered_map<int, connection> connections;
+        std::uint64_t connection_counter = 0;
+        std::vector<char> input = std::vector<char>(READ_BUFFER_SIZE);
+        std::array<epoll_event, MAX_EVENTS> events;
+
+        static std::size_t unsent(const connection& conn) noexcept { return conn.output.size() - conn.sent; }
+
+        bool over_limit(const connection& conn) const noexcept { return pause_above && unsent(conn) > pause_above; }
+
+        //false when the connection is broken
+        template<typename Handler>
+        bool flush(int fd, connection& conn, Handler& handler)
+        {
+            bool alive = true;
+            {
+                KV_TRACE_SCOPE("send");
+                while (conn.sent < conn.output.size())
+                {
+                    ++server_stats::g_stats.total_io_syscalls;
+                    const auto n = ::send(fd, conn.output.data() + conn.sent, conn.output.size() - conn.sent, MSG_NOSIGNAL);
+                    if (n > 0)
+                        conn.sent += static_cast<std::size_t>(n);
+                    else if (n == -1 && errno == EINTR)
+                        continue;
+                    else
+                    {
+                        alive = n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+                        break;
+                    }
+                }
+            }
+            if (conn.sent == conn.output.size())
+            {
+                conn.output.clear();
+                conn.sent = 0;
+            }
+            if (alive && unsent(conn) != conn.reported)
+            {
+                conn.reported = unsent(conn);
+                handler.unsent(conn.id, conn.reported);
+            }
+            return alive;
+        }
+
+        //reads until the socket is drained or the connection is over its output limit, false when the
+        //peer closed or the connection is broken
+        template<typename Handler>
+        bool receive(int fd, connection& conn, Handler& handler)
+        {
+            for (;;)
+            {
+                if (over_limit(conn))
+                    return true;    //unread stays set, reading resumes once the replies are written
+                ssize_t n;
+                ++server_stats::g_stats.total_io_syscalls;
+                {
+                    KV_TRACE_SCOPE("recv");
+                    n = ::recv(fd, input.data(), input.size(), 0);
+                }
+                if (n > 0)
+                {
+                    auto reply = handler.received(conn.id, std::string_view{input.data(), static_cast<std::size_t>(n)});
+                    if (conn.output.empty())
+                        conn.output = std::move(reply);
+                    else
+                        conn.output += reply;
+                    if (static_cast<std::size_t>(n) < input.size())
+                    {
+                        conn.unread = false;    //a short read drained the socket
+                        return true;
+                    }
+                }
+                else if (n == -1 && errno == EINTR)
+                    continue;
+                else
+                {
+                    conn.unread = false;
+                    return n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+                }
+            }
+        }
+
+        template<typename Handler>
+        void accept_all(Handler& handler)
+        {
+            for (;;)
+            {
+                ++server_stats::g_stats.total_io_syscalls;
+                const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd == -1)
+                {
+                    if (errno == EINTR || errno == ECONNABORTED)
+                        continue;
+                    return;     //EAGAIN, or out of descriptors until a connection closes
+                }
+                if (unix_path.empty())
+                    tune_accepted_socket(fd);
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.fd = fd;
+                if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+                {
+                    ::close(fd);
+                    continue;
+                }
+                auto& conn = connections[fd];
+                conn.id = std::to_string(++connection_counter);
+                if (!unix_path.empty())
+                    conn.id.insert(0, "unix:");
+                handler.connected(conn.id);
+            }
+        }
+
+        template<typename Handler>
+        void drop(int fd, Handler& handler)
+        {
+            auto it = connections.find(fd);
+            if (it == connections.end())
+                return;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            const auto id = std::move(it->second.id);
+            connections.erase(it);
+            handler.disconnected(id);
+        }
+
+        bool listen_on(int fd)
+        {
+            listen_fd = fd;
+            epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;    //level-triggered, accept_all may stop early
+            ev.data.fd = listen_fd;
+            if (listen_fd == -1 || epoll_fd == -1 || ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == -1)
+            {
+                const int error = errno;
+                close();
+                errno = error;
+                return false;
+            }
+            return true;
+        }
+
+    public:
+        epoll_stream() = default;
+        ~epoll_stream() { close(); }
+        epoll_stream(const epoll_stream&) = delete;
+        epoll_stream& operator=(const epoll_stream&) = delete;
+
+        bool bind(int port)
+        {
+            return listen_on(listen_tcp(port));
+        }
+
+        bool bind_unix(const std::string& path)
+        {
+            if (!listen_on(listen_unix(path)))
+                return false;
+            unix_path = path;
+            return true;
+        }
+
+        //connections are closed without notifying the handler
+        void close()
+        {
+            for (auto& [fd, conn] : connections)
+                ::close(fd);
+            connections.clear();
+            for (int* fd : { &listen_fd, &epoll_fd })
+            {
+                if (*fd != -1)
+                    ::close(*fd);
+                *fd = -1;
+            }
+            if (!unix_path.empty())
+                ::unlink(unix_path.c_str());
+            unix_path.clear();
+        }
+
+        void stop_accepting()
+        {
+            if (listen_fd == -1)
+                return;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_fd, nullptr);
+            ::close(listen_fd);
+            listen_fd = -1;
+            if (!unix_path.empty())
+                ::unlink(unix_path.c_str());
+            unix_path.clear();
+        }
+
+        void pause_reading_above(std::size_t bytes) noexcept { pause_above = bytes; }
+
+        template<typename Handler>
+        bool kill(const std::string& id, Handler& handler)
+        {
+            for (const auto& [fd, conn] : connections)
+                if (conn.id == id)
+                {
+                    drop(fd, handler);
+                    return true;
+                }
+            return false;
+        }
+
+        bool drained() const noexcept
+        {
+            for (const auto& [fd, conn] : connections)
+                if (!conn.output.empty())
+                    return false;
+            return true;
+        }
+
+        int handle() const noexcept { return epoll_fd; }
+
+        zmq_pollitem_t pollitem() const noexcept { return { nullptr, epoll_fd, ZMQ_POLLIN, 0 }; }
+
+        template<typename Handler>
+        void on_readable(Handler& handler)
+        {
+            ++server_stats::g_stats.total_io_syscalls;
+            const int n = ::epoll_wait(epoll_fd, events.data(), MAX_EVENTS, 0);
+            for (int i = 0; i < n; ++i)
+            {
+                const int fd = events[i].data.fd;
+                const auto flags = events[i].events;
+                if (fd == listen_fd)
+                {
+                    accept_all(handler);
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end())
+                    continue;
+                auto& conn = it->second;
+                bool alive = !(flags & EPOLLERR);
+                if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+                    conn.unread = true;
+                while (alive)
+                {
+                    if (conn.unread && !over_limit(conn))
+                        alive = receive(fd, conn, handler);
+                    if (!conn.output.empty())
+                        alive = flush(fd, conn, handler) && alive;
+                    if (!conn.unread || over_limit(conn))
+                        break;
+                }
+                if (!alive || (flags & EPOLLHUP))
+                    drop(fd, handler);
+            }
+        }
+    };
+}
+
+#endif /* __linux__ */
+
+#endif /* EPOLL_STREAM_HPP */
\ No newline at end of file
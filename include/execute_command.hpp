@@ -6,15 +6,80 @@
 #ifndef EXECUTE_COMMAND_HPP
 #define EXECUTE_COMMAND_HPP
 
+#include <cstddef>
 #include <string>
+#include <utility>
 
 #include "resp.hpp"
 #include "resp_command.hpp"
+#include "tracing.hpp"
+#include "transaction.hpp"
+
+//commands that modify the dataset, the ones logged to the append only file
+static inline bool is_write_command(const std::string& cmd_name)
+{
+    return cmd_name == "SET" || cmd_name == "DEL" ||
+           cmd_name == "SADD" || cmd_name == "SREM" ||
+           cmd_name == "ZADD" || cmd_name == "ZREM" || cmd_name == "ZREMRANGEBYSCORE" ||
+           cmd_name == "FLUSHDB";
+}
+
+//positions of the key arguments as [first, last], last 0 meaning every remaining argument and
+//first 0 a command without keys
+static inline std::pair<std::size_t, std::size_t> key_arguments(const std::string& cmd_name)
+{
+    if (cmd_name == "DEL" || cmd_name == "EXISTS" || cmd_name == "SINTER" || cmd_name == "SUNION")
+        return { 1, 0 };
+    if (cmd_name == "SET" || cmd_name == "GET" || cmd_name == "TYPE" ||
+        cmd_name == "SADD" || cmd_name == "SREM" || cmd_name == "SCARD" || cmd_name == "SMEMBERS" || cmd_name == "SISMEMBER" ||
+        cmd_name == "ZADD" || cmd_name == "ZREM" || cmd_name == "ZREMRANGEBYSCORE" || cmd_name == "ZSCORE" || 
+        cmd_name == "ZCARD" || cmd_name == "ZRANGE")
+        return { 1, 1 };
+    return { 0, 0 };
+}
+
+//number of arguments counting the command name, negative for at least that many, 0 for an
+//unknown command; checked when MULTI queues a command
+static inline int command_arity(const std::string& cmd_name)
+{
+    if (cmd_name == "FLUSHDB" || cmd_name == "DBSIZE" || cmd_name == "PING" || cmd_name == "ROLE" ||
+        cmd_name == "SAVE" || cmd_name == "BGSAVE" || cmd_name == "LASTSAVE" || cmd_name == "BGREWRITEAOF" ||
+        cmd_name == "MULTI" || cmd_name == "EXEC" || cmd_name == "DISCARD" || cmd_name == "UNWATCH")
+        return 1;
+    if (cmd_name == "GET" || cmd_name == "TYPE" || cmd_name == "SELECT" ||
+        cmd_name == "SCARD" || cmd_name == "SMEMBERS" || cmd_name == "ZCARD")
+        return 2;
+    if (cmd_name == "SET" || cmd_name == "SISMEMBER" || cmd_name == "ZSCORE" || cmd_name == "REPLICAOF")
+        return 3;
+    if (cmd_name == "ZREMRANGEBYSCORE")
+        return 4;
+    if (cmd_name == "KEYS" || cmd_name == "INFO" || cmd_name == "HOTKEYS" || cmd_name == "BIGKEYS")
+        return -1;
+    if (cmd_name == "EXISTS" || cmd_name == "DEL" || cmd_name == "SINTER" || cmd_name == "SUNION" ||
+        cmd_name == "CLIENT" || cmd_name == "LATENCY" || cmd_name == "SLOWLOG" || cmd_name == "MEMORY" ||
+        cmd_name == "OBJECT" || cmd_name == "TRACE" || cmd_name == "WATCH" || cmd_name == "SCRIPT")
+        return -2;
+    if (cmd_name == "SADD" || cmd_name == "SREM" || cmd_name == "ZREM" || cmd_name == "EVAL" || cmd_name == "EVALSHA")
+        return -3;
+    if (cmd_name == "ZADD" || cmd_name == "ZRANGE")
+        return -4;
+    return 0;
+}
+
+//WATCH: bumps the versions of the keys a write command modified
+template<typename Database>
+static inline void touch_keys(Database& db, const resp::command& cmd)
+{
+    const auto [first, last] = key_arguments(cmd.name());
+    for (std::size_t i = first; first && i < cmd.size() && (!last || i <= last); ++i)
+        db.touch(cmd[i]);
+}
 
 template<typename Context, typename CommandStrategy>
-static inline std::string execute_command(Context& ctx, const resp::command& cmd, bool& unk_cmd)
+static inline std::string dispatch_command(Context& ctx, const resp::command& cmd, bool& unk_cmd)
 {
     const auto& cmd_name = cmd.name();
+    KV_TRACE_SCOPE_ARG("dispatch", cmd_name);
     
     if (cmd_name == "SET") //SET key value
         return CommandStrategy::set(ctx, cmd);
@@ -88,9 +153,88 @@ static inline std::string execute_command(Context& ctx, const resp::command& cmd
     if (cmd_name == "PING") //PING
         return CommandStrategy::ping(ctx, cmd);
 
+    if (cmd_name == "SAVE") //SAVE
+        return CommandStrategy::save(ctx, cmd);
+
+    if (cmd_name == "BGSAVE") //BGSAVE
+        return CommandStrategy::bgsave(ctx, cmd);
+
+    if (cmd_name == "LASTSAVE") //LASTSAVE
+        return CommandStrategy::lastsave(ctx, cmd);
+
+    if (cmd_name == "BGREWRITEAOF") //BGREWRITEAOF
+        return CommandStrategy::bgrewriteaof(ctx, cmd);
+
+    if (cmd_name == "REPLICAOF") //REPLICAOF host port | NO ONE
+        return CommandStrategy::replicaof(ctx, cmd);
+
+    if (cmd_name == "ROLE") //ROLE
+        return CommandStrategy::role(ctx, cmd);
+
+    if (cmd_name == "INFO") //INFO [section ...]
+        return CommandStrategy::info(ctx, cmd);
+
+    if (cmd_name == "LATENCY") //LATENCY HISTOGRAM [command ...] | LATEST | RESET [command ...]
+        return CommandStrategy::latency(ctx, cmd);
+
+    if (cmd_name == "SLOWLOG") //SLOWLOG GET [count] | LEN | RESET
+        return CommandStrategy::slowlog(ctx, cmd);
+
+    if (cmd_name == "MEMORY") //MEMORY USAGE key [SAMPLES count]
+        return CommandStrategy::memory(ctx, cmd);
+
+    if (cmd_name == "OBJECT") //OBJECT FREQ key
+        return CommandStrategy::object(ctx, cmd);
+
+    if (cmd_name == "HOTKEYS") //HOTKEYS [count]
+        return CommandStrategy::hotkeys(ctx, cmd);
+
+    if (cmd_name == "BIGKEYS") //BIGKEYS [count]
+        return CommandStrategy::bigkeys(ctx, cmd);
+
+    if (cmd_name == "TRACE") //TRACE DUMP [filename] | RESET
+        return CommandStrategy::trace(ctx, cmd);
+
+    if (cmd_name == "MULTI") //MULTI
+        return CommandStrategy::multi(ctx, cmd);
+
+    if (cmd_name == "EXEC") //EXEC
+        return CommandStrategy::exec(ctx, cmd);
+
+    if (cmd_name == "DISCARD") //DISCARD
+        return CommandStrategy::discard(ctx, cmd);
+
+    if (cmd_name == "WATCH") //WATCH key [key ...]
+        return CommandStrategy::watch(ctx, cmd);
+
+    if (cmd_name == "UNWATCH") //UNWATCH
+        return CommandStrategy::unwatch(ctx, cmd);
+
+    if (cmd_name == "EVAL") //EVAL script numkeys [key ...] [arg ...]
+        return CommandStrategy::eval(ctx, cmd);
+
+    if (cmd_name == "EVALSHA") //EVALSHA sha1 numkeys [key ...] [arg ...]
+        return CommandStrategy::evalsha(ctx, cmd);
+
+    if (cmd_name == "SCRIPT") //SCRIPT LOAD script | EXISTS sha1 [sha1 ...] | FLUSH
+        return CommandStrategy::script(ctx, cmd);
+
     //ignore command
     unk_cmd = true;
     return resp::error_unknown_command(cmd_name);
 }
 
+//between MULTI and EXEC commands are queued instead of executed
+template<typename Context, typename CommandStrategy>
+static inline std::string execute_command(Context& ctx, const resp::command& cmd, bool& unk_cmd)
+{
+    auto& client = ctx.Client();
+    if (client.InMulti && !transaction::is_control_command(cmd.name()))
+        return transaction::queue(client, cmd, command_arity(cmd.name()));
+    auto reply = dispatch_command<Context, CommandStrategy>(ctx, cmd, unk_cmd);
+    if (!reply.empty() && reply[0] != '-' && is_write_command(cmd.name()))
+        touch_keys(client.CurrentDb(), cmd);
+    return reply;
+}
+
 #endif /* EXECUTE_COMMAND_HPP */
\ No newline at end of file
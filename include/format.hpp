@@ -34,12 +34,29 @@ namespace format
         return std::format("-ERR unknown subcommand '{}'\r\n", sv);
     }
 
+    static inline std::string resp_error(const std::string_view& sv)
+    {
+        return std::format("-ERR {}\r\n", sv);
+    }
+
     static inline std::string resp_integer(int num)
     {
         if (num) return std::format(":{:+}\r\n", num);
         return std::format(":0\r\n", num);
     }
 
+    static inline std::string resp_integer(long long num)
+    {
+        if (num) return std::format(":{:+}\r\n", num);
+        return std::format(":0\r\n", num);
+    }
+
+    static inline std::string resp_integer(unsigned long long num)
+    {
+        if (num) return std::format(":+{}\r\n", num);
+        return std::format(":0\r\n", num);
+    }
+
     static inline std::string zmq_version_string(int major, int minor, int patch, const std::string& backend)
     {
         return std::format("ZMQ version {}.{}.{} (Backend: {})\n\n", major, minor, patch, backend);
@@ -49,6 +66,11 @@ namespace format
     {
         return std::format("tcp://*:{}", port);
     }
+
+    static inline std::string zmq_tcp_address(const std::string& host, int port)
+    {
+        return std::format("tcp://{}:{}", host, port);
+    }
 }
 #else
 #include <sstream>
@@ -90,6 +112,13 @@ namespace format
         return std::move(oss.str());
     }
 
+    static inline std::string resp_error(const std::string_view& sv)
+    {
+        std::ostringstream oss;
+        oss << "-ERR " << sv << "\r\n";
+        return std::move(oss.str());
+    }
+
     static inline std::string resp_integer(int num)
     {
         std::ostringstream oss;
@@ -100,6 +129,26 @@ namespace format
         return std::move(oss.str());
     }
 
+    static inline std::string resp_integer(long long num)
+    {
+        std::ostringstream oss;
+        if (num != 0)
+            oss << ':' << (num > 0 ? "+" : "") << num << "\r\n";
+        else
+            oss << ":0\r\n";
+        return std::move(oss.str());
+    }
+
+    static inline std::string resp_integer(unsigned long long num)
+    {
+        std::ostringstream oss;
+        if (num != 0)
+            oss << ":+" << num << "\r\n";
+        else
+            oss << ":0\r\n";
+        return std::move(oss.str());
+    }
+
     static inline std::string zmq_version_string(int major, int minor, int patch, const std::string& backend)
     {
         std::ostringstream oss;
@@ -114,6 +163,13 @@ namespace format
         oss << "tcp://*:" << port;
         return std::move(oss.str());
     }
+
+    static inline std::string zmq_tcp_address(const std::string& host, int port)
+    {
+        std::ostringstream oss;
+        oss << "tcp://" << host << ':' << port;
+        return std::move(oss.str());
+    }
 }
 #endif 
 
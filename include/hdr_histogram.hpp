@@ -0,0 +1,127 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef HDR_HISTOGRAM_HPP
+#define HDR_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+//Fixed-memory latency histogram with the HdrHistogram bucket layout: values are grouped by
+//power of two and every power is split in SUB_BUCKET_HALF_COUNT linear sub-buckets, so any
+//recorded value is reported within 1/SUB_BUCKET_HALF_COUNT (< 1%) of its real value.
+/*
+
+  bucket 0 covers [0, 256) one by one, bucket b > 0 covers [128 << b, 256 << b) in steps of 1 << b
+
+*/
+class hdr_histogram final
+{
+public:
+    static constexpr int SUB_BUCKET_HALF_COUNT_MAGNITUDE = 7;
+    static constexpr std::uint64_t SUB_BUCKET_HALF_COUNT = 1ull << SUB_BUCKET_HALF_COUNT_MAGNITUDE;
+    static constexpr std::uint64_t SUB_BUCKET_COUNT = 2 * SUB_BUCKET_HALF_COUNT;
+    static constexpr std::uint64_t SUB_BUCKET_MASK = SUB_BUCKET_COUNT - 1;
+    static constexpr int MAX_MAGNITUDE = 40;    //values are clamped to 2^40 - 1 (18 minutes in nanoseconds)
+    static constexpr std::uint64_t HIGHEST_TRACKABLE_VALUE = (1ull << MAX_MAGNITUDE) - 1;
+    static constexpr int BUCKET_COUNT = MAX_MAGNITUDE - SUB_BUCKET_HALF_COUNT_MAGNITUDE;
+    static constexpr std::size_t COUNTS_LENGTH = (BUCKET_COUNT + 1) * SUB_BUCKET_HALF_COUNT;
+
+private:
+    std::array<std::uint64_t, COUNTS_LENGTH> counts{};
+    std::uint64_t total_count = 0;
+    std::uint64_t min_value = UINT64_MAX;
+    std::uint64_t max_value = 0;
+    double sum = 0;
+
+    static constexpr int bucket_index(std::uint64_t value) noexcept
+    {
+        return (63 - std::countl_zero(value | SUB_BUCKET_MASK)) - SUB_BUCKET_HALF_COUNT_MAGNITUDE;
+    }
+
+    static constexpr std::size_t counts_index(std::uint64_t value) noexcept
+    {
+        int bucket = bucket_index(value);
+        std::uint64_t sub_bucket = value >> bucket;
+        return ((static_cast<std::size_t>(bucket) + 1) << SUB_BUCKET_HALF_COUNT_MAGNITUDE) + (sub_bucket - SUB_BUCKET_HALF_COUNT);
+    }
+
+    //largest value that falls in the same counts slot
+    static constexpr std::uint64_t highest_equivalent_value(std::size_t index) noexcept
+    {
+        int bucket = static_cast<int>(index >> SUB_BUCKET_HALF_COUNT_MAGNITUDE) - 1;
+        std::uint64_t sub_bucket = (index & (SUB_BUCKET_HALF_COUNT - 1)) + SUB_BUCKET_HALF_COUNT;
+        if (bucket < 0)
+        {
+            bucket = 0;
+            sub_bucket -= SUB_BUCKET_HALF_COUNT;
+        }
+        return ((sub_bucket + 1) << bucket) - 1;
+    }
+
+public:
+    void record(std::uint64_t value, std::uint64_t count = 1) noexcept
+    {
+        value = std::min(value, HIGHEST_TRACKABLE_VALUE);
+        counts[counts_index(value)] += count;
+        total_count += count;
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+        sum += static_cast<double>(value) * static_cast<double>(count);
+    }
+
+    void merge(const hdr_histogram& other) noexcept
+    {
+        for (std::size_t i = 0; i < COUNTS_LENGTH; ++i)
+            counts[i] += other.counts[i];
+        total_count += other.total_count;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+        sum += other.sum;
+    }
+
+    void reset() noexcept
+    {
+        *this = hdr_histogram{};
+    }
+
+    std::uint64_t count() const noexcept { return total_count; }
+    std::uint64_t min() const noexcept { return total_count ? min_value : 0; }
+    std::uint64_t max() const noexcept { return max_value; }
+    double mean() const noexcept { return total_count ? sum / static_cast<double>(total_count) : 0.0; }
+
+    //value at or below which percentile% of the recorded values fall, e.g. percentile(99.9)
+    std::uint64_t percentile(double percentile) const noexcept
+    {
+        if (!total_count)
+            return 0;
+        percentile = std::clamp(percentile, 0.0, 100.0);
+        auto wanted = static_cast<std::uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total_count)));
+        wanted = std::max<std::uint64_t>(wanted, 1);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < COUNTS_LENGTH; ++i)
+        {
+            seen += counts[i];
+            if (seen >= wanted)
+                return std::min(highest_equivalent_value(i), max_value);
+        }
+        return max_value;
+    }
+
+    //calls visitor(upper bound, count) for every non empty slot, in increasing order
+    template<typename Visitor>
+    void for_each_bucket(Visitor visitor) const
+    {
+        for (std::size_t i = 0; i < COUNTS_LENGTH; ++i)
+            if (counts[i])
+                visitor(highest_equivalent_value(i), counts[i]);
+    }
+};
+
+#endif /* HDR_HISTOGRAM_HPP */
\ No newline at end of file
@@ -0,0 +1,249 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef HOTKEYS_HPP
+#define HOTKEYS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "database_defs.hpp"
+#include "format.hpp"
+#include "resp.hpp"
+
+//Hot and big key tracking over every database. One in sample_rate key accesses is fed to a
+//Count-Min sketch (frequencies of every key in fixed memory) and to two small top-K tables: the
+//most frequent keys by sketch estimate and the biggest keys by MEMORY USAGE estimate (taken for
+//one in BIG_KEY_SAMPLE_RATE samples, sizes change slowly). Counts are halved every DECAY_SAMPLES
+//samples so the hot list follows the current load.
+/*
+    HOTKEYS [count]     [key, db, estimated accesses] most frequent first
+    BIGKEYS [count]     [key, db, type, bytes, elements] biggest first
+    OBJECT FREQ key     estimated accesses of key
+*/
+
+namespace hotkeys
+{
+    constexpr std::size_t SKETCH_DEPTH = 4;
+    constexpr std::size_t SKETCH_WIDTH = 1 << 14;       //256 KiB of counters
+    constexpr std::size_t TOP_K = 32;
+    constexpr std::uint64_t DEFAULT_SAMPLE_RATE = 8;
+    constexpr std::uint64_t BIG_KEY_SAMPLE_RATE = 8;              //sizes are taken for one in 8 samples
+    constexpr std::uint64_t DECAY_SAMPLES = 10 * SKETCH_WIDTH;
+
+    static inline std::uint64_t hash_of(int db_num, std::string_view key) noexcept
+    {
+        //splitmix64 finalizer, the sketch rows use both halves
+        std::uint64_t h = std::hash<std::string_view>{}(key) ^ (static_cast<std::uint64_t>(db_num) * 0x9E3779B97F4A7C15ull);
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+        return h ^ (h >> 31);
+    }
+
+    class count_min_sketch final
+    {
+        std::vector<std::uint32_t> counters = std::vector<std::uint32_t>(SKETCH_DEPTH * SKETCH_WIDTH);
+
+        static std::size_t index_of(std::uint64_t hash, std::size_t row) noexcept
+        {
+            const auto h1 = static_cast<std::uint32_t>(hash), h2 = static_cast<std::uint32_t>(hash >> 32) | 1;
+            return row * SKETCH_WIDTH + (h1 + row * h2) % SKETCH_WIDTH;
+        }
+
+    public:
+        //conservative update: only the counters at the current minimum grow
+        std::uint32_t add(std::uint64_t hash) noexcept
+        {
+            const auto count = estimate(hash) + 1;
+            if (!count)
+                return UINT32_MAX;
+            for (std::size_t row = 0; row < SKETCH_DEPTH; ++row)
+            {
+                auto& counter = counters[index_of(hash, row)];
+                counter = std::max(counter, count);
+            }
+            return count;
+        }
+
+        std::uint32_t estimate(std::uint64_t hash) const noexcept
+        {
+            std::uint32_t count = UINT32_MAX;
+            for (std::size_t row = 0; row < SKETCH_DEPTH; ++row)
+                count = std::min(count, counters[index_of(hash, row)]);
+            return count;
+        }
+
+        void halve() noexcept
+        {
+            for (auto& counter : counters)
+                counter >>= 1;
+        }
+
+        void reset() noexcept
+        {
+            std::fill(counters.begin(), counters.end(), 0);
+        }
+    };
+
+    struct tracked_key final
+    {
+        std::uint64_t hash;
+        int db;
+        std::string key;
+        std::uint64_t weight;       //sketch estimate or bytes
+    };
+
+    //the capacity heaviest keys offered so far; a linear scan is cheaper than a heap at this size
+    class top_k final
+    {
+        std::vector<tracked_key> entries;
+        std::size_t capacity;
+        std::size_t lightest = 0;
+
+        void find_lightest() noexcept
+        {
+            lightest = 0;
+            for (std::size_t i = 1; i < entries.size(); ++i)
+                if (entries[i].weight < entries[lightest].weight)
+                    lightest = i;
+        }
+
+    public:
+        explicit top_k(std::size_t capacity) : capacity{capacity} { entries.reserve(capacity); }
+
+        void offer(std::uint64_t hash, int db, const std::string& key, std::uint64_t weight)
+        {
+            for (std::size_t i = 0; i < entries.size(); ++i)
+            {
+                auto& entry = entries[i];
+                if (entry.hash == hash && entry.db == db && entry.key == key)
+                {
+                    entry.weight = weight;
+                    if (i == lightest || weight < entries[lightest].weight)
+                        find_lightest();
+                    return;
+                }
+            }
+            if (entries.size() < capacity)
+                entries.push_back({hash, db, key, weight});
+            else if (weight > entries[lightest].weight)
+                entries[lightest] = {hash, db, key, weight};
+            else
+                return;
+            find_lightest();
+        }
+
+        void halve() noexcept
+        {
+            for (auto& entry : entries)
+                entry.weight >>= 1;
+        }
+
+        void clear() noexcept
+        {
+            entries.clear();
+            lightest = 0;
+        }
+
+        std::vector<tracked_key> sorted() const
+        {
+            auto result = entries;
+            std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return a.weight > b.weight; });
+            return result;
+        }
+    };
+
+    class key_sampler final
+    {
+        count_min_sketch sketch;
+        top_k hot{TOP_K}, big{TOP_K};
+        std::uint64_t accesses = 0;
+        std::uint64_t samples = 0;
+
+    public:
+        std::uint64_t sample_rate = DEFAULT_SAMPLE_RATE;   //0 disables, 1 samples every access
+
+        bool should_sample() noexcept
+        {
+            return sample_rate && ++accesses % sample_rate == 0;
+        }
+
+        template<typename Database>
+        void record(int db_num, const Database& db, const std::string& key)
+        {
+            const auto hash = hash_of(db_num, key);
+            hot.offer(hash, db_num, key, sketch.add(hash));
+            if (++samples % BIG_KEY_SAMPLE_RATE == 0)
+                if (auto usage = db.usage(key))
+                    big.offer(hash, db_num, key, usage->Bytes);
+            if (samples % DECAY_SAMPLES == 0)
+            {
+                sketch.halve();
+                hot.halve();
+            }
+        }
+
+        //accesses since the counts were last halved, scaled back from the samples
+        std::uint64_t frequency(int db_num, std::string_view key) const noexcept
+        {
+            return static_cast<std::uint64_t>(sketch.estimate(hash_of(db_num, key))) * std::max<std::uint64_t>(sample_rate, 1);
+        }
+
+        void reset() noexcept
+        {
+            sketch.reset();
+            hot.clear();
+            big.clear();
+            accesses = samples = 0;
+        }
+
+        std::string hot_keys_reply(std::size_t count) const
+        {
+            auto entries = hot.sorted();
+            entries.resize(std::min(count, entries.size()));
+            std::string reply = format::resp_array_size(entries.size());
+            for (const auto& entry : entries)
+            {
+                reply += format::resp_array_size(3);
+                reply += resp::simple_string(entry.key);
+                reply += resp::integer(entry.db);
+                reply += resp::integer(entry.weight * std::max<std::uint64_t>(sample_rate, 1));
+            }
+            return reply;
+        }
+
+        //sizes are taken again, keys deleted since they were sampled are left out
+        template<typename Databases>
+        std::string big_keys_reply(const Databases& databases, std::size_t count) const
+        {
+            std::vector<std::pair<tracked_key, KeyUsage_t>> entries;
+            for (auto& entry : big.sorted())
+                if (auto usage = databases[entry.db].usage(entry.key))
+                    entries.emplace_back(std::move(entry), *usage);
+            std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.second.Bytes > b.second.Bytes; });
+            entries.resize(std::min(count, entries.size()));
+            std::string reply = format::resp_array_size(entries.size());
+            for (const auto& [entry, usage] : entries)
+            {
+                reply += format::resp_array_size(5);
+                reply += resp::simple_string(entry.key);
+                reply += resp::integer(entry.db);
+                reply += resp::simple_string(to_string(databases[entry.db].lookup_type_of(entry.key)));
+                reply += resp::integer(usage.Bytes);
+                reply += resp::integer(usage.Elements);
+            }
+            return reply;
+        }
+    };
+
+    static key_sampler g_sampler;
+}
+
+#endif /* HOTKEYS_HPP */
\ No newline at end of file
@@ -0,0 +1,106 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef LIFECYCLE_HPP
+#define LIFECYCLE_HPP
+
+#include <zmq.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+
+//Graceful shutdown on SIGINT/SIGTERM. The signal handler only stores the signal number in a
+//lock-free atomic and writes a wake descriptor (an eventfd, or a pipe outside Linux) that the event
+//loop polls, so the loop reacts at once instead of at its next poll timeout. The server then goes
+//through the phases:
+//  RUNNING     serving
+//  DRAINING    the front ends stop accepting; requests already received are executed and their
+//              replies written until every front end is drained, for SHUTDOWN_TIMEOUT_IN_MS at most
+//  PERSISTING  background save/rewrite children are waited for, then the append only file is flushed
+//              and fsynced or, without it, a final snapshot is written when there are unsaved changes
+//  STOPPED     background threads (ZeroMQ monitor, reactors) are joined and the sockets closed
+//Every write acknowledged before the signal is on disk when the process exits.
+
+namespace lifecycle
+{
+    enum class phase : std::uint8_t { RUNNING, DRAINING, PERSISTING, STOPPED };
+
+    constexpr int SHUTDOWN_TIMEOUT_IN_MS = 5 * 1000;
+    constexpr int DRAIN_POLL_IN_MS = 50;   //a drain ends once a poll this long finds nothing to read
+
+    class state final
+    {
+        static_assert(std::atomic<int>::is_always_lock_free, "the signal handler needs a lock-free atomic");
+
+        std::atomic<int> requested_by{0};   //signal number
+        std::atomic<phase> current{phase::RUNNING};
+        int wake_fds[2]{-1, -1};            //read and write ends, the same eventfd on Linux
+
+    public:
+        state() = default;
+        ~state() { close(); }
+        state(const state&) = delete;
+        state& operator=(const state&) = delete;
+
+        void open()
+        {
+#if defined(__linux__)
+            wake_fds[0] = wake_fds[1] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif !defined(_WIN32)
+            if (::pipe(wake_fds) == 0)
+                for (int fd : wake_fds)
+                    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+        }
+
+        void close()
+        {
+#if !defined(_WIN32)
+            if (wake_fds[0] != -1)
+                ::close(wake_fds[0]);
+            if (wake_fds[1] != -1 && wake_fds[1] != wake_fds[0])
+                ::close(wake_fds[1]);
+#endif
+            wake_fds[0] = wake_fds[1] = -1;
+        }
+
+        //async-signal-safe
+        void request_shutdown(int signum) noexcept
+        {
+            requested_by.store(signum, std::memory_order_relaxed);
+#if !defined(_WIN32)
+            if (wake_fds[1] != -1)
+            {
+                std::uint64_t one = 1;
+                [[maybe_unused]] auto rc = ::write(wake_fds[1], &one, sizeof(one));
+            }
+#endif
+        }
+
+        bool shutdown_requested() const noexcept { return requested_by.load(std::memory_order_relaxed) != 0; }
+
+        int signal() const noexcept { return requested_by.load(std::memory_order_relaxed); }
+
+        phase current_phase() const noexcept { return current.load(std::memory_order_relaxed); }
+
+        void enter(phase p) noexcept { current.store(p, std::memory_order_relaxed); }
+
+        int handle() const noexcept { return wake_fds[0]; }
+
+        zmq_pollitem_t pollitem() const noexcept { return { nullptr, wake_fds[0], ZMQ_POLLIN, 0 }; }
+    };
+
+    static state g_lifecycle;
+}
+
+#endif /* LIFECYCLE_HPP */
\ No newline at end of file
@@ -6,12 +6,19 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
 #include "quill/Backend.h"
 #include "quill/Frontend.h"
 #define QUILL_DISABLE_NON_PREFIXED_MACROS
 #include "quill/LogMacros.h"
 #include "quill/Logger.h"
 #include "quill/sinks/ConsoleSink.h"
+#include "quill/sinks/RotatingFileSink.h"
 #include "quill/std/Array.h"
 #include "quill/std/Chrono.h"
 #include "quill/std/Deque.h"
@@ -41,6 +48,24 @@ public:
         logger->set_log_level(quill::LogLevel::TraceL3);
     }
     ~Logger() = default;
+
+    //moves the output to a size-rotated file (logfile, logfile.1, ...) when logfile is set
+    void configure(quill::LogLevel level, const std::string& logfile, std::size_t max_file_size, std::uint32_t max_files)
+    {
+        if (!logfile.empty())
+        {
+            auto file_sink = quill::Frontend::create_or_get_sink<quill::RotatingFileSink>(logfile, [&]() {
+                quill::RotatingFileSinkConfig config;
+                config.set_open_mode('a');
+                config.set_rotation_max_file_size(max_file_size);
+                config.set_max_backup_files(max_files);
+                return config;
+            }());
+            logger = quill::Frontend::create_or_get_logger("file", std::move(file_sink));
+        }
+        logger->set_log_level(level);
+    }
+
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
     Logger(Logger&&) = delete;
@@ -51,6 +76,39 @@ public:
 
 static Logger g_logger;
 
+static inline std::optional<quill::LogLevel> to_log_level(std::string_view name)
+{
+    using enum quill::LogLevel;
+    if (name == "trace_l3") return TraceL3;
+    if (name == "trace_l2") return TraceL2;
+    if (name == "trace_l1") return TraceL1;
+    if (name == "debug") return Debug;
+    if (name == "info") return Info;
+    if (name == "notice") return Notice;
+    if (name == "warning") return Warning;
+    if (name == "error") return Error;
+    if (name == "critical") return Critical;
+    return std::nullopt;
+}
+
+//which executed commands get a log line: one in every sample_rate and every command taking at
+//least slower_than_us, both off by default so the GET/SET fast path pays one branch
+struct command_log_policy final
+{
+    std::uint64_t sample_rate = 0;  //0 disables sampling, 1 logs every command
+    double slower_than_us = -1;     //negative disables
+    std::uint64_t counter = 0;
+
+    bool should_log(double duration_us) noexcept
+    {
+        if (slower_than_us >= 0 && duration_us >= slower_than_us)
+            return true;
+        return sample_rate && ++counter % sample_rate == 0;
+    }
+};
+
+static command_log_policy g_command_log;
+
 #define LOG_TRACE_L3(fmt, ...) QUILL_LOG_TRACE_L3(g_logger.get(), fmt, ##__VA_ARGS__)
 #define LOG_TRACE_L2(fmt, ...) QUILL_LOG_TRACE_L2(g_logger.get(), fmt, ##__VA_ARGS__)
 #define LOG_TRACE_L1(fmt, ...) QUILL_LOG_TRACE_L1(g_logger.get(), fmt, ##__VA_ARGS__)
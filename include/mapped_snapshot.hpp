@@ -0,0 +1,318 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef MAPPED_SNAPSHOT_HPP
+#define MAPPED_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "crc64.hpp"
+#include "database_defs.hpp"
+#include "mapped_value.hpp"
+
+//KV Store mappable snapshot, laid out so a warm restart only reads the key index
+/*
+
+file      = header values index ;
+header    = magic(8) u32(version) u32(db count) u64(index offset) u64(index size)
+            u64(index crc64) u64(file size) pad to 64 bytes ;
+values    = (value pad to 8)* ;                    //string bytes or container payload
+index     = (u64(key count) entry*)* ;             //one block per database, in order
+entry     = u64(value offset) u64(value size) u8(type) pad(3) u32(key length) key pad to 8 ;
+
+string payload     = bytes ;
+set payload        = u64(count) (u32(length) bytes)* ;
+sorted set payload = u64(count) (f64(score) u32(length) bytes)* ;
+
+All integers are little endian. Only the index is read at startup; values are left in the
+mapping, served from it while read-only and decoded into containers on first access.
+
+*/
+
+namespace mapped_snapshot
+{
+    constexpr char MAGIC[] = { 'K', 'V', 'M', 'M', 'A', 'P', '\0', '\0' };
+    constexpr std::uint32_t VERSION = 1;
+    constexpr std::size_t HEADER_SIZE = 64;
+    constexpr std::size_t ALIGNMENT = 8;
+
+    constexpr std::uint8_t TYPE_STRING = 0x00;
+    constexpr std::uint8_t TYPE_SET = 0x01;
+    constexpr std::uint8_t TYPE_ZSET = 0x02;
+
+    static inline std::size_t padding(std::size_t offset) noexcept
+    {
+        return (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT;
+    }
+
+    static inline void put_u32(std::string& out, std::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+
+    static inline void put_u64(std::string& out, std::uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+
+    static inline void put_f64(std::string& out, double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put_u64(out, bits);
+    }
+
+    static inline bool is_mapped_snapshot(const std::string& filename)
+    {
+        char magic[sizeof(MAGIC)]{};
+        std::FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file)
+            return false;
+        std::size_t n = std::fread(magic, 1, sizeof(magic), file);
+        std::fclose(file);
+        return n == sizeof(MAGIC) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    }
+
+    template<typename Databases>
+    static void save(const std::string& filename, const Databases& databases)
+    {
+        std::string temp_filename = filename + ".tmp";
+        std::FILE* file = std::fopen(temp_filename.c_str(), "wb");
+        if (!file)
+            throw std::runtime_error("cannot open " + temp_filename);
+        try
+        {
+            auto write = [file](const void* data, std::size_t size) {
+                if (size && std::fwrite(data, 1, size, file) != size)
+                    throw std::runtime_error("snapshot write failed");
+            };
+            const char zeros[HEADER_SIZE]{};
+            write(zeros, HEADER_SIZE);
+
+            std::uint64_t offset = HEADER_SIZE;
+            std::string index, payload;
+            for (std::size_t db_num = 0; db_num < databases.size(); ++db_num)
+            {
+                const auto& db = databases[db_num];
+                using db_type = std::decay_t<decltype(db)>;
+                put_u64(index, db.size());
+                db.for_each([&](std::string_view key, const auto& value) {
+                    using value_type = std::decay_t<decltype(value)>;
+                    std::uint8_t type;
+                    payload.clear();
+                    if constexpr (std::is_same_v<value_type, typename db_type::string_type>)
+                    {
+                        type = TYPE_STRING;
+                        payload.append(value.data(), value.size());
+                    }
+                    else if constexpr (std::is_same_v<value_type, typename db_type::set_type>)
+                    {
+                        type = TYPE_SET;
+                        put_u64(payload, value.size());
+                        for (const auto& member : value)
+                        {
+                            put_u32(payload, static_cast<std::uint32_t>(member.size()));
+                            payload.append(member.data(), member.size());
+                        }
+                    }
+                    else
+                    {
+                        type = TYPE_ZSET;
+                        put_u64(payload, value.Members.size());
+                        for (const auto& [member, score] : value.Members)
+                        {
+                            put_f64(payload, score);
+                            put_u32(payload, static_cast<std::uint32_t>(member.size()));
+                            payload.append(member.data(), member.size());
+                        }
+                    }
+                    write(payload.data(), payload.size());
+                    put_u64(index, offset);
+                    put_u64(index, payload.size());
+                    index.push_back(static_cast<char>(type));
+                    index.append(3, '\0');
+                    put_u32(index, static_cast<std::uint32_t>(key.size()));
+                    index.append(key);
+                    index.append(padding(index.size()), '\0');
+                    offset += payload.size();
+                    write(zeros, padding(offset));
+                    offset += padding(offset);
+                });
+            }
+            write(index.data(), index.size());
+
+            std::string header(MAGIC, sizeof(MAGIC));
+            put_u32(header, VERSION);
+            put_u32(header, static_cast<std::uint32_t>(databases.size()));
+            put_u64(header, offset);
+            put_u64(header, index.size());
+            put_u64(header, crc64::update(0, index.data(), index.size()));
+            put_u64(header, offset + index.size());
+            header.resize(HEADER_SIZE, '\0');
+            if (std::fseek(file, 0, SEEK_SET) != 0)
+                throw std::runtime_error("snapshot seek failed");
+            write(header.data(), header.size());
+            if (std::fflush(file) != 0)
+                throw std::runtime_error("snapshot flush failed");
+#ifndef _WIN32
+            if (::fsync(::fileno(file)) != 0)
+                throw std::runtime_error("snapshot sync failed");
+#endif
+        }
+        catch (...)
+        {
+            std::fclose(file);
+            std::remove(temp_filename.c_str());
+            throw;
+        }
+        std::fclose(file);
+        std::filesystem::rename(temp_filename, filename);
+    }
+
+    //read-only view of a whole file, pages are faulted in on demand
+    class file_mapping final
+    {
+        const char* data_ = nullptr;
+        std::size_t size_ = 0;
+#ifdef _WIN32
+        std::vector<char> buffer;
+#endif
+    public:
+        explicit file_mapping(const std::string& filename)
+        {
+#ifndef _WIN32
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd == -1)
+                throw std::runtime_error("cannot open " + filename);
+            struct stat st{};
+            if (::fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("cannot stat " + filename);
+            }
+            void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (addr == MAP_FAILED)
+                throw std::runtime_error("cannot map " + filename);
+            data_ = static_cast<const char*>(addr);
+            size_ = static_cast<std::size_t>(st.st_size);
+#else
+            std::FILE* file = std::fopen(filename.c_str(), "rb");
+            if (!file)
+                throw std::runtime_error("cannot open " + filename);
+            buffer.resize(std::filesystem::file_size(filename));
+            std::size_t n = std::fread(buffer.data(), 1, buffer.size(), file);
+            std::fclose(file);
+            if (n != buffer.size())
+                throw std::runtime_error("cannot read " + filename);
+            data_ = buffer.data();
+            size_ = buffer.size();
+#endif
+        }
+
+        ~file_mapping()
+        {
+#ifndef _WIN32
+            if (data_)
+                ::munmap(const_cast<char*>(data_), size_);
+#endif
+        }
+
+        file_mapping(const file_mapping&) = delete;
+        file_mapping& operator=(const file_mapping&) = delete;
+
+        const char* data() const noexcept { return data_; }
+        std::size_t size() const noexcept { return size_; }
+    };
+
+    //mappings stay alive for the whole process, values may point into any of them
+    static std::vector<std::unique_ptr<file_mapping>> g_mappings;
+
+    //returns the number of keys indexed, values are not touched
+    template<typename Databases>
+    static std::size_t load(const std::string& filename, Databases& databases)
+    {
+        using mapped_layout::read_u32;
+        using mapped_layout::read_u64;
+        auto mapping = std::make_unique<file_mapping>(filename);
+        const char* base = mapping->data();
+        const std::size_t size = mapping->size();
+        if (size < HEADER_SIZE || std::memcmp(base, MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error("not a mappable snapshot file");
+        if (read_u32(base + 8) != VERSION)
+            throw std::runtime_error("unsupported snapshot version");
+        const std::uint32_t db_count = read_u32(base + 12);
+        const std::uint64_t index_offset = read_u64(base + 16);
+        const std::uint64_t index_size = read_u64(base + 24);
+        if (read_u64(base + 40) != size || index_offset < HEADER_SIZE || index_offset > size || index_size != size - index_offset)
+            throw std::runtime_error("truncated snapshot");
+        if (db_count > databases.size())
+            throw std::runtime_error("snapshot database index out of range");
+        const char* p = base + index_offset;
+        const char* end = p + index_size;
+        if (crc64::update(0, p, index_size) != read_u64(base + 32))
+            throw std::runtime_error("snapshot checksum mismatch");
+
+        std::size_t loaded{};
+        for (std::uint32_t db_num = 0; db_num < db_count; ++db_num)
+        {
+            auto& db = databases[db_num];
+            if (end - p < 8)
+                throw std::runtime_error("truncated snapshot index");
+            std::uint64_t count = read_u64(p);
+            p += 8;
+            db.reserve(db.size() + count);
+            for (; count; --count, ++loaded)
+            {
+                if (end - p < 24)
+                    throw std::runtime_error("truncated snapshot index");
+                std::uint64_t value_offset = read_u64(p);
+                std::uint64_t value_size = read_u64(p + 8);
+                std::uint8_t type = static_cast<std::uint8_t>(p[16]);
+                std::uint32_t key_length = read_u32(p + 20);
+                p += 24;
+                if (static_cast<std::uint64_t>(end - p) < key_length || value_offset > index_offset || value_size > index_offset - value_offset)
+                    throw std::runtime_error("corrupt snapshot index");
+                std::string key(p, key_length);
+                p += key_length;
+                p += padding(p - base);
+                MappedValue_t mapped;
+                switch (type)
+                {
+                    case TYPE_STRING: mapped.Type = DbValueTypeEnum::STRING; break;
+                    case TYPE_SET: mapped.Type = DbValueTypeEnum::SET; break;
+                    case TYPE_ZSET: mapped.Type = DbValueTypeEnum::SORTEDSET; break;
+                    default: throw std::runtime_error("unknown snapshot entry type");
+                }
+                mapped.Data = base + value_offset;
+                mapped.Size = value_size;
+                db.template Emplace<MappedValue_t>(std::move(key)) = mapped;
+            }
+        }
+        g_mappings.push_back(std::move(mapping));
+        return loaded;
+    }
+}
+
+#endif /* MAPPED_SNAPSHOT_HPP */
\ No newline at end of file
@@ -0,0 +1,112 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef MAPPED_VALUE_HPP
+#define MAPPED_VALUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "database_defs.hpp"
+
+//value still living inside a memory mapped snapshot (see mapped_snapshot.hpp);
+//strings are served straight from the mapping, containers are decoded on first access
+struct MappedValue_t final
+{
+    DbValueTypeEnum Type = DbValueTypeEnum::NONE;
+    const char* Data = nullptr;
+    std::size_t Size = 0;
+
+    std::string_view view() const noexcept { return { Data, Size }; }
+};
+
+namespace mapped_layout
+{
+    //the layout is little endian regardless of the host
+    static inline std::uint32_t read_u32(const char* p) noexcept
+    {
+        const auto* b = reinterpret_cast<const unsigned char*>(p);
+        return static_cast<std::uint32_t>(b[0]) | static_cast<std::uint32_t>(b[1]) << 8 |
+               static_cast<std::uint32_t>(b[2]) << 16 | static_cast<std::uint32_t>(b[3]) << 24;
+    }
+
+    static inline std::uint64_t read_u64(const char* p) noexcept
+    {
+        return static_cast<std::uint64_t>(read_u32(p)) | static_cast<std::uint64_t>(read_u32(p + 4)) << 32;
+    }
+
+    static inline double read_f64(const char* p) noexcept
+    {
+        std::uint64_t bits = read_u64(p);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    //the checksum covers the index only, so every read of a payload stays within its Size
+    struct value_reader final
+    {
+        const char* position;
+        const char* end;
+
+        explicit value_reader(const MappedValue_t& mapped) noexcept
+            : position{mapped.Data}, end{mapped.Data + mapped.Size}
+        {
+        }
+
+        //the next size bytes
+        const char* take(std::size_t size)
+        {
+            if (static_cast<std::size_t>(end - position) < size)
+                throw std::runtime_error("corrupt mapped value");
+            const char* p = position;
+            position += size;
+            return p;
+        }
+
+        void expect_end() const
+        {
+            if (position != end)
+                throw std::runtime_error("corrupt mapped value");
+        }
+    };
+
+    //set payload: u64 count, (u32 length, bytes)*
+    template<typename Set>
+    static void decode_set(const MappedValue_t& mapped, Set& set)
+    {
+        value_reader reader{mapped};
+        std::uint64_t count = read_u64(reader.take(8));
+        for (; count; --count)
+        {
+            std::uint32_t length = read_u32(reader.take(4));
+            set.emplace(std::string(reader.take(length), length));
+        }
+        reader.expect_end();
+    }
+
+    //sorted set payload: u64 count, (f64 score, u32 length, bytes)*
+    template<typename SortedSet>
+    static void decode_sortedset(const MappedValue_t& mapped, SortedSet& sorted_set)
+    {
+        value_reader reader{mapped};
+        std::uint64_t count = read_u64(reader.take(8));
+        for (; count; --count)
+        {
+            double score = read_f64(reader.take(8));
+            std::uint32_t length = read_u32(reader.take(4));
+            auto [iter, emplaced] = sorted_set.Members.emplace(std::string(reader.take(length), length), score);
+            if (emplaced)
+                sorted_set.Scores.emplace(score, iter);
+        }
+        reader.expect_end();
+    }
+}
+
+#endif /* MAPPED_VALUE_HPP */
\ No newline at end of file
@@ -0,0 +1,182 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "command_stats.hpp"
+#include "server_stats.hpp"
+#include "used_memory.hpp"
+
+//OpenMetrics text exposition of the server counters, answered to GET /metrics by the endpoint in
+//zmq_metrics.hpp (--metrics-port). The per command latency histograms are folded into a fixed set
+//of buckets; a slot of command_stats::latency_histogram that straddles a bound is counted in the
+//next bucket, so a bucket may leave out values up to 6.25% below its bound.
+/*
+    kv_store_commands_total{cmd="get"} 10
+    kv_store_command_duration_seconds_bucket{cmd="get",le="1e-05"} 9
+    kv_store_keys{db="0"} 3
+    kv_store_zmq_events_total{event="accepted"} 4
+    # EOF
+*/
+
+namespace metrics
+{
+    constexpr std::size_t MAX_REQUEST_SIZE = 8 * 1024;
+    constexpr const char* CONTENT_TYPE = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+    //ZeroMQ monitor events of the RESP socket, counted by the monitor thread
+    struct zmq_events final
+    {
+        std::atomic<std::uint64_t> accepted{0};
+        std::atomic<std::uint64_t> accept_failed{0};
+        std::atomic<std::uint64_t> disconnected{0};
+        std::atomic<std::uint64_t> closed{0};
+    };
+
+    static zmq_events g_zmq_events;
+
+    //upper bounds in nanoseconds and their le label in seconds
+    constexpr std::array<std::pair<std::uint64_t, const char*>, 21> DURATION_BUCKETS{{
+        {1000, "1e-06"}, {2500, "2.5e-06"}, {5000, "5e-06"},
+        {10000, "1e-05"}, {25000, "2.5e-05"}, {50000, "5e-05"},
+        {100000, "0.0001"}, {250000, "0.00025"}, {500000, "0.0005"},
+        {1000000, "0.001"}, {2500000, "0.0025"}, {5000000, "0.005"},
+        {10000000, "0.01"}, {25000000, "0.025"}, {50000000, "0.05"},
+        {100000000, "0.1"}, {250000000, "0.25"}, {500000000, "0.5"},
+        {1000000000, "1.0"}, {2500000000, "2.5"}, {10000000000, "10.0"}
+    }};
+
+    static inline void family(std::ostringstream& oss, std::string_view name, std::string_view type, std::string_view help)
+    {
+        oss << "# TYPE " << name << ' ' << type << "\n# HELP " << name << ' ' << help << '\n';
+    }
+
+    static inline void command_families(std::ostringstream& oss)
+    {
+        using command_stats::g_command_stats;
+        const auto names = g_command_stats.names();
+        const auto counter = [&](std::string_view name, std::string_view help, auto field) {
+            family(oss, name, "counter", help);
+            for (const auto& cmd_name : names)
+                oss << name << "_total{cmd=\"" << command_stats::to_lower(cmd_name) << "\"} "
+                    << (g_command_stats.find(cmd_name)->*field).load(std::memory_order_relaxed) << '\n';
+        };
+        counter("kv_store_commands", "Commands executed.", &command_stats::command_stat::calls);
+        counter("kv_store_commands_failed", "Commands that replied with an error.", &command_stats::command_stat::failed_calls);
+        counter("kv_store_commands_rejected", "Commands refused before running.", &command_stats::command_stat::rejected_calls);
+
+        family(oss, "kv_store_command_duration_seconds", "histogram", "Command execution time.");
+        for (const auto& cmd_name : names)
+        {
+            const auto& stat = *g_command_stats.find(cmd_name);
+            const auto label = command_stats::to_lower(cmd_name);
+            std::array<std::uint64_t, DURATION_BUCKETS.size()> buckets{};
+            std::uint64_t count = 0;
+            stat.histogram.for_each_bucket([&](std::uint64_t upper_ns, std::uint64_t slot_count) {
+                count += slot_count;
+                for (std::size_t i = 0; i < buckets.size(); ++i)
+                    if (upper_ns <= DURATION_BUCKETS[i].first)
+                        buckets[i] += slot_count;
+            });
+            for (std::size_t i = 0; i < buckets.size(); ++i)
+                oss << "kv_store_command_duration_seconds_bucket{cmd=\"" << label << "\",le=\"" << DURATION_BUCKETS[i].second << "\"} " << buckets[i] << '\n';
+            oss << "kv_store_command_duration_seconds_bucket{cmd=\"" << label << "\",le=\"+Inf\"} " << count << '\n'
+                << "kv_store_command_duration_seconds_count{cmd=\"" << label << "\"} " << count << '\n'
+                << "kv_store_command_duration_seconds_sum{cmd=\"" << label << "\"} "
+                << std::to_string(static_cast<double>(stat.nanoseconds.load(std::memory_order_relaxed)) / 1e9) << '\n';
+        }
+    }
+
+    //whole exposition, # EOF terminated
+    template<typename Databases, typename Clients>
+    static std::string render(const Databases& databases, const Clients& clients)
+    {
+        using server_stats::g_stats;
+        const auto now = server_stats::clock_type::now();
+        g_stats.track(now);
+        std::ostringstream oss;
+        command_families(oss);
+
+        family(oss, "kv_store_keys", "gauge", "Keys per database.");
+        for (std::size_t i = 0; i < databases.size(); ++i)
+            oss << "kv_store_keys{db=\"" << i << "\"} " << databases[i].size() << '\n';
+        family(oss, "kv_store_memory_used_bytes", "gauge", "Heap bytes in use.");
+        oss << "kv_store_memory_used_bytes " << used_memory::bytes() << '\n';
+        family(oss, "kv_store_memory_peak_bytes", "gauge", "Highest heap bytes in use seen.");
+        oss << "kv_store_memory_peak_bytes " << g_stats.used_memory_peak << '\n';
+        family(oss, "kv_store_connected_clients", "gauge", "Connected RESP clients.");
+        oss << "kv_store_connected_clients " << clients.size() << '\n';
+        family(oss, "kv_store_uptime_seconds", "gauge", "Seconds since the server started.");
+        oss << "kv_store_uptime_seconds " << std::chrono::duration_cast<std::chrono::seconds>(now - g_stats.start_time).count() << '\n';
+
+        const auto counter = [&](std::string_view name, std::string_view help, std::uint64_t value) {
+            family(oss, name, "counter", help);
+            oss << name << "_total " << value << '\n';
+        };
+        counter("kv_store_connections_received", "Client connections accepted.", g_stats.total_connections_received);
+        counter("kv_store_net_input_bytes", "Bytes received from clients.", g_stats.total_net_input_bytes);
+        counter("kv_store_net_output_bytes", "Bytes sent to clients.", g_stats.total_net_output_bytes);
+        counter("kv_store_keyspace_hits", "Key lookups of read commands that found the key.", g_stats.keyspace_hits);
+        counter("kv_store_keyspace_misses", "Key lookups of read commands that missed the key.", g_stats.keyspace_misses);
+        counter("kv_store_io_syscalls", "Socket system calls of the native front ends.", g_stats.total_io_syscalls);
+        counter("kv_store_client_output_buffer_limit_disconnections", "Clients disconnected for reaching their output buffer limit.", g_stats.client_output_buffer_limit_disconnections);
+
+        family(oss, "kv_store_zmq_events", "counter", "ZeroMQ monitor events of the RESP socket.");
+        for (const auto& [event, value] : { std::pair{"accepted", &g_zmq_events.accepted}, std::pair{"accept_failed", &g_zmq_events.accept_failed},
+                                            std::pair{"disconnected", &g_zmq_events.disconnected}, std::pair{"closed", &g_zmq_events.closed} })
+            oss << "kv_store_zmq_events_total{event=\"" << event << "\"} " << value->load(std::memory_order_relaxed) << '\n';
+        oss << "# EOF\n";
+        return oss.str();
+    }
+
+    static inline std::string http_reply(std::string_view status, std::string_view content_type, std::string_view body)
+    {
+        std::ostringstream oss;
+        oss << "HTTP/1.1 " << status << "\r\n"
+            << "Content-Type: " << content_type << "\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "Connection: close\r\n\r\n" << body;
+        return oss.str();
+    }
+
+    //full HTTP reply for a request whose headers are complete, empty while they're still arriving;
+    //render() is only called for GET /metrics
+    template<typename Render>
+    static std::string http_response(std::string_view request, Render render)
+    {
+        if (request.find("\r\n\r\n") == std::string_view::npos)
+        {
+            if (request.size() < MAX_REQUEST_SIZE)
+                return {};
+            return http_reply("431 Request Header Fields Too Large", "text/plain", "request too large\n");
+        }
+        const auto line = request.substr(0, request.find("\r\n"));
+        const auto method_end = line.find(' ');
+        const auto path_end = line.find(' ', method_end + 1);
+        if (method_end == std::string_view::npos || path_end == std::string_view::npos)
+            return http_reply("400 Bad Request", "text/plain", "bad request\n");
+        const auto method = line.substr(0, method_end);
+        auto path = line.substr(method_end + 1, path_end - method_end - 1);
+        path = path.substr(0, path.find('?'));
+        if (method != "GET")
+            return http_reply("405 Method Not Allowed", "text/plain", "method not allowed\n");
+        if (path != "/metrics")
+            return http_reply("404 Not Found", "text/plain", "not found\n");
+        return http_reply("200 OK", CONTENT_TYPE, render());
+    }
+}
+
+#endif /* METRICS_HPP */
\ No newline at end of file
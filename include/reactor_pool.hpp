@@ -0,0 +1,538 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef REACTOR_POOL_HPP
+#define REACTOR_POOL_HPP
+
+//RESP front end of N reactor threads (--transport epoll --reactors N, Linux only). Every reactor
+//owns a SO_REUSEPORT listening socket, so the kernel spreads the connections, and an epoll loop
+//that accepts, receives, frames complete RESP commands and sends replies. The databases stay owned
+//by the event loop thread: complete requests and connection events go to it over a lock-free SPSC
+//queue per reactor and the replies come back over another one, an eventfd wakes up each side.
+//Accepting, socket I/O and framing scale with the reactors, commands still run one at a time.
+//Same Handler as zmq_stream.hpp, always called from the event loop thread. On shutdown
+//stop_accepting makes every reactor close its listening socket; the pool is drained once each
+//reactor has taken every reply queued for it and has nothing left to write or to hand over.
+//Reactors stop reading from a connection with more than pause_reading_above bytes unsent and
+//report backlogs from REACTOR_UNSENT_REPORT_MIN bytes to the event loop (UNSENT); kill asks the
+//owning reactor to close a connection.
+
+#if defined(__linux__)
+
+#include <zmq.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "native_socket.hpp"
+#include "resp_command_parser.hpp"
+#include "server_stats.hpp"
+#include "spsc_queue.hpp"
+#include "tracing.hpp"
+
+namespace transport
+{
+    constexpr std::size_t REACTOR_QUEUE_CAPACITY = 16 * 1024;
+    constexpr int REACTOR_MAX_EVENTS = 256;
+    constexpr int REACTOR_IDLE_TIMEOUT_IN_MS = 100;        //how soon a reactor sees the pool stopping
+    constexpr std::size_t REACTOR_READ_BUFFER_SIZE = 64 * 1024;
+    constexpr std::size_t REACTOR_UNSENT_REPORT_MIN = REACTOR_READ_BUFFER_SIZE;
+
+    struct reactor_message final
+    {
+        enum kind_type : std::uint8_t { CONNECTED, DISCONNECTED, REQUEST, REPLY, CLOSE, UNSENT };
+        kind_type kind = REQUEST;
+        std::uint64_t serial = 0;   //connection, unique across the reactors
+        std::string data;
+        std::size_t unsent = 0;     //UNSENT: reply bytes the connection still has to write
+    };
+
+    class reactor final
+    {
+        static constexpr std::uint64_t LISTEN_TAG = ~0ull, WAKE_TAG = ~0ull - 1;
+
+        struct connection final
+        {
+            int fd;
+            std::string input;      //bytes not yet forming a complete command
+            std::string output;
+            std::size_t sent = 0;
+            std::size_t reported = 0;   //unsent bytes the executor knows of
+            bool unread = false;        //input left in the socket while reading was paused
+        };
+
+        const std::size_t index, count, pause_above;
+        const std::atomic<bool>& running;
+        const std::atomic<bool>& accepting;
+        const int executor_wake_fd;
+        int listen_fd = -1, epoll_fd = -1;
+        std::unordered_map<std::uint64_t, connection> connections;
+        std::uint64_t connection_counter = 0;
+        std::deque<reactor_message> backlog;    //requests waiting for room in inbound
+        bool notify = false;                    //the executor has messages to pick up
+        std::vector<char> buffer = std::vector<char>(REACTOR_READ_BUFFER_SIZE);
+        std::uint64_t replies_taken = 0;
+        std::thread thread;
+
+        void count_syscall() noexcept { syscalls.fetch_add(1, std::memory_order_relaxed); }
+
+        void to_executor(reactor_message::kind_type kind, std::uint64_t serial, std::string data = {}, std::size_t unsent = 0)
+        {
+            reactor_message msg{kind, serial, std::move(data), unsent};
+            if (!backlog.empty() || !inbound.try_push(std::move(msg)))
+                backlog.push_back(std::move(msg));
+            else
+                notify = true;
+        }
+
+        static std::size_t unsent(const connection& conn) noexcept { return conn.output.size() - conn.sent; }
+
+        bool over_limit(const connection& conn) const noexcept { return pause_above && unsent(conn) > pause_above; }
+
+        bool flush(std::uint64_t serial, connection& conn)
+        {
+            bool alive = true;
+            {
+                KV_TRACE_SCOPE("send");
+                while (conn.sent < conn.output.size())
+                {
+                    count_syscall();
+                    const auto n = ::send(conn.fd, conn.output.data() + conn.sent, conn.output.size() - conn.sent, MSG_NOSIGNAL);
+                    if (n > 0)
+                        conn.sent += static_cast<std::size_t>(n);
+                    else if (n == -1 && errno == EINTR)
+                        continue;
+                    else
+                    {
+                        alive = n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+                        break;
+                    }
+                }
+            }
+            if (conn.sent == conn.output.size())
+            {
+                conn.output.clear();
+                conn.sent = 0;
+            }
+            const auto bytes = unsent(conn);
+            if (alive && bytes != conn.reported && (conn.reported || bytes >= REACTOR_UNSENT_REPORT_MIN))
+            {
+                conn.reported = bytes < REACTOR_UNSENT_REPORT_MIN ? 0 : bytes;
+                to_executor(reactor_message::UNSENT, serial, {}, conn.reported);
+            }
+            return alive;
+        }
+
+        //complete commands go to the executor, input that isn't RESP as well so it replies the error
+        void frame(std::uint64_t serial, connection& conn)
+        {
+            KV_TRACE_SCOPE("frame");
+            std::size_t complete = 0;
+            try
+            {
+                resp::command_parser parser{ conn.input.data(), conn.input.data() + conn.input.size() };
+                while (parser.parse_next())
+                    ;
+                complete = static_cast<std::size_t>(parser.position - conn.input.data());
+                if (complete < conn.input.size() && conn.input[complete] != '*')
+                    complete = conn.input.size();
+            }
+            catch (...)
+            {
+                complete = conn.input.size();
+            }
+            if (!complete)
+                return;
+            if (complete == conn.input.size())
+                to_executor(reactor_message::REQUEST, serial, std::move(conn.input));
+            else
+                to_executor(reactor_message::REQUEST, serial, conn.input.substr(0, complete));
+            conn.input.erase(0, complete);
+        }
+
+        bool receive(std::uint64_t serial, connection& conn)
+        {
+            for (;;)
+            {
+                if (over_limit(conn))
+                    break;          //unread stays set, reading resumes once the replies are written
+                count_syscall();
+                ssize_t n;
+                {
+                    KV_TRACE_SCOPE("recv");
+                    n = ::recv(conn.fd, buffer.data(), buffer.size(), 0);
+                }
+                if (n > 0)
+                {
+                    conn.input.append(buffer.data(), static_cast<std::size_t>(n));
+                    if (static_cast<std::size_t>(n) < buffer.size())
+                    {
+                        conn.unread = false;
+                        break;
+                    }
+                }
+                else if (n == -1 && errno == EINTR)
+                    continue;
+                else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    conn.unread = false;
+                    break;
+                }
+                else
+                {
+                    frame(serial, conn);
+                    return false;
+                }
+            }
+            frame(serial, conn);
+            return true;
+        }
+
+        //writes, then reads until the socket is drained unless the connection is still over its output
+        //limit (replies only arrive from the executor, so reading can't change it); false when the peer
+        //closed or the connection is broken
+        bool serve(std::uint64_t serial, connection& conn)
+        {
+            bool alive = true;
+            if (!conn.output.empty())
+                alive = flush(serial, conn);
+            if (alive && conn.unread && !over_limit(conn))
+                alive = receive(serial, conn);
+            return alive;
+        }
+
+        void accept_all()
+        {
+            for (;;)
+            {
+                count_syscall();
+                const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd == -1)
+                {
+                    if (errno == EINTR || errno == ECONNABORTED)
+                        continue;
+                    return;
+                }
+                tune_accepted_socket(fd);
+                const auto serial = ++connection_counter * count + index;
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.u64 = serial;
+                if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+                {
+                    ::close(fd);
+                    continue;
+                }
+                connections[serial].fd = fd;
+                to_executor(reactor_message::CONNECTED, serial);
+            }
+        }
+
+        void drop(std::uint64_t serial)
+        {
+            auto it = connections.find(serial);
+            if (it == connections.end())
+                return;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+            ::close(it->second.fd);
+            connections.erase(it);
+            to_executor(reactor_message::DISCONNECTED, serial);
+        }
+
+        void drain_outbound()
+        {
+            std::uint64_t value;
+            count_syscall();
+            while (::read(wake_fd, &value, sizeof(value)) == -1 && errno == EINTR)
+                ;
+            reactor_message msg;
+            while (outbound.try_pop(msg))
+            {
+                ++replies_taken;
+                auto it = connections.find(msg.serial);
+                if (it == connections.end())
+                    continue;
+                if (msg.kind == reactor_message::CLOSE)
+                {
+                    drop(msg.serial);
+                    continue;
+                }
+                auto& conn = it->second;
+                if (conn.output.empty())
+                    conn.output = std::move(msg.data);
+                else
+                    conn.output += msg.data;
+                if (!serve(msg.serial, conn))
+                    drop(msg.serial);
+            }
+        }
+
+        void close_listener()
+        {
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_fd, nullptr);
+            ::close(listen_fd);
+            listen_fd = -1;
+        }
+
+        //published while stopping only, replies_taken last so the executor reads a matching flushed
+        void publish_drain_state()
+        {
+            bool idle = backlog.empty();
+            for (auto it = connections.begin(); idle && it != connections.end(); ++it)
+                idle = it->second.output.empty();
+            flushed.store(idle, std::memory_order_relaxed);
+            taken.store(replies_taken, std::memory_order_release);
+        }
+
+        void run()
+        {
+            std::array<epoll_event, REACTOR_MAX_EVENTS> events;
+            while (running.load(std::memory_order_relaxed))
+            {
+                const bool stopping = !accepting.load(std::memory_order_relaxed);
+                if (stopping && listen_fd != -1)
+                    close_listener();
+                count_syscall();
+                const int n = ::epoll_wait(epoll_fd, events.data(), REACTOR_MAX_EVENTS, backlog.empty() ? REACTOR_IDLE_TIMEOUT_IN_MS : 1);
+                for (int i = 0; i < n; ++i)
+                {
+                    const auto tag = events[i].data.u64;
+                    const auto flags = events[i].events;
+                    if (tag == LISTEN_TAG)
+                        accept_all();
+                    else if (tag == WAKE_TAG)
+                        drain_outbound();
+                    else if (auto it = connections.find(tag); it != connections.end())
+                    {
+                        auto& conn = it->second;
+                        if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+                            conn.unread = true;
+                        const bool alive = !(flags & EPOLLERR) && serve(tag, conn);
+                        if (!alive || (flags & EPOLLHUP))
+                            drop(tag);
+                    }
+                }
+                while (!backlog.empty() && inbound.try_push(std::move(backlog.front())))
+                {
+                    backlog.pop_front();
+                    notify = true;
+                }
+                if (notify)
+                {
+                    notify = false;
+                    std::uint64_t one = 1;
+                    count_syscall();
+                    [[maybe_unused]] auto rc = ::write(executor_wake_fd, &one, sizeof(one));
+                }
+                if (stopping)
+                    publish_drain_state();
+            }
+        }
+
+    public:
+        spsc_queue<reactor_message, REACTOR_QUEUE_CAPACITY> inbound;     //reactor -> executor
+        spsc_queue<reactor_message, REACTOR_QUEUE_CAPACITY> outbound;    //executor -> reactor
+        std::atomic<std::uint64_t> syscalls{0};
+        std::atomic<std::uint64_t> taken{0};    //outbound messages taken, see publish_drain_state
+        std::atomic<bool> flushed{false};
+        std::uint64_t queued = 0;               //outbound messages pushed, executor side
+        int wake_fd = -1;
+
+        reactor(std::size_t index, std::size_t count, std::size_t pause_above, const std::atomic<bool>& running, const std::atomic<bool>& accepting, int executor_wake_fd)
+            : index{index}, count{count}, pause_above{pause_above}, running{running}, accepting{accepting}, executor_wake_fd{executor_wake_fd} {}
+        ~reactor() { stop(); }
+        reactor(const reactor&) = delete;
+        reactor& operator=(const reactor&) = delete;
+
+        bool start(int port)
+        {
+            listen_fd = listen_tcp(port, true);
+            epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+            wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (listen_fd == -1 || epoll_fd == -1 || wake_fd == -1)
+                return false;
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = LISTEN_TAG;
+            if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == -1)
+                return false;
+            ev.data.u64 = WAKE_TAG;
+            if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) == -1)
+                return false;
+            thread = std::thread([this]() { run(); });
+            return true;
+        }
+
+        //the pool clears running first
+        void stop()
+        {
+            if (thread.joinable())
+                thread.join();
+            for (auto& [serial, conn] : connections)
+                ::close(conn.fd);
+            connections.clear();
+            for (int* fd : { &listen_fd, &epoll_fd, &wake_fd })
+            {
+                if (*fd != -1)
+                    ::close(*fd);
+                *fd = -1;
+            }
+        }
+
+        void wake() noexcept
+        {
+            std::uint64_t one = 1;
+            [[maybe_unused]] auto rc = ::write(wake_fd, &one, sizeof(one));
+        }
+    };
+
+    class reactor_pool final
+    {
+        std::atomic<bool> running{false}, accepting{false};
+        std::size_t pause_above = 0;
+        int wake_fd = -1;       //written by the reactors, polled by the event loop
+        std::vector<std::unique_ptr<reactor>> reactors;
+
+        reactor& owner(std::uint64_t serial) noexcept { return *reactors[serial % reactors.size()]; }
+
+        //blocks only while the reactor's queue is full, it is draining it meanwhile
+        void to_reactor(reactor_message&& msg)
+        {
+            auto& r = owner(msg.serial);
+            while (!r.outbound.try_push(std::move(msg)))
+            {
+                r.wake();
+                std::this_thread::yield();
+            }
+            ++r.queued;
+        }
+
+    public:
+        reactor_pool() = default;
+        ~reactor_pool() { close(); }
+        reactor_pool(const reactor_pool&) = delete;
+        reactor_pool& operator=(const reactor_pool&) = delete;
+
+        bool bind(int port, std::size_t count)
+        {
+            wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd == -1)
+                return false;
+            running = accepting = true;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                reactors.push_back(std::make_unique<reactor>(i, count, pause_above, running, accepting, wake_fd));
+                if (!reactors.back()->start(port))
+                {
+                    const int error = errno;
+                    close();
+                    errno = error;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        //connections are closed without notifying the handler
+        void close()
+        {
+            running = false;
+            reactors.clear();
+            if (wake_fd != -1)
+                ::close(wake_fd);
+            wake_fd = -1;
+        }
+
+        //before bind
+        void pause_reading_above(std::size_t bytes) noexcept { pause_above = bytes; }
+
+        //the reactor closes the connection, its DISCONNECTED follows
+        template<typename Handler>
+        bool kill(const std::string& id, Handler&)
+        {
+            std::uint64_t serial = 0;
+            auto [ptr, ec] = std::from_chars(id.data(), id.data() + id.size(), serial);
+            if (ec != std::errc{} || ptr != id.data() + id.size() || reactors.empty())
+                return false;
+            to_reactor({reactor_message::CLOSE, serial});
+            owner(serial).wake();
+            return true;
+        }
+
+        void stop_accepting()
+        {
+            accepting = false;
+            for (auto& r : reactors)
+                r->wake();
+        }
+
+        bool drained() const noexcept
+        {
+            for (const auto& r : reactors)
+                if (r->taken.load(std::memory_order_acquire) != r->queued || !r->flushed.load(std::memory_order_relaxed))
+                    return false;
+            return true;
+        }
+
+        int handle() const noexcept { return wake_fd; }
+
+        zmq_pollitem_t pollitem() const noexcept { return { nullptr, wake_fd, ZMQ_POLLIN, 0 }; }
+
+        template<typename Handler>
+        void on_readable(Handler& handler)
+        {
+            std::uint64_t value;
+            ++server_stats::g_stats.total_io_syscalls;
+            while (::read(wake_fd, &value, sizeof(value)) == -1 && errno == EINTR)
+                ;
+            reactor_message msg;
+            for (auto& r : reactors)
+            {
+                bool replied = false;
+                while (r->inbound.try_pop(msg))
+                {
+                    const auto client_id = std::to_string(msg.serial);
+                    if (msg.kind == reactor_message::CONNECTED)
+                        handler.connected(client_id);
+                    else if (msg.kind == reactor_message::DISCONNECTED)
+                        handler.disconnected(client_id);
+                    else if (msg.kind == reactor_message::UNSENT)
+                        handler.unsent(client_id, msg.unsent);
+                    else if (auto reply = handler.received(client_id, msg.data); !reply.empty())
+                    {
+                        to_reactor({reactor_message::REPLY, msg.serial, std::move(reply)});
+                        replied = true;
+                    }
+                }
+                if (replied)
+                {
+                    ++server_stats::g_stats.total_io_syscalls;
+                    r->wake();
+                }
+                server_stats::g_stats.total_io_syscalls += r->syscalls.exchange(0, std::memory_order_relaxed);
+            }
+        }
+    };
+}
+
+#endif /* __linux__ */
+
+#endif /* REACTOR_POOL_HPP */
\ No newline at end of file
@@ -0,0 +1,261 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef REPLICATION_HPP
+#define REPLICATION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aof.hpp"
+#include "execute_command.hpp"
+#include "resp.hpp"
+#include "resp_command.hpp"
+#include "resp_command_parser.hpp"
+#include "snapshot.hpp"
+
+//Primary -> replica asynchronous replication. Every successful write command on the primary is
+//encoded in RESP and appended to the replication stream; a position in the stream is its byte
+//offset and a stream is named by a random replication ID. The latest bytes are kept in a circular
+//backlog, so a replica reconnecting with (ID, offset) resumes from it (partial resync) and only
+//replicas outside the window get a snapshot of the whole dataset (full sync).
+//The transport lives in zmq_replication.hpp.
+
+namespace replication
+{
+    enum class role
+    {
+        MASTER, REPLICA
+    };
+
+    enum class link_state
+    {
+        NONE,       //not a replica
+        CONNECT,    //waiting for the primary to answer PSYNC
+        SYNC,       //receiving the snapshot of a full resync
+        CONNECTED   //streaming
+    };
+
+    //the replication endpoint of a primary is its RESP port plus this offset
+    constexpr int PORT_OFFSET = 10000;
+    constexpr std::size_t DEFAULT_BACKLOG_SIZE = 1 << 20;
+    constexpr std::size_t REPLID_SIZE = 40;
+
+    //pseudo client applying the primary's stream on a replica, kept across links so its
+    //SELECTed database survives partial resyncs
+    static const std::string MASTER_CLIENT_ID = "MASTER-LINK";
+
+    static inline std::string random_replid()
+    {
+        constexpr char digits[] = "0123456789abcdef";
+        std::random_device rd;
+        std::string replid(REPLID_SIZE, '0');
+        for (auto& c : replid)
+            c = digits[rd() & 0xF];
+        return replid;
+    }
+
+    //fixed-size ring holding the latest bytes of the replication stream
+    class circular_backlog final
+    {
+        std::vector<char> buffer;
+        std::size_t index = 0;          //next write position in the ring
+        std::size_t histlen = 0;        //valid bytes in the ring
+        std::uint64_t offset = 0;       //stream offset right after the last byte written
+
+    public:
+        explicit circular_backlog(std::size_t size = DEFAULT_BACKLOG_SIZE) : buffer(size) {}
+
+        void resize(std::size_t size)
+        {
+            buffer.assign(size, '\0');
+            index = histlen = 0;
+        }
+
+        void append(std::string_view data)
+        {
+            offset += data.size();
+            if (data.size() > buffer.size())
+                data.remove_prefix(data.size() - buffer.size());
+            while (!data.empty())
+            {
+                std::size_t n = std::min(buffer.size() - index, data.size());
+                std::memcpy(buffer.data() + index, data.data(), n);
+                index = (index + n) % buffer.size();
+                histlen = std::min(histlen + n, buffer.size());
+                data.remove_prefix(n);
+            }
+        }
+
+        std::size_t capacity() const noexcept { return buffer.size(); }
+        std::size_t size() const noexcept { return histlen; }
+        std::uint64_t end_offset() const noexcept { return offset; }
+        std::uint64_t first_offset() const noexcept { return offset - histlen; }
+
+        bool contains(std::uint64_t from) const noexcept
+        {
+            return from >= first_offset() && from <= offset;
+        }
+
+        //stream bytes [from, end_offset())
+        std::string copy(std::uint64_t from) const
+        {
+            std::size_t length = static_cast<std::size_t>(offset - from);
+            std::size_t start = (index + buffer.size() - length) % buffer.size();
+            std::string out;
+            out.reserve(length);
+            std::size_t n = std::min(length, buffer.size() - start);
+            out.append(buffer.data() + start, n);
+            out.append(buffer.data(), length - n);
+            return out;
+        }
+
+        //drops the history and continues the stream at from
+        void reset(std::uint64_t from) noexcept
+        {
+            index = histlen = 0;
+            offset = from;
+        }
+    };
+
+    struct replication_state final
+    {
+        role current_role = role::MASTER;
+        std::string master_host;
+        int master_port = 0;
+        link_state state = link_state::NONE;
+        bool reconfigured = false;          //set by REPLICAOF, handled by the event loop
+        std::size_t connected_replicas = 0;
+
+        std::string replid = random_replid();
+        std::string replid2 = std::string(REPLID_SIZE, '0'); //previous ID, valid up to second_replid_offset
+        std::uint64_t second_replid_offset = 0;
+        circular_backlog backlog;
+        int selected_db = -1;               //last SELECT in the stream
+
+        std::size_t sync_full = 0;
+        std::size_t sync_partial_ok = 0;
+        std::size_t sync_partial_err = 0;
+
+        bool is_replica() const noexcept { return current_role == role::REPLICA; }
+        std::uint64_t master_repl_offset() const noexcept { return backlog.end_offset(); }
+
+        void replicaof(const std::string& host, int port)
+        {
+            current_role = role::REPLICA;
+            master_host = host;
+            master_port = port;
+            state = link_state::CONNECT;
+            reconfigured = true;
+        }
+
+        //a promoted replica starts a new history, replicas of the old primary may still resume
+        //from it up to the current offset through replid2
+        void replicaof_no_one()
+        {
+            if (is_replica())
+            {
+                replid2 = replid;
+                second_replid_offset = master_repl_offset();
+                replid = random_replid();
+            }
+            current_role = role::MASTER;
+            master_host.clear();
+            master_port = 0;
+            state = link_state::NONE;
+            reconfigured = true;
+        }
+
+        //a replica holding (id, offset) can continue from the backlog
+        bool can_partial_resync(std::string_view id, std::uint64_t offset) const noexcept
+        {
+            if (id != replid && (id != replid2 || offset > second_replid_offset))
+                return false;
+            return backlog.contains(offset);
+        }
+
+        //a new replica joins through a snapshot: the next command must carry its SELECT
+        void full_sync_started()
+        {
+            selected_db = -1;
+            ++sync_full;
+        }
+
+        //successful writes on a primary
+        void feed(int db_num, const resp::command& cmd)
+        {
+            std::string out;
+            if (db_num != selected_db)
+            {
+                aof::append_select(out, db_num);
+                selected_db = db_num;
+            }
+            aof::append_command(out, cmd);
+            backlog.append(out);
+        }
+
+        //the stream of the primary on a replica, stored verbatim so offsets match
+        void feed_stream(std::string_view data)
+        {
+            backlog.append(data);
+        }
+
+        //a replica adopting a primary's history after a full sync
+        void reset(const std::string& id, std::uint64_t offset)
+        {
+            replid = id;
+            replid2 = std::string(REPLID_SIZE, '0');
+            second_replid_offset = 0;
+            backlog.reset(offset);
+            selected_db = -1;
+        }
+    };
+
+    static replication_state g_replication;
+
+    //replicas serve reads only, their dataset changes through the primary's stream
+    static inline bool rejects_write(const std::string& cmd_name)
+    {
+        return g_replication.is_replica() && is_write_command(cmd_name);
+    }
+
+    //applies complete commands of the primary's stream, returns the number of bytes consumed
+    template<typename Context, typename CommandStrategy>
+    static std::size_t apply(std::string_view stream)
+    {
+        auto& state = g_replication;
+        //a missing MASTER_CLIENT_ID resumes on the last SELECT of the stream
+        if (!Context::find_client(MASTER_CLIENT_ID))
+        {
+            Context::create_or_remove_client(MASTER_CLIENT_ID);
+            Context{MASTER_CLIENT_ID}.Client().CurrentDb(std::max(state.selected_db, 0));
+        }
+        resp::command_parser parser { stream.data(), stream.data() + stream.size() };
+        while (auto args_opt = parser.parse_next())
+        {
+            bool unk_cmd{};
+            Context ctx{MASTER_CLIENT_ID};
+            resp::command cmd(std::move(*args_opt));
+            execute_command<Context, CommandStrategy>(ctx, cmd, unk_cmd);
+            if (is_write_command(cmd.name()))
+            {
+                aof::g_aof.feed(ctx.Client().CurrentDbNumber, cmd);
+                ++snapshot::g_snapshot.changes_since_last_save;
+            }
+        }
+        std::size_t consumed = parser.position - stream.data();
+        state.feed_stream(stream.substr(0, consumed));
+        state.selected_db = Context{MASTER_CLIENT_ID}.Client().CurrentDbNumber;
+        return consumed;
+    }
+}
+
+#endif /* REPLICATION_HPP */
\ No newline at end of file
@@ -6,6 +6,7 @@
 #ifndef RESP_HPP
 #define RESP_HPP
 
+#include <concepts>
 #include <iterator>
 #include <string>
 #include <string_view>
@@ -57,6 +58,11 @@ namespace resp
         return format::error_unknown_subcommand(sv);
     }
 
+    static inline std::string error(const std::string_view& sv)
+    {
+        return format::resp_error(sv);
+    }
+
     constexpr const char* error_wrong_number_of_arguments_for_command()
     {
         return "-ERR wrong number of arguments for command\r\n";
@@ -82,15 +88,85 @@ namespace resp
         return "-ERR syntax error\r\n";
     }
 
+    constexpr const char* error_background_save_in_progress()
+    {
+        return "-ERR Background save already in progress\r\n";
+    }
+
+    constexpr const char* error_background_rewrite_in_progress()
+    {
+        return "-ERR Background append only file rewriting already in progress\r\n";
+    }
+
+    constexpr const char* error_protocol()
+    {
+        return "-ERR Protocol error\r\n";
+    }
+
+    constexpr const char* error_readonly()
+    {
+        return "-READONLY You can't write against a read only replica.\r\n";
+    }
+
+    constexpr const char* error_misconf_aof()
+    {
+        return "-MISCONF Errors writing to the AOF file, write commands are disabled\r\n";
+    }
+
+    constexpr const char* error_multi_calls_can_not_be_nested()
+    {
+        return "-ERR MULTI calls can not be nested\r\n";
+    }
+
+    constexpr const char* error_exec_without_multi()
+    {
+        return "-ERR EXEC without MULTI\r\n";
+    }
+
+    constexpr const char* error_discard_without_multi()
+    {
+        return "-ERR DISCARD without MULTI\r\n";
+    }
+
+    constexpr const char* error_watch_inside_multi()
+    {
+        return "-ERR WATCH inside MULTI is not allowed\r\n";
+    }
+
+    constexpr const char* error_execabort()
+    {
+        return "-EXECABORT Transaction discarded because of previous errors.\r\n";
+    }
+
+    constexpr const char* error_noscript()
+    {
+        return "-NOSCRIPT No matching script. Please use EVAL.\r\n";
+    }
+
     static inline std::string integer(int num)
     {
         return format::resp_integer(num);
     }
+
+    //64-bit sizes and counters, never narrowed to int
+    template<std::integral T>
+        requires (sizeof(T) > sizeof(int))
+    static inline std::string integer(T num)
+    {
+        if constexpr (std::is_signed_v<T>)
+            return format::resp_integer(static_cast<long long>(num));
+        else
+            return format::resp_integer(static_cast<unsigned long long>(num));
+    }
     
     constexpr const char* ok() { return "+OK\r\n"; }
     constexpr const char* nil() { return "$-1\r\n"; }
     constexpr const char* pong() { return "+PONG\r\n"; }
     constexpr const char* empty_array() { return "*0\r\n"; }
+    constexpr const char* nil_array() { return "*-1\r\n"; }
+    constexpr const char* queued() { return "+QUEUED\r\n"; }
+    constexpr const char* background_saving_started() { return "+Background saving started\r\n"; }
+    constexpr const char* background_rewrite_started() { return "+Background append only file rewriting started\r\n"; }
 }
 
 #endif /* RESP_HPP */
\ No newline at end of file
@@ -36,6 +36,8 @@ namespace resp
 
         const std::size_t size() const { return args.size(); }
 
+        const std::vector<std::string_view>& arguments() const { return args; }
+
         const std::string operator[](std::size_t index) const
         {
             if (index == 0)
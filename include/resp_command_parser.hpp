@@ -28,7 +28,9 @@ namespace resp
 {
     struct command_parser final
     {
-        const char* position;    
+        const char* position;
+        const char* end = nullptr; //when set, reads never go past it
+
         std::optional<std::vector<std::string_view>> parse()
         {
             if (position[0] == '*')
@@ -41,16 +43,47 @@ namespace resp
             return std::nullopt;
         }
 
+        //parses one command and advances past it, for buffers holding several commands;
+        //on failure position is left untouched so an incomplete tail can be kept
+        std::optional<std::vector<std::string_view>> parse_next()
+        {
+            if (has(1) && position[0] == '*')
+            {
+                const char* old_position = position;
+                auto cmd_opt = read_array();
+                if (!cmd_opt)
+                    position = old_position;
+                return cmd_opt;
+            }
+            return std::nullopt;
+        }
+
     private:
+        bool has(std::size_t count) const
+        {
+            return !end || (position <= end && static_cast<std::size_t>(end - position) >= count);
+        }
+
+        const char* find_crlf(const char* from) const
+        {
+            if (end)
+                return static_cast<const char*>(std::memchr(from, '\r', from < end ? end - from : 0));
+            return std::strchr(from, '\r');
+        }
+
         std::optional<std::string_view> read_string()
         {
             const char* pos = position;        
+            if (!has(1) || !find_crlf(pos + 1))
+                return std::nullopt;
             char* pos_beg = const_cast<char*>(pos + 1);
-            char* pos_end = std::strchr(pos_beg,'\r');
+            char* pos_end = const_cast<char*>(find_crlf(pos_beg));
             std::size_t size = std::strtoll(pos_beg, &pos_end, 10);
             if (pos_beg == pos_end)
                 return std::nullopt;
             position = pos_end + 2; //\r\n
+            if (!has(size) || !has(size + 2))
+                return std::nullopt;
             std::string_view sv{ position, position + size };
             position += size;
             position += 2; //\r\n
@@ -61,13 +94,17 @@ namespace resp
         {
             using size_type = std::vector<std::string_view>::size_type;
             const char* pos = position;
+            if (!has(1) || !find_crlf(pos + 1))
+                return std::nullopt;
             char* pos_beg = const_cast<char*>(pos + 1);
-            char* pos_end = std::strchr(pos_beg,'\r');
+            char* pos_end = const_cast<char*>(find_crlf(pos_beg));
             size_type size = std::strtoll(pos_beg, &pos_end, 10);
             if (pos_beg == pos_end)
                 return std::nullopt;
             pos_end += 2; //\r\n
             position = pos_end;
+            if (!has(size))
+                return std::nullopt;
             if (size > 0)
             {
                 std::vector<std::string_view> temp(size); 
@@ -0,0 +1,1174 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef SCRIPT_VM_HPP
+#define SCRIPT_VM_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "coarse_clock.hpp"
+#include "format.hpp"
+#include "resp.hpp"
+#include "resp_command.hpp"
+
+//The language of EVAL scripts: the subset of Lua that server side scripts are written in, compiled
+//once into bytecode for a stack machine.
+//  local x = e   x = e   t[i] = e   if/elseif/else/end   while/do/end   for i = a, b[, step] do/end
+//  do/end   break   return [e]   -- comments
+//  nil true false numbers 'strings' "strings" {e, e, ...}   t[i] #t
+//  or and not   == ~= < <= > >=   ..   + - * / %   unary -
+//  redis.call(name, arg, ...)   tonumber(e)   tostring(e)   type(e)
+//Variables are locals, KEYS and ARGV; tables are arrays indexed from 1. redis.call executes the
+//command with string views of its arguments, so KEYS and ARGV, which view the EVAL command, reach
+//the command without being copied; its reply becomes a number (integer), a string (bulk or status),
+//false (nil) or a table (array), and an error reply ends the script with that error. The returned
+//value becomes the reply: number as integer, string as bulk, table as array, true as 1, nil and
+//false as nil. The execution is aborted once it runs past its time budget.
+
+namespace script
+{
+    struct table;
+    using table_ptr = std::shared_ptr<table>;
+
+    //std::string_view: a string owned by the EVAL command (KEYS, ARGV) or by the program (constants)
+    using value = std::variant<std::monostate, bool, double, std::string, std::string_view, table_ptr>;
+
+    struct table final
+    {
+        std::vector<value> items;
+    };
+
+    //every table of one execution: tables are reference counted and t[1] = t would never be
+    //freed, so the destructor empties the ones still alive, which breaks any cycle among them
+    class heap final
+    {
+        std::vector<std::weak_ptr<table>> tables;
+        std::size_t next_sweep = 64;
+
+    public:
+        heap() = default;
+        heap(const heap&) = delete;
+        heap& operator=(const heap&) = delete;
+
+        ~heap()
+        {
+            //all kept alive while emptied, so none is freed from within another's items
+            std::vector<table_ptr> alive;
+            alive.reserve(tables.size());
+            for (auto& t : tables)
+                if (auto p = t.lock())
+                    alive.push_back(std::move(p));
+            for (auto& t : alive)
+                t->items.clear();
+        }
+
+        table_ptr make()
+        {
+            if (tables.size() == next_sweep)
+            {
+                std::erase_if(tables, [](const std::weak_ptr<table>& t) { return t.expired(); });
+                next_sweep = std::max<std::size_t>(64, 2 * tables.size());
+            }
+            auto t = std::make_shared<table>();
+            tables.push_back(t);
+            return t;
+        }
+    };
+
+    //compilation or execution error
+    struct error final : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    //error reply of a command called by the script, the reply of the script as is
+    struct reply_error final : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    enum class opcode : std::uint8_t
+    {
+        PUSH_CONST, PUSH_NIL, PUSH_TRUE, PUSH_FALSE, POP,
+        LOAD, STORE,                                //local slot
+        NEW_TABLE, INDEX, SET_INDEX, LEN,           //NEW_TABLE pops arg items
+        NEG, NOT, ADD, SUB, MUL, DIV, MOD, CONCAT,
+        EQ, NE, LT, LE, GT, GE,
+        JUMP, JUMP_IF_FALSE, JUMP_IF_FALSE_OR_POP, JUMP_IF_TRUE_OR_POP,
+        FOR_CHECK, FOR_STEP,                        //slots arg (variable), arg + 1 (limit), arg + 2 (step)
+        CALL,                                       //redis.call with arg arguments
+        TONUMBER, TOSTRING, TYPE,
+        RETURN
+    };
+
+    struct instruction final
+    {
+        opcode op;
+        std::int32_t arg;
+    };
+
+    struct program final
+    {
+        std::vector<instruction> code;
+        std::vector<value> constants;
+        std::size_t locals = 0;                     //slot 0 is KEYS, slot 1 is ARGV
+    };
+
+    constexpr std::size_t KEYS_SLOT = 0;
+    constexpr std::size_t ARGV_SLOT = 1;
+
+    //nested blocks, parentheses, operators and tables, like LUAI_MAXCCALLS; the compiler and
+    //to_reply recurse once per level, deeper ones would overflow the stack
+    constexpr int MAX_NESTING = 200;
+
+    static inline bool is_string(const value& v)
+    {
+        return std::holds_alternative<std::string>(v) || std::holds_alternative<std::string_view>(v);
+    }
+
+    static inline std::string_view as_string_view(const value& v)
+    {
+        if (auto s = std::get_if<std::string>(&v))
+            return *s;
+        return std::get<std::string_view>(v);
+    }
+
+    static inline bool truthy(const value& v)
+    {
+        if (std::holds_alternative<std::monostate>(v))
+            return false;
+        if (auto b = std::get_if<bool>(&v))
+            return *b;
+        return true;
+    }
+
+    static inline const char* type_name(const value& v)
+    {
+        switch (v.index())
+        {
+            case 0: return "nil";
+            case 1: return "boolean";
+            case 2: return "number";
+            case 5: return "table";
+            default: return "string";
+        }
+    }
+
+    //integers print without a fraction, like Lua's %.14g
+    static inline std::string number_to_string(double n)
+    {
+        char buffer[32];
+        if (std::floor(n) == n && std::fabs(n) < 1e15)
+            std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(n));
+        else
+            std::snprintf(buffer, sizeof(buffer), "%.14g", n);
+        return buffer;
+    }
+
+    static inline std::optional<double> string_to_number(std::string_view sv)
+    {
+        while (!sv.empty() && (sv.front() == ' ' || sv.front() == '\t'))
+            sv.remove_prefix(1);
+        while (!sv.empty() && (sv.back() == ' ' || sv.back() == '\t'))
+            sv.remove_suffix(1);
+        if (sv.size() > 2 && sv[0] == '0' && (sv[1] | 0x20) == 'x')
+        {
+            unsigned long long n{};
+            auto [ptr, ec] = std::from_chars(sv.data() + 2, sv.data() + sv.size(), n, 16);
+            if (ec == std::errc{} && ptr == sv.data() + sv.size())
+                return static_cast<double>(n);
+            return std::nullopt;
+        }
+        if (!sv.empty() && sv.front() == '+')
+            sv.remove_prefix(1);
+        double n{};
+        auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), n);
+        if (sv.empty() || ec != std::errc{} || ptr != sv.data() + sv.size())
+            return std::nullopt;
+        return n;
+    }
+
+    class compiler final
+    {
+        enum class token_kind : std::uint8_t { NAME, NUMBER, STRING, SYMBOL, END };
+
+        struct token final
+        {
+            token_kind kind = token_kind::END;
+            std::string text;
+            double number = 0;
+        };
+
+        struct local final
+        {
+            std::string name;
+            std::size_t slot;
+        };
+
+        std::string_view source;
+        std::size_t position = 0;
+        int line = 1;
+        token current;
+        program prog;
+        std::vector<local> scope{ {"KEYS", KEYS_SLOT}, {"ARGV", ARGV_SLOT} };
+        std::vector<std::vector<std::size_t>> loop_breaks;
+        int depth = 0;
+
+        //held by block, expression and the rules recursing into themselves
+        struct nesting final
+        {
+            compiler& c;
+
+            explicit nesting(compiler& c) : c{c}
+            {
+                if (c.depth == MAX_NESTING)
+                    c.fail("chunk has too many syntax levels");
+                ++c.depth;
+            }
+
+            ~nesting() { --c.depth; }
+        };
+
+    public:
+        explicit compiler(std::string_view source) : source{source} {}
+
+        program compile()
+        {
+            prog.locals = scope.size();
+            next();
+            block();
+            if (current.kind != token_kind::END)
+                fail("'<eof>' expected near '" + current.text + "'");
+            emit(opcode::PUSH_NIL);
+            emit(opcode::RETURN);
+            return std::move(prog);
+        }
+
+    private:
+        [[noreturn]] void fail(const std::string& message) const
+        {
+            throw error("line " + std::to_string(line) + ": " + message);
+        }
+
+        static bool is_keyword(std::string_view name)
+        {
+            for (auto keyword : { "and", "break", "do", "else", "elseif", "end", "false", "for", "if",
+                                  "local", "nil", "not", "or", "return", "then", "true", "while" })
+                if (name == keyword)
+                    return true;
+            return false;
+        }
+
+        char peek_char(std::size_t ahead = 0) const
+        {
+            return position + ahead < source.size() ? source[position + ahead] : '\0';
+        }
+
+        void skip_space_and_comments()
+        {
+            while (position < source.size())
+            {
+                const char c = source[position];
+                if (c == '\n')
+                {
+                    ++line;
+                    ++position;
+                }
+                else if (c == ' ' || c == '\t' || c == '\r')
+                    ++position;
+                else if (c == '-' && peek_char(1) == '-')
+                {
+                    position += 2;
+                    if (peek_char() == '[' && peek_char(1) == '[')
+                    {
+                        const auto end = source.find("]]", position);
+                        if (end == std::string_view::npos)
+                            fail("unfinished long comment");
+                        for (auto i = position; i < end; ++i)
+                            line += source[i] == '\n';
+                        position = end + 2;
+                    }
+                    else
+                        while (position < source.size() && source[position] != '\n')
+                            ++position;
+                }
+                else
+                    break;
+            }
+        }
+
+        void next()
+        {
+            skip_space_and_comments();
+            current = token{};
+            if (position == source.size())
+                return;
+            const char c = source[position];
+            if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+            {
+                const auto start = position;
+                while (std::isalnum(static_cast<unsigned char>(peek_char())) || peek_char() == '_')
+                    ++position;
+                current.text = source.substr(start, position - start);
+                current.kind = is_keyword(current.text) ? token_kind::SYMBOL : token_kind::NAME;
+            }
+            else if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && std::isdigit(static_cast<unsigned char>(peek_char(1)))))
+            {
+                const auto start = position;
+                while (std::isalnum(static_cast<unsigned char>(peek_char())) || peek_char() == '.' ||
+                       ((peek_char() == '+' || peek_char() == '-') && (source[position - 1] | 0x20) == 'e'))
+                    ++position;
+                current.text = source.substr(start, position - start);
+                auto n = string_to_number(current.text);
+                if (!n)
+                    fail("malformed number near '" + current.text + "'");
+                current.kind = token_kind::NUMBER;
+                current.number = *n;
+            }
+            else if (c == '\'' || c == '"')
+                read_string(c);
+            else if (c == '[' && peek_char(1) == '[')
+            {
+                position += 2;
+                if (peek_char() == '\n')
+                {
+                    ++line;
+                    ++position;
+                }
+                const auto end = source.find("]]", position);
+                if (end == std::string_view::npos)
+                    fail("unfinished long string");
+                current.text = source.substr(position, end - position);
+                for (char ch : current.text)
+                    line += ch == '\n';
+                position = end + 2;
+                current.kind = token_kind::STRING;
+            }
+            else
+            {
+                static constexpr std::string_view two_chars[] = { "==", "~=", "<=", ">=", ".." };
+                current.kind = token_kind::SYMBOL;
+                for (auto symbol : two_chars)
+                    if (source.substr(position, 2) == symbol)
+                    {
+                        current.text = symbol;
+                        position += 2;
+                        return;
+                    }
+                if (std::string_view{"+-*/%#<>=(){}[];,."}.find(c) == std::string_view::npos)
+                    fail(std::string{"unexpected symbol near '"} + c + "'");
+                current.text = c;
+                ++position;
+            }
+        }
+
+        void read_string(char quote)
+        {
+            ++position;
+            current.kind = token_kind::STRING;
+            while (true)
+            {
+                if (position == source.size() || source[position] == '\n')
+                    fail("unfinished string");
+                char c = source[position++];
+                if (c == quote)
+                    break;
+                if (c == '\\')
+                {
+                    if (position == source.size())
+                        fail("unfinished string");
+                    c = source[position++];
+                    switch (c)
+                    {
+                        case 'n': c = '\n'; break;
+                        case 't': c = '\t'; break;
+                        case 'r': c = '\r'; break;
+                        case '0': c = '\0'; break;
+                        case '\\': case '\'': case '"': break;
+                        case '\n': ++line; break;
+                        default: fail(std::string{"invalid escape sequence '\\"} + c + "'");
+                    }
+                }
+                current.text.push_back(c);
+            }
+        }
+
+        bool check(std::string_view symbol) const
+        {
+            return current.kind == token_kind::SYMBOL && current.text == symbol;
+        }
+
+        bool accept(std::string_view symbol)
+        {
+            if (!check(symbol))
+                return false;
+            next();
+            return true;
+        }
+
+        void expect(std::string_view symbol)
+        {
+            if (!accept(symbol))
+                fail("'" + std::string{symbol} + "' expected near '" + (current.kind == token_kind::END ? "<eof>" : current.text) + "'");
+        }
+
+        std::string expect_name()
+        {
+            if (current.kind != token_kind::NAME)
+                fail("name expected near '" + current.text + "'");
+            auto name = std::move(current.text);
+            next();
+            return name;
+        }
+
+        std::size_t emit(opcode op, std::int32_t arg = 0)
+        {
+            prog.code.push_back({op, arg});
+            return prog.code.size() - 1;
+        }
+
+        void patch(std::size_t at)
+        {
+            prog.code[at].arg = static_cast<std::int32_t>(prog.code.size());
+        }
+
+        void emit_constant(value v)
+        {
+            prog.constants.push_back(std::move(v));
+            emit(opcode::PUSH_CONST, static_cast<std::int32_t>(prog.constants.size() - 1));
+        }
+
+        std::size_t declare(std::string name)
+        {
+            const auto slot = scope.size();
+            scope.push_back({std::move(name), slot});
+            prog.locals = std::max(prog.locals, scope.size());
+            return slot;
+        }
+
+        const local* resolve(const std::string& name) const
+        {
+            for (auto it = scope.rbegin(); it != scope.rend(); ++it)
+                if (it->name == name)
+                    return &*it;
+            return nullptr;
+        }
+
+        bool block_ends() const
+        {
+            return current.kind == token_kind::END || check("end") || check("else") || check("elseif");
+        }
+
+        void block()
+        {
+            nesting level{*this};
+            const auto scope_size = scope.size();
+            while (!block_ends())
+            {
+                if (accept("return"))
+                {
+                    if (block_ends() || check(";"))
+                        emit(opcode::PUSH_NIL);
+                    else
+                        expression();
+                    emit(opcode::RETURN);
+                    accept(";");
+                    if (!block_ends())
+                        fail("'end' expected after return");
+                    break;
+                }
+                statement();
+                accept(";");
+            }
+            scope.resize(scope_size);
+        }
+
+        void statement()
+        {
+            if (accept("local"))
+            {
+                auto name = expect_name();
+                if (accept("="))
+                    expression();
+                else
+                    emit(opcode::PUSH_NIL);
+                emit(opcode::STORE, static_cast<std::int32_t>(declare(std::move(name))));
+            }
+            else if (accept("if"))
+            {
+                std::vector<std::size_t> ends;
+                do
+                {
+                    expression();
+                    expect("then");
+                    const auto skip = emit(opcode::JUMP_IF_FALSE);
+                    block();
+                    ends.push_back(emit(opcode::JUMP));
+                    patch(skip);
+                } while (accept("elseif"));
+                if (accept("else"))
+                    block();
+                expect("end");
+                for (auto at : ends)
+                    patch(at);
+            }
+            else if (accept("while"))
+            {
+                const auto start = prog.code.size();
+                expression();
+                expect("do");
+                const auto exit = emit(opcode::JUMP_IF_FALSE);
+                loop_body(start);
+                patch(exit);
+                patch_breaks();
+            }
+            else if (accept("for"))
+            {
+                const auto scope_size = scope.size();
+                const auto slot = declare(expect_name());
+                declare("(for limit)");
+                declare("(for step)");
+                expect("=");
+                expression();
+                emit(opcode::STORE, static_cast<std::int32_t>(slot));
+                expect(",");
+                expression();
+                emit(opcode::STORE, static_cast<std::int32_t>(slot + 1));
+                if (accept(","))
+                    expression();
+                else
+                    emit_constant(1.0);
+                emit(opcode::STORE, static_cast<std::int32_t>(slot + 2));
+                expect("do");
+                const auto start = prog.code.size();
+                emit(opcode::FOR_CHECK, static_cast<std::int32_t>(slot));
+                const auto exit = emit(opcode::JUMP_IF_FALSE);
+                loop_breaks.emplace_back();
+                block();
+                expect("end");
+                emit(opcode::FOR_STEP, static_cast<std::int32_t>(slot));
+                emit(opcode::JUMP, static_cast<std::int32_t>(start));
+                patch(exit);
+                patch_breaks();
+                scope.resize(scope_size);
+            }
+            else if (accept("do"))
+            {
+                block();
+                expect("end");
+            }
+            else if (accept("break"))
+            {
+                if (loop_breaks.empty())
+                    fail("no loop to break");
+                loop_breaks.back().push_back(emit(opcode::JUMP));
+            }
+            else if (current.kind == token_kind::NAME)
+                assignment_or_call();
+            else
+                fail("unexpected symbol near '" + (current.kind == token_kind::END ? std::string{"<eof>"} : current.text) + "'");
+        }
+
+        void loop_body(std::size_t start)
+        {
+            loop_breaks.emplace_back();
+            block();
+            expect("end");
+            emit(opcode::JUMP, static_cast<std::int32_t>(start));
+        }
+
+        void patch_breaks()
+        {
+            for (auto at : loop_breaks.back())
+                patch(at);
+            loop_breaks.pop_back();
+        }
+
+        void assignment_or_call()
+        {
+            auto name = expect_name();
+            if (is_builtin(name))
+            {
+                builtin_call(name);
+                emit(opcode::POP);
+                return;
+            }
+            const auto* var = resolve(name);
+            if (!var)
+                fail("assignment to undeclared variable '" + name + "', use local");
+            const auto slot = static_cast<std::int32_t>(var->slot);
+            if (accept("="))
+            {
+                expression();
+                emit(opcode::STORE, slot);
+                return;
+            }
+            emit(opcode::LOAD, slot);
+            expect("[");
+            while (true)
+            {
+                expression();
+                expect("]");
+                if (accept("="))
+                {
+                    expression();
+                    emit(opcode::SET_INDEX);
+                    return;
+                }
+                emit(opcode::INDEX);
+                expect("[");
+            }
+        }
+
+        static bool is_builtin(const std::string& name)
+        {
+            return name == "redis" || name == "tonumber" || name == "tostring" || name == "type";
+        }
+
+        void builtin_call(const std::string& name)
+        {
+            if (name == "redis")
+            {
+                expect(".");
+                if (expect_name() != "call")
+                    fail("only redis.call is supported");
+            }
+            expect("(");
+            std::int32_t count = 0;
+            if (!check(")"))
+                do
+                {
+                    expression();
+                    ++count;
+                } while (accept(","));
+            expect(")");
+            if (name == "redis")
+            {
+                if (count == 0)
+                    fail("redis.call needs a command name");
+                emit(opcode::CALL, count);
+                return;
+            }
+            if (count != 1)
+                fail(name + " takes one argument");
+            emit(name == "tonumber" ? opcode::TONUMBER : name == "tostring" ? opcode::TOSTRING : opcode::TYPE);
+        }
+
+        void expression()
+        {
+            nesting level{*this};
+            and_expression();
+            while (accept("or"))
+            {
+                const auto end = emit(opcode::JUMP_IF_TRUE_OR_POP);
+                and_expression();
+                patch(end);
+            }
+        }
+
+        void and_expression()
+        {
+            comparison();
+            while (accept("and"))
+            {
+                const auto end = emit(opcode::JUMP_IF_FALSE_OR_POP);
+                comparison();
+                patch(end);
+            }
+        }
+
+        void comparison()
+        {
+            concatenation();
+            while (true)
+            {
+                opcode op;
+                if (accept("==")) op = opcode::EQ;
+                else if (accept("~=")) op = opcode::NE;
+                else if (accept("<")) op = opcode::LT;
+                else if (accept("<=")) op = opcode::LE;
+                else if (accept(">")) op = opcode::GT;
+                else if (accept(">=")) op = opcode::GE;
+                else break;
+                concatenation();
+                emit(op);
+            }
+        }
+
+        //right associative
+        void concatenation()
+        {
+            additive();
+            if (accept(".."))
+            {
+                nesting level{*this};
+                concatenation();
+                emit(opcode::CONCAT);
+            }
+        }
+
+        void additive()
+        {
+            multiplicative();
+            while (true)
+            {
+                if (accept("+")) { multiplicative(); emit(opcode::ADD); }
+                else if (accept("-")) { multiplicative(); emit(opcode::SUB); }
+                else break;
+            }
+        }
+
+        void multiplicative()
+        {
+            unary();
+            while (true)
+            {
+                if (accept("*")) { unary(); emit(opcode::MUL); }
+                else if (accept("/")) { unary(); emit(opcode::DIV); }
+                else if (accept("%")) { unary(); emit(opcode::MOD); }
+                else break;
+            }
+        }
+
+        void unary()
+        {
+            opcode op;
+            if (accept("not")) op = opcode::NOT;
+            else if (accept("-")) op = opcode::NEG;
+            else if (accept("#")) op = opcode::LEN;
+            else
+            {
+                primary();
+                return;
+            }
+            nesting level{*this};
+            unary();
+            emit(op);
+        }
+
+        void primary()
+        {
+            if (current.kind == token_kind::NUMBER)
+            {
+                emit_constant(current.number);
+                next();
+            }
+            else if (current.kind == token_kind::STRING)
+            {
+                emit_constant(std::move(current.text));
+                next();
+            }
+            else if (accept("nil"))
+                emit(opcode::PUSH_NIL);
+            else if (accept("true"))
+                emit(opcode::PUSH_TRUE);
+            else if (accept("false"))
+                emit(opcode::PUSH_FALSE);
+            else if (accept("{"))
+            {
+                std::int32_t count = 0;
+                if (!check("}"))
+                    do
+                    {
+                        if (check("}"))
+                            break;      //trailing separator
+                        expression();
+                        ++count;
+                    } while (accept(",") || accept(";"));
+                expect("}");
+                emit(opcode::NEW_TABLE, count);
+            }
+            else if (accept("("))
+            {
+                expression();
+                expect(")");
+            }
+            else if (current.kind == token_kind::NAME)
+            {
+                auto name = expect_name();
+                if (is_builtin(name))
+                    builtin_call(name);
+                else if (const auto* var = resolve(name))
+                    emit(opcode::LOAD, static_cast<std::int32_t>(var->slot));
+                else
+                    fail("undeclared variable '" + name + "'");
+            }
+            else
+                fail("unexpected symbol near '" + (current.kind == token_kind::END ? std::string{"<eof>"} : current.text) + "'");
+            while (accept("["))
+            {
+                expression();
+                expect("]");
+                emit(opcode::INDEX);
+            }
+        }
+    };
+
+    static inline program compile(std::string_view source)
+    {
+        return compiler{source}.compile();
+    }
+
+    //reply of a command called by the script
+    static value from_reply(std::string_view& reply, heap& tables, bool top = true)
+    {
+        const auto eol = reply.find("\r\n");
+        if (reply.empty() || eol == std::string_view::npos)
+            throw error("malformed command reply");
+        const char type = reply[0];
+        const auto header = reply.substr(1, eol - 1);
+        reply.remove_prefix(eol + 2);
+        auto length = [&]() {
+            long long n{};
+            const auto* first = header.data() + (!header.empty() && header[0] == '+');   //resp::integer signs positives
+            auto [ptr, ec] = std::from_chars(first, header.data() + header.size(), n);
+            if (ec != std::errc{} || ptr != header.data() + header.size())
+                throw error("malformed command reply");
+            return n;
+        };
+        switch (type)
+        {
+            case '+':
+                return std::string{header};
+            case '-':
+                if (top)
+                    throw reply_error(std::string{header});
+                return std::string{header};
+            case ':':
+                return static_cast<double>(length());
+            case '$':
+            {
+                const auto n = length();
+                if (n < 0)
+                    return false;
+                if (reply.size() < static_cast<std::size_t>(n) + 2)
+                    throw error("malformed command reply");
+                std::string s{reply.substr(0, static_cast<std::size_t>(n))};
+                reply.remove_prefix(static_cast<std::size_t>(n) + 2);
+                return s;
+            }
+            case '*':
+            {
+                const auto n = length();
+                if (n < 0)
+                    return false;
+                auto t = tables.make();
+                t->items.reserve(static_cast<std::size_t>(n));
+                for (long long i = 0; i < n; ++i)
+                    t->items.push_back(from_reply(reply, tables, false));
+                return t;
+            }
+            default:
+                throw error("malformed command reply");
+        }
+    }
+
+    //reply of the script, a table nested deeper than MAX_NESTING (or within itself) throws
+    static void to_reply(const value& v, std::string& reply, int depth = 0)
+    {
+        if (auto n = std::get_if<double>(&v))
+        {
+            if (!std::isfinite(*n))
+                throw error("number has no integer representation");
+            const auto integer = static_cast<long long>(*n);
+            if (integer >= std::numeric_limits<int>::min() && integer <= std::numeric_limits<int>::max())
+                reply.append(resp::integer(static_cast<int>(integer)));
+            else
+                reply.append(":").append(std::to_string(integer)).append("\r\n");
+        }
+        else if (is_string(v))
+            reply.append(resp::simple_string(as_string_view(v)));
+        else if (auto t = std::get_if<table_ptr>(&v))
+        {
+            if (depth == MAX_NESTING)
+                throw error("reply nested too deeply");
+            //like Lua to RESP in Redis, the array stops at the first nil
+            std::size_t size = 0;
+            while (size < (*t)->items.size() && !std::holds_alternative<std::monostate>((*t)->items[size]))
+                ++size;
+            reply.append(format::resp_array_size(size));
+            for (std::size_t i = 0; i < size; ++i)
+                to_reply((*t)->items[i], reply, depth + 1);
+        }
+        else if (auto b = std::get_if<bool>(&v); b && *b)
+            reply.append(":1\r\n");
+        else
+            reply.append(resp::nil());
+    }
+
+    static inline table_ptr make_table(heap& tables, const std::vector<std::string_view>& items)
+    {
+        auto t = tables.make();
+        t->items.assign(items.begin(), items.end());
+        return t;
+    }
+
+    //call(cmd) executes a command and returns its reply; deadline bounds the execution; the
+    //tables, the returned one included, are valid while tables lives
+    template<typename Call>
+    static value run(const program& prog, heap& tables, table_ptr keys, table_ptr argv, Call& call,
+                     coarse_clock::clock_type::time_point deadline)
+    {
+        constexpr std::uint32_t DEADLINE_CHECK_INTERVAL = 1024;     //instructions between clock reads
+        std::vector<value> slots(prog.locals);
+        slots[KEYS_SLOT] = std::move(keys);
+        slots[ARGV_SLOT] = std::move(argv);
+        std::vector<value> stack;
+        stack.reserve(16);
+        std::uint32_t steps = 0;
+
+        auto pop = [&]() {
+            auto v = std::move(stack.back());
+            stack.pop_back();
+            return v;
+        };
+        auto number = [](const value& v) {
+            if (auto n = std::get_if<double>(&v))
+                return *n;
+            if (is_string(v))
+                if (auto n = string_to_number(as_string_view(v)))
+                    return *n;
+            throw error(std::string{"attempt to perform arithmetic on a "} + type_name(v) + " value");
+        };
+        auto text = [](const value& v) {
+            if (auto n = std::get_if<double>(&v))
+                return number_to_string(*n);
+            if (is_string(v))
+                return std::string{as_string_view(v)};
+            throw error(std::string{"attempt to concatenate a "} + type_name(v) + " value");
+        };
+        auto index_of = [](const value& key, std::size_t size, bool append) -> std::size_t {
+            auto n = std::get_if<double>(&key);
+            if (!n || std::floor(*n) != *n || *n < 1 || *n > static_cast<double>(size + append))
+                return 0;
+            return static_cast<std::size_t>(*n);
+        };
+        auto equals = [](const value& a, const value& b) {
+            if (is_string(a) && is_string(b))
+                return as_string_view(a) == as_string_view(b);
+            if (a.index() != b.index())
+                return false;
+            if (auto n = std::get_if<double>(&a))
+                return *n == std::get<double>(b);
+            if (auto x = std::get_if<bool>(&a))
+                return *x == std::get<bool>(b);
+            if (auto t = std::get_if<table_ptr>(&a))
+                return *t == std::get<table_ptr>(b);
+            return true;
+        };
+        //-1, 0, 1
+        auto compare = [](const value& a, const value& b) {
+            if (auto x = std::get_if<double>(&a))
+                if (auto y = std::get_if<double>(&b))
+                    return *x < *y ? -1 : *x > *y ? 1 : 0;
+            if (is_string(a) && is_string(b))
+            {
+                const auto c = as_string_view(a).compare(as_string_view(b));
+                return c < 0 ? -1 : c > 0 ? 1 : 0;
+            }
+            throw error(std::string{"attempt to compare "} + type_name(a) + " with " + type_name(b));
+        };
+
+        for (std::size_t pc = 0; ; )
+        {
+            if (++steps == DEADLINE_CHECK_INTERVAL)
+            {
+                steps = 0;
+                if (coarse_clock::read() >= deadline)
+                    throw error("script exceeded its time budget");
+            }
+            const auto [op, arg] = prog.code[pc++];
+            switch (op)
+            {
+                case opcode::PUSH_CONST:
+                {
+                    //string constants are viewed in the program, which outlives the execution
+                    const auto& constant = prog.constants[arg];
+                    if (auto s = std::get_if<std::string>(&constant))
+                        stack.emplace_back(std::string_view{*s});
+                    else
+                        stack.push_back(constant);
+                    break;
+                }
+                case opcode::PUSH_NIL: stack.emplace_back(); break;
+                case opcode::PUSH_TRUE: stack.emplace_back(true); break;
+                case opcode::PUSH_FALSE: stack.emplace_back(false); break;
+                case opcode::POP: stack.pop_back(); break;
+                case opcode::LOAD: stack.push_back(slots[arg]); break;
+                case opcode::STORE: slots[arg] = pop(); break;
+                case opcode::NEW_TABLE:
+                {
+                    auto t = tables.make();
+                    t->items.assign(std::make_move_iterator(stack.end() - arg), std::make_move_iterator(stack.end()));
+                    stack.resize(stack.size() - arg);
+                    stack.emplace_back(std::move(t));
+                    break;
+                }
+                case opcode::INDEX:
+                {
+                    auto key = pop();
+                    auto container = pop();
+                    auto t = std::get_if<table_ptr>(&container);
+                    if (!t)
+                        throw error(std::string{"attempt to index a "} + type_name(container) + " value");
+                    const auto i = index_of(key, (*t)->items.size(), false);
+                    stack.push_back(i ? (*t)->items[i - 1] : value{});
+                    break;
+                }
+                case opcode::SET_INDEX:
+                {
+                    auto v = pop();
+                    auto key = pop();
+                    auto container = pop();
+                    auto t = std::get_if<table_ptr>(&container);
+                    if (!t)
+                        throw error(std::string{"attempt to index a "} + type_name(container) + " value");
+                    auto& items = (*t)->items;
+                    const auto i = index_of(key, items.size(), true);
+                    if (!i)
+                        throw error("table index out of range, tables are arrays");
+                    if (i > items.size())
+                        items.push_back(std::move(v));
+                    else
+                        items[i - 1] = std::move(v);
+                    while (!items.empty() && std::holds_alternative<std::monostate>(items.back()))
+                        items.pop_back();
+                    break;
+                }
+                case opcode::LEN:
+                {
+                    auto v = pop();
+                    if (auto t = std::get_if<table_ptr>(&v))
+                        stack.emplace_back(static_cast<double>((*t)->items.size()));
+                    else if (is_string(v))
+                        stack.emplace_back(static_cast<double>(as_string_view(v).size()));
+                    else
+                        throw error(std::string{"attempt to get length of a "} + type_name(v) + " value");
+                    break;
+                }
+                case opcode::NEG: stack.back() = -number(stack.back()); break;
+                case opcode::NOT: stack.back() = !truthy(stack.back()); break;
+                case opcode::ADD: case opcode::SUB: case opcode::MUL: case opcode::DIV: case opcode::MOD:
+                {
+                    const auto b = number(pop());
+                    const auto a = number(stack.back());
+                    double r;
+                    switch (op)
+                    {
+                        case opcode::ADD: r = a + b; break;
+                        case opcode::SUB: r = a - b; break;
+                        case opcode::MUL: r = a * b; break;
+                        case opcode::DIV: r = a / b; break;
+                        default: r = a - std::floor(a / b) * b; break;
+                    }
+                    stack.back() = r;
+                    break;
+                }
+                case opcode::CONCAT:
+                {
+                    auto b = pop();
+                    stack.back() = text(stack.back()) + text(b);
+                    break;
+                }
+                case opcode::EQ: case opcode::NE:
+                {
+                    auto b = pop();
+                    stack.back() = equals(stack.back(), b) == (op == opcode::EQ);
+                    break;
+                }
+                case opcode::LT: case opcode::LE: case opcode::GT: case opcode::GE:
+                {
+                    auto b = pop();
+                    const auto c = compare(stack.back(), b);
+                    stack.back() = op == opcode::LT ? c < 0 : op == opcode::LE ? c <= 0 : op == opcode::GT ? c > 0 : c >= 0;
+                    break;
+                }
+                case opcode::JUMP: pc = arg; break;
+                case opcode::JUMP_IF_FALSE: if (!truthy(pop())) pc = arg; break;
+                case opcode::JUMP_IF_FALSE_OR_POP: if (!truthy(stack.back())) pc = arg; else stack.pop_back(); break;
+                case opcode::JUMP_IF_TRUE_OR_POP: if (truthy(stack.back())) pc = arg; else stack.pop_back(); break;
+                case opcode::FOR_CHECK:
+                {
+                    const auto i = number(slots[arg]), limit = number(slots[arg + 1]), step = number(slots[arg + 2]);
+                    if (step == 0)
+                        throw error("'for' step is zero");
+                    stack.emplace_back(step > 0 ? i <= limit : i >= limit);
+                    break;
+                }
+                case opcode::FOR_STEP: slots[arg] = number(slots[arg]) + number(slots[arg + 2]); break;
+                case opcode::CALL:
+                {
+                    //numbers are the only arguments formatted, strings are passed as views
+                    const auto first = stack.size() - arg;
+                    std::vector<std::string> formatted;     //never reallocated, args view its strings
+                    formatted.reserve(std::count_if(stack.begin() + first, stack.end(),
+                                                    [](const value& v) { return std::holds_alternative<double>(v); }));
+                    std::vector<std::string_view> args;
+                    args.reserve(arg);
+                    for (auto i = first; i < stack.size(); ++i)
+                    {
+                        if (is_string(stack[i]))
+                            args.push_back(as_string_view(stack[i]));
+                        else if (auto n = std::get_if<double>(&stack[i]))
+                            args.push_back(formatted.emplace_back(number_to_string(*n)));
+                        else
+                            throw error("redis.call arguments must be strings or numbers");
+                    }
+                    resp::command cmd(std::move(args));
+                    std::string reply = call(cmd);
+                    stack.resize(first);
+                    std::string_view rest{reply};
+                    stack.push_back(from_reply(rest, tables));
+                    break;
+                }
+                case opcode::TONUMBER:
+                {
+                    auto& v = stack.back();
+                    if (is_string(v))
+                    {
+                        auto n = string_to_number(as_string_view(v));
+                        v = n ? value{*n} : value{};
+                    }
+                    else if (!std::holds_alternative<double>(v))
+                        v = value{};
+                    break;
+                }
+                case opcode::TOSTRING:
+                {
+                    auto& v = stack.back();
+                    if (std::holds_alternative<std::monostate>(v))
+                        v = std::string{"nil"};
+                    else if (auto b = std::get_if<bool>(&v))
+                        v = std::string{*b ? "true" : "false"};
+                    else if (std::holds_alternative<table_ptr>(v))
+                        v = std::string{"table"};
+                    else
+                        v = text(v);
+                    break;
+                }
+                case opcode::TYPE: stack.back() = std::string{type_name(stack.back())}; break;
+                case opcode::RETURN: return pop();
+            }
+        }
+    }
+}
+
+#endif /* SCRIPT_VM_HPP */
\ No newline at end of file
@@ -0,0 +1,188 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef SCRIPTING_HPP
+#define SCRIPTING_HPP
+
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "coarse_clock.hpp"
+#include "format.hpp"
+#include "resp.hpp"
+#include "resp_command.hpp"
+#include "script_vm.hpp"
+#include "sha1.hpp"
+#include "utils.hpp"
+
+//EVAL script numkeys [key ...] [arg ...], EVALSHA sha1 numkeys [key ...] [arg ...] and SCRIPT
+//LOAD|EXISTS|FLUSH. A script is compiled once (script_vm.hpp) and kept under the SHA1 of its text,
+//so EVALSHA and later EVALs of the same text go straight to the bytecode. Its redis.call commands
+//execute like the client's own, one after the other within the same event loop turn, and a
+//check that took a round trip per command (GET the role, SISMEMBER the permission) becomes one
+//EVALSHA. A script running past --script-time-limit is aborted; the commands it already executed
+//stay executed.
+
+namespace scripting
+{
+    constexpr std::chrono::milliseconds DEFAULT_TIME_LIMIT{5000};
+
+    class script_cache final
+    {
+        std::unordered_map<std::string, std::shared_ptr<const script::program>> scripts;
+
+    public:
+        std::chrono::milliseconds time_limit = DEFAULT_TIME_LIMIT;
+
+        //compiles source unless it is cached, throws script::error
+        std::pair<std::string, std::shared_ptr<const script::program>> load(std::string_view source)
+        {
+            auto sha = sha1::hex(source);
+            auto it = scripts.find(sha);
+            if (it == scripts.end())
+                it = scripts.emplace(sha, std::make_shared<const script::program>(script::compile(source))).first;
+            return { std::move(sha), it->second };
+        }
+
+        std::shared_ptr<const script::program> find(const std::string& sha) const
+        {
+            auto it = scripts.find(sha);
+            return it != scripts.end() ? it->second : nullptr;
+        }
+
+        bool contains(const std::string& sha) const { return scripts.contains(sha); }
+
+        std::size_t size() const { return scripts.size(); }
+
+        void flush() { scripts.clear(); }
+    };
+
+    static script_cache g_scripts;
+
+    //commands a script can't call
+    static inline bool is_allowed_in_script(const std::string& cmd_name)
+    {
+        return cmd_name != "EVAL" && cmd_name != "EVALSHA" && cmd_name != "SCRIPT" &&
+               cmd_name != "MULTI" && cmd_name != "EXEC" && cmd_name != "DISCARD" &&
+               cmd_name != "WATCH" && cmd_name != "UNWATCH";
+    }
+
+    static inline std::string to_lower_sha(std::string_view sv)
+    {
+        std::string s{sv};
+        for (auto& c : s)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    //EVAL and EVALSHA, execute(cmd) executes a command called by the script and returns its reply
+    template<typename Execute>
+    static std::string eval(const resp::command& cmd, Execute execute)
+    {
+        if (cmd.size() < 3)
+            return resp::error_wrong_number_of_arguments_for_command();
+        const auto& args = cmd.arguments();
+        std::size_t numkeys{};
+        auto [ptr, ec] = std::from_chars(args[2].data(), args[2].data() + args[2].size(), numkeys);
+        if (ec != std::errc{} || ptr != args[2].data() + args[2].size())
+            return resp::error_value_is_not_an_integer_or_out_of_range();
+        if (numkeys > cmd.size() - 3)
+            return resp::error("Number of keys can't be greater than number of args");
+
+        std::shared_ptr<const script::program> prog;
+        if (cmd.name() == "EVALSHA")
+        {
+            if (!(prog = g_scripts.find(to_lower_sha(args[1]))))
+                return resp::error_noscript();
+        }
+        else
+        {
+            try
+            {
+                prog = g_scripts.load(args[1]).second;
+            }
+            catch (const script::error& e)
+            {
+                return resp::error(std::string{"Error compiling script: "} + e.what());
+            }
+        }
+
+        //KEYS and ARGV view the arguments of this command
+        script::heap tables;
+        const auto keys_end = args.begin() + 3 + static_cast<std::ptrdiff_t>(numkeys);
+        auto keys = script::make_table(tables, std::vector<std::string_view>(args.begin() + 3, keys_end));
+        auto argv = script::make_table(tables, std::vector<std::string_view>(keys_end, args.end()));
+        auto call = [&](resp::command& called) {
+            if (!is_allowed_in_script(called.name()))
+                throw script::error("This command is not allowed from scripts: " + called.name());
+            return execute(called);
+        };
+        try
+        {
+            const auto deadline = coarse_clock::read() + g_scripts.time_limit;
+            auto result = script::run(*prog, tables, std::move(keys), std::move(argv), call, deadline);
+            std::string reply;
+            script::to_reply(result, reply);
+            return reply;
+        }
+        catch (const script::reply_error& e)
+        {
+            return "-" + std::string{e.what()} + "\r\n";
+        }
+        catch (const script::error& e)
+        {
+            return resp::error(std::string{"Error running script: "} + e.what());
+        }
+    }
+
+    //SCRIPT LOAD script | EXISTS sha1 [sha1 ...] | FLUSH
+    static inline std::string script_command(const resp::command& cmd)
+    {
+        if (cmd.size() < 2)
+            return resp::error_wrong_number_of_arguments_for_command();
+
+        const auto subcmd = to_upper(cmd[1]);
+        if (subcmd == "LOAD")
+        {
+            if (cmd.size() != 3)
+                return resp::error_wrong_number_of_arguments_for_command();
+            try
+            {
+                return resp::simple_string(g_scripts.load(cmd.arguments()[2]).first);
+            }
+            catch (const script::error& e)
+            {
+                return resp::error(std::string{"Error compiling script: "} + e.what());
+            }
+        }
+        if (subcmd == "EXISTS")
+        {
+            if (cmd.size() < 3)
+                return resp::error_wrong_number_of_arguments_for_command();
+            std::string reply = format::resp_array_size(cmd.size() - 2);
+            for (std::size_t i = 2; i < cmd.size(); ++i)
+                reply.append(resp::integer(g_scripts.contains(to_lower_sha(cmd.arguments()[i])) ? 1 : 0));
+            return reply;
+        }
+        if (subcmd == "FLUSH")
+        {
+            if (cmd.size() > 3)
+                return resp::error_wrong_number_of_arguments_for_command();
+            g_scripts.flush();
+            return resp::ok();
+        }
+        return resp::error_unknown_subcommand(cmd[1]);
+    }
+}
+
+#endif /* SCRIPTING_HPP */
\ No newline at end of file
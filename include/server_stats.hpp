@@ -0,0 +1,249 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef SERVER_STATS_HPP
+#define SERVER_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "command_stats.hpp"
+#include "database_defs.hpp"
+#include "resp_command.hpp"
+#include "used_memory.hpp"
+#include "utils.hpp"
+
+//Server wide counters behind INFO server/clients/memory/stats/keyspace. They are plain integers
+//bumped by the event loop thread; producing INFO walks the 8 databases and the connected clients
+//once and does no other work, so it can be scraped every second.
+
+namespace server_stats
+{
+    constexpr const char* VERSION = "0.1";
+
+    using clock_type = std::chrono::steady_clock;
+
+    //per second rate of a monotonic counter, from snapshots taken at least SAMPLE_PERIOD apart and
+    //measured over the last WINDOW (or since the oldest snapshot while there's less history)
+    class instantaneous_metric final
+    {
+        static constexpr std::size_t SAMPLES = 16;
+        static constexpr std::chrono::milliseconds SAMPLE_PERIOD{100};
+        static constexpr std::chrono::milliseconds WINDOW = SAMPLE_PERIOD * SAMPLES;
+
+        std::array<std::pair<clock_type::time_point, std::uint64_t>, SAMPLES> samples{};
+        std::size_t next = 0;           //slot of the next snapshot
+        std::size_t count = 0;          //valid snapshots
+
+    public:
+        void track(clock_type::time_point now, std::uint64_t value) noexcept
+        {
+            if (count && now - samples[(next + SAMPLES - 1) % SAMPLES].first < SAMPLE_PERIOD)
+                return;
+            samples[next] = {now, value};
+            next = (next + 1) % SAMPLES;
+            count = std::min(count + 1, SAMPLES);
+        }
+
+        double rate(clock_type::time_point now, std::uint64_t value) const noexcept
+        {
+            if (!count)
+                return 0;
+            const std::pair<clock_type::time_point, std::uint64_t>* from = nullptr;
+            for (std::size_t i = 1; i <= count; ++i)
+            {
+                from = &samples[(next + SAMPLES - i) % SAMPLES];
+                if (now - from->first >= WINDOW)
+                    break;
+            }
+            const std::chrono::duration<double> elapsed = now - from->first;
+            return elapsed.count() > 0 ? static_cast<double>(value - from->second) / elapsed.count() : 0;
+        }
+    };
+
+    struct server_stats_t final
+    {
+        clock_type::time_point start_time = clock_type::now();
+        int tcp_port = 0;
+        std::uint64_t total_connections_received = 0;
+        std::uint64_t total_commands_processed = 0;
+        std::uint64_t total_net_input_bytes = 0;
+        std::uint64_t total_net_output_bytes = 0;
+        std::uint64_t keyspace_hits = 0;
+        std::uint64_t keyspace_misses = 0;
+        std::uint64_t total_io_syscalls = 0;   //made by the native front ends (epoll, io_uring)
+        std::uint64_t client_output_buffer_limit_disconnections = 0;
+        std::size_t used_memory_peak = 0;
+        instantaneous_metric ops_per_sec, net_input_per_sec, net_output_per_sec;
+
+        //called from the event loop and before INFO, cheap when nothing is due
+        void track(clock_type::time_point now) noexcept
+        {
+            ops_per_sec.track(now, total_commands_processed);
+            net_input_per_sec.track(now, total_net_input_bytes);
+            net_output_per_sec.track(now, total_net_output_bytes);
+            used_memory_peak = std::max(used_memory_peak, used_memory::bytes());
+        }
+    };
+
+    static server_stats_t g_stats;
+
+    //lookup_type_of for commands reading the key, counted as a keyspace hit or miss
+    template<typename Database>
+    static inline DbValueTypeEnum lookup_type_for_read(const Database& db, const std::string& key)
+    {
+        const auto type = db.lookup_type_of(key);
+        ++(type == DbValueTypeEnum::NONE ? g_stats.keyspace_misses : g_stats.keyspace_hits);
+        return type;
+    }
+
+    static inline std::string bytes_to_human(std::size_t bytes)
+    {
+        constexpr const char* UNITS = "KMGT";
+        std::ostringstream oss;
+        if (bytes < 1024)
+        {
+            oss << bytes << 'B';
+            return oss.str();
+        }
+        double value = static_cast<double>(bytes) / 1024;
+        std::size_t unit = 0;
+        for (; value >= 1024 && unit < 3; ++unit)
+            value /= 1024;
+        oss << std::fixed << std::setprecision(2) << value << UNITS[unit];
+        return oss.str();
+    }
+
+    static inline std::string info_server(std::string_view backend, clock_type::time_point now)
+    {
+        const auto uptime = std::chrono::duration_cast<std::chrono::seconds>(now - g_stats.start_time).count();
+        std::ostringstream oss;
+        oss << "# Server\r\n"
+            << "kv_store_version:" << VERSION << "\r\n"
+            << "kv_store_backend:" << backend << "\r\n"
+            << "tcp_port:" << g_stats.tcp_port << "\r\n"
+            << "uptime_in_seconds:" << uptime << "\r\n"
+            << "uptime_in_days:" << uptime / 86400 << "\r\n";
+        return oss.str();
+    }
+
+    //Clients maps ids to clients with QueryBuffer and OutputBytes
+    template<typename Clients>
+    static std::string info_clients(const Clients& clients)
+    {
+        std::size_t max_input_buffer = 0, max_output_buffer = 0;
+        for (const auto& kv : clients)
+        {
+            max_input_buffer = std::max(max_input_buffer, kv.second.QueryBuffer.size());
+            max_output_buffer = std::max(max_output_buffer, kv.second.OutputBytes);
+        }
+        std::ostringstream oss;
+        oss << "# Clients\r\n"
+            << "connected_clients:" << clients.size() << "\r\n"
+            << "client_recent_max_input_buffer:" << max_input_buffer << "\r\n"
+            << "client_recent_max_output_buffer:" << max_output_buffer << "\r\n";
+        return oss.str();
+    }
+
+    static inline std::string info_memory()
+    {
+        const auto used = used_memory::bytes();
+        std::ostringstream oss;
+        oss << "# Memory\r\n"
+            << "used_memory:" << used << "\r\n"
+            << "used_memory_human:" << bytes_to_human(used) << "\r\n"
+            << "used_memory_peak:" << g_stats.used_memory_peak << "\r\n"
+            << "used_memory_peak_human:" << bytes_to_human(g_stats.used_memory_peak) << "\r\n"
+            << "mem_allocator:libc\r\n";
+        return oss.str();
+    }
+
+    static inline std::string info_stats(clock_type::time_point now)
+    {
+        const auto lookups = g_stats.keyspace_hits + g_stats.keyspace_misses;
+        std::ostringstream oss;
+        oss << "# Stats\r\n"
+            << "total_connections_received:" << g_stats.total_connections_received << "\r\n"
+            << "total_commands_processed:" << g_stats.total_commands_processed << "\r\n"
+            << "instantaneous_ops_per_sec:" << static_cast<std::uint64_t>(g_stats.ops_per_sec.rate(now, g_stats.total_commands_processed)) << "\r\n"
+            << "total_net_input_bytes:" << g_stats.total_net_input_bytes << "\r\n"
+            << "total_net_output_bytes:" << g_stats.total_net_output_bytes << "\r\n"
+            << std::fixed << std::setprecision(2)
+            << "instantaneous_input_kbps:" << g_stats.net_input_per_sec.rate(now, g_stats.total_net_input_bytes) / 1024 << "\r\n"
+            << "instantaneous_output_kbps:" << g_stats.net_output_per_sec.rate(now, g_stats.total_net_output_bytes) / 1024 << "\r\n"
+            << "keyspace_hits:" << g_stats.keyspace_hits << "\r\n"
+            << "keyspace_misses:" << g_stats.keyspace_misses << "\r\n"
+            << "keyspace_hit_ratio:" << (lookups ? static_cast<double>(g_stats.keyspace_hits) / lookups : 0.0) << "\r\n"
+            << "client_output_buffer_limit_disconnections:" << g_stats.client_output_buffer_limit_disconnections << "\r\n"
+            << "total_io_syscalls:" << g_stats.total_io_syscalls << "\r\n"
+            << "io_syscalls_per_command:" << (g_stats.total_commands_processed ? static_cast<double>(g_stats.total_io_syscalls) / g_stats.total_commands_processed : 0.0) << "\r\n";
+        return oss.str();
+    }
+
+    //keys never expire in this store, expires and avg_ttl are kept for Redis tooling
+    template<typename Databases>
+    static std::string info_keyspace(const Databases& databases)
+    {
+        std::ostringstream oss;
+        oss << "# Keyspace\r\n";
+        for (std::size_t i = 0; i < databases.size(); ++i)
+            if (const auto keys = databases[i].size())
+                oss << "db" << i << ":keys=" << keys << ",expires=0,avg_ttl=0\r\n";
+        return oss.str();
+    }
+
+    //INFO [section ...]: no section or "default" is server, clients, memory, stats and keyspace;
+    //"all" and "everything" add commandstats and latencystats; unknown sections are skipped
+    template<typename Databases, typename Clients>
+    static std::string info(const resp::command& cmd, const Databases& databases, const Clients& clients, std::string_view backend)
+    {
+        enum : unsigned
+        {
+            SERVER = 1, CLIENTS = 2, MEMORY = 4, STATS = 8, KEYSPACE = 16, COMMANDSTATS = 32, LATENCYSTATS = 64,
+            DEFAULT = SERVER | CLIENTS | MEMORY | STATS | KEYSPACE, ALL = DEFAULT | COMMANDSTATS | LATENCYSTATS
+        };
+        unsigned sections = cmd.size() == 1 ? static_cast<unsigned>(DEFAULT) : 0u;
+        for (std::size_t i = 1; i < cmd.size(); ++i)
+        {
+            const auto section = to_upper(cmd[i]);
+            if (section == "ALL" || section == "EVERYTHING") sections |= ALL;
+            else if (section == "DEFAULT") sections |= DEFAULT;
+            else if (section == "SERVER") sections |= SERVER;
+            else if (section == "CLIENTS") sections |= CLIENTS;
+            else if (section == "MEMORY") sections |= MEMORY;
+            else if (section == "STATS") sections |= STATS;
+            else if (section == "KEYSPACE") sections |= KEYSPACE;
+            else if (section == "COMMANDSTATS") sections |= COMMANDSTATS;
+            else if (section == "LATENCYSTATS") sections |= LATENCYSTATS;
+        }
+
+        const auto now = clock_type::now();
+        g_stats.track(now);
+        std::string text;
+        auto append = [&text](const std::string& section) {
+            if (!text.empty())
+                text += "\r\n";
+            text += section;
+        };
+        if (sections & SERVER) append(info_server(backend, now));
+        if (sections & CLIENTS) append(info_clients(clients));
+        if (sections & MEMORY) append(info_memory());
+        if (sections & STATS) append(info_stats(now));
+        if (sections & KEYSPACE) append(info_keyspace(databases));
+        if (sections & COMMANDSTATS) append(command_stats::info_commandstats());
+        if (sections & LATENCYSTATS) append(command_stats::info_latencystats());
+        return text;
+    }
+}
+
+#endif /* SERVER_STATS_HPP */
\ No newline at end of file
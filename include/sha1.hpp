@@ -0,0 +1,91 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef SHA1_HPP
+#define SHA1_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//SHA-1 (FIPS 180-4), names the cached scripts like Redis EVALSHA does; not used for security
+struct sha1 final
+{
+    static std::array<std::uint8_t, 20> digest(std::string_view data) noexcept
+    {
+        std::uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+        std::uint8_t block[64];
+        std::size_t offset = 0;
+        for (; data.size() - offset >= 64; offset += 64)
+        {
+            for (std::size_t i = 0; i < 64; ++i)
+                block[i] = static_cast<std::uint8_t>(data[offset + i]);
+            compress(h, block);
+        }
+        //the rest, 0x80, zeros and the length in bits fill one or two blocks
+        std::uint8_t tail[128]{};
+        const std::size_t rest = data.size() - offset;
+        for (std::size_t i = 0; i < rest; ++i)
+            tail[i] = static_cast<std::uint8_t>(data[offset + i]);
+        tail[rest] = 0x80;
+        const std::size_t tail_size = rest < 56 ? 64 : 128;
+        const std::uint64_t bit_length = static_cast<std::uint64_t>(data.size()) * 8;
+        for (int i = 0; i < 8; ++i)
+            tail[tail_size - 1 - i] = static_cast<std::uint8_t>(bit_length >> (8 * i));
+        for (std::size_t start = 0; start < tail_size; start += 64)
+        {
+            for (std::size_t i = 0; i < 64; ++i)
+                block[i] = tail[start + i];
+            compress(h, block);
+        }
+        std::array<std::uint8_t, 20> out{};
+        for (int i = 0; i < 20; ++i)
+            out[i] = static_cast<std::uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+        return out;
+    }
+
+    //40 lowercase hexadecimal digits
+    static std::string hex(std::string_view data)
+    {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string s;
+        s.reserve(40);
+        for (auto byte : digest(data))
+        {
+            s.push_back(digits[byte >> 4]);
+            s.push_back(digits[byte & 0x0F]);
+        }
+        return s;
+    }
+
+private:
+    static constexpr std::uint32_t rotl(std::uint32_t x, int n) noexcept { return (x << n) | (x >> (32 - n)); }
+
+    static void compress(std::uint32_t (&h)[5], const std::uint8_t (&block)[64]) noexcept
+    {
+        std::uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+            w[i] = std::uint32_t{block[4 * i]} << 24 | std::uint32_t{block[4 * i + 1]} << 16 |
+                   std::uint32_t{block[4 * i + 2]} << 8 | std::uint32_t{block[4 * i + 3]};
+        for (int i = 16; i < 80; ++i)
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            std::uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            const auto t = rotl(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rotl(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+};
+
+#endif /* SHA1_HPP */
\ No newline at end of file
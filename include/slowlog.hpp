@@ -0,0 +1,124 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef SLOWLOG_HPP
+#define SLOWLOG_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "format.hpp"
+#include "resp.hpp"
+#include "resp_command.hpp"
+
+//Commands that took at least log_slower_than_us, kept in a fixed-capacity ring (newest entries
+//overwrite the oldest) and read back with SLOWLOG GET/LEN/RESET. Faster commands cost a single
+//comparison and never allocate.
+
+namespace slowlog
+{
+    constexpr std::int64_t DEFAULT_LOG_SLOWER_THAN_US = 10000;
+    constexpr std::size_t DEFAULT_MAX_LEN = 128;
+    constexpr std::size_t MAX_ARGC = 32;          //arguments kept per entry, the last one notes the rest
+    constexpr std::size_t MAX_ARG_LENGTH = 128;   //bytes kept per argument
+
+    struct entry final
+    {
+        std::uint64_t id;
+        std::int64_t timestamp;         //unix seconds
+        std::uint64_t duration_us;
+        std::vector<std::string> args;
+        std::string client_id;
+        std::string client_name;
+        std::string lib_name;
+    };
+
+    class slow_log final
+    {
+        std::vector<entry> ring;
+        std::size_t next = 0;           //slot of the next entry
+        std::size_t count = 0;          //valid entries
+        std::uint64_t next_id = 0;
+
+    public:
+        std::int64_t log_slower_than_us = DEFAULT_LOG_SLOWER_THAN_US;   //negative disables
+
+        explicit slow_log(std::size_t max_len = DEFAULT_MAX_LEN) : ring(max_len) {}
+
+        void resize(std::size_t max_len)
+        {
+            ring.assign(max_len, entry{});
+            next = count = 0;
+        }
+
+        std::size_t max_len() const noexcept { return ring.size(); }
+        std::size_t size() const noexcept { return count; }
+
+        void record(const resp::command& cmd, std::uint64_t duration_us,
+                    const std::string& client_id, const std::string& client_name, const std::string& lib_name)
+        {
+            if (log_slower_than_us < 0 || duration_us < static_cast<std::uint64_t>(log_slower_than_us) || ring.empty())
+                return;
+
+            auto& e = ring[next];
+            e.id = next_id++;
+            e.timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            e.duration_us = duration_us;
+            const auto& arguments = cmd.arguments();
+            const std::size_t kept = arguments.size() > MAX_ARGC ? MAX_ARGC - 1 : arguments.size();
+            e.args.clear();
+            for (std::size_t i = 0; i < kept; ++i)
+            {
+                std::string_view arg = arguments[i];
+                if (arg.size() > MAX_ARG_LENGTH)
+                    e.args.push_back(std::string(arg.substr(0, MAX_ARG_LENGTH)) + "... (" + std::to_string(arg.size() - MAX_ARG_LENGTH) + " more bytes)");
+                else
+                    e.args.emplace_back(arg);
+            }
+            if (kept < arguments.size())
+                e.args.push_back("... (" + std::to_string(arguments.size() - kept) + " more arguments)");
+            e.client_id = client_id;
+            e.client_name = client_name;
+            e.lib_name = lib_name;
+
+            next = (next + 1) % ring.size();
+            count = std::min(count + 1, ring.size());
+        }
+
+        void reset() noexcept
+        {
+            next = count = 0;
+        }
+
+        //newest first: [id, timestamp, duration, [args], client id, client name, lib name]
+        std::string get(std::size_t max_entries) const
+        {
+            const std::size_t n = std::min(max_entries, count);
+            std::string reply = format::resp_array_size(n);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                const auto& e = ring[(next + ring.size() - 1 - i) % ring.size()];
+                reply += format::resp_array_size(7);
+                reply += ":" + std::to_string(e.id) + "\r\n";
+                reply += ":" + std::to_string(e.timestamp) + "\r\n";
+                reply += ":" + std::to_string(e.duration_us) + "\r\n";
+                reply += resp::array(e.args.begin(), e.args.end());
+                reply += resp::simple_string(e.client_id);
+                reply += resp::simple_string(e.client_name);
+                reply += resp::simple_string(e.lib_name);
+            }
+            return reply;
+        }
+    };
+
+    static slow_log g_slowlog;
+}
+
+#endif /* SLOWLOG_HPP */
\ No newline at end of file
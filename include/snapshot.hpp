@@ -0,0 +1,663 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "crc64.hpp"
+#include "mapped_snapshot.hpp"
+
+//KV Store snapshot (point-in-time binary dump of all databases)
+/*
+
+snapshot  = magic version (selectdb resizedb entry*)* eof crc64 ;
+magic     = "KVSNAP" ;
+version   = u8 ;
+selectdb  = 0xFE varint(db index) ;
+resizedb  = 0xFB varint(key count) ;
+entry     = type str(key) value ;
+eof       = 0xFF ;
+crc64     = u64 (little endian, CRC-64/Jones of every preceding byte) ;
+
+str       = varint(length << 1) bytes         //raw string
+          | varint(1) zigzag-varint(integer)  //canonical decimal integer ;
+
+type  value
+0x00  str                                     //string
+0x01  varint(count) str*                      //set
+0x02  varint(count) zigzag-varint*            //set of integers only (intset)
+0x03  varint(count) (str f64)*                //sorted set
+0x04  varint(count) (str zigzag-varint)*      //sorted set with integral scores only
+
+*/
+
+namespace snapshot
+{
+    constexpr char MAGIC[] = { 'K', 'V', 'S', 'N', 'A', 'P' };
+    constexpr std::uint8_t VERSION = 1;
+
+    constexpr std::uint8_t OP_SELECTDB = 0xFE;
+    constexpr std::uint8_t OP_RESIZEDB = 0xFB;
+    constexpr std::uint8_t OP_EOF = 0xFF;
+
+    constexpr std::uint8_t TYPE_STRING = 0x00;
+    constexpr std::uint8_t TYPE_SET = 0x01;
+    constexpr std::uint8_t TYPE_SET_INTSET = 0x02;
+    constexpr std::uint8_t TYPE_ZSET = 0x03;
+    constexpr std::uint8_t TYPE_ZSET_INTSCORES = 0x04;
+
+    static inline std::uint64_t zigzag_encode(std::int64_t value) noexcept
+    {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    static inline std::int64_t zigzag_decode(std::uint64_t value) noexcept
+    {
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
+
+    //only canonical representations qualify, so decoding gives back the same bytes
+    static inline bool try_parse_integer(std::string_view sv, std::int64_t& value) noexcept
+    {
+        if (sv.empty() || sv.size() > 20)
+            return false;
+        std::size_t i = 0;
+        bool negative = sv[0] == '-';
+        if (negative) ++i;
+        if (i == sv.size() || (sv[i] == '0' && sv.size() > i + 1) || (negative && sv[i] == '0'))
+            return false;
+        std::uint64_t acc = 0;
+        for (; i < sv.size(); ++i)
+        {
+            if (sv[i] < '0' || sv[i] > '9')
+                return false;
+            std::uint64_t digit = sv[i] - '0';
+            if (acc > (UINT64_MAX - digit) / 10)
+                return false;
+            acc = acc * 10 + digit;
+        }
+        if (negative)
+        {
+            if (acc > static_cast<std::uint64_t>(INT64_MAX) + 1)
+                return false;
+            value = static_cast<std::int64_t>(0 - acc);
+        }
+        else
+        {
+            if (acc > static_cast<std::uint64_t>(INT64_MAX))
+                return false;
+            value = static_cast<std::int64_t>(acc);
+        }
+        return true;
+    }
+
+    static inline bool is_integral_score(double score) noexcept
+    {
+        constexpr double LIMIT = 9007199254740992.0; //2^53
+        return std::isfinite(score) && score == std::trunc(score) && std::fabs(score) <= LIMIT
+            && !(score == 0.0 && std::signbit(score));
+    }
+
+    //buffered output with running checksum, any sink with append(const char*, size)
+    template<typename Sink>
+    class writer final
+    {
+        Sink& sink;
+        std::uint64_t crc = 0;
+        std::vector<char> buffer;
+    public:
+        explicit writer(Sink& sink, std::size_t buffer_size = 1 << 16)
+            : sink{sink} { buffer.reserve(buffer_size); }
+        writer(const writer&) = delete;
+        writer& operator=(const writer&) = delete;
+
+        void bytes(const void* data, std::size_t size)
+        {
+            crc = crc64::update(crc, data, size);
+            const char* p = static_cast<const char*>(data);
+            if (buffer.size() + size > buffer.capacity())
+            {
+                flush();
+                if (size >= buffer.capacity())
+                {
+                    sink.append(p, size);
+                    return;
+                }
+            }
+            buffer.insert(buffer.end(), p, p + size);
+        }
+
+        void u8(std::uint8_t value) { bytes(&value, 1); }
+
+        void varint(std::uint64_t value)
+        {
+            unsigned char tmp[10];
+            std::size_t n = 0;
+            while (value >= 0x80)
+            {
+                tmp[n++] = static_cast<unsigned char>(value | 0x80);
+                value >>= 7;
+            }
+            tmp[n++] = static_cast<unsigned char>(value);
+            bytes(tmp, n);
+        }
+
+        void f64(double value)
+        {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            fixed64(bits);
+        }
+
+        void fixed64(std::uint64_t value)
+        {
+            unsigned char tmp[8];
+            for (int i = 0; i < 8; ++i)
+                tmp[i] = static_cast<unsigned char>(value >> (8 * i));
+            bytes(tmp, 8);
+        }
+
+        void str(std::string_view sv)
+        {
+            std::int64_t value;
+            if (try_parse_integer(sv, value))
+            {
+                varint(1);
+                varint(zigzag_encode(value));
+                return;
+            }
+            varint(static_cast<std::uint64_t>(sv.size()) << 1);
+            bytes(sv.data(), sv.size());
+        }
+
+        //the checksum covers every byte written before it
+        void finish()
+        {
+            std::uint64_t checksum = crc;
+            fixed64(checksum);
+            flush();
+        }
+
+        void flush()
+        {
+            if (!buffer.empty())
+            {
+                sink.append(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+    };
+
+    struct file_sink final
+    {
+        std::FILE* file;
+        void append(const char* data, std::size_t size)
+        {
+            if (std::fwrite(data, 1, size, file) != size)
+                throw std::runtime_error("snapshot write failed");
+        }
+    };
+
+    struct string_sink final
+    {
+        std::string& out;
+        void append(const char* data, std::size_t size) { out.append(data, size); }
+    };
+
+    //streaming input with running checksum, any source with read(char*, size) -> size
+    template<typename Source>
+    class reader final
+    {
+        Source& source;
+        std::uint64_t crc = 0;
+        std::vector<char> buffer;
+        std::size_t pos = 0, end = 0;
+
+        void fill()
+        {
+            crc = crc64::update(crc, buffer.data(), pos);
+            std::size_t remaining = end - pos;
+            std::memmove(buffer.data(), buffer.data() + pos, remaining);
+            pos = 0;
+            end = remaining + source.read(buffer.data() + remaining, buffer.size() - remaining);
+        }
+
+    public:
+        explicit reader(Source& source, std::size_t buffer_size = 1 << 20)
+            : source{source}, buffer(buffer_size) {}
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+
+        void bytes(char* out, std::size_t size)
+        {
+            while (size)
+            {
+                if (pos == end)
+                {
+                    fill();
+                    if (pos == end)
+                        throw std::runtime_error("unexpected end of snapshot");
+                }
+                std::size_t n = std::min(size, end - pos);
+                std::memcpy(out, buffer.data() + pos, n);
+                pos += n; out += n; size -= n;
+            }
+        }
+
+        std::uint8_t u8()
+        {
+            char c;
+            bytes(&c, 1);
+            return static_cast<std::uint8_t>(c);
+        }
+
+        std::uint64_t varint()
+        {
+            std::uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                std::uint8_t b = u8();
+                value |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    return value;
+            }
+            throw std::runtime_error("malformed varint in snapshot");
+        }
+
+        std::uint64_t fixed64()
+        {
+            unsigned char tmp[8];
+            bytes(reinterpret_cast<char*>(tmp), 8);
+            std::uint64_t value = 0;
+            for (int i = 0; i < 8; ++i)
+                value |= static_cast<std::uint64_t>(tmp[i]) << (8 * i);
+            return value;
+        }
+
+        double f64()
+        {
+            std::uint64_t bits = fixed64();
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        std::string str()
+        {
+            std::uint64_t header = varint();
+            if (header == 1)
+                return std::to_string(zigzag_decode(varint()));
+            if (header & 1)
+                throw std::runtime_error("malformed string in snapshot");
+            std::string s(header >> 1, '\0');
+            bytes(s.data(), s.size());
+            return s;
+        }
+
+        //checksum of every byte consumed so far
+        std::uint64_t checksum() const noexcept
+        {
+            return crc64::update(crc, buffer.data(), pos);
+        }
+    };
+
+    struct file_source final
+    {
+        std::FILE* file;
+        std::size_t read(char* out, std::size_t size) { return std::fread(out, 1, size, file); }
+    };
+
+    struct memory_source final
+    {
+        std::string_view data;
+        std::size_t read(char* out, std::size_t size)
+        {
+            std::size_t n = std::min(size, data.size());
+            std::memcpy(out, data.data(), n);
+            data.remove_prefix(n);
+            return n;
+        }
+    };
+
+    template<typename Writer, typename Databases>
+    static void write_databases(Writer& w, const Databases& databases)
+    {
+        w.bytes(MAGIC, sizeof(MAGIC));
+        w.u8(VERSION);
+        for (std::size_t db_num = 0; db_num < databases.size(); ++db_num)
+        {
+            const auto& db = databases[db_num];
+            using db_type = std::decay_t<decltype(db)>;
+            if (db.size() == 0)
+                continue;
+            w.u8(OP_SELECTDB);
+            w.varint(db_num);
+            w.u8(OP_RESIZEDB);
+            w.varint(db.size());
+            db.for_each([&w](std::string_view key, const auto& value) {
+                using value_type = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<value_type, typename db_type::string_type>)
+                {
+                    w.u8(TYPE_STRING);
+                    w.str(key);
+                    w.str(std::string_view{value.data(), value.size()});
+                }
+                else if constexpr (std::is_same_v<value_type, typename db_type::set_type>)
+                {
+                    bool intset = true;
+                    std::int64_t ignored;
+                    for (const auto& member : value)
+                        if (!try_parse_integer(member, ignored)) { intset = false; break; }
+                    w.u8(intset ? TYPE_SET_INTSET : TYPE_SET);
+                    w.str(key);
+                    w.varint(value.size());
+                    for (const auto& member : value)
+                    {
+                        if (intset)
+                        {
+                            std::int64_t n;
+                            try_parse_integer(member, n);
+                            w.varint(zigzag_encode(n));
+                        }
+                        else
+                            w.str(member);
+                    }
+                }
+                else
+                {
+                    bool intscores = true;
+                    for (const auto& [member, score] : value.Members)
+                        if (!is_integral_score(score)) { intscores = false; break; }
+                    w.u8(intscores ? TYPE_ZSET_INTSCORES : TYPE_ZSET);
+                    w.str(key);
+                    w.varint(value.Members.size());
+                    for (const auto& [member, score] : value.Members)
+                    {
+                        w.str(member);
+                        if (intscores)
+                            w.varint(zigzag_encode(static_cast<std::int64_t>(score)));
+                        else
+                            w.f64(score);
+                    }
+                }
+            });
+        }
+        w.u8(OP_EOF);
+        w.finish();
+    }
+
+    template<typename Reader, typename Databases>
+    static std::size_t read_databases(Reader& r, Databases& databases)
+    {
+        char magic[sizeof(MAGIC)];
+        r.bytes(magic, sizeof(magic));
+        if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error("not a snapshot file");
+        if (r.u8() != VERSION)
+            throw std::runtime_error("unsupported snapshot version");
+
+        using db_type = std::decay_t<decltype(databases[0])>;
+        db_type* db = nullptr;
+        std::size_t loaded{};
+        for (;;)
+        {
+            std::uint8_t op = r.u8();
+            if (op == OP_EOF)
+                break;
+            if (op == OP_SELECTDB)
+            {
+                std::uint64_t db_num = r.varint();
+                if (db_num >= databases.size())
+                    throw std::runtime_error("snapshot database index out of range");
+                db = &databases[db_num];
+                continue;
+            }
+            if (op == OP_RESIZEDB)
+            {
+                if (!db)
+                    throw std::runtime_error("snapshot resizedb before selectdb");
+                db->reserve(db->size() + r.varint());
+                continue;
+            }
+            if (!db)
+                throw std::runtime_error("snapshot entry before selectdb");
+            std::string key = r.str();
+            switch (op)
+            {
+                case TYPE_STRING:
+                    db->template Emplace<typename db_type::string_type>(std::move(key)) = r.str();
+                    break;
+                case TYPE_SET:
+                case TYPE_SET_INTSET:
+                {
+                    auto& set = db->template Emplace<typename db_type::set_type>(std::move(key));
+                    for (std::uint64_t n = r.varint(); n; --n)
+                    {
+                        if (op == TYPE_SET_INTSET)
+                            set.emplace(std::to_string(zigzag_decode(r.varint())));
+                        else
+                            set.emplace(r.str());
+                    }
+                    break;
+                }
+                case TYPE_ZSET:
+                case TYPE_ZSET_INTSCORES:
+                {
+                    auto& sorted_set = db->template Emplace<typename db_type::sortedset_type>(std::move(key));
+                    for (std::uint64_t n = r.varint(); n; --n)
+                    {
+                        std::string member = r.str();
+                        double score = op == TYPE_ZSET_INTSCORES ? static_cast<double>(zigzag_decode(r.varint())) : r.f64();
+                        auto [iter, emplaced] = sorted_set.Members.emplace(std::move(member), score);
+                        if (emplaced)
+                            sorted_set.Scores.emplace(score, iter);
+                    }
+                    break;
+                }
+                default:
+                    throw std::runtime_error("unknown snapshot entry type");
+            }
+            ++loaded;
+        }
+        std::uint64_t expected = r.checksum();
+        if (r.fixed64() != expected)
+            throw std::runtime_error("snapshot checksum mismatch");
+        return loaded;
+    }
+
+    //write to a temporary file and rename it, so a crash never leaves a torn snapshot
+    template<typename Databases>
+    static void save(const std::string& filename, const Databases& databases, bool mappable = false)
+    {
+        if (mappable)
+        {
+            mapped_snapshot::save(filename, databases);
+            return;
+        }
+        std::string temp_filename = filename + ".tmp";
+        std::FILE* file = std::fopen(temp_filename.c_str(), "wb");
+        if (!file)
+            throw std::runtime_error("cannot open " + temp_filename);
+        try
+        {
+            file_sink sink{file};
+            writer<file_sink> w{sink};
+            write_databases(w, databases);
+            if (std::fflush(file) != 0)
+                throw std::runtime_error("snapshot flush failed");
+#ifndef _WIN32
+            if (::fsync(::fileno(file)) != 0)
+                throw std::runtime_error("snapshot sync failed");
+#endif
+        }
+        catch (...)
+        {
+            std::fclose(file);
+            std::remove(temp_filename.c_str());
+            throw;
+        }
+        std::fclose(file);
+        std::filesystem::rename(temp_filename, filename);
+    }
+
+    template<typename Databases>
+    static std::string save_to_string(const Databases& databases)
+    {
+        std::string out;
+        string_sink sink{out};
+        writer<string_sink> w{sink};
+        write_databases(w, databases);
+        return out;
+    }
+
+    //databases are expected to be empty, returns the number of keys loaded
+    template<typename Databases>
+    static std::size_t load(const std::string& filename, Databases& databases)
+    {
+        if (mapped_snapshot::is_mapped_snapshot(filename))
+            return mapped_snapshot::load(filename, databases);
+        std::FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file)
+            throw std::runtime_error("cannot open " + filename);
+        try
+        {
+            file_source source{file};
+            reader<file_source> r{source};
+            std::size_t loaded = read_databases(r, databases);
+            std::fclose(file);
+            return loaded;
+        }
+        catch (...)
+        {
+            std::fclose(file);
+            throw;
+        }
+    }
+
+    template<typename Databases>
+    static std::size_t load_from_string(std::string_view data, Databases& databases)
+    {
+        memory_source source{data};
+        reader<memory_source> r{source};
+        return read_databases(r, databases);
+    }
+
+    struct persistence_state final
+    {
+        std::string filename = "dump.kvs";
+        bool mappable = false;          //write the mmap friendly layout (mapped_snapshot.hpp)
+        std::int64_t last_save_time = 0; //unix time in seconds
+        bool last_save_ok = true;
+        long child_pid = -1;
+        std::uint64_t changes_since_last_save = 0;  //write commands applied, a final snapshot is due on shutdown
+        std::uint64_t changes_at_fork = 0;          //the ones the background save is writing
+
+        bool in_progress() const noexcept { return child_pid != -1; }
+
+        //a foreground save covers every change
+        void saved(bool ok, std::uint64_t changes_saved = UINT64_MAX)
+        {
+            using namespace std::chrono;
+            last_save_ok = ok;
+            if (ok)
+            {
+                last_save_time = duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+                changes_since_last_save -= std::min(changes_since_last_save, changes_saved);
+            }
+        }
+    };
+
+    static persistence_state g_snapshot;
+
+#ifndef _WIN32
+    //the child serializes a copy-on-write image of the databases while the parent keeps serving;
+    //returns its pid, -1 when fork failed
+    template<typename Databases>
+    static pid_t fork_save(const std::string& filename, const Databases& databases, bool mappable = false)
+    {
+        pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            int status = 0;
+            try { save(filename, databases, mappable); }
+            catch (...) { status = 1; }
+            std::_Exit(status);
+        }
+        return pid;
+    }
+
+    //nullopt while the child of fork_save runs, then whether it saved
+    static inline std::optional<bool> wait_save(pid_t pid, bool wait = false)
+    {
+        int status = 0;
+        pid_t rc = ::waitpid(pid, &status, wait ? 0 : WNOHANG);
+        if (rc == 0)
+            return std::nullopt;
+        return rc > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+#endif
+
+    template<typename Databases>
+    static bool background_save(const Databases& databases)
+    {
+        if (g_snapshot.in_progress())
+            return false;
+#ifdef _WIN32
+        try { save(g_snapshot.filename, databases, g_snapshot.mappable); g_snapshot.saved(true); }
+        catch (...) { g_snapshot.saved(false); }
+        return true;
+#else
+        pid_t pid = fork_save(g_snapshot.filename, databases, g_snapshot.mappable);
+        if (pid == -1)
+            return false;
+        g_snapshot.child_pid = pid;
+        g_snapshot.changes_at_fork = g_snapshot.changes_since_last_save;
+        return true;
+#endif
+    }
+
+    //call periodically from the event loop, returns true when a background save just finished
+    static inline bool poll_background_save(bool wait = false)
+    {
+#ifndef _WIN32
+        if (!g_snapshot.in_progress())
+            return false;
+        auto ok = wait_save(static_cast<pid_t>(g_snapshot.child_pid), wait);
+        if (!ok)
+            return false;
+        g_snapshot.child_pid = -1;
+        g_snapshot.saved(*ok, g_snapshot.changes_at_fork);
+        return true;
+#else
+        (void)wait;
+        return false;
+#endif
+    }
+}
+
+#endif /* SNAPSHOT_HPP */
\ No newline at end of file
@@ -0,0 +1,68 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+//Bounded lock-free queue for exactly one producer thread and one consumer thread. Each side only
+//writes its own index and keeps a cached copy of the other one, so the shared cache lines are
+//touched only when the cached view says the queue is full or empty.
+
+template<typename T, std::size_t Capacity>
+class spsc_queue final
+{
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+    static constexpr std::size_t CACHE_LINE = 64;
+
+    alignas(CACHE_LINE) std::atomic<std::size_t> head{0};   //next slot to pop, written by the consumer
+    std::size_t cached_tail = 0;
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail{0};   //next slot to push, written by the producer
+    std::size_t cached_head = 0;
+    alignas(CACHE_LINE) std::array<T, Capacity> slots;
+
+public:
+    spsc_queue() = default;
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    //producer only, value is left untouched when the queue is full
+    bool try_push(T&& value)
+    {
+        const auto t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head == Capacity)
+        {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head == Capacity)
+                return false;
+        }
+        slots[t & (Capacity - 1)] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer only
+    bool try_pop(T& value)
+    {
+        const auto h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail)
+        {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail)
+                return false;
+        }
+        value = std::move(slots[h & (Capacity - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+};
+
+#endif /* SPSC_QUEUE_HPP */
\ No newline at end of file
@@ -0,0 +1,89 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//Hashed timing wheel: Slots buckets of one tick each, a timer goes to the bucket of its deadline
+//tick modulo Slots, so scheduling is O(1) whatever the deadline and advancing only visits the
+//buckets of the ticks that passed. A timer further than one revolution away stays in its bucket
+//until a visit finds its deadline passed. Timers aren't canceled: the owner checks on expiry
+//whether it still applies and schedules it again if not (--timeout, client idle deadlines that
+//move with every command).
+
+template<typename Key, std::size_t Slots = 512>
+class timer_wheel final
+{
+    static_assert(Slots && (Slots & (Slots - 1)) == 0, "Slots must be a power of 2");
+
+public:
+    using clock_type = std::chrono::steady_clock;
+
+private:
+    struct timer final
+    {
+        Key key;
+        clock_type::time_point deadline;
+    };
+
+    std::array<std::vector<timer>, Slots> slots;
+    clock_type::time_point origin;
+    clock_type::duration tick;
+    std::uint64_t next_tick = 0;    //first tick not visited yet
+    std::size_t count = 0;
+
+    std::uint64_t tick_of(clock_type::time_point t) const noexcept
+    {
+        return t <= origin ? 0 : static_cast<std::uint64_t>((t - origin) / tick);
+    }
+
+public:
+    explicit timer_wheel(clock_type::duration tick = std::chrono::seconds(1), clock_type::time_point origin = clock_type::now())
+        : origin{origin}, tick{tick} {}
+
+    void schedule(Key key, clock_type::time_point deadline)
+    {
+        const auto t = std::max(tick_of(deadline), next_tick);
+        slots[t & (Slots - 1)].push_back({std::move(key), deadline});
+        ++count;
+    }
+
+    //calls expired(key) for every timer whose deadline is not after now; expired may schedule
+    template<typename Expired>
+    void advance(clock_type::time_point now, Expired&& expired)
+    {
+        const auto last = tick_of(now);
+        //a visit checks every timer of a bucket, one revolution covers all of them
+        const auto first = last >= next_tick + Slots ? last - Slots + 1 : next_tick;
+        std::vector<timer> bucket;
+        for (auto t = first; t <= last; ++t)
+        {
+            bucket.swap(slots[t & (Slots - 1)]);
+            next_tick = t + 1;
+            for (auto& item : bucket)
+            {
+                --count;
+                if (item.deadline <= now)
+                    expired(std::move(item.key));
+                else
+                    schedule(std::move(item.key), item.deadline);
+            }
+            bucket.clear();
+        }
+        next_tick = std::max(next_tick, last + 1);
+    }
+
+    std::size_t size() const noexcept { return count; }
+};
+
+#endif /* TIMER_WHEEL_HPP */
\ No newline at end of file
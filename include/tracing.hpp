@@ -0,0 +1,200 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef TRACING_HPP
+#define TRACING_HPP
+
+//Request pipeline tracing, compiled in with -DKV_TRACE=ON (KV_TRACE defined). KV_TRACE_SCOPE(name)
+//records the time spent until the end of the enclosing scope into a ring owned by the calling
+//thread; the newest RING_CAPACITY events of every thread are written as Chrome trace JSON by
+//TRACE DUMP or SIGUSR1, to be opened in chrome://tracing, ui.perfetto.dev or speedscope.
+//Without KV_TRACE the macros expand to nothing and their arguments aren't evaluated.
+/*
+    KV_TRACE_SCOPE("parse");                    name must be a string literal
+    KV_TRACE_SCOPE_ARG("dispatch", cmd.name()); the argument is copied, shown as args.arg
+*/
+
+#ifdef KV_TRACE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tracing
+{
+    constexpr bool ENABLED = true;
+    constexpr std::size_t RING_CAPACITY = 64 * 1024;   //events per thread
+    constexpr std::size_t ARG_LENGTH = 23;
+
+    using clock_type = std::chrono::steady_clock;
+
+    struct event final
+    {
+        const char* name;
+        std::int64_t start_ns;
+        std::int64_t duration_ns;
+        char arg[ARG_LENGTH + 1];
+    };
+
+    //written by its thread only; dumps read it without stopping the writer, so the events of
+    //another busy thread may be torn while its ring wraps
+    struct ring final
+    {
+        std::uint32_t tid;
+        std::atomic<std::uint64_t> next{0};
+        std::array<event, RING_CAPACITY> events;
+    };
+
+    class registry final
+    {
+        std::mutex lock;
+        std::vector<std::unique_ptr<ring>> rings;   //never released, threads may outlive a dump
+
+    public:
+        ring& add()
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            rings.push_back(std::make_unique<ring>());
+            rings.back()->tid = static_cast<std::uint32_t>(rings.size());
+            return *rings.back();
+        }
+
+        template<typename Visitor>
+        void for_each(Visitor visitor)
+        {
+            std::lock_guard<std::mutex> guard{lock};
+            for (auto& r : rings)
+                visitor(*r);
+        }
+    };
+
+    static registry g_registry;
+
+    static inline ring& this_thread_ring()
+    {
+        thread_local ring& r = g_registry.add();
+        return r;
+    }
+
+    static inline std::int64_t now_ns() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+    }
+
+    class scope final
+    {
+        const char* name;
+        std::int64_t start_ns;
+        std::string_view arg;
+
+    public:
+        explicit scope(const char* name, std::string_view arg = {}) noexcept
+            : name{name}, start_ns{now_ns()}, arg{arg} {}
+
+        ~scope()
+        {
+            const auto end_ns = now_ns();
+            auto& r = this_thread_ring();
+            const auto n = r.next.load(std::memory_order_relaxed);
+            auto& e = r.events[n % RING_CAPACITY];
+            e.name = name;
+            e.start_ns = start_ns;
+            e.duration_ns = end_ns - start_ns;
+            const auto length = std::min(arg.size(), ARG_LENGTH);
+            std::copy_n(arg.data(), length, e.arg);
+            e.arg[length] = '\0';
+            r.next.store(n + 1, std::memory_order_release);
+        }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+    };
+
+    static inline void reset()
+    {
+        g_registry.for_each([](ring& r) { r.next.store(0, std::memory_order_release); });
+    }
+
+    //Chrome trace event format, complete ("X") events with microsecond timestamps
+    static inline std::size_t write_json(std::ostream& os)
+    {
+        std::size_t count = 0;
+        os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        g_registry.for_each([&](ring& r) {
+            const auto next = r.next.load(std::memory_order_acquire);
+            const auto first = next > RING_CAPACITY ? next - RING_CAPACITY : 0;
+            for (auto i = first; i < next; ++i)
+            {
+                const auto& e = r.events[i % RING_CAPACITY];
+                os << (count++ ? ",\n" : "\n")
+                   << "{\"name\":\"" << e.name << "\",\"cat\":\"kv\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r.tid
+                   << ",\"ts\":" << e.start_ns / 1000 << '.' << std::to_string(1000 + e.start_ns % 1000).substr(1)
+                   << ",\"dur\":" << e.duration_ns / 1000 << '.' << std::to_string(1000 + e.duration_ns % 1000).substr(1);
+                if (e.arg[0])
+                {
+                    os << ",\"args\":{\"arg\":\"";
+                    for (const char* c = e.arg; *c; ++c)
+                        if (*c == '"' || *c == '\\') os << '\\' << *c;
+                        else if (static_cast<unsigned char>(*c) >= 0x20) os << *c;
+                    os << "\"}";
+                }
+                os << '}';
+            }
+        });
+        os << "\n]}\n";
+        return count;
+    }
+
+    //events written, 0 when the file can't be created
+    static inline std::size_t dump(const std::string& filename)
+    {
+        std::ofstream file(filename, std::ios::trunc);
+        if (!file)
+            return 0;
+        const auto count = write_json(file);
+        return file ? count : 0;
+    }
+}
+
+#define KV_TRACE_CONCAT_IMPL(a, b) a##b
+#define KV_TRACE_CONCAT(a, b) KV_TRACE_CONCAT_IMPL(a, b)
+#define KV_TRACE_SCOPE(name) ::tracing::scope KV_TRACE_CONCAT(kv_trace_scope_, __LINE__){name}
+#define KV_TRACE_SCOPE_ARG(name, arg) ::tracing::scope KV_TRACE_CONCAT(kv_trace_scope_, __LINE__){name, arg}
+
+#else
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace tracing
+{
+    constexpr bool ENABLED = false;
+
+    static inline void reset() {}
+    static inline std::size_t write_json(std::ostream&) { return 0; }
+    static inline std::size_t dump(const std::string&) { return 0; }
+}
+
+#define KV_TRACE_SCOPE(name) static_cast<void>(0)
+#define KV_TRACE_SCOPE_ARG(name, arg) static_cast<void>(0)
+
+#endif /* KV_TRACE */
+
+namespace tracing
+{
+    constexpr const char* DEFAULT_DUMP_FILENAME = "kv_trace.json";
+}
+
+#endif /* TRACING_HPP */
\ No newline at end of file
@@ -0,0 +1,90 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef TRANSACTION_HPP
+#define TRANSACTION_HPP
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "format.hpp"
+#include "resp.hpp"
+#include "resp_command.hpp"
+
+//MULTI/EXEC/DISCARD/WATCH/UNWATCH. After MULTI a client's commands are queued in Client_t and
+//answered +QUEUED; EXEC executes them back to back within the same event loop turn, so no other
+//client's command runs in between, and returns their replies as one array. WATCH is optimistic:
+//the database keeps a version counter only for the keys under watch, bumped by every write to
+//them (FLUSHDB bumps all), and EXEC answers a nil array without executing anything when one of
+//the versions differs from the one seen by WATCH.
+
+namespace transaction
+{
+    //executed at once even inside MULTI
+    static inline bool is_control_command(const std::string& cmd_name)
+    {
+        return cmd_name == "MULTI" || cmd_name == "EXEC" || cmd_name == "DISCARD" ||
+               cmd_name == "WATCH" || cmd_name == "UNWATCH";
+    }
+
+    //the arguments are copied, the query buffer holding them is consumed before EXEC; an unknown
+    //command (arity 0) or a wrong number of arguments isn't queued and makes EXEC abort
+    template<typename Client>
+    static std::string queue(Client& client, const resp::command& cmd, int arity)
+    {
+        if (arity == 0)
+        {
+            client.MultiFailed = true;
+            return resp::error_unknown_command(cmd.name());
+        }
+        const auto size = static_cast<int>(cmd.size());
+        if (arity > 0 ? size != arity : size < -arity)
+        {
+            client.MultiFailed = true;
+            return resp::error_wrong_number_of_arguments_for_command();
+        }
+        auto& args = client.Queued.emplace_back();
+        args.reserve(cmd.size());
+        for (const auto& arg : cmd.arguments())
+            args.emplace_back(arg);
+        return resp::queued();
+    }
+
+    //leaves MULTI and releases the watched keys
+    template<typename Client>
+    static void discard(Client& client)
+    {
+        client.InMulti = client.MultiFailed = false;
+        client.Queued.clear();
+        client.Unwatch();
+    }
+
+    //execute runs one queued command and returns its reply
+    template<typename Client, typename Execute>
+    static std::string exec(Client& client, Execute execute)
+    {
+        if (!client.InMulti)
+            return resp::error_exec_without_multi();
+        auto queued = std::move(client.Queued);
+        const bool failed = client.MultiFailed;
+        const bool touched = client.WatchedKeysTouched();
+        discard(client);
+        if (failed)
+            return resp::error_execabort();
+        if (touched)
+            return resp::nil_array();
+        std::string replies = format::resp_array_size(queued.size());
+        for (const auto& args : queued)
+        {
+            resp::command cmd(std::vector<std::string_view>(args.begin(), args.end()));
+            replies.append(execute(cmd));
+        }
+        return replies;
+    }
+}
+
+#endif /* TRANSACTION_HPP */
\ No newline at end of file
@@ -0,0 +1,509 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef URING_STREAM_HPP
+#define URING_STREAM_HPP
+
+//RESP front end over io_uring (--transport io_uring, Linux 6.0 or later), on the raw system calls
+//of <linux/io_uring.h>. One multishot accept feeds every connection, and every connection keeps one
+//multishot recv that picks its buffers from a ring of URING_BUFFER_COUNT buffers registered with
+//the kernel, so reads need no system call at all. Completions are reaped from the shared ring
+//when the event loop finds the ring descriptor readable; the replies of each connection are then
+//gathered into one send and everything queued while reaping (sends, re-armed receives) goes to the
+//kernel with a single io_uring_enter. A connection has at most one send in flight, replies that
+//arrive meanwhile wait in its pending buffer, which keeps them ordered without linked requests.
+//Same Handler as zmq_stream.hpp; INFO stats reports io_syscalls_per_command. On shutdown
+//stop_accepting cancels the multishot accept, drained tells when no reply is left to send.
+//A connection with more than pause_reading_above bytes unsent gets its receive canceled and
+//re-armed once it catches up; backlogs from URING_UNSENT_REPORT_MIN bytes are reported to the
+//handler (unsent), smaller ones are only the send in flight.
+
+#if defined(__linux__)
+
+#include <zmq.h>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "native_socket.hpp"
+#include "server_stats.hpp"
+#include "tracing.hpp"
+
+namespace transport
+{
+    constexpr unsigned URING_ENTRIES = 1024;            //submission queue, the completion queue is twice as big
+    constexpr unsigned URING_BUFFER_COUNT = 512;        //power of 2
+    constexpr unsigned URING_BUFFER_SIZE = 16 * 1024;
+    constexpr std::uint16_t URING_BUFFER_GROUP = 0;
+    constexpr std::size_t URING_UNSENT_REPORT_MIN = URING_BUFFER_SIZE;
+
+    class uring_stream final
+    {
+        enum op : std::uint64_t { ACCEPT = 0, RECV = 1, SEND = 2, CANCEL = 3 };
+        static constexpr std::uint64_t OP_BITS = 2;
+
+        struct connection final
+        {
+            int fd;
+            std::string id;
+            std::string output;         //the send in flight
+            std::size_t sent = 0;
+            std::string pending;        //replies waiting for the send in flight
+            std::size_t reported = 0;   //unsent bytes the handler knows of
+            bool receiving = false;     //multishot recv armed
+            bool sending = false;
+            bool closing = false;
+            bool paused = false;        //over the output limit, the recv is canceled
+        };
+
+        int ring_fd = -1, listen_fd = -1;
+        void* sq_ring = MAP_FAILED;
+        void* cq_ring = MAP_FAILED;
+        std::size_t sq_ring_size = 0, cq_ring_size = 0;
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        std::size_t sqes_size = 0;
+        unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags;
+        unsigned *cq_head, *cq_tail, *cq_mask;
+        io_uring_cqe* cqes;
+        unsigned sq_entries = 0, sq_local_tail = 0, to_submit = 0;
+        bool accepting = false;
+        std::size_t pause_above = 0;
+
+        //struct io_uring_buf_ring as an array: its flexible bufs member is misplaced when compiled
+        //as C++, the ring tail overlays the resv field of the first entry
+        io_uring_buf* buf_ring = static_cast<io_uring_buf*>(MAP_FAILED);
+        std::vector<char> buffers;
+        std::uint16_t buf_tail = 0;
+
+        std::unordered_map<std::uint64_t, connection> connections;
+        std::uint64_t connection_counter = 0;
+        std::vector<std::uint64_t> ready;       //connections with new pending replies
+
+        template<typename T>
+        static T load_acquire(T* p) noexcept { return std::atomic_ref<T>(*p).load(std::memory_order_acquire); }
+
+        template<typename T>
+        static void store_release(T* p, T value) noexcept { std::atomic_ref<T>(*p).store(value, std::memory_order_release); }
+
+        static void* map(std::size_t size, int fd, off_t offset) noexcept
+        {
+            return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        }
+
+        bool setup()
+        {
+            io_uring_params params{};
+            params.flags = IORING_SETUP_CLAMP | IORING_SETUP_SINGLE_ISSUER;
+            ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, URING_ENTRIES, &params));
+            if (ring_fd == -1 && errno == EINVAL)
+            {
+                params = {};
+                params.flags = IORING_SETUP_CLAMP;
+                ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, URING_ENTRIES, &params));
+            }
+            if (ring_fd == -1)
+                return false;
+            if (!(params.features & IORING_FEAT_NODROP))
+            {
+                errno = ENOSYS;
+                return false;
+            }
+            sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+            sq_ring = map(sq_ring_size, ring_fd, IORING_OFF_SQ_RING);
+            if (sq_ring == MAP_FAILED)
+                return false;
+            cq_ring = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ring : map(cq_ring_size, ring_fd, IORING_OFF_CQ_RING);
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(map(sqes_size, ring_fd, IORING_OFF_SQES));
+            if (cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+                return false;
+
+            auto* sq = static_cast<char*>(sq_ring);
+            sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_flags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+            auto* sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            for (unsigned i = 0; i < params.sq_entries; ++i)
+                sq_array[i] = i;
+            sq_entries = params.sq_entries;
+            sq_local_tail = *sq_tail;
+            auto* cq = static_cast<char*>(cq_ring);
+            cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            //provided buffer ring, multishot recv takes its buffers from here
+            buf_ring = static_cast<io_uring_buf*>(::mmap(nullptr, URING_BUFFER_COUNT * sizeof(io_uring_buf),
+                PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+            if (buf_ring == MAP_FAILED)
+                return false;
+            io_uring_buf_reg reg{};
+            reg.ring_addr = reinterpret_cast<std::uint64_t>(buf_ring);
+            reg.ring_entries = URING_BUFFER_COUNT;
+            reg.bgid = URING_BUFFER_GROUP;
+            if (::syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+                return false;
+            buffers.resize(static_cast<std::size_t>(URING_BUFFER_COUNT) * URING_BUFFER_SIZE);
+            for (std::uint16_t bid = 0; bid < URING_BUFFER_COUNT; ++bid)
+                recycle(bid);
+            store_release(&buf_ring[0].resv, buf_tail);
+            return true;
+        }
+
+        //published to the kernel by the next submit
+        void recycle(std::uint16_t bid) noexcept
+        {
+            auto& buf = buf_ring[buf_tail & (URING_BUFFER_COUNT - 1)];
+            buf.addr = reinterpret_cast<std::uint64_t>(buffers.data() + static_cast<std::size_t>(bid) * URING_BUFFER_SIZE);
+            buf.len = URING_BUFFER_SIZE;
+            buf.bid = bid;
+            ++buf_tail;
+        }
+
+        void submit()
+        {
+            store_release(&buf_ring[0].resv, buf_tail);
+            store_release(sq_tail, sq_local_tail);
+            const bool overflow = std::atomic_ref<unsigned>(*sq_flags).load(std::memory_order_relaxed) & IORING_SQ_CQ_OVERFLOW;
+            if (!to_submit && !overflow)
+                return;
+            ++server_stats::g_stats.total_io_syscalls;
+            const auto rc = ::syscall(__NR_io_uring_enter, ring_fd, to_submit, 0, overflow ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (rc > 0)
+                to_submit -= std::min(to_submit, static_cast<unsigned>(rc));
+        }
+
+        io_uring_sqe* next_sqe(std::uint64_t user_data)
+        {
+            if (sq_local_tail - load_acquire(sq_head) >= sq_entries)
+                submit();
+            if (sq_local_tail - load_acquire(sq_head) >= sq_entries)
+                return nullptr;
+            auto* sqe = &sqes[sq_local_tail & *sq_mask];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->user_data = user_data;
+            ++sq_local_tail;
+            ++to_submit;
+            return sqe;
+        }
+
+        void queue_accept()
+        {
+            if (auto* sqe = next_sqe(ACCEPT))
+            {
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->fd = listen_fd;
+                sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+                sqe->accept_flags = SOCK_CLOEXEC;
+            }
+        }
+
+        void queue_recv(std::uint64_t serial, connection& conn)
+        {
+            if (auto* sqe = next_sqe(serial << OP_BITS | RECV))
+            {
+                sqe->opcode = IORING_OP_RECV;
+                sqe->fd = conn.fd;
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = URING_BUFFER_GROUP;
+                sqe->ioprio = IORING_RECV_MULTISHOT;
+                conn.receiving = true;
+            }
+        }
+
+        void queue_send(std::uint64_t serial, connection& conn)
+        {
+            if (auto* sqe = next_sqe(serial << OP_BITS | SEND))
+            {
+                sqe->opcode = IORING_OP_SEND;
+                sqe->fd = conn.fd;
+                sqe->addr = reinterpret_cast<std::uint64_t>(conn.output.data() + conn.sent);
+                sqe->len = static_cast<std::uint32_t>(conn.output.size() - conn.sent);
+                sqe->msg_flags = MSG_NOSIGNAL;
+                conn.sending = true;
+            }
+        }
+
+        static std::size_t unsent(const connection& conn) noexcept { return conn.output.size() - conn.sent + conn.pending.size(); }
+
+        bool over_limit(const connection& conn) const noexcept { return pause_above && unsent(conn) > pause_above; }
+
+        template<typename Handler>
+        void report(connection& conn, Handler& handler)
+        {
+            const auto bytes = unsent(conn);
+            if (bytes != conn.reported && (conn.reported || bytes >= URING_UNSENT_REPORT_MIN))
+            {
+                conn.reported = bytes < URING_UNSENT_REPORT_MIN ? 0 : bytes;
+                handler.unsent(conn.id, conn.reported);
+            }
+        }
+
+        void pause(std::uint64_t serial, connection& conn)
+        {
+            conn.paused = true;
+            if (auto* sqe = next_sqe(CANCEL))
+            {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = serial << OP_BITS | RECV;
+            }
+        }
+
+        //the receive ends on shutdown, the connection goes once nothing is in flight
+        template<typename Handler>
+        void close_connection(std::uint64_t serial, connection& conn, Handler& handler)
+        {
+            if (!conn.closing)
+            {
+                conn.closing = true;
+                if (conn.receiving)
+                    ::shutdown(conn.fd, SHUT_RDWR);
+            }
+            if (conn.receiving || conn.sending)
+                return;
+            ::close(conn.fd);
+            const auto id = std::move(conn.id);
+            connections.erase(serial);
+            handler.disconnected(id);
+        }
+
+        template<typename Handler>
+        void on_accept(const io_uring_cqe& cqe, Handler& handler)
+        {
+            if (!(cqe.flags & IORING_CQE_F_MORE) && accepting)
+                queue_accept();
+            if (cqe.res < 0)
+                return;
+            tune_accepted_socket(cqe.res);
+            const auto serial = ++connection_counter;
+            auto& conn = connections[serial];
+            conn.fd = cqe.res;
+            conn.id = std::to_string(serial);
+            handler.connected(conn.id);
+            queue_recv(serial, conn);
+        }
+
+        template<typename Handler>
+        void on_recv(std::uint64_t serial, const io_uring_cqe& cqe, Handler& handler)
+        {
+            auto it = connections.find(serial);
+            if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER))
+            {
+                const auto bid = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                if (it != connections.end() && !it->second.closing)
+                {
+                    auto& conn = it->second;
+                    const auto* data = buffers.data() + static_cast<std::size_t>(bid) * URING_BUFFER_SIZE;
+                    auto reply = handler.received(conn.id, std::string_view{data, static_cast<std::size_t>(cqe.res)});
+                    if (!reply.empty())
+                    {
+                        if (conn.pending.empty())
+                            ready.push_back(serial);
+                        conn.pending += reply;
+                        report(conn, handler);
+                        if (!conn.paused && conn.receiving && over_limit(conn))
+                            pause(serial, conn);
+                    }
+                }
+                recycle(bid);
+            }
+            if (it == connections.end() || (cqe.flags & IORING_CQE_F_MORE))
+                return;
+            auto& conn = it->second;
+            conn.receiving = false;
+            if (conn.closing || !(cqe.res > 0 || cqe.res == -ENOBUFS || (cqe.res == -ECANCELED && conn.paused)))
+                close_connection(serial, conn, handler);
+            else if (over_limit(conn))
+                conn.paused = true;         //on_send re-arms it
+            else
+            {
+                conn.paused = false;
+                queue_recv(serial, conn);   //the buffers recycled in this batch are published with it
+            }
+        }
+
+        template<typename Handler>
+        void on_send(std::uint64_t serial, const io_uring_cqe& cqe, Handler& handler)
+        {
+            auto it = connections.find(serial);
+            if (it == connections.end())
+                return;
+            auto& conn = it->second;
+            conn.sending = false;
+            if (cqe.res < 0 || conn.closing)
+            {
+                close_connection(serial, conn, handler);
+                return;
+            }
+            conn.sent += static_cast<std::size_t>(cqe.res);
+            if (conn.sent < conn.output.size())
+            {
+                queue_send(serial, conn);
+                report(conn, handler);
+                return;
+            }
+            conn.output.clear();
+            conn.sent = 0;
+            if (!conn.pending.empty())
+            {
+                conn.output.swap(conn.pending);
+                queue_send(serial, conn);
+            }
+            report(conn, handler);
+            if (conn.paused && !conn.receiving && !over_limit(conn))
+            {
+                conn.paused = false;
+                queue_recv(serial, conn);
+            }
+        }
+
+    public:
+        uring_stream() = default;
+        ~uring_stream() { close(); }
+        uring_stream(const uring_stream&) = delete;
+        uring_stream& operator=(const uring_stream&) = delete;
+
+        bool bind(int port)
+        {
+            listen_fd = listen_tcp(port);
+            if (listen_fd == -1 || !setup())
+            {
+                const int error = errno;
+                close();
+                errno = error;
+                return false;
+            }
+            accepting = true;
+            queue_accept();
+            submit();
+            return true;
+        }
+
+        //connections are closed without notifying the handler
+        void close()
+        {
+            for (auto& [serial, conn] : connections)
+                ::close(conn.fd);
+            connections.clear();
+            ready.clear();
+            if (ring_fd != -1)
+                ::close(ring_fd);   //the kernel drops the requests in flight and the registered buffers
+            if (sqes != MAP_FAILED)
+                ::munmap(sqes, sqes_size);
+            if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+                ::munmap(cq_ring, cq_ring_size);
+            if (sq_ring != MAP_FAILED)
+                ::munmap(sq_ring, sq_ring_size);
+            if (buf_ring != MAP_FAILED)
+                ::munmap(buf_ring, URING_BUFFER_COUNT * sizeof(io_uring_buf));
+            if (listen_fd != -1)
+                ::close(listen_fd);
+            ring_fd = listen_fd = -1;
+            sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+            sq_ring = cq_ring = MAP_FAILED;
+            buf_ring = static_cast<io_uring_buf*>(MAP_FAILED);
+            to_submit = 0;
+            accepting = false;
+        }
+
+        void stop_accepting()
+        {
+            if (!accepting)
+                return;
+            accepting = false;
+            if (auto* sqe = next_sqe(CANCEL))
+            {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = ACCEPT;
+            }
+            submit();
+            ::close(listen_fd);     //the socket goes once the canceled accept lets it go
+            listen_fd = -1;
+        }
+
+        void pause_reading_above(std::size_t bytes) noexcept { pause_above = bytes; }
+
+        template<typename Handler>
+        bool kill(const std::string& id, Handler& handler)
+        {
+            for (auto& [serial, conn] : connections)
+                if (conn.id == id)
+                {
+                    close_connection(serial, conn, handler);
+                    return true;
+                }
+            return false;
+        }
+
+        bool drained() const noexcept
+        {
+            if (!ready.empty())
+                return false;
+            for (const auto& [serial, conn] : connections)
+                if (conn.sending || !conn.pending.empty())
+                    return false;
+            return true;
+        }
+
+        int handle() const noexcept { return ring_fd; }
+
+        zmq_pollitem_t pollitem() const noexcept { return { nullptr, ring_fd, ZMQ_POLLIN, 0 }; }
+
+        template<typename Handler>
+        void on_readable(Handler& handler)
+        {
+            KV_TRACE_SCOPE("io_uring_reap");
+            auto head = *cq_head;
+            const auto tail = load_acquire(cq_tail);
+            for (; head != tail; ++head)
+            {
+                const auto cqe = cqes[head & *cq_mask];
+                const auto serial = cqe.user_data >> OP_BITS;
+                switch (cqe.user_data & ((1 << OP_BITS) - 1))
+                {
+                case ACCEPT: on_accept(cqe, handler); break;
+                case RECV: on_recv(serial, cqe, handler); break;
+                case SEND: on_send(serial, cqe, handler); break;
+                case CANCEL: break;
+                }
+            }
+            store_release(cq_head, head);
+            for (const auto serial : ready)
+            {
+                auto it = connections.find(serial);
+                if (it != connections.end() && !it->second.sending && !it->second.closing && !it->second.pending.empty())
+                {
+                    it->second.output.swap(it->second.pending);
+                    queue_send(serial, it->second);
+                }
+            }
+            ready.clear();
+            submit();
+        }
+    };
+}
+
+#endif /* __linux__ */
+
+#endif /* URING_STREAM_HPP */
\ No newline at end of file
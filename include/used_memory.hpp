@@ -0,0 +1,62 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef USED_MEMORY_HPP
+#define USED_MEMORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+//Bytes held by the process heap, counted at malloc/free time with the allocator's own block size
+//(no header is added to the blocks). The server routes operator new/delete through here with
+//src/used_memory.inl; programs that don't include it read 0.
+
+namespace used_memory
+{
+    static std::atomic<std::size_t> g_bytes{0};
+
+    static inline std::size_t usable_size(void* p) noexcept
+    {
+#if defined(_WIN32)
+        return _msize(p);
+#elif defined(__APPLE__)
+        return malloc_size(p);
+#else
+        return malloc_usable_size(p);
+#endif
+    }
+
+    static inline void* allocate(std::size_t size) noexcept
+    {
+        void* p = std::malloc(size ? size : 1);
+        if (p)
+            g_bytes.fetch_add(usable_size(p), std::memory_order_relaxed);
+        return p;
+    }
+
+    static inline void release(void* p) noexcept
+    {
+        if (!p)
+            return;
+        g_bytes.fetch_sub(usable_size(p), std::memory_order_relaxed);
+        std::free(p);
+    }
+
+    static inline std::size_t bytes() noexcept
+    {
+        return g_bytes.load(std::memory_order_relaxed);
+    }
+}
+
+#endif /* USED_MEMORY_HPP */
\ No newline at end of file
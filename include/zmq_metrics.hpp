@@ -0,0 +1,109 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef ZMQ_METRICS_HPP
+#define ZMQ_METRICS_HPP
+
+#include <zmq.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "format.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+
+//HTTP endpoint for metrics.hpp on a second ZMQ_STREAM socket of the server's context, polled by
+//the event loop next to the RESP socket. Scrapes are rendered between commands and replies are
+//sent without waiting, so a slow scraper never holds the loop; every connection is closed after
+//its reply.
+
+namespace metrics
+{
+    class zmq_metrics_endpoint final
+    {
+        void* socket = nullptr;
+        std::unordered_map<std::string, std::string> requests;  //routing id -> bytes received
+
+        bool send(const std::string& id, const std::string& data)
+        {
+            return zmq_send(socket, id.data(), id.size(), ZMQ_DONTWAIT | ZMQ_SNDMORE) != -1 &&
+                   zmq_send(socket, data.data(), data.size(), ZMQ_DONTWAIT) != -1;
+        }
+
+    public:
+        zmq_metrics_endpoint() = default;
+        ~zmq_metrics_endpoint() { close(); }
+        zmq_metrics_endpoint(const zmq_metrics_endpoint&) = delete;
+        zmq_metrics_endpoint& operator=(const zmq_metrics_endpoint&) = delete;
+
+        bool bind(void* ctx, int port)
+        {
+            socket = zmq_socket(ctx, ZMQ_STREAM);
+            if (!socket)
+                return false;
+            int no_linger = 0;
+            zmq_setsockopt(socket, ZMQ_LINGER, &no_linger, sizeof(no_linger));
+            if (zmq_bind(socket, format::zmq_tcp_address(port).c_str()) != 0)
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if (socket)
+            {
+                zmq_close(socket);
+                socket = nullptr;
+            }
+            requests.clear();
+        }
+
+        void* handle() const noexcept { return socket; }
+
+        //Render is called as render() and returns the exposition text
+        template<typename Render>
+        void on_readable(Render render)
+        {
+            for (;;)
+            {
+                std::string frames[2];
+                for (auto& frame : frames)
+                {
+                    zmq_msg_t msg;
+                    zmq_msg_init(&msg);
+                    if (zmq_msg_recv(&msg, socket, ZMQ_DONTWAIT) == -1)
+                    {
+                        zmq_msg_close(&msg);
+                        return;
+                    }
+                    const char* data = static_cast<const char*>(zmq_msg_data(&msg));
+                    frame.assign(data, data + zmq_msg_size(&msg));
+                    zmq_msg_close(&msg);
+                }
+                const auto& [id, payload] = frames;
+                if (payload.empty())    //connected or disconnected
+                {
+                    requests.erase(id);
+                    continue;
+                }
+                auto& request = requests[id];
+                request += payload;
+                auto reply = http_response(request, render);
+                if (reply.empty())
+                    continue;
+                if (!send(id, reply))
+                    LOG_WARNING("Metrics reply to a scraper dropped");
+                send(id, {});           //an empty message closes the connection
+                requests.erase(id);
+            }
+        }
+    };
+}
+
+#endif /* ZMQ_METRICS_HPP */
\ No newline at end of file
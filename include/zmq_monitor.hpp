@@ -8,6 +8,7 @@
 
 #include <zmq.h>
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
@@ -44,9 +45,10 @@ class zmq_monitor_type
     void* socket_;
     void *monitor_socket_;
     volatile bool running_;
+    std::atomic<bool> stop_requested_;
 public:
     explicit zmq_monitor_type(void* context) noexcept
-        : ctx_{context}, socket_{nullptr}, monitor_socket_{nullptr}, running_{false}{}
+        : ctx_{context}, socket_{nullptr}, monitor_socket_{nullptr}, running_{false}, stop_requested_{false}{}
 
     virtual ~zmq_monitor_type() noexcept
     {
@@ -60,7 +62,8 @@ public:
         ctx_(that.ctx_),
         socket_(that.socket_),
         monitor_socket_(that.monitor_socket_),
-        running_(that.running_)
+        running_(that.running_),
+        stop_requested_(that.stop_requested_.load())
     {
         that.ctx_ = nullptr;
         that.socket_ = nullptr;
@@ -70,13 +73,21 @@ public:
 
     void monitor(void* socket, const std::string& addr, int timeout, int events = ZMQ_EVENT_ALL)
     {
-        monitor(socket, addr.c_str(), events);
+        monitor(socket, addr.c_str(), timeout, events);
     }
 
     void monitor(void* socket, const char* addr, int timeout, int events = ZMQ_EVENT_ALL)
     {
         init(socket, addr, events);
-        while(running_) check_event(timeout);
+        while(running_ && !stop_requested_) check_event(timeout);
+    }
+
+protected:
+    //from the thread owning the monitored socket: the stop event wakes up the monitoring loop
+    void stop(void* socket)
+    {
+        stop_requested_ = true;
+        zmq_socket_monitor(socket, nullptr, 0);
     }
 
 private:
@@ -0,0 +1,648 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef ZMQ_REPLICATION_HPP
+#define ZMQ_REPLICATION_HPP
+
+#include <zmq.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aof.hpp"
+#include "coarse_clock.hpp"
+#include "format.hpp"
+#include "logger.hpp"
+#include "replication.hpp"
+#include "snapshot.hpp"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+//Replication link over ZeroMQ: the primary binds a ROUTER socket at its RESP port plus
+//replication::PORT_OFFSET, every replica connects a DEALER socket to it.
+/*
+    replica -> primary
+        PSYNC <replid> <offset>                 resume the stream named replid at offset, or get a full sync
+        ACK <offset>                            heartbeat with the offset processed so far
+
+    primary -> replica
+        FULLRESYNC <replid> <offset>            full resync, the stream continues at offset after the snapshot
+        SNAPSHOT <size> <bytes>                 next chunk of the dataset (snapshot.hpp format) of size bytes
+        CONTINUE <replid> <offset>              partial resync, the stream continues at offset from the backlog
+        STREAM <offset> <commands>              RESP encoded write commands starting at offset
+        PING <offset>                           heartbeat with the primary's replication offset
+        RESYNC                                  the primary doesn't know this replica (anymore), PSYNC again
+
+    The snapshot of a full resync is written by a forked child, like BGSAVE, and every replica
+    asking for one meanwhile shares it; it is then read back and sent a few chunks per event loop
+    iteration, so neither serializing nor sending the dataset stalls the clients.
+*/
+
+namespace replication
+{
+    using clock = std::chrono::steady_clock;
+
+    constexpr auto PING_INTERVAL = std::chrono::seconds(1);
+    constexpr auto PSYNC_RETRY = std::chrono::seconds(3);       //PSYNC unanswered, e.g. sent while disconnected
+    constexpr auto PRIMARY_TIMEOUT = std::chrono::seconds(10);  //replica resyncs when the primary goes silent
+    constexpr auto REPLICA_TIMEOUT = std::chrono::seconds(60);  //primary forgets replicas that stop acking
+    constexpr std::size_t SNAPSHOT_CHUNK_SIZE = 64 * 1024;
+    constexpr std::size_t SNAPSHOT_CHUNKS_PER_ITERATION = 16;   //per replica
+
+    //all frames of one message, false when nothing is pending
+    static inline bool receive(void* socket, std::vector<std::string>& frames)
+    {
+        frames.clear();
+        int more = 1;
+        while (more)
+        {
+            zmq_msg_t msg;
+            zmq_msg_init(&msg);
+            if (zmq_msg_recv(&msg, socket, frames.empty() ? ZMQ_DONTWAIT : 0) == -1)
+            {
+                zmq_msg_close(&msg);
+                return false;
+            }
+            const char* data = static_cast<const char*>(zmq_msg_data(&msg));
+            frames.emplace_back(data, data + zmq_msg_size(&msg));
+            more = zmq_msg_more(&msg);
+            zmq_msg_close(&msg);
+        }
+        return true;
+    }
+
+    //never blocks the event loop, a peer that can't keep up is resynchronized later
+    static inline bool send(void* socket, std::initializer_list<std::string_view> frames)
+    {
+        std::size_t remaining = frames.size();
+        for (const auto& frame : frames)
+        {
+            if (zmq_send(socket, frame.data(), frame.size(), ZMQ_DONTWAIT | (--remaining ? ZMQ_SNDMORE : 0)) == -1)
+                return false;
+        }
+        return true;
+    }
+
+    static inline std::optional<std::uint64_t> to_offset(std::string_view sv)
+    {
+        std::uint64_t offset;
+        auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), offset);
+        if (ec != std::errc{} || ptr != sv.data() + sv.size())
+            return std::nullopt;
+        return offset;
+    }
+
+    class zmq_primary final
+    {
+        enum class sync_state
+        {
+            WAIT_SNAPSHOT,  //full resync requested
+            WAIT_CHILD,     //FULLRESYNC sent, the child is writing the snapshot
+            SEND_SNAPSHOT,  //receiving the snapshot in chunks
+            ONLINE          //streaming
+        };
+        struct replica final
+        {
+            std::string id;
+            std::uint64_t offset;       //next stream byte to send
+            clock::time_point last_seen;
+            sync_state sync = sync_state::ONLINE;
+            std::uint64_t sent = 0;     //snapshot bytes
+        };
+        void* socket = nullptr;
+        std::vector<replica> replicas;
+        clock::time_point last_ping{};
+
+        //the snapshot shared by the full resyncs, the stream continues at sync_offset after it
+        std::string sync_filename;
+        std::string sync_replid;
+        std::uint64_t sync_offset = 0;
+        long sync_child = -1;
+        std::FILE* sync_file = nullptr;
+        std::uint64_t sync_size = 0;
+
+        void drop(std::size_t index)
+        {
+            LOG_INFO("Replica {} disconnected", replicas[index].id);
+            replicas.erase(replicas.begin() + static_cast<std::ptrdiff_t>(index));
+            g_replication.connected_replicas = replicas.size();
+        }
+
+        template<typename Databases>
+        void psync(const std::string& id, const std::string& replid, const std::string& offset, const Databases& databases)
+        {
+            auto it = std::find_if(replicas.begin(), replicas.end(), [&](const replica& r) { return r.id == id; });
+            if (it == replicas.end())
+                it = replicas.insert(replicas.end(), replica{id});
+            it->last_seen = coarse_clock::g_clock.now();
+            g_replication.connected_replicas = replicas.size();
+
+            auto& state = g_replication;
+            auto offset_opt = to_offset(offset);
+            if (offset_opt && state.can_partial_resync(replid, *offset_opt))
+            {
+                it->offset = *offset_opt;
+                it->sync = sync_state::ONLINE;
+                ++state.sync_partial_ok;
+                send(socket, { id, "CONTINUE", state.replid, offset });
+                LOG_INFO("Partial resynchronization of replica {} from {}", id, offset);
+                return;
+            }
+            if (replid != "?")
+                ++state.sync_partial_err;
+            it->sync = sync_state::WAIT_SNAPSHOT;
+            it->sent = 0;
+            sync(databases);
+        }
+
+        template<typename Databases>
+        bool start_snapshot(const Databases& databases)
+        {
+            auto& state = g_replication;
+            state.full_sync_started();
+            sync_replid = state.replid;
+            sync_offset = state.master_repl_offset();
+            sync_filename = snapshot::g_snapshot.filename + ".sync";
+#ifdef _WIN32
+            try { snapshot::save(sync_filename, databases); }
+            catch (...) { return false; }
+            return open_snapshot();
+#else
+            sync_child = snapshot::fork_save(sync_filename, databases);
+            return sync_child != -1;
+#endif
+        }
+
+        bool open_snapshot()
+        {
+            std::error_code ec;
+            sync_size = std::filesystem::file_size(sync_filename, ec);
+            if (ec || !(sync_file = std::fopen(sync_filename.c_str(), "rb")))
+                return false;
+            return true;
+        }
+
+        void close_snapshot()
+        {
+#ifndef _WIN32
+            if (sync_child != -1)
+            {
+                ::kill(static_cast<pid_t>(sync_child), SIGKILL);
+                snapshot::wait_save(static_cast<pid_t>(sync_child), true);
+                sync_child = -1;
+            }
+#endif
+            if (sync_file)
+            {
+                std::fclose(sync_file);
+                sync_file = nullptr;
+            }
+            if (!sync_filename.empty())
+            {
+                std::error_code ec;
+                std::filesystem::remove(sync_filename, ec);
+            }
+        }
+
+        //false when the replica has to be dropped
+        bool send_snapshot(replica& r)
+        {
+            char chunk[SNAPSHOT_CHUNK_SIZE];
+            const auto total = std::to_string(sync_size);
+            for (std::size_t i = 0; i < SNAPSHOT_CHUNKS_PER_ITERATION && r.sent < sync_size; ++i)
+            {
+                const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(SNAPSHOT_CHUNK_SIZE, sync_size - r.sent));
+                if (std::fseek(sync_file, static_cast<long>(r.sent), SEEK_SET) != 0 || std::fread(chunk, 1, size, sync_file) != size)
+                    return false;
+                if (!send(socket, { r.id, "SNAPSHOT", total, std::string_view{chunk, size} }))
+                    return errno == EAGAIN;     //the next iteration retries
+                r.sent += size;
+            }
+            if (r.sent == sync_size)
+            {
+                r.sync = sync_state::ONLINE;
+                LOG_INFO("Full resynchronization of replica {} at {} ({} bytes)", r.id, sync_offset, sync_size);
+            }
+            return true;
+        }
+
+        //moves the full resyncs along: forks the snapshot, waits for the child, sends the chunks
+        template<typename Databases>
+        void sync(const Databases& databases)
+        {
+            auto in = [&](sync_state s) { return std::any_of(replicas.begin(), replicas.end(), [&](const replica& r) { return r.sync == s; }); };
+            auto drop_all = [&](sync_state s) {
+                for (std::size_t i = replicas.size(); i-- > 0; )
+                    if (replicas[i].sync == s)
+                        drop(i);
+            };
+#ifndef _WIN32
+            if (sync_child != -1)
+            {
+                if (auto ok = snapshot::wait_save(static_cast<pid_t>(sync_child)))
+                {
+                    sync_child = -1;
+                    if (*ok && open_snapshot())
+                    {
+                        for (auto& r : replicas)
+                            if (r.sync == sync_state::WAIT_CHILD)
+                                r.sync = sync_state::SEND_SNAPSHOT;
+                    }
+                    else
+                    {
+                        LOG_ERROR("Error writing the snapshot of a full resynchronization");
+                        drop_all(sync_state::WAIT_CHILD);
+                    }
+                }
+            }
+#endif
+            //a replica joins the snapshot being written or sent while the backlog still holds the
+            //stream from its offset, otherwise it waits for the next one
+            const bool current = sync_child != -1 || (sync_file && g_replication.backlog.contains(sync_offset));
+            if (in(sync_state::WAIT_SNAPSHOT) && (current || !sync_file))
+            {
+                if (!current && !start_snapshot(databases))
+                {
+                    LOG_ERROR("Error starting the snapshot of a full resynchronization");
+                    close_snapshot();
+                    drop_all(sync_state::WAIT_SNAPSHOT);
+                }
+                for (auto& r : replicas)
+                {
+                    if (r.sync != sync_state::WAIT_SNAPSHOT)
+                        continue;
+                    r.offset = sync_offset;
+                    r.sync = sync_child != -1 ? sync_state::WAIT_CHILD : sync_state::SEND_SNAPSHOT;
+                    send(socket, { r.id, "FULLRESYNC", sync_replid, std::to_string(sync_offset) });
+                }
+            }
+            for (std::size_t i = 0; i < replicas.size(); )
+            {
+                if (replicas[i].sync == sync_state::SEND_SNAPSHOT && !send_snapshot(replicas[i]))
+                {
+                    drop(i);
+                    continue;
+                }
+                ++i;
+            }
+            if (sync_file && !in(sync_state::SEND_SNAPSHOT))
+                close_snapshot();
+        }
+
+    public:
+        zmq_primary() = default;
+        ~zmq_primary() { close(); }
+        zmq_primary(const zmq_primary&) = delete;
+        zmq_primary& operator=(const zmq_primary&) = delete;
+
+        bool bind(void* ctx, int port)
+        {
+            socket = zmq_socket(ctx, ZMQ_ROUTER);
+            if (!socket)
+                return false;
+            int on = 1, no_linger = 0;
+            zmq_setsockopt(socket, ZMQ_LINGER, &no_linger, sizeof(no_linger));
+            zmq_setsockopt(socket, ZMQ_ROUTER_MANDATORY, &on, sizeof(on));
+            zmq_setsockopt(socket, ZMQ_ROUTER_HANDOVER, &on, sizeof(on));
+            if (zmq_bind(socket, format::zmq_tcp_address(port).c_str()) != 0)
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if (socket)
+            {
+                zmq_close(socket);
+                socket = nullptr;
+            }
+            close_snapshot();
+            replicas.clear();
+            g_replication.connected_replicas = 0;
+        }
+
+        void* handle() const noexcept { return socket; }
+
+        //the event loop polls with a short timeout while snapshot chunks remain to be sent
+        bool sending_snapshot() const noexcept
+        {
+            return std::any_of(replicas.begin(), replicas.end(), [](const replica& r) { return r.sync == sync_state::SEND_SNAPSHOT; });
+        }
+
+        template<typename Databases>
+        void on_readable(const Databases& databases)
+        {
+            std::vector<std::string> frames;
+            while (receive(socket, frames))
+            {
+                if (frames.size() < 3)
+                    continue;
+                const auto& id = frames[0];
+                const auto& verb = frames[1];
+                if (verb == "PSYNC" && frames.size() == 4)
+                {
+                    psync(id, frames[2], frames[3], databases);
+                }
+                else if (verb == "ACK")
+                {
+                    auto it = std::find_if(replicas.begin(), replicas.end(), [&](const replica& r) { return r.id == id; });
+                    if (it != replicas.end())
+                        it->last_seen = coarse_clock::g_clock.now();
+                    else
+                        send(socket, { id, "RESYNC" });
+                }
+            }
+        }
+
+        //streams what was fed since the last call, once per event loop iteration
+        void flush()
+        {
+            const auto& backlog = g_replication.backlog;
+            for (std::size_t i = 0; i < replicas.size(); )
+            {
+                auto& r = replicas[i];
+                if (r.sync == sync_state::ONLINE && r.offset < backlog.end_offset())
+                {
+                    //fell out of the window or can't keep up: it comes back through PSYNC
+                    if (!backlog.contains(r.offset) ||
+                        !send(socket, { r.id, "STREAM", std::to_string(r.offset), backlog.copy(r.offset) }))
+                    {
+                        drop(i);
+                        continue;
+                    }
+                    r.offset = backlog.end_offset();
+                }
+                ++i;
+            }
+        }
+
+        template<typename Databases>
+        void cron(const Databases& databases)
+        {
+            sync(databases);
+            auto now = coarse_clock::g_clock.now();
+            if (now - last_ping < PING_INTERVAL)
+                return;
+            last_ping = now;
+            auto offset = std::to_string(g_replication.master_repl_offset());
+            for (std::size_t i = 0; i < replicas.size(); )
+            {
+                if (now - replicas[i].last_seen > REPLICA_TIMEOUT || !send(socket, { replicas[i].id, "PING", offset }))
+                {
+                    drop(i);
+                    continue;
+                }
+                ++i;
+            }
+        }
+    };
+
+    template<typename Context, typename CommandStrategy>
+    class zmq_replica final
+    {
+        void* socket = nullptr;
+        clock::time_point last_seen{};
+        clock::time_point last_psync{};
+        clock::time_point last_ack{};
+        std::string sync_replid;        //of the full resync in progress
+        std::uint64_t sync_offset = 0;
+        std::string sync_filename;      //the snapshot chunks received so far go to disk, not to memory
+        std::FILE* sync_file = nullptr;
+        std::uint64_t sync_received = 0;
+
+        //a fresh server has a random replication ID, so the primary answers with a full sync
+        void psync()
+        {
+            const auto& state = g_replication;
+            g_replication.state = link_state::CONNECT;
+            last_seen = last_psync = coarse_clock::g_clock.now();
+            send(socket, { "PSYNC", state.replid, std::to_string(state.master_repl_offset()) });
+        }
+
+        static std::string routing_id()
+        {
+            std::random_device rd;
+            return "replica-" + std::to_string((static_cast<std::uint64_t>(rd()) << 32) | rd());
+        }
+
+        bool open_sync_file()
+        {
+            close_sync_file();
+            sync_filename = snapshot::g_snapshot.filename + ".replica";
+            sync_received = 0;
+            return (sync_file = std::fopen(sync_filename.c_str(), "wb")) != nullptr;
+        }
+
+        void close_sync_file()
+        {
+            if (sync_file)
+            {
+                std::fclose(sync_file);
+                sync_file = nullptr;
+            }
+            if (!sync_filename.empty())
+            {
+                std::error_code ec;
+                std::filesystem::remove(sync_filename, ec);
+                sync_filename.clear();
+            }
+        }
+
+        //false when the chunk can't be stored, the transfer is then abandoned
+        bool write_sync_chunk(std::string_view chunk)
+        {
+            if (!sync_file || std::fwrite(chunk.data(), 1, chunk.size(), sync_file) != chunk.size())
+                return false;
+            sync_received += chunk.size();
+            return true;
+        }
+
+        template<typename Databases>
+        void full_resync(const std::string& replid, std::uint64_t offset, Databases& databases)
+        {
+            for (auto& db : databases)
+                db.clear();
+            ++snapshot::g_snapshot.changes_since_last_save;
+            try
+            {
+                const bool flushed = std::fflush(sync_file) == 0;
+                std::fclose(sync_file);
+                sync_file = nullptr;
+                if (!flushed)
+                    throw std::runtime_error("cannot write " + sync_filename);
+                //a mapped snapshot stays mapped after close_sync_file removes the file
+                auto keys = snapshot::load(sync_filename, databases);
+                LOG_INFO("Full resynchronization from primary: {} keys at {}", keys, offset);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_ERROR("Error loading the primary's snapshot: {}", e.what());
+                for (auto& db : databases)
+                    db.clear();
+                g_replication.reset(random_replid(), 0);
+                psync();
+                return;
+            }
+            g_replication.reset(replid, offset);
+            g_replication.state = link_state::CONNECTED;
+            if (aof::g_aof.is_open() && !aof::g_aof.rewrite_in_progress())
+                aof::g_aof.background_rewrite(databases);
+        }
+
+    public:
+        zmq_replica() = default;
+        ~zmq_replica() { close(); }
+        zmq_replica(const zmq_replica&) = delete;
+        zmq_replica& operator=(const zmq_replica&) = delete;
+
+        bool connect(void* ctx, const std::string& host, int port)
+        {
+            close();
+            socket = zmq_socket(ctx, ZMQ_DEALER);
+            if (!socket)
+                return false;
+            int no_linger = 0;
+            zmq_setsockopt(socket, ZMQ_LINGER, &no_linger, sizeof(no_linger));
+            //a stable identity lets the primary hand over the old connection after a blip
+            auto id = routing_id();
+            zmq_setsockopt(socket, ZMQ_ROUTING_ID, id.data(), id.size());
+            if (zmq_connect(socket, format::zmq_tcp_address(host, port + PORT_OFFSET).c_str()) != 0)
+            {
+                close();
+                return false;
+            }
+            psync();
+            return true;
+        }
+
+        void close()
+        {
+            close_sync_file();
+            if (socket)
+            {
+                zmq_close(socket);
+                socket = nullptr;
+            }
+        }
+
+        void* handle() const noexcept { return socket; }
+
+        template<typename Databases>
+        void on_readable(Databases& databases)
+        {
+            auto& state = g_replication;
+            std::vector<std::string> frames;
+            while (receive(socket, frames))
+            {
+                last_seen = coarse_clock::g_clock.now();
+                const auto& verb = frames[0];
+                if (verb == "RESYNC")
+                {
+                    psync();
+                    continue;
+                }
+                if (frames.size() < 2)
+                    continue;
+                std::optional<std::uint64_t> offset_opt;
+                if (verb == "FULLRESYNC" && frames.size() == 3 && (offset_opt = to_offset(frames[2])))
+                {
+                    sync_replid = frames[1];
+                    sync_offset = *offset_opt;
+                    if (!open_sync_file())
+                    {
+                        //PSYNC_RETRY asks again
+                        LOG_ERROR("Cannot open {} for the primary's snapshot", sync_filename);
+                        continue;
+                    }
+                    state.state = link_state::SYNC;
+                    LOG_INFO("Full resynchronization from primary at {}, waiting for the snapshot", sync_offset);
+                }
+                else if (verb == "SNAPSHOT" && frames.size() == 3 && state.state == link_state::SYNC && (offset_opt = to_offset(frames[1])))
+                {
+                    if (!write_sync_chunk(frames[2]))
+                    {
+                        LOG_ERROR("Cannot write {} for the primary's snapshot", sync_filename);
+                        close_sync_file();
+                        psync();
+                        continue;
+                    }
+                    if (sync_received < *offset_opt)
+                        continue;
+                    if (sync_received == *offset_opt)
+                        full_resync(sync_replid, sync_offset, databases);
+                    else
+                        psync();
+                    close_sync_file();
+                }
+                else if (verb == "CONTINUE" && frames.size() == 3 && (offset_opt = to_offset(frames[2])))
+                {
+                    //the primary may continue our history under a new ID after a failover
+                    if (frames[1] != state.replid)
+                    {
+                        state.replid2 = state.replid;
+                        state.second_replid_offset = state.master_repl_offset();
+                        state.replid = frames[1];
+                    }
+                    LOG_INFO("Partial resynchronization from primary at {}", *offset_opt);
+                    state.state = link_state::CONNECTED;
+                }
+                else if (state.state != link_state::CONNECTED)
+                {
+                    continue;
+                }
+                else if (verb == "STREAM" && frames.size() == 3 && (offset_opt = to_offset(frames[1])))
+                {
+                    if (*offset_opt != state.master_repl_offset())
+                    {
+                        LOG_WARNING("Replication stream gap: expected {} got {}", state.master_repl_offset(), *offset_opt);
+                        psync();
+                        continue;
+                    }
+                    apply<Context, CommandStrategy>(frames[2]);
+                }
+                else if (verb == "PING" && (offset_opt = to_offset(frames[1])) && *offset_opt > state.master_repl_offset())
+                {
+                    //a stream message was lost while the connection was down
+                    psync();
+                }
+            }
+        }
+
+        void cron()
+        {
+            auto now = coarse_clock::g_clock.now();
+            const auto state = g_replication.state;
+            if (now - last_seen > PRIMARY_TIMEOUT || (state == link_state::CONNECT && now - last_psync > PSYNC_RETRY))
+            {
+                LOG_WARNING("No answer from primary, resynchronizing");
+                psync();
+            }
+            else if (state != link_state::CONNECT && now - last_ack >= PING_INTERVAL)
+            {
+                last_ack = now;
+                send(socket, { "ACK", std::to_string(g_replication.master_repl_offset()) });
+            }
+        }
+    };
+}
+
+#endif /* ZMQ_REPLICATION_HPP */
\ No newline at end of file
@@ -0,0 +1,269 @@
+//Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+//C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+//Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+//May 2025
+
+#ifndef ZMQ_STREAM_HPP
+#define ZMQ_STREAM_HPP
+
+#include <zmq.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "cppcodec/base64_rfc4648.hpp"
+#include "format.hpp"
+#include "tracing.hpp"
+
+//RESP front end over a ZMQ_STREAM socket (--transport zmq, the default). Every TCP connection is
+//a routing id, base64 encoded into the client id; an empty message announces a connection or its
+//end. One message is handled per poll wake up. Unbinding a ZMQ_STREAM endpoint also drops the
+//connections it accepted, so on shutdown stop_accepting only lets close() linger until the replies
+//already queued are sent (zmq_ctx_term waits for them); drained is always true.
+//The send high water mark is unlimited, so a client that doesn't read never blocks the event loop
+//nor loses replies; instead replies are sent zero-copy and ZeroMQ releases each one once its I/O
+//thread has written it, which tells the unsent bytes of every connection. report_unsent hands the
+//backlogs from ZMQ_UNSENT_REPORT_MIN bytes to the handler. A ZMQ_STREAM socket can't stop reading
+//a single connection, so pause_reading_above does nothing here and only the limits of
+//client_output_limit.hpp apply; kill closes a connection by sending it an empty message.
+/*
+    Handler, shared with epoll_stream.hpp:
+        void connected(const std::string& client_id)
+        void disconnected(const std::string& client_id)
+        std::string received(const std::string& client_id, std::string_view payload)   reply bytes
+        void unsent(const std::string& client_id, std::size_t bytes)                  reply bytes not written yet
+*/
+
+namespace transport
+{
+    constexpr std::size_t ZMQ_UNSENT_REPORT_MIN = 64 * 1024;
+
+    class zmq_stream final
+    {
+        struct peer_output final
+        {
+            std::atomic<std::size_t> released{0};   //written by the ZeroMQ I/O thread
+            std::size_t queued = 0;
+            std::size_t reported = 0;
+        };
+
+        struct queued_reply final
+        {
+            std::string bytes;
+            std::shared_ptr<peer_output> owner;
+        };
+
+        void* socket = nullptr;
+        std::unordered_map<std::string, std::shared_ptr<peer_output>> peers;
+        std::unordered_set<std::string> backlogged; //peers with unsent bytes reported or to report
+        std::unordered_set<std::string> killed;     //closed by kill, until ZeroMQ notifies their end
+        int linger_on_shutdown_ms;
+
+        static void release(void*, void* hint)
+        {
+            auto* reply = static_cast<queued_reply*>(hint);
+            reply->owner->released.fetch_add(reply->bytes.size(), std::memory_order_relaxed);
+            delete reply;
+        }
+
+        static std::size_t unsent(const peer_output& out) noexcept
+        {
+            return out.queued - out.released.load(std::memory_order_relaxed);
+        }
+
+        void send(const std::string& client_id, std::string&& reply)
+        {
+            using base64 = cppcodec::base64_rfc4648;
+            auto id = [&]() { KV_TRACE_SCOPE("base64_decode"); return base64::decode(client_id); }();
+            KV_TRACE_SCOPE("zmq_send");
+            auto it = peers.find(client_id);
+            if (it == peers.end())
+            {
+                zmq_send(socket, id.data(), id.size(), ZMQ_SNDMORE);
+                zmq_send(socket, reply.data(), reply.size(), 0);
+                return;
+            }
+            auto& out = it->second;
+            auto* queued = new queued_reply{std::move(reply), out};
+            const auto size = queued->bytes.size();
+            zmq_msg_t msg;
+            if (zmq_msg_init_data(&msg, queued->bytes.data(), size, release, queued) != 0)
+            {
+                delete queued;
+                return;
+            }
+            out->queued += size;
+            zmq_send(socket, id.data(), id.size(), ZMQ_SNDMORE);
+            if (zmq_msg_send(&msg, socket, 0) == -1)
+                zmq_msg_close(&msg);    //releases it, so queued and released stay even
+            if (unsent(*out) >= ZMQ_UNSENT_REPORT_MIN)
+                backlogged.insert(client_id);
+        }
+
+        template<typename T, typename UnaryOperator>
+        static std::optional<std::pair<T, int>> read(void* socket, UnaryOperator op)
+        {
+            int more = 0;
+            std::size_t more_size = sizeof(more);
+            T result{};
+            zmq_msg_t msg;
+            int rc = zmq_msg_init(&msg);
+            if (rc != 0) return std::nullopt;
+            {
+                KV_TRACE_SCOPE("zmq_msg_recv");
+                rc = zmq_msg_recv(&msg, socket, 0);
+            }
+            if (rc > 0)
+            {
+                char* ptr = static_cast<char*>(zmq_msg_data(&msg));
+                std::size_t size = zmq_msg_size(&msg);
+                if (size) result = op(ptr, size);
+                zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &more_size);
+            }
+            zmq_msg_close(&msg);
+            return std::make_pair(result, more);
+        }
+
+        std::optional<std::pair<std::string, std::string>> request_handler()
+        {
+            std::string id, payload;
+            auto id_opt = read<std::string>(socket, [](char* ptr, std::size_t size){ KV_TRACE_SCOPE("base64_encode"); return cppcodec::base64_rfc4648::encode(ptr, size); });
+            int more = (*id_opt).second;
+            if (more)
+            {
+                id = (*id_opt).first;
+                auto payload_opt = read<std::string>(socket, [](char* ptr, std::size_t size){ return std::string(ptr, ptr + size); });
+                payload = (*payload_opt).first;
+            }
+            return std::make_pair(id, payload);
+        }
+
+    public:
+        explicit zmq_stream(int linger_on_shutdown_ms = 0) : linger_on_shutdown_ms{linger_on_shutdown_ms} {}
+        ~zmq_stream() { close(); }
+        zmq_stream(const zmq_stream&) = delete;
+        zmq_stream& operator=(const zmq_stream&) = delete;
+
+        bool bind(void* ctx, int port)
+        {
+            socket = zmq_socket(ctx, ZMQ_STREAM);
+            if (!socket)
+                return false;
+            int no_linger = 0, no_hwm = 0;
+            zmq_setsockopt(socket, ZMQ_LINGER, &no_linger, sizeof(no_linger));
+            zmq_setsockopt(socket, ZMQ_SNDHWM, &no_hwm, sizeof(no_hwm));
+            if (zmq_bind(socket, format::zmq_tcp_address(port).c_str()) != 0)
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if (socket)
+            {
+                zmq_close(socket);
+                socket = nullptr;
+            }
+            peers.clear();
+            backlogged.clear();
+            killed.clear();
+        }
+
+        void pause_reading_above(std::size_t) noexcept {}
+
+        //once per event loop iteration
+        template<typename Handler>
+        void report_unsent(Handler& handler)
+        {
+            for (auto it = backlogged.begin(); it != backlogged.end();)
+            {
+                auto peer = peers.find(*it);
+                if (peer == peers.end())
+                {
+                    it = backlogged.erase(it);
+                    continue;
+                }
+                auto& out = *peer->second;
+                auto bytes = unsent(out);
+                if (bytes < ZMQ_UNSENT_REPORT_MIN)
+                    bytes = 0;
+                if (bytes != out.reported)
+                {
+                    out.reported = bytes;
+                    handler.unsent(*it, bytes);
+                }
+                it = bytes ? std::next(it) : backlogged.erase(it);
+            }
+        }
+
+        template<typename Handler>
+        bool kill(const std::string& id, Handler& handler)
+        {
+            if (!socket || !peers.erase(id))
+                return false;
+            backlogged.erase(id);
+            auto routing_id = cppcodec::base64_rfc4648::decode(id);
+            zmq_send(socket, routing_id.data(), routing_id.size(), ZMQ_SNDMORE);
+            zmq_send(socket, "", 0, 0);
+            killed.insert(id);
+            handler.disconnected(id);
+            return true;
+        }
+
+        void stop_accepting()
+        {
+            if (!socket)
+                return;
+            int linger = linger_on_shutdown_ms;
+            zmq_setsockopt(socket, ZMQ_LINGER, &linger, sizeof(linger));
+        }
+
+        bool drained() const noexcept { return true; }
+
+        void* handle() const noexcept { return socket; }
+
+        zmq_pollitem_t pollitem() const noexcept { return { socket, 0, ZMQ_POLLIN, 0 }; }
+
+        template<typename Handler>
+        void on_readable(Handler& handler)
+        {
+            auto req_opt = request_handler();
+            if (!req_opt)
+                return;
+            auto& [client_id, payload] = *req_opt;
+            if (payload.empty())
+            {
+                if (killed.erase(client_id))
+                    return;
+                if (peers.try_emplace(client_id, std::make_shared<peer_output>()).second)
+                    handler.connected(client_id);
+                else
+                {
+                    peers.erase(client_id);
+                    backlogged.erase(client_id);
+                    handler.disconnected(client_id);
+                }
+                return;
+            }
+            if (killed.count(client_id))
+                return;     //input the connection sent before kill closed it
+            auto reply = handler.received(client_id, payload);
+            if (reply.empty())
+                return;
+            KV_TRACE_SCOPE("send_reply");
+            send(client_id, std::move(reply));
+        }
+    };
+}
+
+#endif /* ZMQ_STREAM_HPP */
\ No newline at end of file
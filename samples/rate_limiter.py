@@ -24,17 +24,25 @@ if not args.noflush:
     print('Flushed')
 
 class RateLimiter:
+    # sliding window in one round trip (EVALSHA) instead of up to three
+    SCRIPT = """
+local now = tonumber(ARGV[1])
+redis.call('ZREMRANGEBYSCORE', KEYS[1], 0, now - tonumber(ARGV[3]))
+if redis.call('ZCARD', KEYS[1]) < tonumber(ARGV[2]) then
+    redis.call('ZADD', KEYS[1], now, ARGV[4])
+    return 1
+end
+return 0
+"""
     def __init__(self, rcli, max_calls_in_period, time_period_in_seconds):
         self.rcli = rcli
         self.max_calls_in_period = max(1, max_calls_in_period)
         self.time_period_in_seconds = max(1, time_period_in_seconds)
+        self.script = rcli.register_script(RateLimiter.SCRIPT)
     def allow(self, key, req_id):
         current_time = int(time.time())
-        self.rcli.zremrangebyscore(key, 0, current_time - self.time_period_in_seconds)
-        if self.rcli.zcard(key) < self.max_calls_in_period:
-            self.rcli.zadd(key, {req_id: current_time})
-            return True
-        return False
+        args = [current_time, self.max_calls_in_period, self.time_period_in_seconds, req_id]
+        return self.script(keys=[key], args=args) == 1
 
 def test_call_limit(n, client_id):
     for i in range(n):
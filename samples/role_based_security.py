@@ -42,12 +42,15 @@ def get_user_role(username):
     role_key = r.get(f"user:{username}")
     return role_key if role_key else None
 
-# --- Check if user has permission ---
+# --- Check if user has permission, one round trip (EVALSHA) ---
+HAS_PERMISSION = r.register_script("""
+local role = redis.call('GET', KEYS[1])
+if not role then return 0 end
+return redis.call('SISMEMBER', role, ARGV[1])
+""")
+
 def has_permission(username, permission):
-    role = get_user_role(username)
-    if not role:
-        return False
-    return r.sismember(role, f"perms:{permission}")
+    return HAS_PERMISSION(keys=[f"user:{username}"], args=[f"perms:{permission}"]) == 1
 
 # --- Print role and permissions ---
 def print_user_permissions(username):
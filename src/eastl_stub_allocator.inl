@@ -1,15 +1,188 @@
 #ifdef EASTL_BACKEND_HPP
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include "used_memory.hpp"
+
+//EASTL's default allocator calls the two operator new[] overloads below and releases with
+//delete[], so the whole array new/delete family is replaced by one arena: blocks up to
+//SMALL_LIMIT bytes come from size class free lists carved out of CHUNK_SIZE chunks, bigger or
+//over-aligned ones from malloc. Chunks and large blocks are counted by used_memory. A header
+//in front of every block keeps what delete[] needs and the counters are read through
+//eastl_arena::stats().
+/*
+
+  small block: [header | payload] rounded up to CLASS_GRANULARITY, recycled by its size class
+  large block: [padding | header | payload] straight from malloc, header.padding finds the base
+
+*/
+namespace eastl_arena
+{
+    constexpr std::size_t HEADER_SIZE = 16;         //keeps payloads 16-byte aligned
+    constexpr std::size_t CLASS_GRANULARITY = 16;
+    constexpr std::size_t SMALL_LIMIT = 512;        //header included
+    constexpr std::size_t CLASS_COUNT = SMALL_LIMIT / CLASS_GRANULARITY;
+    constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+    struct arena_stats final
+    {
+        std::uint64_t allocations;          //every new[]
+        std::uint64_t eastl_allocations;    //new[] issued by EASTL containers
+        std::uint64_t deallocations;
+        std::size_t bytes_in_use;           //requested bytes not yet released
+        std::size_t peak_bytes_in_use;
+        std::size_t chunk_bytes;            //reserved for small blocks, never returned to the system
+    };
+
+    struct header final
+    {
+        std::size_t size;
+        std::uint32_t size_class;   //0 for large blocks
+        std::uint32_t padding;      //bytes between the malloc'd base and the header
+    };
+    static_assert(sizeof(header) <= HEADER_SIZE);
+
+    //spin lock: constant initialized and trivially destructible, delete[] can run after static destructors
+    class spin_lock final
+    {
+        std::atomic_flag flag;
+    public:
+        void lock() noexcept { while (flag.test_and_set(std::memory_order_acquire)); }
+        void unlock() noexcept { flag.clear(std::memory_order_release); }
+    };
+
+    static spin_lock g_lock;
+    static void* g_free_lists[CLASS_COUNT + 1]{};
+    static char* g_chunk_cursor = nullptr;
+    static char* g_chunk_end = nullptr;
+    static arena_stats g_stats{};
+
+    static void* allocate(std::size_t size, std::size_t alignment, std::size_t offset, bool from_eastl) noexcept
+    {
+        std::lock_guard<spin_lock> lock{g_lock};
+        header* h = nullptr;
+        const std::size_t total = (HEADER_SIZE + size + CLASS_GRANULARITY - 1) / CLASS_GRANULARITY * CLASS_GRANULARITY;
+        if (total <= SMALL_LIMIT && alignment <= HEADER_SIZE && offset == 0)
+        {
+            const auto size_class = static_cast<std::uint32_t>(total / CLASS_GRANULARITY);
+            if (void* block = g_free_lists[size_class])
+            {
+                g_free_lists[size_class] = *static_cast<void**>(block);
+                h = static_cast<header*>(block);
+            }
+            else
+            {
+                if (static_cast<std::size_t>(g_chunk_end - g_chunk_cursor) < total)
+                {
+                    //the tail of the previous chunk is abandoned
+                    g_chunk_cursor = static_cast<char*>(used_memory::allocate(CHUNK_SIZE));
+                    if (!g_chunk_cursor)
+                    {
+                        g_chunk_end = nullptr;
+                        return nullptr;
+                    }
+                    g_chunk_end = g_chunk_cursor + CHUNK_SIZE;
+                    g_stats.chunk_bytes += CHUNK_SIZE;
+                }
+                h = reinterpret_cast<header*>(g_chunk_cursor);
+                g_chunk_cursor += total;
+            }
+            h->size_class = size_class;
+            h->padding = 0;
+        }
+        else
+        {
+            alignment = alignment < HEADER_SIZE ? HEADER_SIZE : alignment;
+            char* base = static_cast<char*>(used_memory::allocate(HEADER_SIZE + size + alignment));
+            if (!base)
+                return nullptr;
+            //the payload byte at offset must be aligned
+            auto payload = reinterpret_cast<std::uintptr_t>(base) + HEADER_SIZE + offset;
+            payload = (payload + alignment - 1) / alignment * alignment - offset;
+            h = reinterpret_cast<header*>(payload - HEADER_SIZE);
+            h->size_class = 0;
+            h->padding = static_cast<std::uint32_t>(reinterpret_cast<char*>(h) - base);
+        }
+        h->size = size;
+        ++g_stats.allocations;
+        if (from_eastl)
+            ++g_stats.eastl_allocations;
+        g_stats.bytes_in_use += size;
+        if (g_stats.bytes_in_use > g_stats.peak_bytes_in_use)
+            g_stats.peak_bytes_in_use = g_stats.bytes_in_use;
+        return reinterpret_cast<char*>(h) + HEADER_SIZE;
+    }
+
+    static void deallocate(void* p) noexcept
+    {
+        if (!p)
+            return;
+        std::lock_guard<spin_lock> lock{g_lock};
+        auto h = reinterpret_cast<header*>(static_cast<char*>(p) - HEADER_SIZE);
+        ++g_stats.deallocations;
+        g_stats.bytes_in_use -= h->size;
+        if (h->size_class)
+        {
+            *reinterpret_cast<void**>(h) = g_free_lists[h->size_class];
+            g_free_lists[h->size_class] = h;
+        }
+        else
+        {
+            used_memory::release(reinterpret_cast<char*>(h) - h->padding);
+        }
+    }
+
+    static arena_stats stats()
+    {
+        std::lock_guard<spin_lock> lock{g_lock};
+        return g_stats;
+    }
+}
+
+void* operator new[](std::size_t size)
+{
+    if (void* p = eastl_arena::allocate(size, 0, 0, false))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return eastl_arena::allocate(size, 0, 0, false);
+}
+
+void operator delete[](void* p) noexcept
+{
+    eastl_arena::deallocate(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    eastl_arena::deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    eastl_arena::deallocate(p);
+}
 
 void* operator new[](std::size_t size, const char*, int, unsigned, const char*, int)
 {
-    return ::operator new[](size);
+    if (void* p = eastl_arena::allocate(size, 0, 0, true))
+        return p;
+    throw std::bad_alloc{};
 }
 
-void* operator new[](std::size_t size, std::size_t, std::size_t, const char*, int, unsigned, const char*, int)
+void* operator new[](std::size_t size, std::size_t alignment, std::size_t offset, const char*, int, unsigned, const char*, int)
 {
-    return ::operator new[](size);
+    if (void* p = eastl_arena::allocate(size, alignment, offset, true))
+        return p;
+    throw std::bad_alloc{};
 }
 
 #endif /* EASTL_BACKEND_HPP */
\ No newline at end of file
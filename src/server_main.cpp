@@ -5,98 +5,111 @@
 
 #include <zmq.h>
 
+#include <cerrno>
 #include <chrono>
 #include <csignal>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <utility>
+#include <vector>
 
+#include "aof.hpp"
 #include "argparse/argparse.hpp"
 #include "backend.hpp"
-#include "cppcodec/base64_rfc4648.hpp"
+#include "client_output_limit.hpp"
+#include "coarse_clock.hpp"
+#include "command_stats.hpp"
+#include "epoll_stream.hpp"
 #include "execute_command.hpp"
 #include "format.hpp"
+#include "hotkeys.hpp"
+#include "lifecycle.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "replication.hpp"
 #include "resp_command.hpp"
 #include "resp_command_parser.hpp"
+#include "scripting.hpp"
+#include "server_stats.hpp"
+#include "slowlog.hpp"
+#include "reactor_pool.hpp"
+#include "snapshot.hpp"
+#include "timer_wheel.hpp"
+#include "tracing.hpp"
+#include "transaction.hpp"
+#include "uring_stream.hpp"
+#include "zmq_metrics.hpp"
 #include "zmq_monitor.hpp"
+#include "zmq_replication.hpp"
+#include "zmq_stream.hpp"
 
 #include "eastl_stub_allocator.inl"
+#include "used_memory.inl"
 
 class monitor_zmq_socket final : private zmq_monitor_type 
 {
+    void* monitored_socket;
     std::thread monitor_thread;
 public:
     monitor_zmq_socket(void* context, void* socket, const char* address, int timeout = -1) 
-        : zmq_monitor_type{context}
+        : zmq_monitor_type{context}, monitored_socket{socket}
     {
         if (!context)
             throw std::invalid_argument("context is null");
         if (!socket)
             throw std::invalid_argument("socket is null");        
-        monitor_thread = std::move(std::thread([&](){ 
+        monitor_thread = std::thread([this, socket, address, timeout](){ 
             monitor(socket, address, timeout, ZMQ_EVENT_ALL);
-        }));
-        monitor_thread.detach();
+        });
+    }
+
+    //joined before the monitored socket is closed and the context terminated
+    ~monitor_zmq_socket()
+    {
+        stop(monitored_socket);
+        if (monitor_thread.joinable())
+            monitor_thread.join();
     }
 
 private:
     virtual void on_event_accepted(const zmq_event_type& ev, const char* addr) const 
     {
+        metrics::g_zmq_events.accepted.fetch_add(1, std::memory_order_relaxed);
         LOG_TRACE_L1("Client accepted fd: {} addr: {}", ev.value, addr);
     }
 
+    virtual void on_event_accept_failed(const zmq_event_type&, const char*) const 
+    {
+        metrics::g_zmq_events.accept_failed.fetch_add(1, std::memory_order_relaxed);
+    }
+
     virtual void on_event_disconnected(const zmq_event_type& ev, const char* addr) const 
     {
+        metrics::g_zmq_events.disconnected.fetch_add(1, std::memory_order_relaxed);
         LOG_TRACE_L1("Client disconnected fd: {} addr: {}", ev.value, addr);
     }    
-};
 
-template<typename T, typename UnaryOperator>
-std::optional<std::pair<T, int>> read(void* socket, UnaryOperator op)
-{
-    int more;
-    std::size_t more_size = sizeof(more);
-    T result{};
-    zmq_msg_t msg;
-    int rc = zmq_msg_init(&msg);
-    if (rc != 0) return std::nullopt;
-    rc = zmq_msg_recv(&msg, socket, 0);
-    if (rc > 0)
-    {
-        char* ptr = static_cast<char*>(zmq_msg_data(&msg));
-        std::size_t size = zmq_msg_size(&msg);
-        if (size) result = op(ptr, size);
-        zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &more_size);
-    }    
-    zmq_msg_close(&msg);
-    return std::make_pair(result, more);
-}
-
-std::optional<std::pair<std::string, std::string>> request_handler(void* socket)
-{
-    std::string id, payload;
-    auto id_opt = read<std::string>(socket, [](char* ptr, std::size_t size){ return cppcodec::base64_rfc4648::encode(ptr, size); });
-    int more = (*id_opt).second;
-    if (more)
+    virtual void on_event_closed(const zmq_event_type&, const char*) const 
     {
-        id = (*id_opt).first;
-        auto payload_opt = read<std::string>(socket, [](char* ptr, std::size_t size){ return std::string(ptr, ptr + size); });
-        payload = (*payload_opt).first;
+        metrics::g_zmq_events.closed.fetch_add(1, std::memory_order_relaxed);
     }
-    return std::make_pair(id, payload);
-}
+};
 
-inline std::optional<std::vector<std::string_view>> parse_resp_command(const std::string& payload)
+inline std::optional<std::vector<std::string_view>> parse_resp_command(resp::command_parser& parser)
 {
+    KV_TRACE_SCOPE("parse_resp_command");
     try
     {
-        resp::command_parser parser { payload.c_str() };
-        return parser.parse();
+        return parser.parse_next();
     }
     catch(const std::exception& e)
     {
@@ -112,6 +125,30 @@ inline std::optional<std::vector<std::string_view>> parse_resp_command(const std
 struct args final
 {
     int tcp_port;
+    std::string dbfilename;
+    bool mmap_snapshot;
+    bool appendonly;
+    std::string appendfilename;
+    aof::fsync_policy appendfsync;
+    std::optional<std::pair<std::string, int>> replicaof;
+    std::size_t repl_backlog_size;
+    quill::LogLevel loglevel;
+    std::string logfile;
+    std::size_t logfile_max_size;
+    std::uint32_t logfile_max_files;
+    std::uint64_t log_commands;
+    double log_slower_than;
+    std::int64_t slowlog_log_slower_than;
+    std::size_t slowlog_max_len;
+    int metrics_port;
+    std::uint64_t hotkeys_sample_rate;
+    std::string transport;
+    std::size_t reactors;
+    std::string unixsocket;
+    client_output::limits client_output_buffer_limit;
+    std::chrono::seconds timeout;
+    std::uint64_t latency_sample_rate;
+    std::chrono::milliseconds script_time_limit;
 };
 
 args parse_args(int argc, char* argv[])
@@ -127,13 +164,267 @@ args parse_args(int argc, char* argv[])
                             throw std::out_of_range("Port must be between 1024 and 49151.");
                         return value;
                      });
+    arg_parser.add_argument("--dbfilename")
+              .help("snapshot file loaded at startup and written by SAVE/BGSAVE")
+              .default_value(std::string{"dump.kvs"})
+              .nargs(1);
+    arg_parser.add_argument("--mmap-snapshot")
+              .help("write snapshots in the memory mappable layout, for near-instant warm restarts")
+              .flag();
+    arg_parser.add_argument("--appendonly")
+              .help("log every write command to the append only file and replay it at startup")
+              .flag();
+    arg_parser.add_argument("--appendfilename")
+              .help("append only file name")
+              .default_value(std::string{"appendonly.aof"})
+              .nargs(1);
+    arg_parser.add_argument("--appendfsync")
+              .help("append only file fsync policy (always, everysec, no)")
+              .default_value(std::string{"everysec"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        if (!aof::to_fsync_policy(value))
+                            throw std::invalid_argument("appendfsync must be always, everysec or no.");
+                        return value;
+                     });
+    arg_parser.add_argument("--replicaof")
+              .help("start as a replica of the primary at host port (RESP port, replication uses port + 10000)")
+              .nargs(2);
+    arg_parser.add_argument("--repl-backlog-size")
+              .help("bytes of replication stream kept for partial resynchronization (16384–1073741824)")
+              .nargs(1)
+              .scan<'i', int>()
+              .action([](const std::string& value) {
+                        int size = std::stoi(value);
+                        if (size < 16384 || size > 1073741824)
+                            throw std::out_of_range("Replication backlog size must be between 16384 and 1073741824.");
+                        return value;
+                     });
+    arg_parser.add_argument("--loglevel")
+              .help("trace_l3, trace_l2, trace_l1, debug, info, notice, warning, error or critical")
+              .default_value(std::string{"info"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        if (!to_log_level(value))
+                            throw std::invalid_argument("Unknown log level.");
+                        return value;
+                     });
+    arg_parser.add_argument("--logfile")
+              .help("log to this file, rotated by size, instead of the console")
+              .default_value(std::string{})
+              .nargs(1);
+    arg_parser.add_argument("--logfile-max-size")
+              .help("bytes of a log file before it is rotated (1048576–1073741824)")
+              .default_value(std::string{"67108864"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        int size = std::stoi(value);
+                        if (size < 1048576 || size > 1073741824)
+                            throw std::out_of_range("Log file size must be between 1048576 and 1073741824.");
+                        return value;
+                     });
+    arg_parser.add_argument("--logfile-max-files")
+              .help("rotated log files kept (1–100)")
+              .default_value(std::string{"5"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        int files = std::stoi(value);
+                        if (files < 1 || files > 100)
+                            throw std::out_of_range("Log files must be between 1 and 100.");
+                        return value;
+                     });
+    arg_parser.add_argument("--log-commands")
+              .help("log one in every N executed commands (0 disables, 1 logs all)")
+              .default_value(std::string{"0"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        if (std::stoll(value) < 0)
+                            throw std::out_of_range("Log commands sample rate must not be negative.");
+                        return value;
+                     });
+    arg_parser.add_argument("--slowlog-log-slower-than")
+              .help("microseconds a command must take to enter the SLOWLOG (negative disables)")
+              .default_value(std::string{"10000"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        std::stoll(value);
+                        return value;
+                     });
+    arg_parser.add_argument("--slowlog-max-len")
+              .help("entries kept by the SLOWLOG (1–1048576)")
+              .default_value(std::string{"128"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        int len = std::stoi(value);
+                        if (len < 1 || len > 1048576)
+                            throw std::out_of_range("SLOWLOG length must be between 1 and 1048576.");
+                        return value;
+                     });
+    arg_parser.add_argument("--metrics-port")
+              .help("serve OpenMetrics at http://host:port/metrics (1024–65535, 0 disables)")
+              .default_value(std::string{"0"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        int port = std::stoi(value);
+                        if (port != 0 && (port < 1024 || port > 65535))
+                            throw std::out_of_range("Metrics port must be 0 or between 1024 and 65535.");
+                        return value;
+                     });
+    arg_parser.add_argument("--transport")
+              .help("RESP front end: zmq (ZMQ_STREAM socket), epoll or io_uring (native sockets, Linux only)")
+              .default_value(std::string{"zmq"})
+              .nargs(1)
+              .action([](const std::string& value) {
+#if defined(__linux__)
+                        if (value != "zmq" && value != "epoll" && value != "io_uring")
+                            throw std::invalid_argument("transport must be zmq, epoll or io_uring.");
+#else
+                        if (value != "zmq")
+                            throw std::invalid_argument("transport must be zmq, epoll and io_uring are only available on Linux.");
+#endif
+                        return value;
+                     });
+    arg_parser.add_argument("--reactors")
+              .help("epoll reactor threads sharing the port with SO_REUSEPORT (0–64, 0 serves from the event loop)")
+              .default_value(std::string{"0"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        int reactors = std::stoi(value);
+                        if (reactors < 0 || reactors > 64)
+                            throw std::out_of_range("Reactors must be between 0 and 64.");
+                        return value;
+                     });
+    arg_parser.add_argument("--unixsocket")
+              .help("also serve RESP on this unix domain socket path, next to the TCP port (Linux only)")
+              .default_value(std::string{})
+              .nargs(1)
+              .action([](const std::string& value) {
+#if !defined(__linux__)
+                        if (!value.empty())
+                            throw std::invalid_argument("unixsocket is only available on Linux.");
+#endif
+                        return value;
+                     });
+    arg_parser.add_argument("--client-output-buffer-limit")
+              .help("\"<hard> <soft> <soft seconds>\" unsent reply bytes (b, kb, mb, gb) that disconnect a client, 0 disables")
+              .default_value(std::string{"256mb 64mb 60"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        if (!client_output::parse(value))
+                            throw std::invalid_argument("client-output-buffer-limit must be \"<hard> <soft> <soft seconds>\".");
+                        return value;
+                     });
+    arg_parser.add_argument("--latency-sample-rate")
+              .help("time one in every N commands with the precise clock for the latency statistics (0 disables, 1 times all)")
+              .default_value(std::to_string(command_stats::DEFAULT_TIMING_SAMPLE_RATE))
+              .nargs(1)
+              .action([](const std::string& value) {
+                        if (std::stoll(value) < 0)
+                            throw std::out_of_range("Latency sample rate must not be negative.");
+                        return value;
+                     });
+    arg_parser.add_argument("--timeout")
+              .help("close a client connection after this many idle seconds (0 disables)")
+              .default_value(std::string{"0"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        if (std::stoll(value) < 0)
+                            throw std::out_of_range("Timeout must not be negative.");
+                        return value;
+                     });
+    arg_parser.add_argument("--script-time-limit")
+              .help("milliseconds an EVAL/EVALSHA script may run before it is aborted (1–3600000)")
+              .default_value(std::to_string(scripting::DEFAULT_TIME_LIMIT.count()))
+              .nargs(1)
+              .action([](const std::string& value) {
+                        auto ms = std::stoll(value);
+                        if (ms < 1 || ms > 3600000)
+                            throw std::out_of_range("Script time limit must be between 1 and 3600000.");
+                        return value;
+                     });
+    arg_parser.add_argument("--hotkeys-sample-rate")
+              .help("feed one in every N key accesses to the HOTKEYS/BIGKEYS sampler (0 disables, 1 samples all)")
+              .default_value(std::string{"8"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        if (std::stoll(value) < 0)
+                            throw std::out_of_range("Hot keys sample rate must not be negative.");
+                        return value;
+                     });
+    arg_parser.add_argument("--log-slower-than")
+              .help("log every command taking at least this many microseconds (negative disables)")
+              .default_value(std::string{"-1"})
+              .nargs(1)
+              .action([](const std::string& value) {
+                        std::stod(value);
+                        return value;
+                     });
     int tcp_port;
+    std::string dbfilename;
+    bool mmap_snapshot;
+    bool appendonly;
+    std::string appendfilename;
+    aof::fsync_policy appendfsync;
+    std::optional<std::pair<std::string, int>> replicaof;
+    std::size_t repl_backlog_size;
+    quill::LogLevel loglevel;
+    std::string logfile;
+    std::size_t logfile_max_size;
+    std::uint32_t logfile_max_files;
+    std::uint64_t log_commands;
+    double log_slower_than;
+    std::int64_t slowlog_log_slower_than;
+    std::size_t slowlog_max_len;
+    int metrics_port;
+    std::uint64_t hotkeys_sample_rate;
+    std::string transport;
+    std::size_t reactors;
+    std::string unixsocket;
+    client_output::limits client_output_buffer_limit;
+    std::chrono::seconds timeout;
+    std::uint64_t latency_sample_rate;
+    std::chrono::milliseconds script_time_limit;
     try
     {
         arg_parser.parse_args(argc, argv);
         tcp_port = 1234;
         if (arg_parser.is_used("--port"))
             tcp_port = arg_parser.get<int>("--port");
+        dbfilename = arg_parser.get<std::string>("--dbfilename");
+        mmap_snapshot = arg_parser.get<bool>("--mmap-snapshot");
+        appendonly = arg_parser.get<bool>("--appendonly");
+        appendfilename = arg_parser.get<std::string>("--appendfilename");
+        appendfsync = *aof::to_fsync_policy(arg_parser.get<std::string>("--appendfsync"));
+        if (arg_parser.is_used("--replicaof"))
+        {
+            auto values = arg_parser.get<std::vector<std::string>>("--replicaof");
+            int port = std::stoi(values[1]);
+            if (port <= 0 || port + replication::PORT_OFFSET > 65535)
+                throw std::out_of_range("Primary port is out of range.");
+            replicaof = std::make_pair(values[0], port);
+        }
+        repl_backlog_size = replication::DEFAULT_BACKLOG_SIZE;
+        if (arg_parser.is_used("--repl-backlog-size"))
+            repl_backlog_size = static_cast<std::size_t>(std::stoi(arg_parser.get<std::string>("--repl-backlog-size")));
+        loglevel = *to_log_level(arg_parser.get<std::string>("--loglevel"));
+        logfile = arg_parser.get<std::string>("--logfile");
+        logfile_max_size = static_cast<std::size_t>(std::stoi(arg_parser.get<std::string>("--logfile-max-size")));
+        logfile_max_files = static_cast<std::uint32_t>(std::stoi(arg_parser.get<std::string>("--logfile-max-files")));
+        log_commands = static_cast<std::uint64_t>(std::stoll(arg_parser.get<std::string>("--log-commands")));
+        log_slower_than = std::stod(arg_parser.get<std::string>("--log-slower-than"));
+        slowlog_log_slower_than = std::stoll(arg_parser.get<std::string>("--slowlog-log-slower-than"));
+        slowlog_max_len = static_cast<std::size_t>(std::stoi(arg_parser.get<std::string>("--slowlog-max-len")));
+        metrics_port = std::stoi(arg_parser.get<std::string>("--metrics-port"));
+        hotkeys_sample_rate = static_cast<std::uint64_t>(std::stoll(arg_parser.get<std::string>("--hotkeys-sample-rate")));
+        transport = arg_parser.get<std::string>("--transport");
+        reactors = static_cast<std::size_t>(std::stoi(arg_parser.get<std::string>("--reactors")));
+        if (reactors && transport != "epoll")
+            throw std::invalid_argument("--reactors needs --transport epoll.");
+        unixsocket = arg_parser.get<std::string>("--unixsocket");
+        client_output_buffer_limit = *client_output::parse(arg_parser.get<std::string>("--client-output-buffer-limit"));
+        timeout = std::chrono::seconds(std::stoll(arg_parser.get<std::string>("--timeout")));
+        latency_sample_rate = static_cast<std::uint64_t>(std::stoll(arg_parser.get<std::string>("--latency-sample-rate")));
+        script_time_limit = std::chrono::milliseconds(std::stoll(arg_parser.get<std::string>("--script-time-limit")));
     }
     catch(const std::exception& e)
     {
@@ -141,19 +432,149 @@ args parse_args(int argc, char* argv[])
         std::cerr << arg_parser;
         std::exit(1);
     }
-    return { tcp_port };
+    return { tcp_port, dbfilename, mmap_snapshot, appendonly, appendfilename, appendfsync, replicaof, repl_backlog_size,
+             loglevel, logfile, logfile_max_size, logfile_max_files, log_commands, log_slower_than,
+             slowlog_log_slower_than, slowlog_max_len, metrics_port, hotkeys_sample_rate, transport, reactors, unixsocket,
+             client_output_buffer_limit, timeout, latency_sample_rate, script_time_limit };
 }
 
+void load_snapshot(const std::string& filename)
+{
+    using std::chrono::high_resolution_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    if (!std::filesystem::exists(filename))
+        return;
+    const auto t_s = high_resolution_clock::now();
+    try
+    {
+        auto keys = snapshot::load(filename, g_databases);
+        const milliseconds diff = high_resolution_clock::now() - t_s;
+        LOG_INFO("Loaded {} keys from snapshot {} in {}", keys, filename, diff);
+    }
+    catch(const std::exception& e)
+    {
+        //the next save would replace the only copy of the data, the file is left for inspection
+        LOG_CRITICAL("Refusing to start: error loading snapshot {}: {}", filename, e.what());
+        g_logger.get()->flush_log();
+        std::exit(1);
+    }
+}
+
+//the append only file, when enabled and not empty, is the most complete copy of the data
+bool load_append_only_file(const args& args)
+{
+    using std::chrono::high_resolution_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    auto& aof_file = aof::g_aof;
+    aof_file.enabled = args.appendonly;
+    aof_file.filename = args.appendfilename;
+    aof_file.fsync = args.appendfsync;
+    if (!aof_file.enabled)
+        return false;
+    bool loaded = false;
+    std::error_code ec;
+    if (std::filesystem::file_size(aof_file.filename, ec) > 0 && !ec)
+    {
+        const auto t_s = high_resolution_clock::now();
+        try
+        {
+            auto commands = aof::replay<Context_t, Strategy_t>(aof_file.filename);
+            const milliseconds diff = high_resolution_clock::now() - t_s;
+            LOG_INFO("Replayed {} commands from append only file {} in {}", commands, aof_file.filename, diff);
+            loaded = true;
+        }
+        catch(const aof::corrupt_log_error& e)
+        {
+            //appending to it would bury the damage, the file is left for inspection
+            LOG_CRITICAL("Refusing to start: {}, the commands from offset {} on weren't replayed", e.what(), e.offset);
+            g_logger.get()->flush_log();
+            std::exit(1);
+        }
+        catch(const std::exception& e)
+        {
+            LOG_CRITICAL("Refusing to start: error replaying append only file {}: {}", aof_file.filename, e.what());
+            g_logger.get()->flush_log();
+            std::exit(1);
+        }
+    }
+    return loaded;
+}
+
+//once the data is loaded: the server doesn't start without its log, the writes wouldn't be durable
+void open_append_only_file()
+{
+    auto& aof_file = aof::g_aof;
+    if (!aof_file.enabled)
+        return;
+    try
+    {
+        if (aof_file.open_or_create(g_databases))
+            LOG_INFO("Append only file {} written from the loaded dataset", aof_file.filename);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_CRITICAL("Refusing to start: error opening append only file {}: {}", aof_file.filename, e.what());
+        g_logger.get()->flush_log();
+        std::exit(1);
+    }
+}
+
+//one in --latency-sample-rate commands is timed with the precise clock; the others read the coarse
+//clock, and only while a slow command threshold is set, so the slow logs still catch them
 std::string execute_command(Context_t&& ctx, resp::command&& cmd)
 {
     using std::chrono::high_resolution_clock;
     using microseconds = std::chrono::duration<double, std::micro>;
+    KV_TRACE_SCOPE_ARG("execute_command", cmd.name());
+    if (auto& client = ctx.Client(); client.InMulti && !transaction::is_control_command(cmd.name()))
+    {
+        //queued, statistics and persistence happen when EXEC executes it
+        if (replication::rejects_write(cmd.name()))
+        {
+            client.MultiFailed = true;
+            return resp::error_readonly();
+        }
+        if (aof::g_aof.rejects_writes() && is_write_command(cmd.name()))
+        {
+            client.MultiFailed = true;
+            return resp::error_misconf_aof();
+        }
+        return transaction::queue(client, cmd, command_arity(cmd.name()));
+    }
     std::string reply;
-    bool unk_cmd{};
-    const auto t_s = high_resolution_clock::now();    
+    bool unk_cmd{}, rejected{};
+    const bool timed = command_stats::g_timing.should_time();
+    const bool coarse = !timed && (slowlog::g_slowlog.log_slower_than_us >= 0 || g_command_log.slower_than_us >= 0);
+    high_resolution_clock::time_point t_s, t_e;
+    coarse_clock::clock_type::time_point c_s;
+    if (timed)
+        t_s = high_resolution_clock::now();
+    else if (coarse)
+        c_s = coarse_clock::read();
     try
     {
-        reply = execute_command<Context_t, Strategy_t>(ctx, cmd, unk_cmd);
+        if ((rejected = replication::rejects_write(cmd.name())))
+            reply = resp::error_readonly();
+        else if ((rejected = aof::g_aof.rejects_writes() && is_write_command(cmd.name())))
+            reply = resp::error_misconf_aof();
+        else if (cmd.name() == "EXEC" && cmd.size() == 1)
+        {
+            //every queued command goes through here, logged and fed to the replicas on its own
+            const auto client_id = ctx.Client().Id;
+            reply = transaction::exec(ctx.Client(), [&](resp::command& queued) {
+                return execute_command(Context_t{client_id}, std::move(queued));
+            });
+        }
+        else if (cmd.name() == "EVAL" || cmd.name() == "EVALSHA")
+        {
+            //the commands called by the script too, so their effects are logged and replicated
+            const auto client_id = ctx.Client().Id;
+            reply = scripting::eval(cmd, [&](resp::command& called) {
+                return execute_command(Context_t{client_id}, std::move(called));
+            });
+        }
+        else
+            reply = execute_command<Context_t, Strategy_t>(ctx, cmd, unk_cmd);
     }
     catch(const std::exception& e)
     {
@@ -163,26 +584,374 @@ std::string execute_command(Context_t&& ctx, resp::command&& cmd)
     {
         LOG_ERROR("Unknown error");
     }
-    const auto t_e = high_resolution_clock::now();
-    const microseconds diff = t_e - t_s;
+    microseconds diff{};
+    if (timed)
+        diff = (t_e = high_resolution_clock::now()) - t_s;
+    else if (coarse)
+        diff = coarse_clock::read() - c_s;
+    if (!unk_cmd)
+    {
+        KV_TRACE_SCOPE("stats");
+        ++server_stats::g_stats.total_commands_processed;
+        const bool failed = reply.empty() || reply[0] == '-';
+        if (timed)
+        {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t_e - t_s).count();
+            command_stats::g_command_stats.record(cmd.name(), static_cast<std::uint64_t>(ns), failed, rejected, t_e);
+        }
+        else
+            command_stats::g_command_stats.record(cmd.name(), failed, rejected);
+        const auto& client = ctx.Client();
+        slowlog::g_slowlog.record(cmd, static_cast<std::uint64_t>(diff.count()), client.Id, client.ConnectionName, client.LibName);
+        if (hotkeys::g_sampler.should_sample())
+        {
+            const auto [first, last] = key_arguments(cmd.name());
+            for (std::size_t i = first; first && i < cmd.size() && (!last || i <= last); ++i)
+                hotkeys::g_sampler.record(client.CurrentDbNumber, client.CurrentDb(), cmd[i]);
+        }
+    }
+    if (!reply.empty() && reply[0] != '-' && is_write_command(cmd.name()))
+    {
+        aof::g_aof.feed(ctx.Client().CurrentDbNumber, cmd);
+        replication::g_replication.feed(ctx.Client().CurrentDbNumber, cmd);
+        ++snapshot::g_snapshot.changes_since_last_save;
+    }
     if (unk_cmd)
         LOG_WARNING("Invalid command {} executed for client {} in {}", cmd.name(), ctx.Client().ClientNumber, diff);
-    else
+    else if (g_command_log.should_log(diff.count()))
         LOG_INFO("Command {} executed for client {} in {}", cmd.name(), ctx.Client().ClientNumber, diff);
     return reply;
 }
 
-void tune_zmq_socket(void* s)
+//a TCP segment may carry several pipelined commands or only part of one: the payload is
+//appended to the client's query buffer and every complete command in it is executed in order
+std::string process_request(const std::string& client_id, std::string_view payload)
 {
-    int no_linger = 0;
-    zmq_setsockopt(s, ZMQ_LINGER, &no_linger, sizeof(no_linger));
+    KV_TRACE_SCOPE("process_request");
+    auto* client_ptr = Context_t::find_client(client_id);
+    if (!client_ptr || client_ptr->CloseAsap)
+        return {};      //removed, or waiting to be closed
+    auto& client = *client_ptr;
+    client.LastInteraction = coarse_clock::g_clock.now();
+    server_stats::g_stats.total_net_input_bytes += payload.size();
+    auto& query_buffer = client.QueryBuffer;
+    query_buffer.append(payload);
+    resp::command_parser parser { query_buffer.data(), query_buffer.data() + query_buffer.size() };
+    while (auto cmd_opt = parse_resp_command(parser))
+        client.ReplyBuffer.append(execute_command(Context_t{client_id}, resp::command(std::move(*cmd_opt))));
+    query_buffer.erase(0, parser.position - query_buffer.data());
+    if (!query_buffer.empty() && query_buffer[0] != '*')
+    {
+        LOG_WARNING("Invalid command: {}", query_buffer);
+        query_buffer.clear();
+        client.ReplyBuffer.append(resp::error_protocol());
+    }
+    std::string replies = std::move(client.ReplyBuffer);
+    client.ReplyBuffer.clear();
+    server_stats::g_stats.total_net_output_bytes += replies.size();
+    return replies;
 }
 
-volatile bool running = true;
-void sigint_handler(int) 
+//while writing the append only file fails the write commands are rejected, the commands of
+//the failed write stay buffered and are retried on every flush
+void flush_append_only_file()
 {
+    auto& aof_file = aof::g_aof;
+    const bool was_ok = aof_file.last_write_ok;
+    aof_file.flush();
+    if (was_ok && !aof_file.last_write_ok)
+        LOG_ERROR("Error writing append only file {}, write commands are rejected until it succeeds", aof_file.filename);
+    else if (!was_ok && aof_file.last_write_ok)
+        LOG_INFO("Append only file {} written again, write commands are accepted", aof_file.filename);
+}
+
+void shutdown_handler(int signum)
+{
+    lifecycle::g_lifecycle.request_shutdown(signum);
+}
+
+volatile std::sig_atomic_t trace_dump_requested = 0;
+void sigusr1_handler(int)
+{
+    trace_dump_requested = 1;
+}
+
+constexpr int TIMEOUT_IN_MS = 3 * 1000;
+
+//connection events and requests of the RESP front ends (zmq_stream.hpp, epoll_stream.hpp); a
+//client over its output buffer limits or idle for longer than --timeout is marked with
+//Context_t::close_client, the event loop kills it once the front ends returned
+struct resp_handler final
+{
+    std::chrono::seconds idle_timeout{0};
+    timer_wheel<std::string> idle_clients;
+
+    void connected(const std::string& client_id)
+    {
+        if (Context_t::find_client(client_id))
+            return;
+        auto client = Context_t::create_or_remove_client(client_id);
+        ++server_stats::g_stats.total_connections_received;
+        if (idle_timeout.count())
+            idle_clients.schedule(client_id, coarse_clock::g_clock.now() + idle_timeout);
+        LOG_INFO("Client {} created", client.first);
+    }
+
+    void disconnected(const std::string& client_id) const
+    {
+        if (!Context_t::find_client(client_id))
+            return;     //already removed by close_clients
+        auto client = Context_t::create_or_remove_client(client_id);
+        LOG_INFO("Client {} removed", client.first);
+    }
+
+    std::string received(const std::string& client_id, std::string_view payload) const
+    {
+        auto replies = process_request(client_id, payload);
+        if (!replies.empty())
+            flush_append_only_file();
+        return replies;
+    }
+
+    void unsent(const std::string& client_id, std::size_t bytes)
+    {
+        if (auto* client = Context_t::find_client(client_id))
+        {
+            client->OutputBytes = bytes;
+            enforce_output_limit(*client, coarse_clock::g_clock.now());
+        }
+    }
+
+    //a client stuck above the soft limit isn't reported again, so its time runs out here
+    void check_output_limits(std::chrono::steady_clock::time_point now)
+    {
+        const auto soft = client_output::g_limits.soft;
+        if (!soft)
+            return;
+        for (auto& kv : g_clients)
+            if (kv.second.OutputBytes >= soft)
+                enforce_output_limit(kv.second, now);
+    }
+
+    void enforce_output_limit(Client_t& client, std::chrono::steady_clock::time_point now)
+    {
+        if (client.CloseAsap || !client_output::exceeded(client_output::g_limits, client.OutputBytes, client.OverSoftLimitSince, now))
+            return;
+        Context_t::close_client(client);
+        ++server_stats::g_stats.client_output_buffer_limit_disconnections;
+        LOG_WARNING("Client {} closed for overcoming output buffer limits with {} bytes unsent", client.ClientNumber, client.OutputBytes);
+    }
+
+    //a deadline is only checked when its timer expires, commands just move LastInteraction; a client
+    //already closed whose timer expires again lost its connection without the front end telling it
+    void close_idle_clients(std::chrono::steady_clock::time_point now)
+    {
+        if (!idle_timeout.count())
+            return;
+        idle_clients.advance(now, [&](std::string client_id) {
+            auto* client = Context_t::find_client(client_id);
+            if (!client || client_id == replication::MASTER_CLIENT_ID)
+                return;
+            if (client->CloseAsap)
+            {
+                LOG_WARNING("Client {} removed without a disconnection", client->ClientNumber);
+                disconnected(client_id);
+                return;
+            }
+            if (now - client->LastInteraction < idle_timeout)
+            {
+                idle_clients.schedule(std::move(client_id), client->LastInteraction + idle_timeout);
+                return;
+            }
+            Context_t::close_client(*client);
+            LOG_INFO("Client {} closed after {} idle", client->ClientNumber, std::chrono::duration_cast<std::chrono::seconds>(now - client->LastInteraction));
+            idle_clients.schedule(std::move(client_id), now + idle_timeout);
+        });
+    }
+};
+
+//the connections of g_clients_to_close are killed by their front end; a client none of them knows
+//is only removed
+template<typename... FrontEnds>
+void close_clients(resp_handler& handler, FrontEnds&... front_ends)
+{
+    for (const auto& client_id : std::exchange(g_clients_to_close, {}))
+        if (Context_t::find_client(client_id) && !(front_ends.kill(client_id, handler) || ...))
+            handler.disconnected(client_id);
+}
+
+//DRAINING: the front ends stop accepting and keep serving their connections until no reply is
+//queued and a poll finds no more input, false when SHUTDOWN_TIMEOUT_IN_MS passed first
+template<typename... FrontEnds>
+bool drain(resp_handler& handler, FrontEnds&... front_ends)
+{
+    (front_ends.stop_accepting(), ...);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(lifecycle::SHUTDOWN_TIMEOUT_IN_MS);
+    for (;;)
+    {
+        zmq_pollitem_t events[]{ front_ends.pollitem()... };
+        const int rc = zmq_poll(&events[0], static_cast<int>(sizeof...(FrontEnds)), lifecycle::DRAIN_POLL_IN_MS);
+        int i = 0;
+        ((events[i++].revents & ZMQ_POLLIN ? front_ends.on_readable(handler) : void()), ...);
+        if (rc == 0 && (front_ends.drained() && ...))
+            return true;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+    }
+}
+
+//PERSISTING: waits for the background children, then makes every acknowledged write durable
+void persist_on_shutdown()
+{
+    if (snapshot::poll_background_save(true))
+        LOG_INFO("Background saving {}", snapshot::g_snapshot.last_save_ok ? "terminated with success" : "failed");
+    if (aof::g_aof.poll_background_rewrite(true))
+        LOG_INFO("Background append only file rewriting {}", aof::g_aof.last_rewrite_ok ? "terminated with success" : "failed");
+    auto& state = snapshot::g_snapshot;
+    if (aof::g_aof.is_open())
+    {
+        aof::g_aof.close();     //written and fsynced whatever the appendfsync policy
+        LOG_INFO("Append only file {} synced", aof::g_aof.filename);
+    }
+    else if (state.changes_since_last_save)
+    {
+        const auto changes = state.changes_since_last_save;
+        try
+        {
+            snapshot::save(state.filename, g_databases, state.mappable);
+            state.saved(true);
+            LOG_INFO("Final snapshot with {} unsaved changes written to {}", changes, state.filename);
+        }
+        catch (const std::exception& e)
+        {
+            state.saved(false);
+            LOG_ERROR("Error writing the final snapshot to {}: {}", state.filename, e.what());
+        }
+    }
+}
+
+template<typename FrontEnd>
+void event_loop(void* ctx, FrontEnd& front_end, const args& args)
+{
+    resp_handler handler;
+    handler.idle_timeout = args.timeout;
+    auto& repl_state = replication::g_replication;
+    replication::zmq_primary primary;
+    replication::zmq_replica<Context_t, Strategy_t> replica;
+    const int repl_port = args.tcp_port + replication::PORT_OFFSET;
+    if (primary.bind(ctx, repl_port))
+        LOG_TRACE_L1("Replication listening at {}", format::zmq_tcp_address(repl_port));
+    else
+        LOG_ERROR("Error binding the replication socket at port {}", repl_port);
+    metrics::zmq_metrics_endpoint metrics_endpoint;
+    if (args.metrics_port)
+    {
+        if (metrics_endpoint.bind(ctx, args.metrics_port))
+            LOG_TRACE_L1("Metrics listening at http://*:{}/metrics", args.metrics_port);
+        else
+            LOG_ERROR("Error binding the metrics socket at port {}", args.metrics_port);
+    }
+#if defined(__linux__)
+    //--unixsocket is served by its own epoll front end, whatever transport serves the TCP port
+    transport::epoll_stream local_front_end;
+    if (!args.unixsocket.empty())
+    {
+        local_front_end.pause_reading_above(client_output::g_limits.pause_above());
+        if (local_front_end.bind_unix(args.unixsocket))
+            LOG_TRACE_L1("Listening at unix socket {}", args.unixsocket);
+        else
+            LOG_ERROR("Error binding unix socket {}: {}", args.unixsocket, std::strerror(errno));
+    }
+#endif
+    auto next_client_check = coarse_clock::g_clock.now();
+    while (!lifecycle::g_lifecycle.shutdown_requested())
+    {
+        if (repl_state.reconfigured)
+        {
+            repl_state.reconfigured = false;
+            if (repl_state.is_replica() && replica.connect(ctx, repl_state.master_host, repl_state.master_port))
+                LOG_INFO("Replica of {}:{}", repl_state.master_host, repl_state.master_port);
+            else
+                replica.close();
+        }
+        server_stats::g_stats.track(coarse_clock::g_clock.now());
+        primary.flush();
+        primary.cron(g_databases);
+        if (replica.handle())
+            replica.cron();
+        if constexpr (requires { front_end.report_unsent(handler); })
+            front_end.report_unsent(handler);
+        if (const auto now = coarse_clock::g_clock.now(); now >= next_client_check)
+        {
+            handler.check_output_limits(now);
+            handler.close_idle_clients(now);
+            next_client_check = now + std::chrono::seconds(1);
+        }
+#if defined(__linux__)
+        close_clients(handler, front_end, local_front_end);
+#else
+        close_clients(handler, front_end);
+#endif
+
+        zmq_pollitem_t events[6]{ front_end.pollitem() };
+        int nevents = 1;
+#if defined(__linux__)
+        if (local_front_end.handle() != -1)
+            events[nevents++] = local_front_end.pollitem();
+#endif
+        if (lifecycle::g_lifecycle.handle() != -1)
+            events[nevents++] = lifecycle::g_lifecycle.pollitem();
+        for (void* side_socket : { primary.handle(), replica.handle(), metrics_endpoint.handle() })
+            if (side_socket)
+                events[nevents++] = { side_socket, 0, ZMQ_POLLIN, 0 };
+        int rc = zmq_poll(&events[0], nevents, primary.sending_snapshot() ? 1 : TIMEOUT_IN_MS);
+        coarse_clock::g_clock.update();
+        if (lifecycle::g_lifecycle.shutdown_requested()) break;
+        if (trace_dump_requested)
+        {
+            trace_dump_requested = 0;
+            LOG_INFO("Trace dump of {} events written to {}", tracing::dump(tracing::DEFAULT_DUMP_FILENAME), tracing::DEFAULT_DUMP_FILENAME);
+        }
+        if (snapshot::poll_background_save())
+            LOG_INFO("Background saving {}", snapshot::g_snapshot.last_save_ok ? "terminated with success" : "failed");
+        if (aof::g_aof.poll_background_rewrite())
+            LOG_INFO("Background append only file rewriting {}", aof::g_aof.last_rewrite_ok ? "terminated with success" : "failed");
+        flush_append_only_file();
+        if (rc == 0 || rc == -1) continue;
+        for (int i = 1; i < nevents; ++i)
+        {
+            if (!events[i].socket)      //native descriptors: the unix socket front end or the shutdown wake up
+            {
+#if defined(__linux__)
+                if (events[i].fd == local_front_end.handle() && (events[i].revents & ZMQ_POLLIN))
+                    local_front_end.on_readable(handler);
+#endif
+                continue;
+            }
+            if (events[i].socket == primary.handle() && (events[i].revents & ZMQ_POLLIN))
+                primary.on_readable(g_databases);
+            if (events[i].socket == replica.handle() && (events[i].revents & ZMQ_POLLIN))
+                replica.on_readable(g_databases);
+            if (events[i].socket == metrics_endpoint.handle() && (events[i].revents & ZMQ_POLLIN))
+                metrics_endpoint.on_readable([]() { return metrics::render(g_databases, g_clients); });
+        }
+        if (events[0].revents & ZMQ_POLLIN)
+            front_end.on_readable(handler);
+    }
+
     std::cout << "\nThe server is shutting down gracefully. Closing active connections and releasing resources...\n";
-    running = false;
+    LOG_INFO("Shutdown requested by signal {}", lifecycle::g_lifecycle.signal());
+    lifecycle::g_lifecycle.enter(lifecycle::phase::DRAINING);
+#if defined(__linux__)
+    const bool drained = drain(handler, front_end, local_front_end);
+#else
+    const bool drained = drain(handler, front_end);
+#endif
+    if (!drained)
+        LOG_WARNING("Clients not drained after {} ms, closing them with replies still queued", lifecycle::SHUTDOWN_TIMEOUT_IN_MS);
+    primary.flush();    //the replicas get the tail of the stream
+    lifecycle::g_lifecycle.enter(lifecycle::phase::PERSISTING);
+    persist_on_shutdown();
 }
 
 int main(int argc, char* argv[])
@@ -198,68 +967,102 @@ int main(int argc, char* argv[])
     zmq_version(&major, &minor, &patch);
     std::cout << format::zmq_version_string(major, minor, patch, g_backend);
     
-    signal(SIGINT, sigint_handler);
+    lifecycle::g_lifecycle.open();
+    signal(SIGINT, shutdown_handler);
+#ifdef SIGTERM
+    signal(SIGTERM, shutdown_handler);
+#endif
+#ifdef SIGUSR1
+    if (tracing::ENABLED)
+        signal(SIGUSR1, sigusr1_handler);
+#endif
 
     auto args = parse_args(argc, argv);
+    g_logger.configure(args.loglevel, args.logfile, args.logfile_max_size, args.logfile_max_files);
+    g_command_log.sample_rate = args.log_commands;
+    g_command_log.slower_than_us = args.log_slower_than;
+    slowlog::g_slowlog.log_slower_than_us = args.slowlog_log_slower_than;
+    slowlog::g_slowlog.resize(args.slowlog_max_len);
+    server_stats::g_stats.tcp_port = args.tcp_port;
+    hotkeys::g_sampler.sample_rate = args.hotkeys_sample_rate;
+    command_stats::g_timing.sample_rate = args.latency_sample_rate;
+    scripting::g_scripts.time_limit = args.script_time_limit;
+    //the coarse clock can't tell durations below its resolution
+    const double coarse_resolution_us = std::chrono::duration<double, std::micro>(coarse_clock::resolution()).count();
+    for (const double threshold_us : { static_cast<double>(args.slowlog_log_slower_than), args.log_slower_than })
+        if (threshold_us > 0 && threshold_us < coarse_resolution_us && command_stats::g_timing.sample_rate != 1)
+        {
+            command_stats::g_timing.sample_rate = 1;
+            LOG_INFO("Timing every command, a slow command threshold of {} us is below the {} us coarse clock resolution", threshold_us, coarse_resolution_us);
+        }
+    client_output::g_limits = args.client_output_buffer_limit;
+    snapshot::g_snapshot.filename = args.dbfilename;
+    snapshot::g_snapshot.mappable = args.mmap_snapshot;
+    if (!load_append_only_file(args))
+        load_snapshot(args.dbfilename);
+    open_append_only_file();
+    replication::g_replication.backlog.resize(args.repl_backlog_size);
+    if (args.replicaof)
+        replication::g_replication.replicaof(args.replicaof->first, args.replicaof->second);
 
     void* ctx = zmq_ctx_new();
     if (ctx)
     {
-        void* stream_socket = zmq_socket(ctx, ZMQ_STREAM);
-        if (stream_socket)
+#if defined(__linux__)
+        if (args.transport == "epoll" && args.reactors)
+        {
+            transport::reactor_pool front_end;
+            front_end.pause_reading_above(client_output::g_limits.pause_above());
+            if (front_end.bind(args.tcp_port, args.reactors))
+            {
+                LOG_TRACE_L1("Listening at {} with {} epoll reactors", format::zmq_tcp_address(args.tcp_port), args.reactors);
+                event_loop(ctx, front_end, args);
+            }
+            else
+                LOG_ERROR("Error binding port {}: {}", args.tcp_port, std::strerror(errno));
+        }
+        else if (args.transport == "epoll")
+        {
+            transport::epoll_stream front_end;
+            front_end.pause_reading_above(client_output::g_limits.pause_above());
+            if (front_end.bind(args.tcp_port))
+            {
+                LOG_TRACE_L1("Listening at {} with epoll", format::zmq_tcp_address(args.tcp_port));
+                event_loop(ctx, front_end, args);
+            }
+            else
+                LOG_ERROR("Error binding port {}: {}", args.tcp_port, std::strerror(errno));
+        }
+        else if (args.transport == "io_uring")
+        {
+            transport::uring_stream front_end;
+            front_end.pause_reading_above(client_output::g_limits.pause_above());
+            if (front_end.bind(args.tcp_port))
+            {
+                LOG_TRACE_L1("Listening at {} with io_uring", format::zmq_tcp_address(args.tcp_port));
+                event_loop(ctx, front_end, args);
+            }
+            else
+                LOG_ERROR("Error binding port {} with io_uring: {}", args.tcp_port, std::strerror(errno));
+        }
+        else
+#endif
         {
-            tune_zmq_socket(stream_socket);
-            auto socket_address = format::zmq_tcp_address(args.tcp_port);
-            int rc = zmq_bind(stream_socket, socket_address.c_str());
-            LOG_TRACE_L1("Listening at {}", socket_address);
-            if (rc == 0)
+            transport::zmq_stream front_end{lifecycle::SHUTDOWN_TIMEOUT_IN_MS};
+            front_end.pause_reading_above(client_output::g_limits.pause_above());
+            if (front_end.bind(ctx, args.tcp_port))
             {
-                const int TIMEOUT_IN_MS = 3 * 1000;
-                const char* monitor_address = "inproc://socket-monitor";
-                monitor_zmq_socket monitor(ctx, stream_socket, monitor_address, TIMEOUT_IN_MS);
-                while (running)
-                {
-                    zmq_pollitem_t events[]{ { stream_socket, 0, ZMQ_POLLIN, 0 } };
-                    rc = zmq_poll(&events[0], 1, TIMEOUT_IN_MS);
-                    if (!running) break;
-                    if (rc == 0 || rc == -1) continue;                    
-                    for (int i = 0; i < 1; ++i)
-                    {
-                        if (events[i].socket == stream_socket && (events[i].events & ZMQ_POLLIN))
-                        {
-                            auto req_opt = request_handler(stream_socket);
-                            if (req_opt)
-                            {
-                                auto [client_id, payload] = *req_opt;
-                                if (!payload.empty())
-                                {
-                                    auto cmd_opt = parse_resp_command(payload);
-                                    if (cmd_opt)
-                                    {
-                                        auto cmd_reply = execute_command(Context_t{client_id}, resp::command(std::move(*cmd_opt)));
-                                        using base64 = cppcodec::base64_rfc4648;
-                                        auto id = base64::decode(client_id);
-                                        zmq_send(stream_socket, id.data(), id.size(), ZMQ_SNDMORE);
-                                        zmq_send(stream_socket, cmd_reply.c_str(), cmd_reply.size(), 0);
-                                    }
-                                    else
-                                    {
-                                        LOG_WARNING("Invalid command: {}", payload);                                        
-                                    }
-                                }
-                                else
-                                {
-                                    auto client = Context_t::create_or_remove_client(client_id);
-                                    LOG_INFO("Client {} {}", client.first, client.second ? "created" : "removed");
-                                }
-                            }
-                        }
-                    }
-                }
+                LOG_TRACE_L1("Listening at {}", format::zmq_tcp_address(args.tcp_port));
+                monitor_zmq_socket monitor(ctx, front_end.handle(), "inproc://socket-monitor", TIMEOUT_IN_MS);
+                event_loop(ctx, front_end, args);
             }
-            zmq_close (stream_socket);
+            else
+                LOG_ERROR("Error binding port {}: {}", args.tcp_port, zmq_strerror(zmq_errno()));
         }
+        aof::g_aof.close();
         zmq_ctx_term(ctx);
     }
+    lifecycle::g_lifecycle.enter(lifecycle::phase::STOPPED);
+    LOG_INFO("Server stopped");
     return 0;
 }
\ No newline at end of file
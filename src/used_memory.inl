@@ -0,0 +1,34 @@
+#include <cstddef>
+#include <new>
+
+#include "used_memory.hpp"
+
+//Scalar new/delete counted by used_memory; the array forms forward to these unless the EASTL
+//arena replaces them, and the arena takes its chunks from used_memory as well.
+
+void* operator new(std::size_t size)
+{
+    if (void* p = used_memory::allocate(size))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return used_memory::allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    used_memory::release(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    used_memory::release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    used_memory::release(p);
+}
\ No newline at end of file
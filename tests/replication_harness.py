@@ -0,0 +1,192 @@
+# Source code C++ MasterClass (KV Store project) by Fabio Galuppo
+# C++ MasterClass - https://www.linkedin.com/company/cppmasterclass - https://cppmasterclass.com.br/
+# Fabio Galuppo - http://member.acm.org/~fabiogaluppo - fabiogaluppo@acm.org
+# May 2025
+
+# python replication_harness.py --server=../build/kv_store
+#
+# Starts a primary and a replica on localhost and keeps writing to the primary while it:
+#   1. cuts the replication link for a moment (a TCP proxy sits between replica and primary),
+#      the replica must come back through a partial resynchronization;
+#   2. kills the replica process and starts it again, the new process needs a full sync;
+# then waits for the replica to reach the primary's offset and compares both datasets.
+
+import argparse
+import os
+import random
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import redis
+
+REPL_PORT_OFFSET = 10000
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--server', required=True, help='Path to the kv_store executable')
+parser.add_argument('--port', type=int, default=7100, help='Primary RESP port, default is 7100')
+parser.add_argument('--blip', type=float, default=2.0, help='Seconds the replication link stays down, default is 2')
+parser.add_argument('--keys', type=int, default=2000, help='Distinct keys written per database, default is 2000')
+args = parser.parse_args()
+
+PRIMARY_PORT = args.port
+REPLICA_PORT = args.port + 1
+PROXY_PORT = args.port + 2      # the replica's primary, REPLICAOF 127.0.0.1 PROXY_PORT
+
+class Proxy:
+    """Forwards PROXY_PORT + offset to PRIMARY_PORT + offset and can cut every connection"""
+    def __init__(self, listen_port, target_port):
+        self.target_port = target_port
+        self.down = threading.Event()
+        self.conns = []
+        self.lock = threading.Lock()
+        self.server = socket.create_server(('127.0.0.1', listen_port), reuse_port=False)
+        threading.Thread(target=self.accept, daemon=True).start()
+
+    def accept(self):
+        while True:
+            client, _ = self.server.accept()
+            if self.down.is_set():
+                client.close()
+                continue
+            try:
+                upstream = socket.create_connection(('127.0.0.1', self.target_port))
+            except OSError:
+                client.close()
+                continue
+            with self.lock:
+                self.conns += [client, upstream]
+            threading.Thread(target=self.pipe, args=(client, upstream), daemon=True).start()
+            threading.Thread(target=self.pipe, args=(upstream, client), daemon=True).start()
+
+    def pipe(self, src, dst):
+        try:
+            while data := src.recv(65536):
+                dst.sendall(data)
+        except OSError:
+            pass
+        for s in (src, dst):
+            try: s.shutdown(socket.SHUT_RDWR)
+            except OSError: pass
+
+    def cut(self, seconds):
+        self.down.set()
+        with self.lock:
+            for s in self.conns:
+                try: s.shutdown(socket.SHUT_RDWR)
+                except OSError: pass
+                s.close()
+            self.conns.clear()
+        time.sleep(seconds)
+        self.down.clear()
+
+workdir = tempfile.mkdtemp(prefix='kv_store_repl_')
+
+def start(name, port, *extra):
+    log = open(os.path.join(workdir, f'{name}.log'), 'w')
+    cmd = [args.server, f'--port={port}', f'--dbfilename={os.path.join(workdir, name + ".kvs")}', *extra]
+    return subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT), log.name
+
+def count(logname, text):
+    with open(logname, errors='replace') as f:
+        return f.read().count(text)
+
+def role(port):
+    return redis.Redis(port=port, decode_responses=True).execute_command('ROLE')
+
+def wait_for(predicate, timeout, what):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        try:
+            if predicate():
+                return
+        except redis.ConnectionError:
+            pass
+        time.sleep(0.1)
+    raise TimeoutError(what)
+
+stop_writing = threading.Event()
+written = [0]
+
+def writer():
+    clients = [redis.Redis(port=PRIMARY_PORT, db=db, decode_responses=True) for db in range(4)]
+    while not stop_writing.is_set():
+        r = random.choice(clients)
+        i = random.randrange(args.keys)
+        op = random.random()
+        if op < 0.6:
+            r.set(f'key{i}', f'val{written[0]}')
+        elif op < 0.8:
+            r.sadd(f'set{i % 50}', f'member{i}')
+        elif op < 0.95:
+            r.zadd(f'zset{i % 50}', {f'member{i}': random.random()})
+        else:
+            r.delete(f'key{i}')
+        written[0] += 1
+
+def converged():
+    primary_offset = int(role(PRIMARY_PORT)[1])
+    replica_role = role(REPLICA_PORT)
+    return replica_role[3] == 'connected' and int(replica_role[4]) == primary_offset
+
+def compare():
+    for db in range(4):
+        p = redis.Redis(port=PRIMARY_PORT, db=db, decode_responses=True)
+        r = redis.Redis(port=REPLICA_PORT, db=db, decode_responses=True)
+        assert p.dbsize() == r.dbsize(), f'db {db}: dbsize {p.dbsize()} != {r.dbsize()}'
+        for key in p.keys('*'):
+            kind = p.type(key)
+            if kind == 'string':
+                assert p.get(key) == r.get(key), f'db {db}: {key} differs'
+            elif kind == 'set':
+                assert p.smembers(key) == r.smembers(key), f'db {db}: {key} differs'
+            elif kind == 'zset':
+                assert p.zrange(key, 0, -1, withscores=True) == r.zrange(key, 0, -1, withscores=True), f'db {db}: {key} differs'
+
+primary, primary_log = start('primary', PRIMARY_PORT)
+proxy = Proxy(PROXY_PORT + REPL_PORT_OFFSET, PRIMARY_PORT + REPL_PORT_OFFSET)
+replica_args = ('--replicaof', '127.0.0.1', str(PROXY_PORT))
+replica, replica_log = start('replica', REPLICA_PORT, *replica_args)
+failed = False
+try:
+    wait_for(lambda: redis.Redis(port=PRIMARY_PORT).ping() and redis.Redis(port=REPLICA_PORT).ping(), 10, 'servers up')
+    threading.Thread(target=writer, daemon=True).start()
+    wait_for(lambda: role(REPLICA_PORT)[3] == 'connected', 10, 'initial sync')
+    print(f'Replica connected, full syncs: {count(primary_log, "Full resynchronization")}')
+
+    time.sleep(1)
+    print(f'Cutting the replication link for {args.blip}s under write load...')
+    full_before = count(primary_log, 'Full resynchronization')
+    proxy.cut(args.blip)
+    wait_for(lambda: count(primary_log, 'Partial resynchronization') > 0, 30, 'partial resync')
+    full_after = count(primary_log, 'Full resynchronization')
+    print(f'Partial resynchronizations: {count(primary_log, "Partial resynchronization")}, new full syncs: {full_after - full_before}')
+    assert full_after == full_before, 'the link blip caused a full sync'
+
+    time.sleep(1)
+    print('Killing the replica under write load and starting it again...')
+    replica.send_signal(signal.SIGKILL)
+    replica.wait()
+    replica, replica_log = start('replica', REPLICA_PORT, *replica_args)
+    wait_for(lambda: count(primary_log, 'Full resynchronization') > full_after, 30, 'full sync after restart')
+    print('Restarted replica resynchronized')
+
+    time.sleep(1)
+    stop_writing.set()
+    wait_for(converged, 30, 'replica reaching the primary offset')
+    compare()
+    print(f'OK: {written[0]} writes replicated, datasets match')
+except Exception as e:
+    failed = True
+    print(f'FAILED: {e!r} (logs in {workdir})')
+finally:
+    stop_writing.set()
+    for p in (replica, primary):
+        p.send_signal(signal.SIGINT)
+    for p in (replica, primary):
+        try: p.wait(timeout=10)
+        except subprocess.TimeoutExpired: p.kill()
+sys.exit(1 if failed else 0)
\ No newline at end of file
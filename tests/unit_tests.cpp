@@ -4,15 +4,35 @@
 //May 2025
 
 #include <algorithm>
+#include <csignal>
+#include <filesystem>
+#include <sstream>
 #include <string_view>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
+#include "aof.hpp"
 #include "backend.hpp"
+#include "client_output_limit.hpp"
+#include "command_stats.hpp"
 #include "execute_command.hpp"
+#include "hdr_histogram.hpp"
+#include "hotkeys.hpp"
+#include "lifecycle.hpp"
+#include "metrics.hpp"
+#include "replication.hpp"
+#include "server_stats.hpp"
 #include "resp_command_parser.hpp"
+#include "scripting.hpp"
+#include "slowlog.hpp"
+#include "spsc_queue.hpp"
+#include "timer_wheel.hpp"
+#include "tracing.hpp"
+#include "snapshot.hpp"
 
 #include "../src/eastl_stub_allocator.inl"
 
@@ -599,4 +619,908 @@ TEST_CASE_FIXTURE(unit_test_fixture, "PING")
         resp::command{"PING"sv}
     );
     CHECK(cmd_reply == resp::pong());
+}
+
+struct snapshot_test_fixture : unit_test_fixture
+{
+    snapshot_test_fixture()
+    {
+        snapshot::g_snapshot.filename = (std::filesystem::temp_directory_path() / "kv_store_unit_tests.kvs").string();
+    }
+
+    ~snapshot_test_fixture()
+    {
+        std::filesystem::remove(snapshot::g_snapshot.filename);
+        snapshot::g_snapshot.mappable = false;
+    }
+
+    void populate()
+    {
+        execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+        execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY2"sv, "-1234567890"sv});
+        execute_command(Context_t{client_id}, resp::command{"SADD"sv, "SET1"sv, "KEY1"sv, "KEY2"sv});
+        execute_command(Context_t{client_id}, resp::command{"SADD"sv, "SET2"sv, "1"sv, "2"sv, "300000"sv});
+        execute_command(Context_t{client_id}, resp::command{"ZADD"sv, "ZSET1"sv, "99.9"sv, "KEY1"sv, "-1"sv, "KEY2"sv});
+        execute_command(Context_t{client_id}, resp::command{"ZADD"sv, "ZSET2"sv, "1700000000"sv, "req-1"sv});
+        execute_command(Context_t{client_id}, resp::command{"SELECT"sv, "7"sv});
+        execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY7"sv, "VAL7"sv});
+        execute_command(Context_t{client_id}, resp::command{"SELECT"sv, "0"sv});
+    }
+
+    void verify()
+    {
+        CHECK(execute_command(Context_t{client_id}, resp::command{"DBSIZE"sv}) == resp::integer(6));
+        CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY1"sv}) == resp::simple_string("VAL1"sv));
+        CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY2"sv}) == resp::simple_string("-1234567890"sv));
+        CHECK(execute_command(Context_t{client_id}, resp::command{"SCARD"sv, "SET1"sv}) == resp::integer(2));
+        CHECK(execute_command(Context_t{client_id}, resp::command{"SISMEMBER"sv, "SET2"sv, "300000"sv}) == resp::integer(1));
+        CHECK(execute_command(Context_t{client_id}, resp::command{"ZSCORE"sv, "ZSET1"sv, "KEY1"sv}) == resp::simple_string("99.9"sv));
+        CHECK(execute_command(Context_t{client_id}, resp::command{"ZSCORE"sv, "ZSET1"sv, "KEY2"sv}) == resp::simple_string("-1"sv));
+        CHECK(execute_command(Context_t{client_id}, resp::command{"ZSCORE"sv, "ZSET2"sv, "req-1"sv}) == resp::simple_string("1700000000"sv));
+        execute_command(Context_t{client_id}, resp::command{"SELECT"sv, "7"sv});
+        CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY7"sv}) == resp::simple_string("VAL7"sv));
+    }
+};
+
+TEST_CASE_FIXTURE(snapshot_test_fixture, "SAVE") 
+{
+    populate();
+    auto cmd_reply = execute_command
+    (
+        Context_t{client_id},
+        resp::command{"SAVE"sv}
+    );
+    CHECK(cmd_reply == resp::ok());
+    clear_all_databases();
+    CHECK(snapshot::load(snapshot::g_snapshot.filename, g_databases) == 7);
+    verify();
+}
+
+TEST_CASE_FIXTURE(snapshot_test_fixture, "BGSAVE") 
+{
+    populate();
+    auto cmd_reply = execute_command
+    (
+        Context_t{client_id},
+        resp::command{"BGSAVE"sv}
+    );
+    CHECK(cmd_reply == resp::background_saving_started());
+    snapshot::poll_background_save(true);
+    CHECK(snapshot::g_snapshot.last_save_ok);
+    clear_all_databases();
+    CHECK(snapshot::load(snapshot::g_snapshot.filename, g_databases) == 7);
+    verify();
+}
+
+TEST_CASE_FIXTURE(snapshot_test_fixture, "SAVE MAPPABLE") 
+{
+    snapshot::g_snapshot.mappable = true;
+    populate();
+    auto cmd_reply = execute_command
+    (
+        Context_t{client_id},
+        resp::command{"SAVE"sv}
+    );
+    CHECK(cmd_reply == resp::ok());
+    clear_all_databases();
+    CHECK(snapshot::load(snapshot::g_snapshot.filename, g_databases) == 7);
+    CHECK(g_databases[0].is_mapped("KEY1"));
+    verify();
+    CHECK(g_databases[0].is_mapped("KEY1"));
+    CHECK(!g_databases[0].is_mapped("SET1"));
+    execute_command(Context_t{client_id}, resp::command{"SELECT"sv, "0"sv});
+    auto cmd_reply_2 = execute_command
+    (
+        Context_t{client_id},
+        resp::command{"SET"sv, "KEY1"sv, "VAL2"sv}
+    );
+    CHECK(cmd_reply_2 == resp::ok());
+    CHECK(!g_databases[0].is_mapped("KEY1"));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY1"sv}) == resp::simple_string("VAL2"sv));
+}
+
+TEST_CASE("MAPPED VALUE BOUNDS") 
+{
+    //count 1, length 4, "KEY1"
+    const std::string payload{"\x01\0\0\0\0\0\0\0\x04\0\0\0KEY1", 16};
+    std::unordered_set<std::string> set;
+    mapped_layout::decode_set(MappedValue_t{DbValueTypeEnum::SET, payload.data(), payload.size()}, set);
+    CHECK(set.contains("KEY1"));
+    std::string length_past_end = payload;
+    length_past_end[8] = '\x05';
+    CHECK_THROWS(mapped_layout::decode_set(MappedValue_t{DbValueTypeEnum::SET, length_past_end.data(), length_past_end.size()}, set));
+    std::string count_past_end = payload;
+    count_past_end[7] = '\x7F';
+    CHECK_THROWS(mapped_layout::decode_set(MappedValue_t{DbValueTypeEnum::SET, count_past_end.data(), count_past_end.size()}, set));
+    CHECK_THROWS(mapped_layout::decode_set(MappedValue_t{DbValueTypeEnum::SET, payload.data(), 4}, set));
+    g_databases[0].Dict["SET1"] = MappedValue_t{DbValueTypeEnum::SET, payload.data(), 4};
+    CHECK_THROWS(g_databases[0].usage("SET1"));
+    g_databases[0].Dict["SET1"] = MappedValue_t{DbValueTypeEnum::SET, payload.data(), payload.size()};
+    CHECK(g_databases[0].usage("SET1")->Elements == 1);
+    g_databases[0].del("SET1");
+}
+
+TEST_CASE("SNAPSHOT CHECKSUM") 
+{
+    g_databases[0].Strings("KEY1") = "VAL1";
+    auto image = snapshot::save_to_string(g_databases);
+    clear_all_databases();
+    image[image.find("VAL1")] = 'X';
+    bool rejected = false;
+    try { snapshot::load_from_string(image, g_databases); }
+    catch (const std::runtime_error&) { rejected = true; }
+    CHECK(rejected);
+    clear_all_databases();
+}
+
+struct aof_test_fixture : snapshot_test_fixture
+{
+    aof_test_fixture()
+    {
+        aof::g_aof.filename = (std::filesystem::temp_directory_path() / "kv_store_unit_tests.aof").string();
+    }
+
+    ~aof_test_fixture()
+    {
+        aof::g_aof.close();
+        std::filesystem::remove(aof::g_aof.filename);
+    }
+};
+
+TEST_CASE_FIXTURE(aof_test_fixture, "BGREWRITEAOF") 
+{
+    populate();
+    auto cmd_reply = execute_command
+    (
+        Context_t{client_id},
+        resp::command{"BGREWRITEAOF"sv}
+    );
+    CHECK(cmd_reply == resp::background_rewrite_started());
+    aof::g_aof.poll_background_rewrite(true);
+    CHECK(aof::g_aof.last_rewrite_ok);
+    clear_all_databases();
+    auto applied = aof::replay<Context_t, Strategy_t>(aof::g_aof.filename);
+    CHECK(applied == 9);
+    verify();
+}
+
+TEST_CASE_FIXTURE(aof_test_fixture, "AOF ENABLED AFTER SAVE") 
+{
+    populate();
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SAVE"sv}) == resp::ok());
+    //restart with appendonly: no log yet, so the snapshot is loaded and written to the log
+    clear_all_databases();
+    CHECK(snapshot::load(snapshot::g_snapshot.filename, g_databases) == 7);
+    CHECK(aof::g_aof.open_or_create(g_databases));
+    aof::g_aof.feed(0, resp::command{"SET"sv, "KEY3"sv, "VAL3"sv});
+    aof::g_aof.close();
+    //restart again: only the log is replayed
+    clear_all_databases();
+    CHECK(aof::replay<Context_t, Strategy_t>(aof::g_aof.filename) > 0);
+    CHECK(!aof::g_aof.open_or_create(g_databases));
+    aof::g_aof.close();
+    CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY3"sv}) == resp::simple_string("VAL3"sv));
+    execute_command(Context_t{client_id}, resp::command{"DEL"sv, "KEY3"sv});
+    verify();
+}
+
+TEST_CASE_FIXTURE(aof_test_fixture, "AOF REPLAY") 
+{
+    aof::g_aof.open();
+    aof::g_aof.feed(0, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    aof::g_aof.feed(0, resp::command{"ZADD"sv, "ZSET1"sv, "1"sv, "KEY1"sv, "2"sv, "KEY2"sv});
+    aof::g_aof.feed(3, resp::command{"SADD"sv, "SET1"sv, "KEY1"sv});
+    aof::g_aof.feed(0, resp::command{"ZREMRANGEBYSCORE"sv, "ZSET1"sv, "0"sv, "1"sv});
+    aof::g_aof.close();
+    {
+        std::FILE* file = std::fopen(aof::g_aof.filename.c_str(), "ab");
+        std::fputs("*3\r\n$3\r\nSET\r\n$4\r\nKEY2", file); //torn tail
+        std::fclose(file);
+    }
+    auto applied = aof::replay<Context_t, Strategy_t>(aof::g_aof.filename);
+    CHECK(applied == 7);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY1"sv}) == resp::simple_string("VAL1"sv));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"EXISTS"sv, "KEY2"sv}) == resp::integer(0));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"ZCARD"sv, "ZSET1"sv}) == resp::integer(1));
+    execute_command(Context_t{client_id}, resp::command{"SELECT"sv, "3"sv});
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SCARD"sv, "SET1"sv}) == resp::integer(1));
+    auto truncated_applied = aof::replay<Context_t, Strategy_t>(aof::g_aof.filename);
+    CHECK(truncated_applied == 7);
+}
+
+#if defined(__linux__)
+TEST_CASE("AOF WRITE ERROR") 
+{
+    aof::append_only_file aof_file;
+    aof_file.filename = "/dev/full";    //every write fails with ENOSPC
+    aof_file.open();
+    aof_file.feed(0, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    aof_file.flush();
+    CHECK_FALSE(aof_file.last_write_ok);
+    CHECK(aof_file.rejects_writes());
+}
+#endif
+
+TEST_CASE_FIXTURE(aof_test_fixture, "AOF REPLAY CORRUPT") 
+{
+    aof::g_aof.open();
+    aof::g_aof.feed(0, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    aof::g_aof.close();
+    const auto offset = std::filesystem::file_size(aof::g_aof.filename);
+    {
+        std::FILE* file = std::fopen(aof::g_aof.filename.c_str(), "ab");
+        std::fputs("*3\r\n$3\r\nSET\r\n#4\r\nKEY2\r\n$4\r\nVAL2\r\n", file); //corrupt byte
+        std::fputs("*3\r\n$3\r\nSET\r\n$4\r\nKEY3\r\n$4\r\nVAL3\r\n", file);
+        std::fclose(file);
+    }
+    const auto size = std::filesystem::file_size(aof::g_aof.filename);
+    std::size_t error_offset{};
+    try
+    {
+        aof::replay<Context_t, Strategy_t>(aof::g_aof.filename);
+    }
+    catch (const aof::corrupt_log_error& e)
+    {
+        error_offset = e.offset;
+    }
+    CHECK(error_offset == offset);
+    CHECK(std::filesystem::file_size(aof::g_aof.filename) == size);
+}
+
+struct replication_test_fixture : unit_test_fixture
+{
+    ~replication_test_fixture()
+    {
+        auto& state = replication::g_replication;
+        state.replicaof_no_one();
+        state.reconfigured = false;
+        state.backlog.resize(replication::DEFAULT_BACKLOG_SIZE);
+        state.reset(replication::random_replid(), 0);
+        if (Context_t::find_client(replication::MASTER_CLIENT_ID))
+            Context_t::create_or_remove_client(replication::MASTER_CLIENT_ID);
+    }
+};
+
+TEST_CASE_FIXTURE(replication_test_fixture, "REPLICAOF") 
+{
+    auto cmd_reply_1 = execute_command(Context_t{client_id}, resp::command{"REPLICAOF"sv, "127.0.0.1"sv, "1234"sv});
+    auto cmd_reply_2 = execute_command(Context_t{client_id}, resp::command{"ROLE"sv});
+    bool set_rejected = replication::rejects_write("SET");
+    bool get_rejected = replication::rejects_write("GET");
+    auto cmd_reply_3 = execute_command(Context_t{client_id}, resp::command{"REPLICAOF"sv, "no"sv, "one"sv});
+    auto cmd_reply_4 = execute_command(Context_t{client_id}, resp::command{"ROLE"sv});
+    auto cmd_reply_5 = execute_command(Context_t{client_id}, resp::command{"REPLICAOF"sv, "127.0.0.1"sv, "port"sv});
+    std::vector<std::string> role_1{ "slave", "127.0.0.1", "1234", "connect", "0" };
+    std::vector<std::string> role_2{ "master", "0", "0" };
+    CHECK(cmd_reply_1 == resp::ok());
+    CHECK(cmd_reply_2 == resp::array(role_1.begin(), role_1.end()));
+    CHECK(set_rejected);
+    CHECK(!get_rejected);
+    CHECK(cmd_reply_3 == resp::ok());
+    CHECK(cmd_reply_4 == resp::array(role_2.begin(), role_2.end()));
+    CHECK(cmd_reply_5 == resp::error_value_is_not_an_integer_or_out_of_range());
+}
+
+TEST_CASE_FIXTURE(replication_test_fixture, "REPLICATION STREAM") 
+{
+    auto& state = replication::g_replication;
+    state.feed(0, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    state.feed(0, resp::command{"SADD"sv, "SET1"sv, "KEY1"sv, "KEY2"sv});
+    auto middle = state.master_repl_offset();
+    state.feed(2, resp::command{"ZADD"sv, "ZSET1"sv, "1"sv, "KEY1"sv});
+    state.feed(0, resp::command{"DEL"sv, "KEY1"sv});
+    auto offset = state.master_repl_offset();
+    auto stream = state.backlog.copy(0);
+    CHECK(stream.size() == offset);
+    state.reset(state.replid, 0);
+    std::string_view sv = stream;
+    auto consumed_1 = replication::apply<Context_t, Strategy_t>(sv.substr(0, middle));
+    CHECK(consumed_1 == middle);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY1"sv}) == resp::simple_string("VAL1"sv));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SCARD"sv, "SET1"sv}) == resp::integer(2));
+    auto consumed_2 = replication::apply<Context_t, Strategy_t>(sv.substr(middle, 5)); //torn command
+    CHECK(consumed_2 == 0);
+    auto consumed_3 = replication::apply<Context_t, Strategy_t>(sv.substr(middle));
+    CHECK(consumed_3 == offset - middle);
+    CHECK(state.master_repl_offset() == offset);
+    CHECK(state.backlog.copy(0) == stream);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"EXISTS"sv, "KEY1"sv}) == resp::integer(0));
+    execute_command(Context_t{client_id}, resp::command{"SELECT"sv, "2"sv});
+    CHECK(execute_command(Context_t{client_id}, resp::command{"ZCARD"sv, "ZSET1"sv}) == resp::integer(1));
+}
+
+TEST_CASE_FIXTURE(replication_test_fixture, "REPLICATION MASTER LINK") 
+{
+    auto& state = replication::g_replication;
+    state.feed(2, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    auto middle = state.master_repl_offset();
+    state.feed(2, resp::command{"SET"sv, "KEY2"sv, "VAL2"sv});
+    auto stream = state.backlog.copy(0);
+    state.reset(state.replid, 0);
+    std::string_view sv = stream;
+    CHECK(replication::apply<Context_t, Strategy_t>(sv.substr(0, middle)) == middle);
+    auto master_number = std::to_string(Context_t::find_client(replication::MASTER_CLIENT_ID)->ClientNumber);
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"CLIENT"sv, "KILL"sv, "ID"sv, master_number});
+    CHECK(cmd_reply == resp::integer(0));
+    Context_t::create_or_remove_client(replication::MASTER_CLIENT_ID);
+    CHECK(replication::apply<Context_t, Strategy_t>(sv.substr(middle)) == stream.size() - middle);
+    execute_command(Context_t{client_id}, resp::command{"SELECT"sv, "2"sv});
+    CHECK(execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY2"sv}) == resp::simple_string("VAL2"sv));
+}
+
+TEST_CASE_FIXTURE(replication_test_fixture, "REPLICATION BACKLOG") 
+{
+    auto& state = replication::g_replication;
+    state.backlog.resize(64);
+    for (int i = 0; i < 10; ++i)
+        state.feed(0, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    auto offset = state.master_repl_offset();
+    CHECK(state.backlog.size() == 64);
+    CHECK(!state.backlog.contains(offset - 65));
+    CHECK(state.backlog.contains(offset - 64));
+    CHECK(state.backlog.contains(offset));
+    CHECK(!state.backlog.contains(offset + 1));
+    CHECK(state.backlog.copy(offset - 33) == "*3\r\n$3\r\nSET\r\n$4\r\nKEY1\r\n$4\r\nVAL1\r\n");
+}
+
+TEST_CASE_FIXTURE(replication_test_fixture, "PSYNC") 
+{
+    auto& state = replication::g_replication;
+    state.feed(0, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    auto offset = state.master_repl_offset();
+    CHECK(state.can_partial_resync(state.replid, 0));
+    CHECK(state.can_partial_resync(state.replid, offset));
+    CHECK(!state.can_partial_resync(state.replid, offset + 1));
+    CHECK(!state.can_partial_resync(replication::random_replid(), offset));
+    state.backlog.resize(16);
+    state.feed(0, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    CHECK(!state.can_partial_resync(state.replid, offset));
+    //failover: replicas of the former primary continue with the promoted replica
+    auto former_replid = state.replid;
+    offset = state.master_repl_offset();
+    state.replicaof("127.0.0.1", 1234);
+    state.replicaof_no_one();
+    CHECK(state.replid != former_replid);
+    CHECK(state.can_partial_resync(former_replid, offset));
+    state.feed(0, resp::command{"DEL"sv, "KEY1"sv});
+    CHECK(!state.can_partial_resync(former_replid, state.master_repl_offset()));
+    CHECK(state.can_partial_resync(state.replid, state.master_repl_offset()));
+}
+
+TEST_CASE("HDR HISTOGRAM") 
+{
+    hdr_histogram h;
+    for (std::uint64_t i = 1; i <= 1000000; ++i)
+        h.record(i);
+    CHECK(h.count() == 1000000);
+    CHECK(h.min() == 1);
+    CHECK(h.max() == 1000000);
+    CHECK(h.percentile(100) == 1000000);
+    //reported values stay within 1% of the exact percentile
+    CHECK(h.percentile(50) >= 500000);
+    CHECK(h.percentile(50) <= 505000);
+    CHECK(h.percentile(99) >= 990000);
+    CHECK(h.percentile(99) <= 999900);
+    hdr_histogram other;
+    other.record(5, 10);
+    h.merge(other);
+    CHECK(h.count() == 1000010);
+    CHECK(h.min() == 1);
+}
+
+struct command_stats_test_fixture : unit_test_fixture
+{
+    ~command_stats_test_fixture()
+    {
+        command_stats::g_command_stats.reset();
+    }
+
+    void record(const std::string& cmd_name, std::uint64_t ns, bool failed = false)
+    {
+        command_stats::g_command_stats.record(cmd_name, ns, failed, false, command_stats::clock_type::now());
+    }
+};
+
+TEST_CASE_FIXTURE(command_stats_test_fixture, "INFO COMMANDSTATS") 
+{
+    record("GET", 500);
+    record("GET", 3500);
+    record("SET", 2000, true);
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"INFO"sv, "commandstats"sv});
+    CHECK(cmd_reply.find("cmdstat_get:calls=2,usec=4,usec_per_call=2.00,rejected_calls=0,failed_calls=0\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("cmdstat_set:calls=1,usec=2,usec_per_call=2.00,rejected_calls=0,failed_calls=1\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("# Latencystats") == std::string::npos);
+    cmd_reply = execute_command(Context_t{client_id}, resp::command{"INFO"sv, "latencystats"sv});
+    CHECK(cmd_reply.find("latency_percentiles_usec_get:p50=0.511,p99=3.583,p99.9=3.583\r\n") != std::string::npos);
+}
+
+TEST_CASE_FIXTURE(command_stats_test_fixture, "LATENCY SAMPLING") 
+{
+    command_stats::timing_policy timing{4};
+    int timed = 0;
+    for (int i = 0; i < 12; ++i)
+        timed += timing.should_time();
+    CHECK(timed == 3);
+    timing.sample_rate = 0;
+    CHECK(!timing.should_time());
+
+    record("GET", 2000);
+    for (int i = 0; i < 3; ++i)
+        command_stats::g_command_stats.record("GET", false, false);
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"INFO"sv, "commandstats"sv});
+    CHECK(cmd_reply.find("cmdstat_get:calls=4,usec=8,usec_per_call=2.00,") != std::string::npos);
+
+    const auto before = coarse_clock::g_clock.now();
+    CHECK(coarse_clock::g_clock.update() >= before);
+    CHECK(coarse_clock::resolution().count() > 0);
+}
+
+TEST_CASE_FIXTURE(command_stats_test_fixture, "LATENCY") 
+{
+    record("GET", 500);
+    record("GET", 3000);
+    record("SET", 2000000);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"LATENCY"sv, "HISTOGRAM"sv, "get"sv}) == 
+        "*2\r\n$3\r\nget\r\n*4\r\n$5\r\ncalls\r\n:2\r\n$14\r\nhistogram_usec\r\n*4\r\n:1\r\n:1\r\n:4\r\n:2\r\n");
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"LATENCY"sv, "LATEST"sv});
+    CHECK(cmd_reply.starts_with("*2\r\n*4\r\n$3\r\nget\r\n"));
+    CHECK(cmd_reply.ends_with(":2\r\n:2\r\n"));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"LATENCY"sv, "RESET"sv}) == resp::integer(2));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"LATENCY"sv, "LATEST"sv}) == resp::empty_array());
+    CHECK(execute_command(Context_t{client_id}, resp::command{"LATENCY"sv, "DOCTOR"sv}) == resp::error_unknown_subcommand("DOCTOR"));
+}
+
+TEST_CASE("LATENCY HISTOGRAM PRECISION") 
+{
+    command_stats::latency_histogram h;
+    for (std::uint64_t i = 1; i <= 100000; ++i)
+        h.record(i);
+    CHECK(h.count() == 100000);
+    CHECK(h.percentile(50) >= 50000);
+    CHECK(h.percentile(50) <= 53125);
+    CHECK(h.percentile(99.9) >= 99900);
+    CHECK(h.percentile(99.9) <= 106144);
+    CHECK(h.percentile(0) == 1);
+}
+
+struct slowlog_test_fixture : unit_test_fixture
+{
+    ~slowlog_test_fixture()
+    {
+        slowlog::g_slowlog.log_slower_than_us = slowlog::DEFAULT_LOG_SLOWER_THAN_US;
+        slowlog::g_slowlog.resize(slowlog::DEFAULT_MAX_LEN);
+    }
+};
+
+TEST_CASE_FIXTURE(slowlog_test_fixture, "SLOWLOG") 
+{
+    auto& log = slowlog::g_slowlog;
+    log.resize(2);
+    log.log_slower_than_us = 100;
+    log.record(resp::command{"GET"sv, "KEY1"sv}, 99, "ID1", "", "");
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SLOWLOG"sv, "LEN"sv}) == resp::integer(0));
+    log.record(resp::command{"SINTER"sv, "S1"sv, "S2"sv}, 150, "ID1", "conn1", "redis-py");
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SLOWLOG"sv, "GET"sv}) ==
+        "*1\r\n*7\r\n:0\r\n:" + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()) +
+        "\r\n:150\r\n*3\r\n$6\r\nSINTER\r\n$2\r\nS1\r\n$2\r\nS2\r\n$3\r\nID1\r\n$5\r\nconn1\r\n$8\r\nredis-py\r\n");
+    std::string big(200, 'x');
+    std::vector<std::string_view> args{ "DEL"sv };
+    for (int i = 0; i < 40; ++i)
+        args.push_back(big);
+    log.record(resp::command{std::move(args)}, 200, "ID2", "", "");
+    log.record(resp::command{"ZRANGE"sv, "Z1"sv, "0"sv, "-1"sv}, 300, "ID3", "", "");
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SLOWLOG"sv, "LEN"sv}) == resp::integer(2));
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"SLOWLOG"sv, "GET"sv, "-1"sv});
+    CHECK(cmd_reply.starts_with("*2\r\n*7\r\n:2\r\n"));
+    CHECK(cmd_reply.find("*32\r\n$3\r\nDEL\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("... (72 more bytes)") != std::string::npos);
+    CHECK(cmd_reply.find("... (10 more arguments)") != std::string::npos);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SLOWLOG"sv, "GET"sv, "1"sv}).starts_with("*1\r\n*7\r\n:2\r\n"));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SLOWLOG"sv, "RESET"sv}) == resp::ok());
+    CHECK(execute_command(Context_t{client_id}, resp::command{"SLOWLOG"sv, "GET"sv}) == resp::empty_array());
+}
+
+TEST_CASE_FIXTURE(unit_test_fixture, "INFO") 
+{
+    auto& stats = server_stats::g_stats;
+    const auto hits = stats.keyspace_hits, misses = stats.keyspace_misses;
+    execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    execute_command(Context_t{client_id}, resp::command{"SADD"sv, "SET1"sv, "A"sv});
+    execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY1"sv});
+    execute_command(Context_t{client_id}, resp::command{"GET"sv, "KEY2"sv});
+    execute_command(Context_t{client_id}, resp::command{"SISMEMBER"sv, "SET1"sv, "A"sv});
+    CHECK(stats.keyspace_hits == hits + 2);
+    CHECK(stats.keyspace_misses == misses + 1);
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"INFO"sv});
+    for (auto section : { "# Server\r\n"sv, "# Clients\r\n"sv, "# Memory\r\n"sv, "# Stats\r\n"sv, "# Keyspace\r\n"sv })
+        CHECK(cmd_reply.find(section) != std::string::npos);
+    CHECK(cmd_reply.find("connected_clients:1\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("db0:keys=2,expires=0,avg_ttl=0\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("# Commandstats") == std::string::npos);
+    cmd_reply = execute_command(Context_t{client_id}, resp::command{"INFO"sv, "keyspace"sv, "stats"sv});
+    CHECK(cmd_reply.find("# Stats\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("keyspace_hits:" + std::to_string(stats.keyspace_hits) + "\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("# Server") == std::string::npos);
+    cmd_reply = execute_command(Context_t{client_id}, resp::command{"INFO"sv, "all"sv});
+    CHECK(cmd_reply.find("# Commandstats\r\n") != std::string::npos);
+    CHECK(cmd_reply.find("# Latencystats\r\n") != std::string::npos);
+    CHECK(server_stats::bytes_to_human(1023) == "1023B");
+    CHECK(server_stats::bytes_to_human(1536) == "1.50K");
+    CHECK(server_stats::bytes_to_human(3 * 1024 * 1024) == "3.00M");
+}
+
+TEST_CASE("INSTANTANEOUS METRIC") 
+{
+    using namespace std::chrono_literals;
+    server_stats::instantaneous_metric metric;
+    const server_stats::clock_type::time_point t0{};
+    CHECK(metric.rate(t0, 0) == 0);
+    for (int i = 0; i <= 20; ++i)
+        metric.track(t0 + i * 100ms, i * 1000);
+    CHECK(metric.rate(t0 + 2000ms, 20000) == doctest::Approx(10000));
+    //snapshots closer than the sample period are ignored
+    metric.track(t0 + 2050ms, 99999);
+    CHECK(metric.rate(t0 + 2100ms, 21000) == doctest::Approx(10000));
+    //idle: no new commands over the whole window
+    CHECK(metric.rate(t0 + 10000ms, 20000) == 0);
+}
+
+TEST_CASE_FIXTURE(unit_test_fixture, "CLIENT INFO") 
+{
+    auto& client = Context_t{client_id}.Client();
+    client.QueryBuffer = "*2\r\n$3\r\nGET\r\n";
+    client.ReplyBuffer = "+OK\r\n";
+    client.OutputBytes = 1024;   //reported by the front end
+    client.LastInteraction -= std::chrono::seconds(5);
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"CLIENT"sv, "INFO"sv});
+    CHECK(cmd_reply.find(" idle=5 ") != std::string::npos);
+    CHECK(cmd_reply.find(" obl=1024 ") != std::string::npos);
+    CHECK(cmd_reply.find(" omem=") != std::string::npos);
+    CHECK(cmd_reply.find(" qbuf=13 ") != std::string::npos);
+    CHECK(cmd_reply.find(" tot-mem=0") == std::string::npos);
+}
+
+TEST_CASE_FIXTURE(unit_test_fixture, "CLIENT LIST KILL") 
+{
+    const auto& client = Context_t{client_id}.Client();
+    const auto id = std::to_string(client.ClientNumber);
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"CLIENT"sv, "LIST"sv});
+    CHECK(cmd_reply.find(" id=" + id + " ") != std::string::npos);
+    cmd_reply = execute_command(Context_t{client_id}, resp::command{"CLIENT"sv, "KILL"sv, "ID"sv, std::string_view{id}});
+    CHECK(cmd_reply == resp::integer(1));
+    CHECK(client.CloseAsap);
+    REQUIRE(g_clients_to_close.size() == 1);
+    CHECK(g_clients_to_close[0] == client_id);
+    cmd_reply = execute_command(Context_t{client_id}, resp::command{"CLIENT"sv, "KILL"sv, "ID"sv, std::string_view{id}});
+    CHECK(cmd_reply == resp::integer(0));
+    cmd_reply = execute_command(Context_t{client_id}, resp::command{"CLIENT"sv, "KILL"sv, "ADDR"sv, "1"sv});
+    CHECK(cmd_reply == resp::error_syntax_error());
+    g_clients_to_close.clear();
+}
+
+TEST_CASE_FIXTURE(unit_test_fixture, "MULTI EXEC WATCH") 
+{
+    auto exec = [&](auto... args) { return execute_command(Context_t{client_id}, resp::command{std::string_view{args}...}); };
+    CHECK(exec("EXEC") == resp::error_exec_without_multi());
+    CHECK(exec("DISCARD") == resp::error_discard_without_multi());
+    CHECK(exec("MULTI") == resp::ok());
+    CHECK(exec("MULTI") == resp::error_multi_calls_can_not_be_nested());
+    CHECK(exec("WATCH", "KEY1") == resp::error_watch_inside_multi());
+    CHECK(exec("SET", "KEY1", "VAL1") == resp::queued());
+    CHECK(exec("GET", "KEY1") == resp::queued());
+    CHECK(Context_t{client_id}.Client().CurrentDb().size() == 0);
+    CHECK(exec("EXEC") == "*2\r\n"s + resp::ok() + resp::simple_string("VAL1"sv));
+    CHECK(exec("MULTI") == resp::ok());
+    CHECK(exec("SET", "KEY1", "VAL2") == resp::queued());
+    CHECK(exec("DISCARD") == resp::ok());
+    CHECK(exec("GET", "KEY1") == resp::simple_string("VAL1"sv));
+
+    CHECK(exec("MULTI") == resp::ok());
+    CHECK(exec("SET", "KEY1", "VAL2") == resp::queued());
+    CHECK(exec("GET", "KEY1", "KEY2") == resp::error_wrong_number_of_arguments_for_command());
+    CHECK(exec("EXEC") == resp::error_execabort());
+    CHECK(exec("MULTI") == resp::ok());
+    CHECK(exec("NOSUCHCOMMAND", "KEY1") == resp::error_unknown_command("NOSUCHCOMMAND"));
+    CHECK(exec("SADD", "SET1") == resp::error_wrong_number_of_arguments_for_command());
+    CHECK(exec("EXEC") == resp::error_execabort());
+    CHECK(exec("GET", "KEY1") == resp::simple_string("VAL1"sv));
+
+    CHECK(exec("WATCH", "KEY1", "KEY2") == resp::ok());
+    CHECK(exec("GET", "KEY1") == resp::simple_string("VAL1"sv));
+    CHECK(exec("MULTI") == resp::ok());
+    CHECK(exec("SET", "KEY2", "VAL2") == resp::queued());
+    CHECK(exec("EXEC") == "*1\r\n"s + resp::ok());
+    CHECK(g_databases[0].Watched.empty());
+
+    CHECK(exec("WATCH", "KEY1") == resp::ok());
+    CHECK(exec("SET", "KEY1", "VAL3") == resp::ok());
+    CHECK(exec("MULTI") == resp::ok());
+    CHECK(exec("SET", "KEY2", "VAL3") == resp::queued());
+    CHECK(exec("EXEC") == resp::nil_array());
+    CHECK(exec("GET", "KEY2") == resp::simple_string("VAL2"sv));
+
+    CHECK(exec("WATCH", "KEY2") == resp::ok());
+    CHECK(exec("FLUSHDB") == resp::ok());
+    CHECK(exec("MULTI") == resp::ok());
+    CHECK(exec("EXEC") == resp::nil_array());
+
+    CHECK(exec("WATCH", "KEY1") == resp::ok());
+    CHECK(g_databases[0].Watched.size() == 1);
+    Context_t::create_or_remove_client(client_id);
+    CHECK(g_databases[0].Watched.empty());
+    Context_t::create_or_remove_client(client_id);
+}
+
+TEST_CASE_FIXTURE(unit_test_fixture, "EVAL EVALSHA SCRIPT") 
+{
+    auto exec = [&](auto... args) { return execute_command(Context_t{client_id}, resp::command{std::string_view{args}...}); };
+    const std::string has_permission = 
+        "local role = redis.call('GET', KEYS[1])\n"
+        "if not role then return 0 end\n"
+        "return redis.call('SISMEMBER', role, ARGV[1])";
+    exec("SADD", "role:editor", "perms:read", "perms:write");
+    exec("SET", "user:bob", "role:editor");
+    CHECK(exec("EVAL", has_permission, "1", "user:bob", "perms:write") == resp::integer(1));
+    CHECK(exec("EVAL", has_permission, "1", "user:bob", "perms:delete") == resp::integer(0));
+    CHECK(exec("EVAL", has_permission, "1", "user:eve", "perms:read") == resp::integer(0));
+
+    const auto sha = sha1::hex(has_permission);
+    CHECK(sha1::hex("abc") == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    CHECK(exec("SCRIPT", "LOAD", has_permission) == resp::simple_string(sha));
+    CHECK(exec("SCRIPT", "EXISTS", sha, "ffff") == "*2\r\n"s + resp::integer(1) + resp::integer(0));
+    CHECK(exec("EVALSHA", to_upper(sha), "1", "user:bob", "perms:read") == resp::integer(1));
+
+    CHECK(exec("EVAL", "local t = {} for i = 1, 3 do t[#t + 1] = redis.call('SET', KEYS[i], i * 10) end return t", 
+               "3", "K1", "K2", "K3") == "*3\r\n"s + resp::simple_string("OK"sv) + resp::simple_string("OK"sv) + resp::simple_string("OK"sv));
+    CHECK(exec("GET", "K2") == resp::simple_string("20"sv));
+    CHECK(exec("EVAL", "return {ARGV[1] .. '!', tonumber(ARGV[2]) + 1, false, nil, 'dropped'}", "0", "x", "41") == 
+          "*3\r\n"s + resp::simple_string("x!"sv) + resp::integer(42) + resp::nil());
+    CHECK(exec("EVAL", "return redis.call('SADD', KEYS[1], 'a')", "1", "user:bob") == resp::error_wrong_type());
+    CHECK(exec("EVAL", "return redis.call('MULTI')", "0").starts_with("-ERR Error running script: "));
+    CHECK(exec("EVAL", "x = 1", "0").starts_with("-ERR Error compiling script: "));
+    CHECK(exec("EVAL", "return " + std::string(100, '(') + "1" + std::string(100, ')'), "0") == resp::integer(1));
+    const auto too_deep = resp::error("Error compiling script: line 1: chunk has too many syntax levels");
+    CHECK(exec("EVAL", "return " + std::string(30000, '(') + "1" + std::string(30000, ')'), "0") == too_deep);
+    std::string nots;
+    for (int i = 0; i < 30000; ++i)
+        nots += "not ";
+    CHECK(exec("EVAL", "return " + nots + "1", "0") == too_deep);
+    CHECK(exec("EVAL", "local t = {} t[1] = t return t", "0") == resp::error("Error running script: reply nested too deeply"));
+    std::weak_ptr<script::table> cycle;
+    {
+        script::heap tables;
+        auto t = tables.make();
+        t->items.push_back(t);
+        cycle = t;
+    }
+    CHECK(cycle.expired());
+    CHECK(exec("EVAL", "return 1", "2", "K1") == resp::error("Number of keys can't be greater than number of args"));
+
+    const auto time_limit = scripting::g_scripts.time_limit;
+    scripting::g_scripts.time_limit = std::chrono::milliseconds(20);
+    CHECK(exec("EVAL", "while true do end", "0") == resp::error("Error running script: script exceeded its time budget"));
+    scripting::g_scripts.time_limit = time_limit;
+
+    CHECK(exec("SCRIPT", "FLUSH") == resp::ok());
+    CHECK(exec("EVALSHA", sha, "1", "user:bob", "perms:read") == resp::error_noscript());
+}
+
+TEST_CASE_FIXTURE(command_stats_test_fixture, "METRICS") 
+{
+    execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    record("GET", 500);
+    record("GET", 3000);
+    record("GET", 20000000, true);
+    auto text = metrics::render(g_databases, g_clients);
+    CHECK(text.find("# TYPE kv_store_commands counter\n") != std::string::npos);
+    CHECK(text.find("kv_store_commands_total{cmd=\"get\"} 3\n") != std::string::npos);
+    CHECK(text.find("kv_store_commands_failed_total{cmd=\"get\"} 1\n") != std::string::npos);
+    CHECK(text.find("kv_store_command_duration_seconds_bucket{cmd=\"get\",le=\"1e-06\"} 1\n") != std::string::npos);
+    CHECK(text.find("kv_store_command_duration_seconds_bucket{cmd=\"get\",le=\"5e-06\"} 2\n") != std::string::npos);
+    CHECK(text.find("kv_store_command_duration_seconds_bucket{cmd=\"get\",le=\"+Inf\"} 3\n") != std::string::npos);
+    CHECK(text.find("kv_store_command_duration_seconds_count{cmd=\"get\"} 3\n") != std::string::npos);
+    CHECK(text.find("kv_store_keys{db=\"0\"} 1\n") != std::string::npos);
+    CHECK(text.find("kv_store_connected_clients 1\n") != std::string::npos);
+    CHECK(text.find("kv_store_zmq_events_total{event=\"accepted\"} ") != std::string::npos);
+    CHECK(text.ends_with("# EOF\n"));
+
+    auto render = []() { return std::string{"# EOF\n"}; };
+    CHECK(metrics::http_response("GET /metrics HTTP/1.1\r\nHost: x\r\n", render).empty());
+    auto reply = metrics::http_response("GET /metrics?x=1 HTTP/1.1\r\nHost: x\r\n\r\n", render);
+    CHECK(reply.starts_with("HTTP/1.1 200 OK\r\n"));
+    CHECK(reply.find("Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n") != std::string::npos);
+    CHECK(reply.ends_with("Content-Length: 6\r\nConnection: close\r\n\r\n# EOF\n"));
+    CHECK(metrics::http_response("GET / HTTP/1.1\r\n\r\n", render).starts_with("HTTP/1.1 404"));
+    CHECK(metrics::http_response("POST /metrics HTTP/1.1\r\n\r\n", render).starts_with("HTTP/1.1 405"));
+    CHECK(metrics::http_response(std::string(metrics::MAX_REQUEST_SIZE, 'x'), render).starts_with("HTTP/1.1 431"));
+}
+
+struct hotkeys_test_fixture : unit_test_fixture
+{
+    hotkeys_test_fixture()
+    {
+        hotkeys::g_sampler.sample_rate = 1;
+    }
+
+    ~hotkeys_test_fixture()
+    {
+        hotkeys::g_sampler.sample_rate = hotkeys::DEFAULT_SAMPLE_RATE;
+        hotkeys::g_sampler.reset();
+    }
+
+    void access(const std::string& key, int times)
+    {
+        auto& client = Context_t{client_id}.Client();
+        for (int i = 0; i < times; ++i)
+            hotkeys::g_sampler.record(client.CurrentDbNumber, client.CurrentDb(), key);
+    }
+};
+
+TEST_CASE_FIXTURE(hotkeys_test_fixture, "HOTKEYS BIGKEYS") 
+{
+    execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY1"sv, "VAL1"sv});
+    execute_command(Context_t{client_id}, resp::command{"SADD"sv, "SET1"sv, "A"sv, "B"sv, "C"sv});
+    for (int i = 0; i < 50; ++i)
+        execute_command(Context_t{client_id}, resp::command{"SET"sv, std::string_view{"COLD" + std::to_string(i)}, "V"sv});
+    for (int i = 0; i < 50; ++i)
+        access("COLD" + std::to_string(i), 1);
+    access("KEY1", 100);
+    access("SET1", 10);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"HOTKEYS"sv, "2"sv}) ==
+        "*2\r\n*3\r\n$4\r\nKEY1\r\n:0\r\n:+100\r\n*3\r\n$4\r\nSET1\r\n:0\r\n:+10\r\n");
+    CHECK(execute_command(Context_t{client_id}, resp::command{"OBJECT"sv, "FREQ"sv, "KEY1"sv}) == resp::integer(100));
+    CHECK(execute_command(Context_t{client_id}, resp::command{"OBJECT"sv, "FREQ"sv, "MISSING"sv}) == resp::nil());
+    auto cmd_reply = execute_command(Context_t{client_id}, resp::command{"BIGKEYS"sv, "1"sv});
+    CHECK(cmd_reply.starts_with("*1\r\n*5\r\n$4\r\nSET1\r\n:0\r\n$3\r\nset\r\n:"));
+    CHECK(cmd_reply.ends_with("\r\n:+3\r\n"));
+    execute_command(Context_t{client_id}, resp::command{"DEL"sv, "SET1"sv});
+    CHECK(execute_command(Context_t{client_id}, resp::command{"BIGKEYS"sv}).find("SET1") == std::string::npos);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"HOTKEYS"sv, "X"sv}) == resp::error_value_is_not_an_integer_or_out_of_range());
+}
+
+TEST_CASE_FIXTURE(unit_test_fixture, "MEMORY USAGE") 
+{
+    std::string big(1000, 'x');
+    execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY1"sv, "V"sv});
+    execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY2"sv, std::string_view{big}});
+    auto small_usage = execute_command(Context_t{client_id}, resp::command{"MEMORY"sv, "USAGE"sv, "KEY1"sv});
+    auto big_usage = execute_command(Context_t{client_id}, resp::command{"MEMORY"sv, "USAGE"sv, "KEY2"sv});
+    CHECK(std::stoul(big_usage.substr(1)) >= std::stoul(small_usage.substr(1)) + 1000);
+    for (int i = 0; i < 100; ++i)
+        execute_command(Context_t{client_id}, resp::command{"SADD"sv, "SET1"sv, std::string_view{std::to_string(i)}});
+    auto all = execute_command(Context_t{client_id}, resp::command{"MEMORY"sv, "USAGE"sv, "SET1"sv, "SAMPLES"sv, "0"sv});
+    auto sampled = execute_command(Context_t{client_id}, resp::command{"MEMORY"sv, "USAGE"sv, "SET1"sv});
+    CHECK(all == sampled);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"MEMORY"sv, "USAGE"sv, "MISSING"sv}) == resp::nil());
+    CHECK(execute_command(Context_t{client_id}, resp::command{"MEMORY"sv, "USAGE"sv, "SET1"sv, "COUNT"sv, "1"sv}) == resp::error_syntax_error());
+    CHECK(execute_command(Context_t{client_id}, resp::command{"MEMORY"sv, "DOCTOR"sv}) == resp::error_unknown_subcommand("DOCTOR"));
+}
+
+TEST_CASE_FIXTURE(unit_test_fixture, "TRACE") 
+{
+    if (!tracing::ENABLED)
+    {
+        CHECK(execute_command(Context_t{client_id}, resp::command{"TRACE"sv, "RESET"sv}).starts_with("-"));
+        return;
+    }
+    CHECK(execute_command(Context_t{client_id}, resp::command{"TRACE"sv, "RESET"sv}) == resp::ok());
+    execute_command(Context_t{client_id}, resp::command{"SET"sv, "KEY1"sv, "V"sv});
+    std::ostringstream oss;
+    CHECK(tracing::write_json(oss) >= 1);
+    CHECK(oss.str().find("{\"name\":\"dispatch\",\"cat\":\"kv\",\"ph\":\"X\"") != std::string::npos);
+    CHECK(oss.str().find("\"args\":{\"arg\":\"SET\"}") != std::string::npos);
+    CHECK(execute_command(Context_t{client_id}, resp::command{"TRACE"sv, "STOP"sv}) == resp::error_unknown_subcommand("STOP"));
+}
+
+TEST_CASE("SPSC QUEUE") 
+{
+    spsc_queue<std::string, 4> queue;
+    std::string value;
+    CHECK(!queue.try_pop(value));
+    for (int i = 0; i < 4; ++i)
+        CHECK(queue.try_push(std::to_string(i)));
+    std::string extra = "4";
+    CHECK(!queue.try_push(std::move(extra)));
+    CHECK(extra == "4");
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK(queue.try_pop(value));
+        CHECK(value == std::to_string(i));
+    }
+    CHECK(!queue.try_pop(value));
+
+    constexpr std::uint64_t COUNT = 100000;
+    spsc_queue<std::uint64_t, 64> numbers;
+    std::thread producer([&]() {
+        for (std::uint64_t i = 1; i <= COUNT; ++i)
+            while (!numbers.try_push(std::uint64_t{i}))
+                std::this_thread::yield();
+    });
+    std::uint64_t expected = 1, number;
+    bool ordered = true;
+    while (expected <= COUNT)
+        if (numbers.try_pop(number))
+            ordered = ordered && number == expected++;
+    producer.join();
+    CHECK(ordered);
+}
+
+TEST_CASE("SHUTDOWN") 
+{
+    lifecycle::state state;
+    state.open();
+    CHECK(!state.shutdown_requested());
+    CHECK(state.current_phase() == lifecycle::phase::RUNNING);
+    state.request_shutdown(SIGTERM);
+    CHECK(state.shutdown_requested());
+    CHECK(state.signal() == SIGTERM);
+#ifndef _WIN32
+    REQUIRE(state.handle() != -1);
+    std::uint64_t value = 0;
+    CHECK(::read(state.handle(), &value, sizeof(value)) > 0);
+#endif
+    state.enter(lifecycle::phase::DRAINING);
+    CHECK(state.current_phase() == lifecycle::phase::DRAINING);
+
+    snapshot::persistence_state persistence;
+    persistence.changes_since_last_save = 10;
+    persistence.saved(true, 6);     //a background save wrote 6, 4 arrived while it ran
+    CHECK(persistence.changes_since_last_save == 4);
+    persistence.saved(false);
+    CHECK(persistence.changes_since_last_save == 4);
+    persistence.saved(true);
+    CHECK(persistence.changes_since_last_save == 0);
+}
+
+TEST_CASE("CLIENT OUTPUT BUFFER LIMIT") 
+{
+    auto limits = client_output::parse("1mb 256KB 2");
+    REQUIRE(limits);
+    CHECK(limits->hard == 1024 * 1024);
+    CHECK(limits->soft == 256 * 1024);
+    CHECK(limits->soft_seconds == std::chrono::seconds{2});
+    CHECK(limits->pause_above() == 256 * 1024);
+    CHECK(client_output::parse("0 0 0"));
+    CHECK(!client_output::parse("1mb 256kb"));
+    CHECK(!client_output::parse("1mb 256kb 2 3"));
+    CHECK(!client_output::parse("1tb 256kb 2"));
+    CHECK(!client_output::parse("1mb 256kb -2"));
+
+    using namespace std::chrono_literals;
+    const auto t0 = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point since{};
+    CHECK(!client_output::exceeded(*limits, 1024, since, t0));
+    CHECK(!client_output::exceeded(*limits, 300 * 1024, since, t0));
+    CHECK(since == t0);
+    CHECK(!client_output::exceeded(*limits, 300 * 1024, since, t0 + 1s));
+    CHECK(!client_output::exceeded(*limits, 1024, since, t0 + 1s));     //back below, the time restarts
+    CHECK(!client_output::exceeded(*limits, 300 * 1024, since, t0 + 2s));
+    CHECK(client_output::exceeded(*limits, 300 * 1024, since, t0 + 4s));
+    CHECK(client_output::exceeded(*limits, 1024 * 1024, since, t0));
+}
+
+TEST_CASE("TIMER WHEEL") 
+{
+    using namespace std::chrono_literals;
+    const auto t0 = std::chrono::steady_clock::now();
+    timer_wheel<int, 8> wheel{1s, t0};
+    wheel.schedule(1, t0 + 2s);
+    wheel.schedule(2, t0 + 20s);    //more than one revolution away
+    wheel.schedule(3, t0 + 2s);
+    std::vector<int> expired;
+    auto collect = [&](int key) { expired.push_back(key); };
+    wheel.advance(t0 + 1s, collect);
+    CHECK(expired.empty());
+    wheel.advance(t0 + 2s, collect);
+    CHECK(expired == std::vector<int>{1, 3});
+    wheel.schedule(4, t0 + 5s);
+    wheel.advance(t0 + 12s, collect);
+    CHECK(expired == std::vector<int>{1, 3, 4});
+    CHECK(wheel.size() == 1);
+    wheel.advance(t0 + 20s, [&](int key) { expired.push_back(key); wheel.schedule(key, t0 + 30s); });
+    CHECK(expired == std::vector<int>{1, 3, 4, 2});
+    CHECK(wheel.size() == 1);
+    wheel.advance(t0 + 100s, collect);     //a long pause visits each bucket once
+    CHECK(expired.back() == 2);
+    CHECK(wheel.size() == 0);
 }
\ No newline at end of file